@@ -0,0 +1,27 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+; PRG header: signature, byte count, checksum (see scripts/signprg.py)
+DB 0x50,0x00,0x00,0x00,0x00
+
+; padding up to the entry point at $A010 (11 bytes)
+DB 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
+
+jp __Start
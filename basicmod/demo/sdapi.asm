@@ -0,0 +1,43 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+SECTION code_user
+
+;-------------------------------------------------------------------------------
+; Entry points of the SD-card API of the launcher. The launcher places a jump
+; table at these fixed addresses before a PRG program is started (see
+; src/sdapi.asm). The layout must be kept in sync with src/sdapi.asm.
+;-------------------------------------------------------------------------------
+
+PUBLIC _sdapi_version
+PUBLIC _sdapi_open
+PUBLIC _sdapi_size
+PUBLIC _sdapi_seek
+PUBLIC _sdapi_read
+PUBLIC _sdapi_read_sectors
+PUBLIC _sdapi_read_sectors_ram
+
+defc _sdapi_version             = $6162
+defc _sdapi_open                = $6165
+defc _sdapi_size                = $6168
+defc _sdapi_seek                = $616B
+defc _sdapi_read                = $616E
+defc _sdapi_read_sectors        = $6171
+defc _sdapi_read_sectors_ram    = $6174
@@ -0,0 +1,104 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _SDAPI_H
+#define _SDAPI_H
+
+/*
+ * SD-card file access for PRG programs launched from the LAUNCHER. The
+ * routines live in the launcher and are reached through a jump table at
+ * $6160 (see sdapi.asm). Always check sdapi_present() before calling any of
+ * them, as the table is absent when the program is started otherwise.
+ *
+ * Files are opened relative to the folder from which the program was started.
+ * The routines select RAM bank 0 of the cartridge and do not preserve IY.
+ * They cache data in $0000-$0FFF and $FE00-$FFFF of RAM bank 0, which
+ * programs should leave untouched while a file is open.
+ */
+
+#include <stdint.h>
+
+#define SDAPI_SIGNATURE ((uint8_t*)0x6160)
+
+#define sdapi_present() (SDAPI_SIGNATURE[0] == 'S' && SDAPI_SIGNATURE[1] == 'D')
+
+/**
+ * @brief Return the version of the API
+ *
+ * @return uint8_t API version
+ */
+uint8_t sdapi_version(void);
+
+/**
+ * @brief Open a file in the current folder
+ *
+ * @param filename DOS 8.3 filename, e.g. "LEVEL1.DAT"
+ * @return uint8_t 0 on success, 1 if the file could not be found or is larger
+ *         than 32 MiB - 512 bytes
+ */
+uint8_t sdapi_open(const char* filename);
+
+/**
+ * @brief Return the size of the opened file
+ *
+ * @return uint32_t file size in bytes
+ */
+uint32_t sdapi_size(void);
+
+/**
+ * @brief Set the read position of the opened file
+ *
+ * @param offset byte offset from the start of the file
+ * @return uint8_t 0 on success, 1 if the offset lies beyond the end of file
+ */
+uint8_t sdapi_seek(uint32_t offset);
+
+/**
+ * @brief Read bytes from the current position into internal RAM
+ *
+ * @param dest    internal RAM address
+ * @param nrbytes number of bytes to read
+ * @return uint16_t number of bytes read
+ */
+uint16_t sdapi_read(uint8_t* dest, uint16_t nrbytes);
+
+/**
+ * @brief Read whole 512-byte sectors of the file into internal RAM; this is
+ *        the fastest way to stream data from the SD card
+ *
+ * @param sector first sector (relative to the start of the file)
+ * @param count  number of sectors
+ * @param dest   internal RAM address
+ * @return uint8_t number of sectors read
+ */
+uint8_t sdapi_read_sectors(uint16_t sector, uint8_t count, uint8_t* dest);
+
+/**
+ * @brief Read whole 512-byte sectors of the file into RAM bank 1 of the
+ *        cartridge
+ *
+ * @param sector   first sector (relative to the start of the file)
+ * @param count    number of sectors
+ * @param ram_addr external RAM address
+ * @return uint8_t number of sectors read
+ */
+uint8_t sdapi_read_sectors_ram(uint16_t sector, uint8_t count, uint16_t ram_addr);
+
+#endif // _SDAPI_H
@@ -0,0 +1,98 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * SDDEMO.PRG - shows the first page of SDDEMO.TXT (placed in the same folder
+ * as the program) and measures how fast the complete file can be streamed
+ * into internal RAM via the SD-card API of the launcher.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sdapi.h"
+
+// set printf io
+#pragma printf "%u %lu %s"
+
+#define DEMOFILE "SDDEMO.TXT"
+
+__at (0x5000) char VIDMEM[];
+char* vidmem = VIDMEM;
+
+__at (0x6000) char KEYMEM[];
+char* keymem = KEYMEM;
+
+uint8_t buffer[0x1000]; // room for 8 sectors
+
+void wait_for_key(void) {
+    keymem[0x0C] = 0;
+    while(keymem[0x0C] == 0) {} // wait until a key is pressed
+}
+
+int main(void) {
+    memset(vidmem, 0x00, 0x1000);
+    strcpy(vidmem, "\006\015SD-CARD API DEMO");
+
+    if(!sdapi_present()) {
+        strcpy(&vidmem[0x50*2], "\001SD-card API not available");
+        wait_for_key();
+        return 0;
+    }
+
+    if(sdapi_open(DEMOFILE) != 0) {
+        sprintf(&vidmem[0x50*2], "\001%s not found", DEMOFILE);
+        wait_for_key();
+        return 0;
+    }
+
+    // show the first lines of the text file, read in small chunks
+    uint8_t line = 2;
+    uint8_t col = 0;
+    uint16_t n = 0;
+    while(line < 21 && (n = sdapi_read(buffer, 64)) != 0) {
+        for(uint16_t i=0; i<n && line < 21; i++) {
+            if(buffer[i] == '\n' || col == 40) {
+                line++;
+                col = 0;
+            }
+            if(buffer[i] >= 0x20 && buffer[i] < 0x7F) {
+                vidmem[0x50*line + col++] = buffer[i];
+            }
+        }
+    }
+
+    // stream the complete file 8 sectors at a time and time it using the
+    // 20 ms interrupt counter of the monitor
+    uint16_t sector = 0;
+    uint8_t nrsectors = 0;
+    const uint16_t t0 = *(uint16_t*)0x6010;
+    while((nrsectors = sdapi_read_sectors(sector, 8, buffer)) != 0) {
+        sector += nrsectors;
+    }
+    const uint16_t ticks = *(uint16_t*)0x6010 - t0;
+
+    sprintf(&vidmem[0x50*22], "\002%lu bytes in %u ms", sdapi_size(), ticks * 20);
+    strcpy(&vidmem[0x50*23], "\003Press any key to return");
+    wait_for_key();
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * p2000t-bench: runs the firmware headless against an SD card image and
+ * reports the cost of the operations selected by a scenario file.
+ *
+ * Scenario commands, one per line ('#' starts a comment):
+ *
+ *   load <file> [slot1]        put a binary at 0x7000, or in the SLOT1 area
+ *   map <file>                 read the symbols of the z88dk .map file
+ *   memory <16|32|40>          memory model reported at 0x605C
+ *   card <sdhc|sdsc> [latency] addressing of the card and the 0xFF bytes
+ *                              before each data token (default 16)
+ *   boot                       power on and jump into the program
+ *   stop <symbol|0xaddr> ...   end the run when execution gets there
+ *   measure <label> <symbol>.. time all calls of the functions during the
+ *                              next wait, excluding time spent on keys
+ *   type <text>                type text followed by RETURN
+ *   key <name|code> ...        press keys: enter, space, up, down, left,
+ *                              right or a key code from ascii.h
+ *   wait [done] [seconds]      run until the firmware waits for a key, or
+ *                              with 'done' until the measured calls returned
+ *   expect <text>              fail unless text is on the screen
+ *   screen                     print the screen
+ *
+ * With -p, the markers that the profiling builds write to PROFILE_PORT are
+ * stored as "T-states value" lines for scripts/profile.py.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "machine.h"
+
+#define WAIT_SECONDS    60
+
+typedef struct {
+    char binary[32];
+    char label[32];
+    uint64_t calls;
+    uint64_t cycles;
+    CartStats stats;
+} Result;
+
+static Result results[256];
+static int nresults = 0;
+static int verbose = 0;
+static FILE *capture = NULL;       // profiling markers of all scenarios
+
+static const struct {
+    const char *name;
+    uint8_t code;
+} keynames[] = {
+    {"enter", 52}, {"space", 17}, {"up", 2}, {"down", 21}, {"left", 0}, {"right", 23},
+};
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: p2000t-bench [-v] [-c results.csv] [-p capture.txt] -i image scenario...\n");
+    exit(2);
+}
+
+static char *strip(char *s) {
+    while(isspace((unsigned char)*s)) {
+        s++;
+    }
+    char *e = s + strlen(s);
+    while(e > s && isspace((unsigned char)e[-1])) {
+        *--e = 0;
+    }
+    return s;
+}
+
+// split off the next (optionally quoted) word
+static char *next_word(char **s) {
+    char *p = *s;
+    while(isspace((unsigned char)*p)) {
+        p++;
+    }
+    if(!*p) {
+        return NULL;
+    }
+
+    char *w = p;
+    if(*p == '"') {
+        w = ++p;
+        while(*p && *p != '"') {
+            p++;
+        }
+    } else {
+        while(*p && !isspace((unsigned char)*p)) {
+            p++;
+        }
+    }
+    if(*p) {
+        *p++ = 0;
+    }
+    *s = p;
+    return w;
+}
+
+static void collect(Machine *m, const char *binary) {
+    for(int i=0; i<m->nprobes; i++) {
+        Probe *p = &m->probes[i];
+        if(!p->armed) {
+            continue;
+        }
+        p->armed = 0;
+        if(nresults < (int)(sizeof(results) / sizeof(Result))) {
+            Result *r = &results[nresults++];
+            snprintf(r->binary, sizeof(r->binary), "%s", binary);
+            snprintf(r->label, sizeof(r->label), "%s", p->label);
+            r->calls = p->calls;
+            r->cycles = p->cycles;
+            r->stats = p->stats;
+        }
+    }
+}
+
+static int run_scenario(const char *filename, const char *image) {
+    FILE *f = fopen(filename, "r");
+    if(!f) {
+        fprintf(stderr, "%s: cannot open scenario\n", filename);
+        return 1;
+    }
+
+    Machine *m = malloc(sizeof(Machine));
+    if(machine_init(m, image) != 0) {
+        fprintf(stderr, "%s: cannot open image\n", image);
+        fclose(f);
+        free(m);
+        return 1;
+    }
+    m->capture = capture;
+
+    char line[256];
+    char binary[32] = "";
+    int slot1 = 0;
+    int lineno = 0;
+    int errors = 0;
+
+    while(fgets(line, sizeof(line), f) && errors == 0) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if(hash) {
+            *hash = 0;
+        }
+        char *rest = strip(line);
+        char *cmd = next_word(&rest);
+        char *arg;
+        if(!cmd) {
+            continue;
+        }
+
+        if(strcmp(cmd, "load") == 0) {
+            char *file = next_word(&rest);
+            arg = next_word(&rest);
+            slot1 = arg && strcmp(arg, "slot1") == 0;
+            if(!file || machine_load(m, file, slot1) != 0) {
+                fprintf(stderr, "%s:%i: cannot load %s\n", filename, lineno, file ? file : "");
+                errors++;
+                break;
+            }
+            const char *base = strrchr(file, '/');
+            snprintf(binary, sizeof(binary), "%s", base ? base + 1 : file);
+        } else if(strcmp(cmd, "map") == 0) {
+            arg = next_word(&rest);
+            if(!arg || machine_load_map(m, arg) <= 0) {
+                fprintf(stderr, "%s:%i: cannot read map file\n", filename, lineno);
+                errors++;
+            }
+        } else if(strcmp(cmd, "memory") == 0) {
+            arg = next_word(&rest);
+            int kb = arg ? atoi(arg) : 40;
+            m->mem[MEMSIZE_FLAG] = (uint8_t)(kb <= 16 ? 1 : (kb <= 32 ? 2 : 3));
+        } else if(strcmp(cmd, "card") == 0) {
+            arg = next_word(&rest);
+            if(!arg || (strcmp(arg, "sdhc") != 0 && strcmp(arg, "sdsc") != 0)) {
+                fprintf(stderr, "%s:%i: invalid card\n", filename, lineno);
+                errors++;
+                break;
+            }
+            m->cart.sdsc = strcmp(arg, "sdsc") == 0;
+            if((arg = next_word(&rest))) {
+                m->cart.read_latency = (uint16_t)atoi(arg);
+            }
+        } else if(strcmp(cmd, "boot") == 0) {
+            uint8_t flag = m->mem[MEMSIZE_FLAG];
+            machine_boot(m, slot1);
+            if(flag) {
+                m->mem[MEMSIZE_FLAG] = flag;
+            }
+        } else if(strcmp(cmd, "stop") == 0) {
+            while((arg = next_word(&rest)) && m->nbreak < MAX_BREAK) {
+                if(machine_symbol(m, arg, &m->breakpoints[m->nbreak]) != 0) {
+                    fprintf(stderr, "%s:%i: unknown symbol %s\n", filename, lineno, arg);
+                    errors++;
+                }
+                m->nbreak++;
+            }
+        } else if(strcmp(cmd, "measure") == 0) {
+            char *label = next_word(&rest);
+            if(!label || m->nprobes == MAX_PROBES) {
+                fprintf(stderr, "%s:%i: invalid measurement\n", filename, lineno);
+                errors++;
+                break;
+            }
+            Probe *p = &m->probes[m->nprobes];
+            memset(p, 0, sizeof(Probe));
+            snprintf(p->label, sizeof(p->label), "%s", label);
+            while((arg = next_word(&rest)) && p->naddr < MAX_PROBE_ADDR) {
+                uint16_t addr;
+                if(machine_symbol(m, arg, &addr) != 0) {
+                    fprintf(stderr, "%s:%i: unknown symbol %s\n", filename, lineno, arg);
+                    errors++;
+                    continue;
+                }
+                p->addr[p->naddr++] = addr;
+                m->probe_at[addr] = (uint8_t)(m->nprobes + 1);
+            }
+            p->armed = 1;
+            m->nprobes++;
+        } else if(strcmp(cmd, "type") == 0) {
+            for(char *c = rest; *c; c++) {
+                int code = machine_keycode(*c);
+                if(code < 0) {
+                    fprintf(stderr, "%s:%i: no key for '%c'\n", filename, lineno, *c);
+                    errors++;
+                    break;
+                }
+                machine_key(m, (uint8_t)code);
+            }
+            machine_key(m, 52);
+        } else if(strcmp(cmd, "key") == 0) {
+            while((arg = next_word(&rest))) {
+                int code = -1;
+                for(size_t i=0; i<sizeof(keynames) / sizeof(keynames[0]); i++) {
+                    if(strcmp(arg, keynames[i].name) == 0) {
+                        code = keynames[i].code;
+                    }
+                }
+                if(code < 0 && isdigit((unsigned char)arg[0])) {
+                    code = atoi(arg);
+                }
+                if(code < 0 || code > 255) {
+                    fprintf(stderr, "%s:%i: unknown key %s\n", filename, lineno, arg);
+                    errors++;
+                    break;
+                }
+                machine_key(m, (uint8_t)code);
+            }
+        } else if(strcmp(cmd, "wait") == 0) {
+            int until = RUN_IDLE;
+            int seconds = WAIT_SECONDS;
+            while((arg = next_word(&rest))) {
+                if(strcmp(arg, "done") == 0) {
+                    until = RUN_DONE;
+                } else {
+                    seconds = atoi(arg);
+                }
+            }
+            int res = machine_run(m, until, (uint64_t)seconds * CPU_CLOCK);
+            if(res == RUN_TIMEOUT) {
+                fprintf(stderr, "%s:%i: no progress after %i seconds\n", filename, lineno, seconds);
+                errors++;
+            }
+            if(res == RUN_STOPPED && verbose) {
+                fprintf(stderr, "%s:%i: %s\n", filename, lineno, m->stop_reason);
+            }
+            for(int i=0; i<m->nprobes; i++) {
+                Probe *p = &m->probes[i];
+                if(p->armed && (p->calls == 0 || p->active)) {
+                    fprintf(stderr, "%s:%i: '%s' did not complete%s%s\n", filename, lineno,
+                            p->label, m->stopped ? ": " : "", m->stopped ? m->stop_reason : "");
+                    errors++;
+                }
+            }
+            collect(m, binary);
+        } else if(strcmp(cmd, "expect") == 0) {
+            char screen[24 * 41 + 1];
+            machine_screen(m, screen);
+            if(!strstr(screen, rest)) {
+                fprintf(stderr, "%s:%i: '%s' not on screen:\n%s", filename, lineno, rest, screen);
+                errors++;
+            }
+        } else if(strcmp(cmd, "screen") == 0) {
+            char screen[24 * 41 + 1];
+            machine_screen(m, screen);
+            printf("%s", screen);
+        } else {
+            fprintf(stderr, "%s:%i: unknown command %s\n", filename, lineno, cmd);
+            errors++;
+        }
+    }
+
+    fclose(f);
+    machine_free(m);
+    free(m);
+    return errors;
+}
+
+static void print_table(FILE *csv) {
+    printf("%-20s %-14s %6s %12s %10s %8s %8s %10s\n",
+           "binary", "operation", "calls", "T-states", "ms", "SD cmds", "sectors", "ext RAM");
+    for(int i=0; i<nresults; i++) {
+        Result *r = &results[i];
+        printf("%-20s %-14s %6llu %12llu %10.1f %8llu %8llu %10llu\n",
+               r->binary, r->label, (unsigned long long)r->calls,
+               (unsigned long long)r->cycles, r->cycles * 1000.0 / CPU_CLOCK,
+               (unsigned long long)r->stats.sd_commands,
+               (unsigned long long)(r->stats.sectors_read + r->stats.sectors_written),
+               (unsigned long long)(r->stats.ram_reads + r->stats.ram_writes));
+    }
+
+    if(csv) {
+        fprintf(csv, "binary,operation,calls,tstates,sd_commands,sectors_read,"
+                     "sectors_written,ram_reads,ram_writes,rom_reads,rom_programs\n");
+        for(int i=0; i<nresults; i++) {
+            Result *r = &results[i];
+            fprintf(csv, "%s,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                    r->binary, r->label, (unsigned long long)r->calls,
+                    (unsigned long long)r->cycles,
+                    (unsigned long long)r->stats.sd_commands,
+                    (unsigned long long)r->stats.sectors_read,
+                    (unsigned long long)r->stats.sectors_written,
+                    (unsigned long long)r->stats.ram_reads,
+                    (unsigned long long)r->stats.ram_writes,
+                    (unsigned long long)r->stats.rom_reads,
+                    (unsigned long long)r->stats.rom_programs);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *image = NULL;
+    const char *csvname = NULL;
+    const char *capturename = NULL;
+    int i;
+
+    for(i=1; i<argc && argv[i][0] == '-'; i++) {
+        if(strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            image = argv[++i];
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            csvname = argv[++i];
+        } else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            capturename = argv[++i];
+        } else if(strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else {
+            usage();
+        }
+    }
+    if(!image || i == argc) {
+        usage();
+    }
+
+    if(capturename && !(capture = fopen(capturename, "w"))) {
+        fprintf(stderr, "%s: cannot write\n", capturename);
+        return 1;
+    }
+
+    int errors = 0;
+    for(; i<argc; i++) {
+        errors += run_scenario(argv[i], image);
+    }
+
+    FILE *csv = NULL;
+    if(csvname && !(csv = fopen(csvname, "w"))) {
+        fprintf(stderr, "%s: cannot write\n", csvname);
+        errors++;
+    }
+    print_table(csv);
+    if(csv) {
+        fclose(csv);
+    }
+    if(capture) {
+        fclose(capture);
+    }
+
+    return errors ? 1 : 0;
+}
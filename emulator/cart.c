@@ -0,0 +1,496 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cart.h"
+
+#define R1_IDLE         0x01
+#define R1_ILLEGAL      0x04
+#define R1_ADDRESS      0x20
+
+#define TOKEN_SINGLE    0xFE
+#define TOKEN_MULTI     0xFC
+#define TOKEN_STOP      0xFD
+
+uint16_t crc16_xmodem(const uint8_t *data, size_t len) {
+    uint16_t crc = 0;
+    for(size_t i=0; i<len; i++) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for(int b=0; b<8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint8_t crc7(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for(size_t i=0; i<len; i++) {
+        uint8_t d = data[i];
+        for(int b=0; b<8; b++) {
+            crc <<= 1;
+            if((d ^ crc) & 0x80) {
+                crc ^= 0x09;
+            }
+            d <<= 1;
+        }
+    }
+    return crc & 0x7F;
+}
+
+//------------------------------------------------------------------------------
+// IMAGE
+//------------------------------------------------------------------------------
+
+int cart_open(Cartridge *cart, const char *filename) {
+    struct stat st;
+
+    memset(cart, 0, sizeof(Cartridge));
+    cart->image_fd = open(filename, O_RDONLY);
+    if(cart->image_fd < 0 || fstat(cart->image_fd, &st) != 0 || st.st_size < 512) {
+        return -1;
+    }
+
+    cart->image_size = (size_t)st.st_size;
+    cart->image = mmap(NULL, cart->image_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, cart->image_fd, 0);
+    if(cart->image == MAP_FAILED) {
+        cart->image = NULL;
+        close(cart->image_fd);
+        return -1;
+    }
+
+    // typical values for a class 10 card at the speed of the P2000T
+    cart->init_calls = 2;
+    cart->read_latency = 16;
+    cart->write_busy = 64;
+
+    memset(cart->rom, 0xFF, ROM_SIZE);
+    cart_reset(cart);
+    return 0;
+}
+
+void cart_close(Cartridge *cart) {
+    if(cart->image) {
+        munmap(cart->image, cart->image_size);
+        close(cart->image_fd);
+        cart->image = NULL;
+    }
+}
+
+void cart_reset(Cartridge *cart) {
+    cart->selected = 0;
+    cart->mosi = 0xFF;
+    cart->miso = 0xFF;
+    cart->idle = 1;
+    cart->app_cmd = 0;
+    cart->acmd41_calls = 0;
+    cart->cmdlen = 0;
+    cart->resplen = cart->resppos = 0;
+    cart->reading = 0;
+    cart->writing = 0;
+    cart->busy = 0;
+    cart->ram_bank = 0;
+    cart->rom_bank = 0;
+    cart->flash_state = 0;
+    cart->flash_id = 0;
+    cart->addr = 0;
+    cart->led = 0;
+}
+
+//------------------------------------------------------------------------------
+// SD CARD
+//------------------------------------------------------------------------------
+
+static void respond(Cartridge *cart, const uint8_t *bytes, uint8_t n) {
+    cart->resp[0] = 0xFF;       // one byte of command response time (N_CR)
+    memcpy(&cart->resp[1], bytes, n);
+    cart->resplen = (uint8_t)(n + 1);
+    cart->resppos = 0;
+}
+
+static void respond_r1(Cartridge *cart, uint8_t r1) {
+    respond(cart, &r1, 1);
+}
+
+// R1 followed by a 16 byte data block (CSD and CID registers)
+static void respond_register(Cartridge *cart, uint8_t *reg) {
+    uint8_t buf[21];
+    reg[15] = (uint8_t)((crc7(reg, 15) << 1) | 1);
+    uint16_t crc = crc16_xmodem(reg, 16);
+    buf[0] = 0x00;
+    buf[1] = 0xFF;
+    buf[2] = TOKEN_SINGLE;
+    memcpy(&buf[3], reg, 16);
+    buf[19] = (uint8_t)(crc >> 8);
+    buf[20] = (uint8_t)(crc & 0xFF);
+    respond(cart, buf, sizeof(buf));
+}
+
+static int valid_block(Cartridge *cart, uint32_t lba) {
+    return (uint64_t)(lba + 1) * 512 <= cart->image_size;
+}
+
+static void start_block(Cartridge *cart) {
+    cart->read_pos = -(int)cart->read_latency - 1;
+    cart->read_crc = crc16_xmodem(&cart->image[(size_t)cart->read_lba * 512], 512);
+}
+
+static void execute_command(Cartridge *cart) {
+    uint8_t idx = cart->cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)cart->cmd[1] << 24) | ((uint32_t)cart->cmd[2] << 16) |
+                   ((uint32_t)cart->cmd[3] << 8) | cart->cmd[4];
+    uint8_t app = cart->app_cmd;
+    uint8_t r1 = cart->idle ? R1_IDLE : 0x00;
+
+    cart->stats.sd_commands++;
+    cart->stats.sd_cmd[idx]++;
+    cart->app_cmd = 0;
+
+    if(app && idx == 41) {
+        if(++cart->acmd41_calls >= cart->init_calls) {
+            cart->idle = 0;
+        }
+        respond_r1(cart, cart->idle ? R1_IDLE : 0x00);
+        return;
+    }
+
+    switch(idx) {
+        case 0:     // GO_IDLE_STATE
+            cart->idle = 1;
+            cart->acmd41_calls = 0;
+            cart->reading = cart->writing = 0;
+            respond_r1(cart, R1_IDLE);
+            break;
+        case 8: {   // SEND_IF_COND
+            uint8_t r7[5] = {r1, 0x00, 0x00, (uint8_t)(arg >> 8) & 0x0F, (uint8_t)arg};
+            respond(cart, r7, 5);
+            break;
+        }
+        case 9: {   // SEND_CSD, version 2.0 layout, or 1.0 for an SDSC card
+            if(cart->sdsc) {
+                // 512-byte blocks, C_SIZE_MULT 7: units of 256 KiB
+                uint32_t csize = (uint32_t)(cart->image_size / (256 * 1024));
+                csize = csize ? (csize > 4096 ? 4095 : csize - 1) : 0;
+                uint8_t csd[16] = {0x00, 0x26, 0x00, 0x32, 0x5F, 0x59,
+                                   (uint8_t)(0x80 | ((csize >> 10) & 0x03)), (uint8_t)(csize >> 2),
+                                   (uint8_t)(((csize & 0x03) << 6) | 0x36), 0xDB, 0xFF,
+                                   0x80, 0x0A, 0x40, 0x00, 0x00};
+                respond_register(cart, csd);
+                break;
+            }
+            uint32_t csize = (uint32_t)(cart->image_size / (512 * 1024));
+            csize = csize ? csize - 1 : 0;
+            uint8_t csd[16] = {0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00,
+                               (uint8_t)((csize >> 16) & 0x3F), (uint8_t)(csize >> 8),
+                               (uint8_t)csize, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x00};
+            respond_register(cart, csd);
+            break;
+        }
+        case 10: {  // SEND_CID
+            uint8_t cid[16] = {0x50, 'P', '2', 'E', 'M', 'U', 'S', 'D', 0x10,
+                               0x00, 0x00, 0x00, 0x01, 0x01, 0x8A, 0x00};
+            respond_register(cart, cid);
+            break;
+        }
+        case 12:    // STOP_TRANSMISSION, answered after a stuff byte
+            cart->reading = 0;
+            cart->resp[0] = 0xFF;
+            cart->resp[1] = 0xFF;
+            cart->resp[2] = 0x00;
+            cart->resplen = 3;
+            cart->resppos = 0;
+            cart->busy = 4;
+            break;
+        case 13: {  // SEND_STATUS
+            uint8_t r2[2] = {r1, 0x00};
+            respond(cart, r2, 2);
+            break;
+        }
+        case 16:    // SET_BLOCKLEN, block addressed cards only accept 512
+            respond_r1(cart, arg == 512 ? r1 : (uint8_t)(r1 | 0x40));
+            break;
+        case 17:    // READ_SINGLE_BLOCK
+        case 18:    // READ_MULTIPLE_BLOCK
+            if(cart->sdsc) {
+                arg = arg & 0x1FF ? 0xFFFFFFFF : arg >> 9;
+            }
+            if(cart->idle) {
+                respond_r1(cart, R1_ILLEGAL | R1_IDLE);
+            } else if(!valid_block(cart, arg)) {
+                respond_r1(cart, R1_ADDRESS);
+            } else {
+                respond_r1(cart, 0x00);
+                cart->reading = idx == 17 ? 1 : 2;
+                cart->read_lba = arg;
+                start_block(cart);
+            }
+            break;
+        case 24:    // WRITE_BLOCK
+        case 25:    // WRITE_MULTIPLE_BLOCK
+            if(cart->sdsc) {
+                arg = arg & 0x1FF ? 0xFFFFFFFF : arg >> 9;
+            }
+            if(cart->idle) {
+                respond_r1(cart, R1_ILLEGAL | R1_IDLE);
+            } else if(!valid_block(cart, arg)) {
+                respond_r1(cart, R1_ADDRESS);
+            } else {
+                respond_r1(cart, 0x00);
+                cart->writing = idx == 24 ? 1 : 2;
+                cart->write_lba = arg;
+                cart->write_pos = -1;
+            }
+            break;
+        case 55:    // APP_CMD
+            cart->app_cmd = 1;
+            respond_r1(cart, r1);
+            break;
+        case 58: {  // READ_OCR: powered up, 3.2-3.4V, CCS unless SDSC
+            uint8_t r3[5] = {r1, cart->sdsc ? 0x80 : 0xC0, 0xFF, 0x80, 0x00};
+            respond(cart, r3, 5);
+            break;
+        }
+        default:
+            respond_r1(cart, (uint8_t)(r1 | R1_ILLEGAL));
+            break;
+    }
+}
+
+// a byte received while the card expects the data of a write command
+static void receive_write(Cartridge *cart, uint8_t b) {
+    if(cart->write_pos < 0) {
+        if(b == TOKEN_STOP && cart->writing == 2) {
+            cart->writing = 0;
+            cart->busy = cart->write_busy;
+        } else if(b == (cart->writing == 1 ? TOKEN_SINGLE : TOKEN_MULTI)) {
+            cart->write_pos = 0;
+        }
+        return;
+    }
+
+    cart->write_buf[cart->write_pos++] = b;
+    if(cart->write_pos < 514) {
+        return;
+    }
+
+    uint16_t crc = (uint16_t)((cart->write_buf[512] << 8) | cart->write_buf[513]);
+    (void)crc;  // the card runs with CRC checking disabled, as after CMD0
+    memcpy(&cart->image[(size_t)cart->write_lba * 512], cart->write_buf, 512);
+    cart->stats.sectors_written++;
+
+    cart->resp[0] = 0x05;       // data accepted
+    cart->resplen = 1;
+    cart->resppos = 0;
+    cart->busy = cart->write_busy;
+
+    if(cart->writing == 2 && valid_block(cart, cart->write_lba + 1)) {
+        cart->write_lba++;
+        cart->write_pos = -1;
+    } else {
+        cart->writing = 0;
+    }
+}
+
+static uint8_t sd_exchange(Cartridge *cart, uint8_t in) {
+    uint8_t out = 0xFF;
+
+    cart->stats.sd_bytes++;
+    if(!cart->selected) {
+        return 0xFF;
+    }
+
+    // the byte shifted out is determined by the state before this exchange
+    if(cart->resppos < cart->resplen) {
+        out = cart->resp[cart->resppos++];
+    } else if(cart->reading) {
+        if(cart->read_pos < -1) {
+            out = 0xFF;
+        } else if(cart->read_pos == -1) {
+            out = TOKEN_SINGLE;
+            cart->stats.sectors_read++;
+        } else if(cart->read_pos < 512) {
+            out = cart->image[(size_t)cart->read_lba * 512 + (size_t)cart->read_pos];
+        } else {
+            out = cart->read_pos == 512 ? (uint8_t)(cart->read_crc >> 8)
+                                        : (uint8_t)(cart->read_crc & 0xFF);
+        }
+        if(++cart->read_pos == 514) {
+            if(cart->reading == 2 && valid_block(cart, cart->read_lba + 1)) {
+                cart->read_lba++;
+                start_block(cart);
+            } else {
+                cart->reading = 0;
+            }
+        }
+    } else if(cart->busy) {
+        cart->busy--;
+        out = 0x00;
+    }
+
+    // the byte shifted in is either data or part of a command
+    if(cart->writing && cart->cmdlen == 0 && cart->resppos >= cart->resplen && !cart->busy) {
+        receive_write(cart, in);
+    } else if(cart->cmdlen > 0 || (in & 0xC0) == 0x40) {
+        cart->cmd[cart->cmdlen++] = in;
+        if(cart->cmdlen == 6) {
+            cart->cmdlen = 0;
+            execute_command(cart);
+        }
+    }
+
+    return out;
+}
+
+//------------------------------------------------------------------------------
+// FLASH CHIP
+//------------------------------------------------------------------------------
+
+static uint32_t rom_address(Cartridge *cart) {
+    return ((uint32_t)(cart->rom_bank & 0x01) << 16) | cart->addr;
+}
+
+/*
+ * SST39SF010 software command sequences; only A14-A0 take part in the
+ * decoding of the command addresses 0x5555 and 0x2AAA. Byte programs and
+ * sector erases complete instantly.
+ */
+static void rom_write(Cartridge *cart, uint8_t val) {
+    uint16_t a = cart->addr & 0x7FFF;
+    uint32_t full = rom_address(cart);
+
+    switch(cart->flash_state) {
+        case 0:
+        case 3:
+            if(cart->flash_state == 3) { // byte program
+                uint8_t old = cart->rom[full];
+                cart->rom[full] = old & val;
+                cart->stats.rom_programs++;
+                if((old & val) != val) {
+                    cart->stats.rom_program_errors++;
+                }
+                cart->flash_state = 0;
+            } else if(a == 0x5555 && val == 0xAA) {
+                cart->flash_state = 1;
+            } else if(val == 0xF0) {
+                cart->flash_id = 0;
+            }
+            break;
+        case 1:
+        case 4:
+            cart->flash_state = (a == 0x2AAA && val == 0x55) ? cart->flash_state + 1 : 0;
+            break;
+        case 2:
+            cart->flash_state = 0;
+            if(a != 0x5555) {
+                break;
+            }
+            switch(val) {
+                case 0xA0: cart->flash_state = 3; break;
+                case 0x80: cart->flash_state = 6; break;
+                case 0x90: cart->flash_id = 1; break;
+                case 0xF0: cart->flash_id = 0; break;
+            }
+            break;
+        case 6:
+            cart->flash_state = (a == 0x5555 && val == 0xAA) ? 4 : 0;
+            break;
+        case 5:
+            if(val == 0x30) {
+                memset(&cart->rom[full & ~(uint32_t)(ROM_SECTOR - 1)], 0xFF, ROM_SECTOR);
+                cart->stats.rom_erases++;
+            } else if(a == 0x5555 && val == 0x10) {
+                memset(cart->rom, 0xFF, ROM_SIZE);
+                cart->stats.rom_erases += ROM_SIZE / ROM_SECTOR;
+            }
+            cart->flash_state = 0;
+            break;
+    }
+}
+
+static uint8_t rom_read(Cartridge *cart) {
+    cart->stats.rom_reads++;
+    if(cart->flash_id) {
+        return (cart->addr & 1) ? (uint8_t)(ROM_DEVICE_ID >> 8) : (uint8_t)ROM_DEVICE_ID;
+    }
+    return cart->rom[rom_address(cart)];
+}
+
+//------------------------------------------------------------------------------
+// PORTS
+//------------------------------------------------------------------------------
+
+uint8_t cart_in(Cartridge *cart, uint8_t port) {
+    switch(port) {
+        case PORT_SERIAL:
+            return cart->miso;
+        case PORT_ROM_IO:
+            return rom_read(cart);
+        case PORT_RAM_IO:
+            cart->stats.ram_reads++;
+            return cart->ram[cart->ram_bank][cart->addr];
+        default:
+            return 0xFF;
+    }
+}
+
+void cart_out(Cartridge *cart, uint8_t port, uint8_t val) {
+    switch(port) {
+        case PORT_SERIAL:
+            cart->mosi = val;
+            break;
+        case PORT_CLKSTART:
+            cart->miso = sd_exchange(cart, cart->mosi);
+            break;
+        case PORT_DESELECT:
+            cart->selected = 0;
+            break;
+        case PORT_SELECT:
+            cart->selected = 1;
+            break;
+        case PORT_LED_IO:
+            cart->led = val;
+            break;
+        case PORT_ADDR_LOW:
+            cart->addr = (uint16_t)((cart->addr & 0xFF00) | val);
+            break;
+        case PORT_ADDR_HIGH:
+            cart->addr = (uint16_t)((cart->addr & 0x00FF) | (val << 8));
+            break;
+        case PORT_ROM_BANK:
+            cart->rom_bank = val;
+            break;
+        case PORT_RAM_BANK:
+            cart->ram_bank = val & 0x01;
+            break;
+        case PORT_ROM_IO:
+            rom_write(cart, val);
+            break;
+        case PORT_RAM_IO:
+            cart->stats.ram_writes++;
+            cart->ram[cart->ram_bank][cart->addr] = val;
+            break;
+    }
+}
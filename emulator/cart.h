@@ -0,0 +1,161 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _CART_H
+#define _CART_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Model of the SLOT2 cartridge as seen through the I/O ports of ports.inc:
+ * an SD card behind the SPI shift register, 2x64 KiB of RAM and a SST39SF010
+ * flash chip, the latter two addressed via the ADDR_LOW / ADDR_HIGH latches.
+ */
+
+#define PORT_SERIAL     0x40
+#define PORT_CLKSTART   0x41
+#define PORT_DESELECT   0x42
+#define PORT_SELECT     0x43
+#define PORT_LED_IO     0x44
+#define PORT_ADDR_LOW   0x48
+#define PORT_ADDR_HIGH  0x49
+#define PORT_ROM_BANK   0x4A
+#define PORT_RAM_BANK   0x4B
+#define PORT_ROM_IO     0x4C
+#define PORT_RAM_IO     0x4D
+
+#define ROM_SIZE        0x20000     // SST39SF010
+#define ROM_SECTOR      0x1000
+#define ROM_DEVICE_ID   0xB5BF
+
+#define SD_RESP_MAX     32
+
+// counters of the I/O traffic, used to attribute cost to operations
+typedef struct {
+    uint64_t sd_commands;           // commands received by the card
+    uint64_t sd_cmd[64];            // ... per command index
+    uint64_t sd_bytes;              // bytes clocked over SPI
+    uint64_t sectors_read;          // data blocks sent by the card
+    uint64_t sectors_written;       // data blocks received by the card
+    uint64_t ram_reads;             // RAM_IO reads
+    uint64_t ram_writes;            // RAM_IO writes
+    uint64_t rom_reads;             // ROM_IO reads
+    uint64_t rom_programs;          // bytes programmed into the flash chip
+    uint64_t rom_erases;            // sectors erased
+    uint64_t rom_program_errors;    // programs that tried to flip a 0 into a 1
+} CartStats;
+
+typedef struct {
+    // SD card
+    uint8_t *image;                 // private mapping of the card image
+    size_t image_size;
+    int image_fd;
+    uint8_t selected;               // ~CS asserted
+    uint8_t mosi;                   // value latched in the SERIAL register
+    uint8_t miso;                   // last byte received from the card
+    uint8_t idle;                   // card still in the idle state
+    uint8_t app_cmd;                // previous command was CMD55
+    uint16_t acmd41_calls;
+    uint16_t init_calls;            // ACMD41 calls before the card is ready
+    uint16_t read_latency;          // 0xFF bytes preceding each data token
+    uint16_t write_busy;            // busy bytes after each written block
+    uint8_t sdsc;                   // standard capacity card: byte addresses
+    uint8_t cmd[6];
+    uint8_t cmdlen;
+    uint8_t resp[SD_RESP_MAX];      // pending response bytes
+    uint8_t resplen;
+    uint8_t resppos;
+    uint8_t reading;                // 0: idle, 1: CMD17, 2: CMD18
+    uint32_t read_lba;
+    int read_pos;                   // <0: latency, 0-511: data, 512-513: CRC
+    uint16_t read_crc;
+    uint8_t writing;                // 0: idle, 1: CMD24, 2: CMD25
+    uint32_t write_lba;
+    int write_pos;                  // -1: waiting for the start token
+    uint8_t write_buf[514];
+    uint16_t busy;
+
+    // external RAM and ROM
+    uint8_t ram[2][0x10000];
+    uint8_t ram_bank;
+    uint8_t rom[ROM_SIZE];
+    uint8_t rom_bank;
+    uint8_t flash_state;            // position in a command sequence
+    uint8_t flash_id;               // software ID mode
+    uint16_t addr;                  // ADDR_HIGH:ADDR_LOW
+    uint8_t led;
+
+    CartStats stats;
+} Cartridge;
+
+/**
+ * @brief Attach a card image; the mapping is private so that writes by the
+ *        firmware never reach the image file
+ *
+ * @param cart cartridge
+ * @param filename image file
+ * @return 0 on success, -1 on failure
+ */
+int cart_open(Cartridge *cart, const char *filename);
+
+/**
+ * @brief Release the card image
+ *
+ * @param cart cartridge
+ */
+void cart_close(Cartridge *cart);
+
+/**
+ * @brief Power-on state of the card, latches and the flash chip; memory
+ *        contents and the card image are retained
+ *
+ * @param cart cartridge
+ */
+void cart_reset(Cartridge *cart);
+
+/**
+ * @brief Read from one of the cartridge ports
+ *
+ * @param cart cartridge
+ * @param port port number (lower 8 bits are decoded)
+ * @return value on the data bus
+ */
+uint8_t cart_in(Cartridge *cart, uint8_t port);
+
+/**
+ * @brief Write to one of the cartridge ports
+ *
+ * @param cart cartridge
+ * @param port port number (lower 8 bits are decoded)
+ * @param val value on the data bus
+ */
+void cart_out(Cartridge *cart, uint8_t port, uint8_t val);
+
+/**
+ * @brief CRC-16 (XMODEM) as used for the SD data blocks and by crc16.asm
+ *
+ * @param data bytes
+ * @param len number of bytes
+ * @return checksum
+ */
+uint16_t crc16_xmodem(const uint8_t *data, size_t len);
+
+#endif // _CART_H
@@ -0,0 +1,380 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "machine.h"
+#include "../src/ascii.h"       // key code to ASCII table of the launcher
+
+#define MONITOR_CLEAR_LINES 0x0035
+#define MONITOR_ISR         0x0038
+#define ISR_CYCLES          (4 + 14)    // EI and RETI of the handler
+
+//------------------------------------------------------------------------------
+// BUS CALLBACKS
+//------------------------------------------------------------------------------
+
+static uint8_t bus_read(void *ctx, uint16_t addr) {
+    Machine *m = ctx;
+    uint8_t v = m->mem[addr];
+
+    // the firmware polls the number of keys in the buffer while waiting
+    if(addr == KEYCOUNT && v == 0 && !m->key_waiting) {
+        m->key_waiting = 1;
+        m->key_wait_start = m->cpu.cycles;
+    }
+    return v;
+}
+
+static void bus_write(void *ctx, uint16_t addr, uint8_t val) {
+    Machine *m = ctx;
+    if(addr >= VIDMEM) {
+        m->mem[addr] = val;
+    }
+}
+
+static uint8_t bus_in(void *ctx, uint16_t port) {
+    Machine *m = ctx;
+    if((port & 0xF0) == 0x40) {
+        return cart_in(&m->cart, (uint8_t)port);
+    }
+    return 0xFF;
+}
+
+static void bus_out(void *ctx, uint16_t port, uint8_t val) {
+    Machine *m = ctx;
+    if((uint8_t)port == PROFILE_PORT && m->capture) {
+        fprintf(m->capture, "%llu 0x%02X\n", (unsigned long long)m->cpu.cycles, val);
+    }
+    if((port & 0xF0) == 0x40) {
+        cart_out(&m->cart, (uint8_t)port, val);
+    }
+}
+
+//------------------------------------------------------------------------------
+// SET UP
+//------------------------------------------------------------------------------
+
+int machine_init(Machine *m, const char *image) {
+    memset(m, 0, sizeof(Machine));
+    if(cart_open(&m->cart, image) != 0) {
+        return -1;
+    }
+
+    m->cpu.ctx = m;
+    m->cpu.read = bus_read;
+    m->cpu.write = bus_write;
+    m->cpu.in = bus_in;
+    m->cpu.out = bus_out;
+    z80_reset(&m->cpu);
+    return 0;
+}
+
+void machine_free(Machine *m) {
+    cart_close(&m->cart);
+    free(m->symbols);
+    m->symbols = NULL;
+}
+
+int machine_load(Machine *m, const char *filename, int slot1) {
+    FILE *f = fopen(filename, "rb");
+    if(!f) {
+        return -1;
+    }
+
+    size_t n;
+    if(slot1) {
+        n = fread(&m->mem[SLOT1_ADDR], 1, VIDMEM - SLOT1_ADDR, f);
+    } else {
+        n = fread(&m->mem[LAUNCHER_ADDR], 1, 0x10000 - LAUNCHER_ADDR, f);
+        memcpy(m->cart.rom, &m->mem[LAUNCHER_ADDR], n);
+    }
+    fclose(f);
+
+    return n > 0 ? 0 : -1;
+}
+
+int machine_load_map(Machine *m, const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if(!f) {
+        return -1;
+    }
+
+    char line[512];
+    int cap = 0;
+    while(fgets(line, sizeof(line), f)) {
+        char name[64];
+        unsigned addr;
+
+        // _name = $7123 ; addr, public, , main_c, code_compiler, main.c:36
+        if(sscanf(line, "%63s = $%x", name, &addr) != 2 || !strstr(line, "; addr")) {
+            continue;
+        }
+        if(m->nsymbols == cap) {
+            cap = cap ? cap * 2 : 1024;
+            m->symbols = realloc(m->symbols, (size_t)cap * sizeof(Symbol));
+        }
+        strcpy(m->symbols[m->nsymbols].name, name);
+        m->symbols[m->nsymbols].addr = (uint16_t)addr;
+        m->nsymbols++;
+    }
+    fclose(f);
+
+    return m->nsymbols;
+}
+
+int machine_symbol(Machine *m, const char *name, uint16_t *addr) {
+    if(name[0] == '0' && (name[1] == 'x' || name[1] == 'X')) {
+        *addr = (uint16_t)strtoul(name, NULL, 16);
+        return 0;
+    }
+    for(int i=0; i<m->nsymbols; i++) {
+        if(strcmp(m->symbols[i].name, name) == 0) {
+            *addr = m->symbols[i].addr;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void machine_boot(Machine *m, int slot1) {
+    z80_reset(&m->cpu);
+    cart_reset(&m->cart);
+
+    memset(&m->mem[VIDMEM], 0x00, LAUNCHER_ADDR - VIDMEM);
+    m->mem[MEMSIZE_FLAG] = 3;       // 40 KiB model
+    m->key_head = m->key_tail = 0;
+    m->key_waiting = 0;
+    m->next_tick = TICK_CYCLES;
+    m->stopped = 0;
+
+    if(slot1) {
+        // the monitor enters a cartridge after verifying its signature
+        m->exit_below = SLOT1_ADDR;
+        m->cpu.sp = 0x9FFF;
+        m->cpu.pc = SLOT1_ENTRY;
+    } else {
+        // BASICBOOTSTRAP calls the launcher; returning ends the run
+        m->exit_below = VIDMEM;
+        m->cpu.sp = 0xFFF0;
+        m->cpu.sp -= 2;
+        m->mem[m->cpu.sp] = 0x00;
+        m->mem[m->cpu.sp + 1] = 0x00;
+        m->cpu.pc = LAUNCHER_ADDR;
+    }
+}
+
+//------------------------------------------------------------------------------
+// KEYBOARD
+//------------------------------------------------------------------------------
+
+void machine_key(Machine *m, uint8_t code) {
+    int next = (m->key_tail + 1) % KEY_QUEUE;
+    if(next != m->key_head) {
+        m->keys[m->key_tail] = code;
+        m->key_tail = next;
+    }
+}
+
+int machine_keycode(char c) {
+    if(c == '\n') {
+        c = 0x0D;
+    }
+    c = (char)tolower((unsigned char)c);
+    for(unsigned i=0; i<sizeof(__ascii); i++) {
+        if(__ascii[i] == (uint8_t)c) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void stop(Machine *m, const char *reason, uint16_t addr) {
+    m->stopped = 1;
+    snprintf(m->stop_reason, sizeof(m->stop_reason), "%s 0x%04X", reason, addr);
+}
+
+/*
+ * Interrupt handler of the monitor: advance the 20 ms tick counter and put a
+ * queued key in the buffer once the firmware is waiting for one
+ */
+static void monitor_isr(Machine *m) {
+    uint16_t tick = (uint16_t)(m->mem[TICKCOUNTER] | (m->mem[TICKCOUNTER + 1] << 8));
+    tick++;
+    m->mem[TICKCOUNTER] = (uint8_t)tick;
+    m->mem[TICKCOUNTER + 1] = (uint8_t)(tick >> 8);
+
+    if(m->key_head != m->key_tail && m->key_waiting && m->mem[KEYCOUNT] == 0) {
+        m->mem[KEYMEM] = m->keys[m->key_head];
+        m->mem[KEYCOUNT] = 1;
+        m->key_head = (m->key_head + 1) % KEY_QUEUE;
+
+        // time spent waiting for the key is not charged to the probes
+        for(int i=0; i<m->nprobes; i++) {
+            Probe *p = &m->probes[i];
+            if(p->active) {
+                uint64_t from = m->key_wait_start > p->start ? m->key_wait_start : p->start;
+                p->excluded += m->cpu.cycles - from;
+            }
+        }
+        m->key_waiting = 0;
+    }
+
+    // EI; RETI
+    m->cpu.pc = (uint16_t)(m->mem[m->cpu.sp] | (m->mem[(uint16_t)(m->cpu.sp + 1)] << 8));
+    m->cpu.sp += 2;
+    m->cpu.iff1 = m->cpu.iff2 = 1;
+    m->cpu.cycles += ISR_CYCLES;
+}
+
+static void monitor_clear_lines(Machine *m) {
+    uint16_t hl = m->cpu.hl;
+    uint16_t n = (uint16_t)((m->cpu.af >> 8) * 0x50);
+    for(uint16_t i=0; i<n; i++) {
+        bus_write(m, (uint16_t)(hl + i), 0x00);
+    }
+    m->cpu.pc = (uint16_t)(m->mem[m->cpu.sp] | (m->mem[(uint16_t)(m->cpu.sp + 1)] << 8));
+    m->cpu.sp += 2;
+    m->cpu.cycles += 0x50 * 24;
+}
+
+//------------------------------------------------------------------------------
+// EXECUTION
+//------------------------------------------------------------------------------
+
+static void probe_enter(Machine *m, Probe *p) {
+    uint16_t sp = m->cpu.sp;
+    p->active = 1;
+    p->ret_pc = (uint16_t)(m->mem[sp] | (m->mem[(uint16_t)(sp + 1)] << 8));
+    p->ret_sp = (uint16_t)(sp + 2);
+    p->start = m->cpu.cycles;
+    p->excluded = 0;
+    p->start_stats = m->cart.stats;
+}
+
+static void probe_leave(Machine *m, Probe *p) {
+    const uint64_t *now = (const uint64_t *)&m->cart.stats;
+    const uint64_t *then = (const uint64_t *)&p->start_stats;
+    uint64_t *acc = (uint64_t *)&p->stats;
+
+    for(size_t i=0; i<sizeof(CartStats) / sizeof(uint64_t); i++) {
+        acc[i] += now[i] - then[i];
+    }
+    p->cycles += m->cpu.cycles - p->start - p->excluded;
+    p->calls++;
+    p->active = 0;
+}
+
+static int probes_done(Machine *m) {
+    int armed = 0;
+    for(int i=0; i<m->nprobes; i++) {
+        Probe *p = &m->probes[i];
+        if(p->armed) {
+            armed++;
+            if(p->active || p->calls == 0) {
+                return 0;
+            }
+        }
+    }
+    return armed > 0;
+}
+
+int machine_run(Machine *m, int until, uint64_t limit) {
+    Z80 *cpu = &m->cpu;
+    uint64_t end = cpu->cycles + limit;
+    int irq = 0;
+
+    while(!m->stopped) {
+        if(cpu->cycles >= m->next_tick) {
+            m->next_tick += TICK_CYCLES;
+            irq = 1;                // the line is held for one tick at most
+        }
+        if(irq && z80_interrupt(cpu)) {
+            irq = 0;
+        }
+
+        uint16_t pc = cpu->pc;
+
+        for(int i=0; i<m->nprobes; i++) {
+            Probe *p = &m->probes[i];
+            if(p->active && pc == p->ret_pc && cpu->sp == p->ret_sp) {
+                probe_leave(m, p);
+                if(until == RUN_DONE && probes_done(m)) {
+                    return RUN_DONE;
+                }
+            }
+        }
+        if(m->probe_at[pc]) {
+            Probe *p = &m->probes[m->probe_at[pc] - 1];
+            if(p->armed && !p->active) {
+                probe_enter(m, p);
+            }
+        }
+        for(int i=0; i<m->nbreak; i++) {
+            if(pc == m->breakpoints[i]) {
+                stop(m, "breakpoint at", pc);
+                return RUN_STOPPED;
+            }
+        }
+
+        if(pc < m->exit_below) {
+            if(pc == MONITOR_ISR) {
+                monitor_isr(m);
+                continue;
+            }
+            if(pc == MONITOR_CLEAR_LINES) {
+                monitor_clear_lines(m);
+                continue;
+            }
+            stop(m, "left the program at", pc);
+            return RUN_STOPPED;
+        }
+        if(cpu->halted && !cpu->iff1) {
+            stop(m, "halted at", pc);
+            return RUN_STOPPED;
+        }
+
+        z80_step(cpu);
+
+        if(until == RUN_IDLE && m->key_waiting && m->key_head == m->key_tail) {
+            return RUN_IDLE;
+        }
+        if(cpu->cycles >= end) {
+            return RUN_TIMEOUT;
+        }
+    }
+
+    return RUN_STOPPED;
+}
+
+void machine_screen(Machine *m, char *buf) {
+    char *p = buf;
+    for(int y=0; y<24; y++) {
+        for(int x=0; x<40; x++) {
+            uint8_t c = m->mem[VIDMEM + y * 0x50 + x];
+            *p++ = (c >= 0x20 && c < 0x7F) ? (char)c : ' ';
+        }
+        *p++ = '\n';
+    }
+    *p = 0;
+}
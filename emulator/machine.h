@@ -0,0 +1,204 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _MACHINE_H
+#define _MACHINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "z80.h"
+#include "cart.h"
+
+/*
+ * Headless P2000T: 0x0000-0x0FFF holds a stand-in for the monitor ROM of
+ * which only the interrupt handler (tick counter and keyboard buffer) and the
+ * clear_lines routine are provided, 0x1000-0x4FFF is the SLOT1 cartridge,
+ * 0x5000 video memory and 0x6000-0xFFFF RAM.
+ */
+
+#define CPU_CLOCK       2500000     // T-states per second
+#define TICK_CYCLES     (CPU_CLOCK / 50)
+
+#define KEYMEM          0x6000
+#define KEYCOUNT        0x600C
+#define TICKCOUNTER     0x6010
+#define MEMSIZE_FLAG    0x605C
+#define VIDMEM          0x5000
+
+#define LAUNCHER_ADDR   0x7000      // where BASICBOOTSTRAP puts the launcher
+#define SLOT1_ADDR      0x1000
+#define SLOT1_ENTRY     0x1010
+
+#define KEY_QUEUE       256
+#define MAX_PROBES      32
+#define MAX_PROBE_ADDR  8
+#define MAX_BREAK       8
+
+#define PROFILE_PORT    0x4F        // markers of the profiling builds
+
+typedef struct {
+    char name[64];
+    uint16_t addr;
+} Symbol;
+
+// accumulated cost of all calls to a set of functions
+typedef struct {
+    char label[32];
+    uint16_t addr[MAX_PROBE_ADDR];
+    int naddr;
+    int armed;                      // calls are being recorded
+    int active;                     // inside a call
+    uint16_t ret_sp;                // stack pointer after the matching return
+    uint16_t ret_pc;
+    uint64_t start;
+    uint64_t excluded;              // time blocked on the keyboard
+    CartStats start_stats;
+    uint64_t calls;
+    uint64_t cycles;
+    CartStats stats;
+} Probe;
+
+typedef struct {
+    Z80 cpu;
+    Cartridge cart;
+    uint8_t mem[0x10000];
+    uint16_t exit_below;            // execution below this address ends a run
+
+    // keyboard
+    uint8_t keys[KEY_QUEUE];
+    int key_head, key_tail;
+    int key_waiting;                // firmware polled an empty key buffer
+    uint64_t key_wait_start;
+
+    uint64_t next_tick;
+    uint16_t breakpoints[MAX_BREAK];
+    int nbreak;
+    int stopped;
+    char stop_reason[64];
+
+    Symbol *symbols;
+    int nsymbols;
+
+    Probe probes[MAX_PROBES];
+    int nprobes;
+    uint8_t probe_at[0x10000];      // probe index + 1 for each entry address
+
+    FILE *capture;                  // receives the profiling markers, if set
+} Machine;
+
+enum {
+    RUN_IDLE,                       // firmware waits for a key that is not queued
+    RUN_DONE,                       // all armed probes have completed a call
+    RUN_STOPPED,                    // execution left the program
+    RUN_TIMEOUT,
+};
+
+/**
+ * @brief Set up a machine with an SD card image
+ *
+ * @param m machine
+ * @param image card image
+ * @return 0 on success, -1 when the image cannot be opened
+ */
+int machine_init(Machine *m, const char *image);
+
+/**
+ * @brief Release the machine
+ *
+ * @param m machine
+ */
+void machine_free(Machine *m);
+
+/**
+ * @brief Put a binary in memory: either in RAM at 0x7000 (and in the flash
+ *        chip, as placed there by the flasher) or in the SLOT1 area
+ *
+ * @param m machine
+ * @param filename binary
+ * @param slot1 whether the binary is a SLOT1 cartridge image
+ * @return 0 on success, -1 on failure
+ */
+int machine_load(Machine *m, const char *filename, int slot1);
+
+/**
+ * @brief Read the symbols of a z88dk .map file
+ *
+ * @param m machine
+ * @param filename map file
+ * @return number of symbols, -1 on failure
+ */
+int machine_load_map(Machine *m, const char *filename);
+
+/**
+ * @brief Find a symbol, or parse a hexadecimal address
+ *
+ * @param m machine
+ * @param name symbol name or 0x-prefixed address
+ * @param addr resulting address
+ * @return 0 on success, -1 when unknown
+ */
+int machine_symbol(Machine *m, const char *name, uint16_t *addr);
+
+/**
+ * @brief Power on: reset the processor and the cartridge and jump into the
+ *        loaded program
+ *
+ * @param m machine
+ * @param slot1 whether the program is a SLOT1 cartridge
+ */
+void machine_boot(Machine *m, int slot1);
+
+/**
+ * @brief Queue a key code (see ascii.h) for the keyboard buffer
+ *
+ * @param m machine
+ * @param code key code
+ */
+void machine_key(Machine *m, uint8_t code);
+
+/**
+ * @brief Translate an ASCII character into a key code
+ *
+ * @param c character
+ * @return key code, -1 if the character has no key
+ */
+int machine_keycode(char c);
+
+/**
+ * @brief Run until the firmware becomes idle, the probes are done, the
+ *        program is left or the time limit passes
+ *
+ * @param m machine
+ * @param until RUN_IDLE or RUN_DONE
+ * @param limit maximum number of T-states
+ * @return reason for returning
+ */
+int machine_run(Machine *m, int until, uint64_t limit);
+
+/**
+ * @brief Copy the visible screen (24 lines of 40 characters) as text
+ *
+ * @param m machine
+ * @param buf buffer of at least 24 * 41 + 1 bytes
+ */
+void machine_screen(Machine *m, char *buf);
+
+#endif // _MACHINE_H
@@ -0,0 +1,62 @@
+# -*- coding: utf-8 -*-
+
+#
+# Build the SD-card image used by the scenarios of p2000t-bench
+#
+# Root folder of the image, in listing order:
+#
+#   1  LAUNCHER.BIN     signed copy of the launcher, for the flash scenario
+#   2  BENCH.CAS        24 KiB cassette program
+#   3  BENCH.CAZ        compressed BENCH.CAS
+#   4  BENCH.PRG        8 KiB PRG program that returns immediately
+#   5  BENCH.PRZ        compressed BENCH.PRG
+#   6  MANY             folder holding 100 small cassette programs
+#   7  BENCH.CAD        direct-load BENCH.CAS
+#
+
+import os
+import sys
+import random
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'scripts'))
+
+from fatimage import FatImage
+from lzpack import pack
+from cas2cad import convert
+from programs import make_cas, make_prg, sign
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='Bench image tool',
+                    description='Create the SD-card image for the emulator scenarios')
+
+    parser.add_argument('image')
+    parser.add_argument('launcher', help='LAUNCHER.BIN to place on the card')
+    parser.add_argument('--seed', type=int, default=2000)
+
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+
+    with open(args.launcher, 'rb') as f:
+        launcher = sign(bytearray(f.read()))
+
+    cas = make_cas('BENCH', 24 * 1024, rng)
+    prg = make_prg(8 * 1024, rng)
+
+    img = FatImage(size_mb=64, sectors_per_cluster=8)
+    img.root.add_file('LAUNCHER.BIN', launcher)
+    img.root.add_file('BENCH.CAS', cas)
+    img.root.add_file('BENCH.CAZ', pack(cas, '.CAS')[0])
+    img.root.add_file('BENCH.PRG', prg)
+    img.root.add_file('BENCH.PRZ', pack(prg, '.PRG')[0])
+    many = img.root.mkdir('MANY')
+    for i in range(100):
+        many.add_file('GAME%03i.CAS' % i, make_cas('GAME%03i' % i, 2048, rng))
+    img.root.add_file('BENCH.CAD', convert(cas)[0])
+    img.save(args.image)
+
+    print('Writing to: %s (%i clusters used)' % (args.image, img.clusters_used))
+
+if __name__ == '__main__':
+    main()
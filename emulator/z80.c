@@ -0,0 +1,863 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "z80.h"
+
+// register access
+#define HI(rp)          ((uint8_t)((rp) >> 8))
+#define LO(rp)          ((uint8_t)((rp) & 0xFF))
+#define SETHI(rp, v)    ((rp) = (uint16_t)(((rp) & 0x00FF) | ((uint16_t)(v) << 8)))
+#define SETLO(rp, v)    ((rp) = (uint16_t)(((rp) & 0xFF00) | (uint8_t)(v)))
+
+#define A               HI(cpu->af)
+#define F               LO(cpu->af)
+#define SETA(v)         SETHI(cpu->af, v)
+#define SETF(v)         SETLO(cpu->af, v)
+
+// T-states of the unprefixed instructions; conditional jumps, calls and
+// returns are listed as not taken
+static const uint8_t cycles_main[256] = {
+     4,10, 7, 6, 4, 4, 7, 4, 4,11, 7, 6, 4, 4, 7, 4,
+     8,10, 7, 6, 4, 4, 7, 4,12,11, 7, 6, 4, 4, 7, 4,
+     7,10,16, 6, 4, 4, 7, 4, 7,11,16, 6, 4, 4, 7, 4,
+     7,10,13, 6,11,11,10, 4, 7,11,13, 6, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     7, 7, 7, 7, 7, 7, 4, 7, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     4, 4, 4, 4, 4, 4, 7, 4, 4, 4, 4, 4, 4, 4, 7, 4,
+     5,10,10,10,10,11, 7,11, 5,10,10, 0,10,17, 7,11,
+     5,10,10,11,10,11, 7,11, 5, 4,10,11,10, 0, 7,11,
+     5,10,10,19,10,11, 7,11, 5, 4,10, 4,10, 0, 7,11,
+     5,10,10, 4,10,11, 7,11, 5, 6,10, 4,10, 0, 7,11,
+};
+
+static uint8_t sz53p[256];      // sign, zero and parity flags of a byte
+static int tables_ready = 0;
+
+static void init_tables(void) {
+    for(int i=0; i<256; i++) {
+        int p = 0;
+        for(int b=0; b<8; b++) {
+            p ^= (i >> b) & 1;
+        }
+        sz53p[i] = (uint8_t)((i & (FLAG_S | FLAG_X | FLAG_Y)) |
+                             (i == 0 ? FLAG_Z : 0) | (p ? 0 : FLAG_PV));
+    }
+    tables_ready = 1;
+}
+
+//------------------------------------------------------------------------------
+// MEMORY ACCESS
+//------------------------------------------------------------------------------
+
+static inline uint8_t rd(Z80 *cpu, uint16_t addr) {
+    return cpu->read(cpu->ctx, addr);
+}
+
+static inline void wr(Z80 *cpu, uint16_t addr, uint8_t val) {
+    cpu->write(cpu->ctx, addr, val);
+}
+
+static inline uint16_t rd16(Z80 *cpu, uint16_t addr) {
+    return (uint16_t)(rd(cpu, addr) | (rd(cpu, (uint16_t)(addr + 1)) << 8));
+}
+
+static inline void wr16(Z80 *cpu, uint16_t addr, uint16_t val) {
+    wr(cpu, addr, LO(val));
+    wr(cpu, (uint16_t)(addr + 1), HI(val));
+}
+
+static inline uint8_t fetch(Z80 *cpu) {
+    return rd(cpu, cpu->pc++);
+}
+
+static inline uint16_t fetch16(Z80 *cpu) {
+    uint16_t v = rd16(cpu, cpu->pc);
+    cpu->pc += 2;
+    return v;
+}
+
+static inline void push(Z80 *cpu, uint16_t val) {
+    cpu->sp -= 2;
+    wr16(cpu, cpu->sp, val);
+}
+
+static inline uint16_t pop(Z80 *cpu) {
+    uint16_t v = rd16(cpu, cpu->sp);
+    cpu->sp += 2;
+    return v;
+}
+
+static inline void inc_r(Z80 *cpu) {
+    cpu->r = (uint8_t)((cpu->r & 0x80) | ((cpu->r + 1) & 0x7F));
+}
+
+//------------------------------------------------------------------------------
+// REGISTER DECODING
+//------------------------------------------------------------------------------
+
+// HL, IX or IY depending on the active prefix
+static inline uint16_t *index_reg(Z80 *cpu, int xy) {
+    return xy == 0 ? &cpu->hl : (xy == 1 ? &cpu->ix : &cpu->iy);
+}
+
+// 8 bit register r (B,C,D,E,H,L,-,A); H and L map onto the index halves
+static uint8_t get_r8(Z80 *cpu, int r, int xy) {
+    switch(r) {
+        case 0: return HI(cpu->bc);
+        case 1: return LO(cpu->bc);
+        case 2: return HI(cpu->de);
+        case 3: return LO(cpu->de);
+        case 4: return HI(*index_reg(cpu, xy));
+        case 5: return LO(*index_reg(cpu, xy));
+        default: return A;
+    }
+}
+
+static void set_r8(Z80 *cpu, int r, int xy, uint8_t v) {
+    switch(r) {
+        case 0: SETHI(cpu->bc, v); break;
+        case 1: SETLO(cpu->bc, v); break;
+        case 2: SETHI(cpu->de, v); break;
+        case 3: SETLO(cpu->de, v); break;
+        case 4: SETHI(*index_reg(cpu, xy), v); break;
+        case 5: SETLO(*index_reg(cpu, xy), v); break;
+        default: SETA(v); break;
+    }
+}
+
+// register pair rp (BC,DE,HL,SP)
+static uint16_t *get_rp(Z80 *cpu, int rp, int xy) {
+    switch(rp) {
+        case 0: return &cpu->bc;
+        case 1: return &cpu->de;
+        case 2: return index_reg(cpu, xy);
+        default: return &cpu->sp;
+    }
+}
+
+// address of the (HL) operand, fetching the displacement for (IX+d)
+static uint16_t operand_addr(Z80 *cpu, int xy) {
+    if(xy == 0) {
+        return cpu->hl;
+    }
+    int8_t d = (int8_t)fetch(cpu);
+    return (uint16_t)(*index_reg(cpu, xy) + d);
+}
+
+static int condition(Z80 *cpu, int cc) {
+    switch(cc) {
+        case 0: return !(F & FLAG_Z);
+        case 1: return F & FLAG_Z;
+        case 2: return !(F & FLAG_C);
+        case 3: return F & FLAG_C;
+        case 4: return !(F & FLAG_PV);
+        case 5: return F & FLAG_PV;
+        case 6: return !(F & FLAG_S);
+        default: return F & FLAG_S;
+    }
+}
+
+//------------------------------------------------------------------------------
+// ARITHMETIC
+//------------------------------------------------------------------------------
+
+static void alu(Z80 *cpu, int op, uint8_t v) {
+    uint8_t a = A;
+    unsigned r;
+    uint8_t f;
+
+    switch(op) {
+        case 0: // ADD
+        case 1: // ADC
+            r = a + v + ((op == 1) ? (F & FLAG_C) : 0);
+            f = (uint8_t)((sz53p[r & 0xFF] & ~FLAG_PV) |
+                ((a ^ v ^ r) & FLAG_H) |
+                ((((a ^ ~v) & (a ^ r)) & 0x80) ? FLAG_PV : 0) |
+                ((r & 0x100) ? FLAG_C : 0));
+            SETA(r);
+            SETF(f);
+            break;
+        case 2: // SUB
+        case 3: // SBC
+        case 7: // CP
+            r = a - v - ((op == 3) ? (F & FLAG_C) : 0);
+            f = (uint8_t)((sz53p[r & 0xFF] & ~FLAG_PV) | FLAG_N |
+                ((a ^ v ^ r) & FLAG_H) |
+                ((((a ^ v) & (a ^ r)) & 0x80) ? FLAG_PV : 0) |
+                ((r & 0x100) ? FLAG_C : 0));
+            if(op != 7) {
+                SETA(r);
+            }
+            SETF(f);
+            break;
+        case 4: // AND
+            a &= v;
+            SETA(a);
+            SETF(sz53p[a] | FLAG_H);
+            break;
+        case 5: // XOR
+            a ^= v;
+            SETA(a);
+            SETF(sz53p[a]);
+            break;
+        case 6: // OR
+            a |= v;
+            SETA(a);
+            SETF(sz53p[a]);
+            break;
+    }
+}
+
+static uint8_t inc8(Z80 *cpu, uint8_t v) {
+    uint8_t r = (uint8_t)(v + 1);
+    SETF((F & FLAG_C) | (sz53p[r] & ~FLAG_PV) |
+         ((r & 0x0F) == 0 ? FLAG_H : 0) | (r == 0x80 ? FLAG_PV : 0));
+    return r;
+}
+
+static uint8_t dec8(Z80 *cpu, uint8_t v) {
+    uint8_t r = (uint8_t)(v - 1);
+    SETF((F & FLAG_C) | (sz53p[r] & ~FLAG_PV) | FLAG_N |
+         ((r & 0x0F) == 0x0F ? FLAG_H : 0) | (r == 0x7F ? FLAG_PV : 0));
+    return r;
+}
+
+static uint16_t add16(Z80 *cpu, uint16_t a, uint16_t b) {
+    uint32_t r = (uint32_t)a + b;
+    SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) |
+         (((a ^ b ^ r) >> 8) & FLAG_H) | ((r & 0x10000) ? FLAG_C : 0));
+    return (uint16_t)r;
+}
+
+static uint16_t adc16(Z80 *cpu, uint16_t a, uint16_t b) {
+    uint32_t r = (uint32_t)a + b + (F & FLAG_C);
+    SETF((((r >> 8) & FLAG_S)) | ((r & 0xFFFF) == 0 ? FLAG_Z : 0) |
+         (((a ^ b ^ r) >> 8) & FLAG_H) |
+         ((((a ^ ~b) & (a ^ r)) & 0x8000) ? FLAG_PV : 0) |
+         ((r & 0x10000) ? FLAG_C : 0));
+    return (uint16_t)r;
+}
+
+static uint16_t sbc16(Z80 *cpu, uint16_t a, uint16_t b) {
+    uint32_t r = (uint32_t)a - b - (F & FLAG_C);
+    SETF((((r >> 8) & FLAG_S)) | ((r & 0xFFFF) == 0 ? FLAG_Z : 0) | FLAG_N |
+         (((a ^ b ^ r) >> 8) & FLAG_H) |
+         ((((a ^ b) & (a ^ r)) & 0x8000) ? FLAG_PV : 0) |
+         ((r & 0x10000) ? FLAG_C : 0));
+    return (uint16_t)r;
+}
+
+// CB-prefixed rotate and shift group
+static uint8_t rot(Z80 *cpu, int op, uint8_t v) {
+    uint8_t c;
+    switch(op) {
+        case 0: c = v >> 7; v = (uint8_t)((v << 1) | c); break;                  // RLC
+        case 1: c = v & 1; v = (uint8_t)((v >> 1) | (c << 7)); break;           // RRC
+        case 2: c = v >> 7; v = (uint8_t)((v << 1) | (F & FLAG_C)); break;      // RL
+        case 3: c = v & 1; v = (uint8_t)((v >> 1) | ((F & FLAG_C) << 7)); break; // RR
+        case 4: c = v >> 7; v = (uint8_t)(v << 1); break;                        // SLA
+        case 5: c = v & 1; v = (uint8_t)((v >> 1) | (v & 0x80)); break;          // SRA
+        case 6: c = v >> 7; v = (uint8_t)((v << 1) | 1); break;                  // SLL
+        default: c = v & 1; v = (uint8_t)(v >> 1); break;                        // SRL
+    }
+    SETF(sz53p[v] | c);
+    return v;
+}
+
+static void daa(Z80 *cpu) {
+    uint8_t a = A;
+    uint8_t f = F;
+    uint8_t corr = 0;
+    uint8_t carry = f & FLAG_C;
+    uint8_t half;
+
+    if((f & FLAG_H) || (a & 0x0F) > 9) {
+        corr |= 0x06;
+    }
+    if(carry || a > 0x99) {
+        corr |= 0x60;
+        carry = FLAG_C;
+    }
+    if(f & FLAG_N) {
+        half = ((f & FLAG_H) && (a & 0x0F) < 6) ? FLAG_H : 0;
+        a = (uint8_t)(a - corr);
+    } else {
+        half = ((a & 0x0F) > 9) ? FLAG_H : 0;
+        a = (uint8_t)(a + corr);
+    }
+    SETA(a);
+    SETF(sz53p[a] | half | (f & FLAG_N) | carry);
+}
+
+//------------------------------------------------------------------------------
+// PREFIXED INSTRUCTIONS
+//------------------------------------------------------------------------------
+
+/*
+ * CB prefix; with an index prefix the displacement precedes the opcode and
+ * the result of the operation is also copied into register r (undocumented)
+ */
+static int exec_cb(Z80 *cpu, int xy) {
+    uint16_t addr = 0;
+    uint8_t op;
+
+    if(xy) {
+        addr = operand_addr(cpu, xy);
+        op = fetch(cpu);
+    } else {
+        op = fetch(cpu);
+        inc_r(cpu);
+        addr = cpu->hl;
+    }
+
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+    int mem = xy || z == 6;
+    uint8_t v = mem ? rd(cpu, addr) : get_r8(cpu, z, 0);
+
+    switch(x) {
+        case 0:
+            v = rot(cpu, y, v);
+            break;
+        case 1: {
+            uint8_t bit = v & (1 << y);
+            SETF((F & FLAG_C) | FLAG_H | (bit ? 0 : (FLAG_Z | FLAG_PV)) |
+                 ((y == 7 && bit) ? FLAG_S : 0));
+            if(xy) {
+                return 20;
+            }
+            return mem ? 12 : 8;
+        }
+        case 2:
+            v &= (uint8_t)~(1 << y);
+            break;
+        default:
+            v |= (uint8_t)(1 << y);
+            break;
+    }
+
+    if(mem) {
+        wr(cpu, addr, v);
+        if(xy && z != 6) {
+            set_r8(cpu, z, 0, v);
+        }
+        return xy ? 23 : 15;
+    }
+
+    set_r8(cpu, z, 0, v);
+    return 8;
+}
+
+static int exec_ed(Z80 *cpu) {
+    uint8_t op = fetch(cpu);
+    inc_r(cpu);
+
+    int y = (op >> 3) & 7;
+    int p = y >> 1;
+
+    if(op >= 0x40 && op < 0x80) {
+        switch(op & 7) {
+            case 0: { // IN r,(C)
+                uint8_t v = cpu->in(cpu->ctx, cpu->bc);
+                if(y != 6) {
+                    set_r8(cpu, y, 0, v);
+                }
+                SETF((F & FLAG_C) | sz53p[v]);
+                return 12;
+            }
+            case 1: // OUT (C),r
+                cpu->out(cpu->ctx, cpu->bc, y == 6 ? 0 : get_r8(cpu, y, 0));
+                return 12;
+            case 2: // SBC / ADC HL,rr
+                if(y & 1) {
+                    cpu->hl = adc16(cpu, cpu->hl, *get_rp(cpu, p, 0));
+                } else {
+                    cpu->hl = sbc16(cpu, cpu->hl, *get_rp(cpu, p, 0));
+                }
+                return 15;
+            case 3: { // LD (nn),rr / LD rr,(nn)
+                uint16_t nn = fetch16(cpu);
+                if(y & 1) {
+                    *get_rp(cpu, p, 0) = rd16(cpu, nn);
+                } else {
+                    wr16(cpu, nn, *get_rp(cpu, p, 0));
+                }
+                return 20;
+            }
+            case 4: { // NEG
+                uint8_t a = A;
+                SETA(0);
+                alu(cpu, 2, a);
+                return 8;
+            }
+            case 5: // RETN / RETI
+                cpu->pc = pop(cpu);
+                cpu->iff1 = cpu->iff2;
+                return 14;
+            case 6: // IM
+                cpu->im = (y & 3) == 2 ? 1 : ((y & 3) == 3 ? 2 : 0);
+                return 8;
+            default:
+                switch(y) {
+                    case 0: cpu->i = A; return 9;              // LD I,A
+                    case 1: cpu->r = A; return 9;              // LD R,A
+                    case 2:                                    // LD A,I
+                    case 3: {                                  // LD A,R
+                        uint8_t v = (y == 2) ? cpu->i : cpu->r;
+                        SETA(v);
+                        SETF((F & FLAG_C) | (sz53p[v] & ~FLAG_PV) |
+                             (cpu->iff2 ? FLAG_PV : 0));
+                        return 9;
+                    }
+                    case 4: { // RRD
+                        uint8_t m = rd(cpu, cpu->hl);
+                        uint8_t a = A;
+                        wr(cpu, cpu->hl, (uint8_t)((a << 4) | (m >> 4)));
+                        a = (uint8_t)((a & 0xF0) | (m & 0x0F));
+                        SETA(a);
+                        SETF((F & FLAG_C) | sz53p[a]);
+                        return 18;
+                    }
+                    case 5: { // RLD
+                        uint8_t m = rd(cpu, cpu->hl);
+                        uint8_t a = A;
+                        wr(cpu, cpu->hl, (uint8_t)((m << 4) | (a & 0x0F)));
+                        a = (uint8_t)((a & 0xF0) | (m >> 4));
+                        SETA(a);
+                        SETF((F & FLAG_C) | sz53p[a]);
+                        return 18;
+                    }
+                    default:
+                        return 8;
+                }
+        }
+    }
+
+    // block instructions
+    if(op >= 0xA0 && op <= 0xBB && (op & 7) <= 3 && y >= 4) {
+        int dir = (y & 1) ? -1 : 1;         // LDD, CPD, IND, OUTD decrement
+        int repeat = y >= 6;
+        int t = 16;
+
+        switch(op & 3) {
+            case 0: { // LDI / LDD / LDIR / LDDR
+                wr(cpu, cpu->de, rd(cpu, cpu->hl));
+                cpu->hl += dir;
+                cpu->de += dir;
+                cpu->bc--;
+                SETF((F & (FLAG_S | FLAG_Z | FLAG_C)) | (cpu->bc ? FLAG_PV : 0));
+                if(repeat && cpu->bc) {
+                    cpu->pc -= 2;
+                    t = 21;
+                }
+                break;
+            }
+            case 1: { // CPI / CPD / CPIR / CPDR
+                uint8_t v = rd(cpu, cpu->hl);
+                uint8_t r = (uint8_t)(A - v);
+                cpu->hl += dir;
+                cpu->bc--;
+                SETF((F & FLAG_C) | FLAG_N | (sz53p[r] & (FLAG_S | FLAG_Z)) |
+                     ((A ^ v ^ r) & FLAG_H) | (cpu->bc ? FLAG_PV : 0));
+                if(repeat && cpu->bc && r != 0) {
+                    cpu->pc -= 2;
+                    t = 21;
+                }
+                break;
+            }
+            case 2: { // INI / IND / INIR / INDR
+                wr(cpu, cpu->hl, cpu->in(cpu->ctx, cpu->bc));
+                cpu->hl += dir;
+                SETHI(cpu->bc, HI(cpu->bc) - 1);
+                SETF((F & FLAG_C) | FLAG_N | (HI(cpu->bc) == 0 ? FLAG_Z : 0));
+                if(repeat && HI(cpu->bc)) {
+                    cpu->pc -= 2;
+                    t = 21;
+                }
+                break;
+            }
+            default: { // OUTI / OUTD / OTIR / OTDR
+                uint8_t v = rd(cpu, cpu->hl);
+                SETHI(cpu->bc, HI(cpu->bc) - 1);
+                cpu->out(cpu->ctx, cpu->bc, v);
+                cpu->hl += dir;
+                SETF((F & FLAG_C) | FLAG_N | (HI(cpu->bc) == 0 ? FLAG_Z : 0));
+                if(repeat && HI(cpu->bc)) {
+                    cpu->pc -= 2;
+                    t = 21;
+                }
+                break;
+            }
+        }
+        return t;
+    }
+
+    return 8; // undefined ED opcodes behave as two NOPs
+}
+
+//------------------------------------------------------------------------------
+// MAIN INSTRUCTION SET
+//------------------------------------------------------------------------------
+
+static int exec_main(Z80 *cpu) {
+    int xy = 0;                     // 0: HL, 1: IX, 2: IY
+    int extra = 0;                  // additional T-states of the prefixes
+    uint8_t op;
+
+    for(;;) {
+        op = fetch(cpu);
+        inc_r(cpu);
+        if(op == 0xDD) {
+            xy = 1;
+        } else if(op == 0xFD) {
+            xy = 2;
+        } else {
+            break;
+        }
+        extra += 4;
+    }
+
+    int t = cycles_main[op] + extra;
+    int x = op >> 6;
+    int y = (op >> 3) & 7;
+    int z = op & 7;
+    int p = y >> 1;
+    uint16_t *ir = index_reg(cpu, xy);
+
+    // LD r,r' (including LD r,(HL) and LD (HL),r)
+    if(x == 1) {
+        if(op == 0x76) {
+            cpu->halted = 1;
+            cpu->pc--;
+            return t;
+        }
+        if(z == 6) {
+            uint16_t addr = operand_addr(cpu, xy);
+            set_r8(cpu, y, 0, rd(cpu, addr));
+            return t + (xy ? 8 : 0);
+        }
+        if(y == 6) {
+            uint16_t addr = operand_addr(cpu, xy);
+            wr(cpu, addr, get_r8(cpu, z, 0));
+            return t + (xy ? 8 : 0);
+        }
+        set_r8(cpu, y, xy, get_r8(cpu, z, xy));
+        return t;
+    }
+
+    // 8 bit arithmetic with a register or (HL)
+    if(x == 2) {
+        if(z == 6) {
+            uint16_t addr = operand_addr(cpu, xy);
+            alu(cpu, y, rd(cpu, addr));
+            return t + (xy ? 8 : 0);
+        }
+        alu(cpu, y, get_r8(cpu, z, xy));
+        return t;
+    }
+
+    switch(op) {
+        case 0x00: // NOP
+            break;
+        case 0x08: { // EX AF,AF'
+            uint16_t tmp = cpu->af;
+            cpu->af = cpu->af_;
+            cpu->af_ = tmp;
+            break;
+        }
+        case 0x10: // DJNZ
+        {
+            int8_t d = (int8_t)fetch(cpu);
+            SETHI(cpu->bc, HI(cpu->bc) - 1);
+            if(HI(cpu->bc)) {
+                cpu->pc = (uint16_t)(cpu->pc + d);
+                t += 5;
+            }
+            break;
+        }
+        case 0x18: { // JR d
+            int8_t d = (int8_t)fetch(cpu);
+            cpu->pc = (uint16_t)(cpu->pc + d);
+            break;
+        }
+        case 0x20: case 0x28: case 0x30: case 0x38: { // JR cc,d
+            int8_t d = (int8_t)fetch(cpu);
+            if(condition(cpu, y - 4)) {
+                cpu->pc = (uint16_t)(cpu->pc + d);
+                t += 5;
+            }
+            break;
+        }
+        case 0x01: case 0x11: case 0x21: case 0x31: // LD rr,nn
+            *get_rp(cpu, p, xy) = fetch16(cpu);
+            break;
+        case 0x09: case 0x19: case 0x29: case 0x39: // ADD HL,rr
+            *ir = add16(cpu, *ir, *get_rp(cpu, p, xy));
+            break;
+        case 0x02: wr(cpu, cpu->bc, A); break;              // LD (BC),A
+        case 0x12: wr(cpu, cpu->de, A); break;              // LD (DE),A
+        case 0x0A: SETA(rd(cpu, cpu->bc)); break;           // LD A,(BC)
+        case 0x1A: SETA(rd(cpu, cpu->de)); break;           // LD A,(DE)
+        case 0x22: wr16(cpu, fetch16(cpu), *ir); break;     // LD (nn),HL
+        case 0x2A: *ir = rd16(cpu, fetch16(cpu)); break;    // LD HL,(nn)
+        case 0x32: wr(cpu, fetch16(cpu), A); break;         // LD (nn),A
+        case 0x3A: SETA(rd(cpu, fetch16(cpu))); break;      // LD A,(nn)
+        case 0x03: case 0x13: case 0x23: case 0x33:         // INC rr
+            (*get_rp(cpu, p, xy))++;
+            break;
+        case 0x0B: case 0x1B: case 0x2B: case 0x3B:         // DEC rr
+            (*get_rp(cpu, p, xy))--;
+            break;
+        case 0x04: case 0x0C: case 0x14: case 0x1C:         // INC r
+        case 0x24: case 0x2C: case 0x3C:
+            set_r8(cpu, y, xy, inc8(cpu, get_r8(cpu, y, xy)));
+            break;
+        case 0x05: case 0x0D: case 0x15: case 0x1D:         // DEC r
+        case 0x25: case 0x2D: case 0x3D:
+            set_r8(cpu, y, xy, dec8(cpu, get_r8(cpu, y, xy)));
+            break;
+        case 0x34: { // INC (HL)
+            uint16_t addr = operand_addr(cpu, xy);
+            wr(cpu, addr, inc8(cpu, rd(cpu, addr)));
+            t += xy ? 8 : 0;
+            break;
+        }
+        case 0x35: { // DEC (HL)
+            uint16_t addr = operand_addr(cpu, xy);
+            wr(cpu, addr, dec8(cpu, rd(cpu, addr)));
+            t += xy ? 8 : 0;
+            break;
+        }
+        case 0x06: case 0x0E: case 0x16: case 0x1E:         // LD r,n
+        case 0x26: case 0x2E: case 0x3E:
+            set_r8(cpu, y, xy, fetch(cpu));
+            break;
+        case 0x36: { // LD (HL),n
+            uint16_t addr = operand_addr(cpu, xy);
+            wr(cpu, addr, fetch(cpu));
+            t += xy ? 5 : 0;
+            break;
+        }
+        case 0x07: { // RLCA
+            uint8_t a = A;
+            a = (uint8_t)((a << 1) | (a >> 7));
+            SETA(a);
+            SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) | (a & FLAG_C));
+            break;
+        }
+        case 0x0F: { // RRCA
+            uint8_t a = A;
+            uint8_t c = a & 1;
+            a = (uint8_t)((a >> 1) | (c << 7));
+            SETA(a);
+            SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) | c);
+            break;
+        }
+        case 0x17: { // RLA
+            uint8_t a = A;
+            uint8_t c = a >> 7;
+            a = (uint8_t)((a << 1) | (F & FLAG_C));
+            SETA(a);
+            SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) | c);
+            break;
+        }
+        case 0x1F: { // RRA
+            uint8_t a = A;
+            uint8_t c = a & 1;
+            a = (uint8_t)((a >> 1) | ((F & FLAG_C) << 7));
+            SETA(a);
+            SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) | c);
+            break;
+        }
+        case 0x27: daa(cpu); break;
+        case 0x2F: // CPL
+            SETA(~A);
+            SETF(F | FLAG_H | FLAG_N);
+            break;
+        case 0x37: // SCF
+            SETF((F & (FLAG_S | FLAG_Z | FLAG_PV)) | FLAG_C);
+            break;
+        case 0x3F: // CCF
+            SETF(((F & (FLAG_S | FLAG_Z | FLAG_PV | FLAG_C)) |
+                 ((F & FLAG_C) ? FLAG_H : 0)) ^ FLAG_C);
+            break;
+
+        case 0xC0: case 0xC8: case 0xD0: case 0xD8:         // RET cc
+        case 0xE0: case 0xE8: case 0xF0: case 0xF8:
+            if(condition(cpu, y)) {
+                cpu->pc = pop(cpu);
+                t += 6;
+            }
+            break;
+        case 0xC1: case 0xD1: case 0xE1:                    // POP rr
+            *get_rp(cpu, p, xy) = pop(cpu);
+            break;
+        case 0xF1: cpu->af = pop(cpu); break;               // POP AF
+        case 0xC5: case 0xD5: case 0xE5:                    // PUSH rr
+            push(cpu, *get_rp(cpu, p, xy));
+            break;
+        case 0xF5: push(cpu, cpu->af); break;               // PUSH AF
+        case 0xC2: case 0xCA: case 0xD2: case 0xDA:         // JP cc,nn
+        case 0xE2: case 0xEA: case 0xF2: case 0xFA: {
+            uint16_t nn = fetch16(cpu);
+            if(condition(cpu, y)) {
+                cpu->pc = nn;
+            }
+            break;
+        }
+        case 0xC3: cpu->pc = fetch16(cpu); break;           // JP nn
+        case 0xC4: case 0xCC: case 0xD4: case 0xDC:         // CALL cc,nn
+        case 0xE4: case 0xEC: case 0xF4: case 0xFC: {
+            uint16_t nn = fetch16(cpu);
+            if(condition(cpu, y)) {
+                push(cpu, cpu->pc);
+                cpu->pc = nn;
+                t += 7;
+            }
+            break;
+        }
+        case 0xCD: { // CALL nn
+            uint16_t nn = fetch16(cpu);
+            push(cpu, cpu->pc);
+            cpu->pc = nn;
+            break;
+        }
+        case 0xC9: cpu->pc = pop(cpu); break;               // RET
+        case 0xC6: case 0xCE: case 0xD6: case 0xDE:         // ALU n
+        case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+            alu(cpu, y, fetch(cpu));
+            break;
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF:         // RST
+        case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+            push(cpu, cpu->pc);
+            cpu->pc = (uint16_t)(y * 8);
+            break;
+        case 0xCB: return exec_cb(cpu, xy) + extra;
+        case 0xED: return exec_ed(cpu) + extra;
+        case 0xD3: { // OUT (n),A
+            uint8_t n = fetch(cpu);
+            cpu->out(cpu->ctx, (uint16_t)((A << 8) | n), A);
+            break;
+        }
+        case 0xDB: { // IN A,(n)
+            uint8_t n = fetch(cpu);
+            SETA(cpu->in(cpu->ctx, (uint16_t)((A << 8) | n)));
+            break;
+        }
+        case 0xD9: { // EXX
+            uint16_t tmp;
+            tmp = cpu->bc; cpu->bc = cpu->bc_; cpu->bc_ = tmp;
+            tmp = cpu->de; cpu->de = cpu->de_; cpu->de_ = tmp;
+            tmp = cpu->hl; cpu->hl = cpu->hl_; cpu->hl_ = tmp;
+            break;
+        }
+        case 0xE3: { // EX (SP),HL
+            uint16_t tmp = rd16(cpu, cpu->sp);
+            wr16(cpu, cpu->sp, *ir);
+            *ir = tmp;
+            break;
+        }
+        case 0xE9: cpu->pc = *ir; break;                    // JP (HL)
+        case 0xEB: { // EX DE,HL (never affected by a prefix)
+            uint16_t tmp = cpu->de;
+            cpu->de = cpu->hl;
+            cpu->hl = tmp;
+            break;
+        }
+        case 0xF3: // DI
+            cpu->iff1 = cpu->iff2 = 0;
+            break;
+        case 0xFB: // EI
+            cpu->iff1 = cpu->iff2 = 1;
+            cpu->ei_delay = 1;
+            break;
+        case 0xF9: cpu->sp = *ir; break;                    // LD SP,HL
+    }
+
+    return t;
+}
+
+//------------------------------------------------------------------------------
+// PUBLIC INTERFACE
+//------------------------------------------------------------------------------
+
+void z80_reset(Z80 *cpu) {
+    if(!tables_ready) {
+        init_tables();
+    }
+    cpu->af = cpu->bc = cpu->de = cpu->hl = 0xFFFF;
+    cpu->af_ = cpu->bc_ = cpu->de_ = cpu->hl_ = 0xFFFF;
+    cpu->ix = cpu->iy = 0xFFFF;
+    cpu->sp = 0xFFFF;
+    cpu->pc = 0x0000;
+    cpu->i = cpu->r = 0;
+    cpu->iff1 = cpu->iff2 = 0;
+    cpu->im = 0;
+    cpu->halted = 0;
+    cpu->ei_delay = 0;
+    cpu->cycles = 0;
+}
+
+int z80_step(Z80 *cpu) {
+    int t;
+
+    cpu->ei_delay = 0;
+    if(cpu->halted) {
+        inc_r(cpu);
+        t = 4;
+    } else {
+        t = exec_main(cpu);
+    }
+
+    cpu->cycles += (uint64_t)t;
+    return t;
+}
+
+int z80_interrupt(Z80 *cpu) {
+    if(!cpu->iff1 || cpu->ei_delay) {
+        return 0;
+    }
+
+    if(cpu->halted) {
+        cpu->halted = 0;
+        cpu->pc++;
+    }
+    cpu->iff1 = cpu->iff2 = 0;
+    inc_r(cpu);
+
+    int t;
+    push(cpu, cpu->pc);
+    if(cpu->im == 2) {
+        cpu->pc = rd16(cpu, (uint16_t)((cpu->i << 8) | 0xFF));
+        t = 19;
+    } else {
+        cpu->pc = 0x0038;   // IM 0 with RST 38 on the bus, or IM 1
+        t = 13;
+    }
+
+    cpu->cycles += (uint64_t)t;
+    return t;
+}
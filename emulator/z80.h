@@ -0,0 +1,86 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _Z80_H
+#define _Z80_H
+
+#include <stdint.h>
+
+/*
+ * Instruction level Z80 core. Every instruction is executed in one go and
+ * charged its documented number of T-states; memory and I/O accesses are
+ * routed through the callbacks so that the machine model can observe them.
+ */
+
+#define FLAG_C  0x01
+#define FLAG_N  0x02
+#define FLAG_PV 0x04
+#define FLAG_X  0x08
+#define FLAG_H  0x10
+#define FLAG_Y  0x20
+#define FLAG_Z  0x40
+#define FLAG_S  0x80
+
+typedef struct Z80 Z80;
+
+struct Z80 {
+    // register pairs, high byte first in the usual notation
+    uint16_t af, bc, de, hl;
+    uint16_t af_, bc_, de_, hl_;
+    uint16_t ix, iy, sp, pc;
+    uint8_t i, r;
+    uint8_t iff1, iff2, im;
+    uint8_t halted;
+    uint8_t ei_delay;           // interrupts are accepted one instruction after EI
+
+    uint64_t cycles;            // T-states since reset
+
+    // machine callbacks
+    void *ctx;
+    uint8_t (*read)(void *ctx, uint16_t addr);
+    void (*write)(void *ctx, uint16_t addr, uint8_t val);
+    uint8_t (*in)(void *ctx, uint16_t port);
+    void (*out)(void *ctx, uint16_t port, uint8_t val);
+};
+
+/**
+ * @brief Reset the processor; registers are set to their power-on values
+ *
+ * @param cpu processor
+ */
+void z80_reset(Z80 *cpu);
+
+/**
+ * @brief Execute a single instruction (or a single HALT cycle)
+ *
+ * @param cpu processor
+ * @return number of T-states consumed
+ */
+int z80_step(Z80 *cpu);
+
+/**
+ * @brief Raise the maskable interrupt line
+ *
+ * @param cpu processor
+ * @return number of T-states consumed, 0 when the interrupt was not accepted
+ */
+int z80_interrupt(Z80 *cpu);
+
+#endif // _Z80_H
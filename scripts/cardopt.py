@@ -0,0 +1,164 @@
+# -*- coding: utf-8 -*-
+
+#
+# Analyse an SD-card image for the access pattern of the launchers and
+# optionally write an optimised copy
+#
+# The launchers are fastest when files are contiguous (a single multiple
+# block read) and folders are short: a folder is scanned sector by sector
+# for every listing and lookup, and only its first 16 clusters are visited
+# at all (F_LL_SIZE). The optimised copy therefore has
+#
+#   - every file and folder in a single run of clusters
+#   - folders without deleted entries, sorted by name (folders first)
+#   - the recommended, or a chosen, cluster size
+#
+# Usage:
+#
+#   python3 cardopt.py sdcard.img                   # analyse
+#   python3 cardopt.py sdcard.img -o optimised.img  # analyse and rewrite
+#
+
+import argparse
+
+from readfat import FatVolume, BYTES_PER_SECTOR
+from fatimage import FatImage, ATTR_ARCHIVE
+
+LINKED_LIST_SIZE = 16       # F_LL_SIZE in fat32.h
+FAT32_MIN_CLUSTERS = 65525
+MAX_SLACK = 0.10            # tolerated fraction of unused bytes in clusters
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='Card optimiser',
+                    description='Report and remove the slow paths of an SD-card image')
+
+    parser.add_argument('image')
+    parser.add_argument('-o', '--output', help='write an optimised copy of the image')
+    parser.add_argument('-c', '--cluster', type=int, help='sectors per cluster of the copy (default: recommended)')
+    parser.add_argument('--keep-order', action='store_true', help='do not sort folders')
+    parser.add_argument('-v', '--verbose', action='store_true', help='list every affected file')
+
+    args = parser.parse_args()
+
+    vol = FatVolume(args.image)
+    root = vol.root()
+    entries = list(vol.walk(root))
+    spc = analyse(vol, entries, args.verbose)
+
+    if args.output:
+        spc = args.cluster if args.cluster else spc
+        img = rewrite(vol, root, spc, not args.keep_order)
+        img.save(args.output)
+        print()
+        print('Writing to: %s (%i clusters of %i bytes used)' %
+              (args.output, img.clusters_used, spc * BYTES_PER_SECTOR))
+
+    vol.close()
+
+def slots(folder):
+    """
+    Directory entries of a folder once compacted, including '.' and '..'
+    or the volume label
+    """
+    n = 2 if folder.path != '/' else 1
+    for c in folder.children:
+        n += 1 + ((len(c.long_name) + 12) // 13 if c.long_name else 0)
+    return n
+
+def analyse(vol, entries, verbose):
+    """
+    Print the report and return the recommended number of sectors per cluster
+    """
+    files = [e for e in entries if not e.is_dir()]
+    folders = [e for e in entries if e.is_dir()]
+    cb = vol.cluster_bytes()
+
+    print('Cluster size: %i bytes, %i clusters' % (cb, vol.clusters))
+    print('Folders: %i, files: %i (%i bytes)' % (len(folders), len(files), sum(f.size for f in files)))
+    print()
+
+    def section(title, items, line):
+        print('%s: %i' % (title, len(items)))
+        for item in items if verbose else items[:10]:
+            print('  ' + line(item))
+        if not verbose and len(items) > 10:
+            print('  ... (use -v to list all)')
+
+    fragmented = sorted([f for f in files if len(vol.runs(f.chain)) > 1],
+                        key=lambda f: -len(vol.runs(f.chain)))
+    section('Fragmented files', fragmented, lambda f: '%-40s %5i clusters in %4i runs' %
+            (f.path, len(f.chain), len(vol.runs(f.chain))))
+    print('  every extra run costs a CMD12 and a new CMD18 while loading')
+
+    long_files = [f for f in files if len(f.chain) > LINKED_LIST_SIZE]
+    section('Files over %i clusters' % LINKED_LIST_SIZE, long_files,
+            lambda f: '%-40s %5i clusters' % (f.path, len(f.chain)))
+
+    broken = [f for f in files if len(f.chain) * cb < f.size]
+    section('Files with a chain shorter than their size', broken,
+            lambda f: '%-40s %5i clusters for %i bytes' % (f.path, len(f.chain), f.size))
+
+    long_folders = sorted([d for d in folders if len(d.chain) > 1], key=lambda d: -len(d.chain))
+    section('Folders spanning more than one cluster', long_folders,
+            lambda d: '%-40s %5i clusters%s' % (d.path, len(d.chain),
+            ', entries beyond cluster %i are invisible to the launchers' % LINKED_LIST_SIZE
+            if len(d.chain) > LINKED_LIST_SIZE else ''))
+
+    holes = sorted([d for d in folders if d.deleted > 0], key=lambda d: -d.deleted)
+    section('Folders with deleted entries', holes,
+            lambda d: '%-40s %5i deleted of %i entries (%i sectors to skip)' %
+            (d.path, d.deleted, d.deleted + d.slots, d.deleted * 32 // BYTES_PER_SECTOR))
+    print()
+
+    # recommend the largest cluster for which all folders stay within the
+    # linked list, the slack is acceptable and FAT32 is still valid
+    used = max(1, sum(f.size for f in files))
+    data_sectors = vol.lba0 + vol.partition_sectors - vol.cluster_begin_lba
+    choice = None
+    for spc in (64, 32, 16, 8, 4, 2, 1):
+        size = spc * BYTES_PER_SECTOR
+        slack = sum(-f.size % size for f in files)
+        fits = all(slots(d) * 32 <= LINKED_LIST_SIZE * size for d in folders)
+        valid = data_sectors // spc >= FAT32_MIN_CLUSTERS
+        if fits and valid and slack <= MAX_SLACK * used:
+            choice = spc
+            break
+        if fits and valid and choice is None:
+            choice = spc            # fall back to the largest that fits
+    if choice is None:
+        choice = 1
+
+    size = choice * BYTES_PER_SECTOR
+    print('Recommended cluster size: %i bytes (%i sectors), %.1f%% slack' %
+          (size, choice, 100.0 * sum(-f.size % size for f in files) / used))
+    too_long = [d for d in folders if slots(d) * 32 > LINKED_LIST_SIZE * size]
+    for d in too_long:
+        print('  %s has %i entries, more than %i clusters can hold; split the folder' %
+              (d.path, slots(d), LINKED_LIST_SIZE))
+
+    return choice
+
+def rewrite(vol, root, spc, sort):
+    """
+    Build an optimised image holding the contents of the volume
+    """
+    size_mb = (vol.lba0 + vol.partition_sectors) * BYTES_PER_SECTOR // (1024 * 1024)
+    img = FatImage(size_mb=size_mb, sectors_per_cluster=spc, label=vol.label or 'P2000T')
+
+    def copy(src, dst):
+        children = src.children
+        if sort:
+            children = sorted(children, key=lambda c: (not c.is_dir(), c.name))
+        for c in children:
+            if c.is_dir():
+                copy(c, dst.mkdir(c.name, c.long_name))
+            else:
+                dst.add_file(c.name, vol.read(c.chain, c.size), c.long_name,
+                             attrib=c.attrib & (0x07 | ATTR_ARCHIVE))
+
+    copy(root, img.root)
+    return img
+
+if __name__ == '__main__':
+    main()
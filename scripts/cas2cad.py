@@ -0,0 +1,93 @@
+# -*- coding: utf-8 -*-
+
+#
+# Convert CAS files into direct-load CAD files
+#
+# A CAD file holds the program without the 256-byte cassette preambles,
+# starting at the second sector, such that the launchers stream it into the
+# RAM bank without de-interleaving the records. See src/cad.h for the layout.
+#
+# Usage:
+#
+#   python3 cas2cad.py GAME.CAS              # produces GAME.CAD
+#   python3 cas2cad.py -r collection/        # converts every CAS file
+#
+
+import os
+import argparse
+
+from lzpack import parse_cas, crc16
+
+SECTOR = 0x200
+PREAMBLE_OFFSET = 0x10
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='CAS to CAD converter',
+                    description='Convert CAS files into direct-load CAD files')
+
+    parser.add_argument('path')
+    parser.add_argument('-o', '--output', help='output file (default: .CAD next to input)')
+    parser.add_argument('-r', '--recursive', action='store_true', help='convert every CAS file below a folder')
+    parser.add_argument('--remove', action='store_true', help='remove the CAS file after conversion')
+
+    args = parser.parse_args()
+
+    if not os.path.exists(args.path):
+        print('File does not exist: %s' % args.path)
+        return
+
+    if os.path.isdir(args.path):
+        if not args.recursive:
+            print('%s is a folder, use -r to convert its contents' % args.path)
+            return
+        converted = saved = 0
+        for root, dirs, files in os.walk(args.path):
+            for name in sorted(files):
+                if os.path.splitext(name)[1].upper() == '.CAS':
+                    saved += convert_file(os.path.join(root, name), None, args.remove)
+                    converted += 1
+        print('Converted %i files, %i bytes of preambles removed' % (converted, saved))
+    else:
+        convert_file(args.path, args.output, args.remove)
+
+def convert_file(filename, outfile, remove):
+    """
+    Convert a single CAS file, returns the number of bytes saved
+    """
+    with open(filename, 'rb') as f:
+        data = bytearray(f.read())
+
+    container, deploy, payload, crc = convert(data)
+
+    base, ext = os.path.splitext(filename)
+    if outfile is None:
+        outfile = base + ('.CAD' if ext.isupper() else '.cad')
+    with open(outfile, 'wb') as f:
+        f.write(container)
+    if remove:
+        os.remove(filename)
+
+    print('%s: 0x%04X, %i bytes, CRC-16 0x%04X -> %s' % (filename, deploy, len(payload), crc, outfile))
+    return len(data) - len(container)
+
+def convert(data):
+    """
+    Build the CAD file of a CAS file, returns the file, deploy address,
+    program data and its checksum
+    """
+    preamble, deploy, payload = parse_cas(data)
+    crc = crc16(payload)
+
+    header = bytearray(SECTOR)
+    header[0x00:0x02] = b'CD'
+    header[0x02] = 1
+    header[0x04:0x06] = deploy.to_bytes(2, 'little')
+    header[0x06:0x08] = len(payload).to_bytes(2, 'little')
+    header[0x08:0x0A] = crc.to_bytes(2, 'little')
+    header[PREAMBLE_OFFSET:PREAMBLE_OFFSET + len(preamble)] = preamble
+
+    return header + payload, deploy, payload, crc
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,404 @@
+# -*- coding: utf-8 -*-
+
+#
+# Build MBR/FAT32 SD-card images for the emulator and for testing
+#
+# The image holds a single primary partition (type 0x0C) starting at sector
+# 2048. Clusters are handed out in the order in which the folder tree is
+# walked, such that every file and folder occupies a contiguous run, unless
+# the image is created with a fragment size. File chains are then split into
+# runs of that many clusters following one of the patterns:
+#
+#   runs        runs separated by a free cluster
+#   interleave  the runs of the files of a folder alternate
+#   scatter     runs at random positions, in random order
+#   reverse     runs in descending order
+#
+# Usage as a module:
+#
+#   img = FatImage(size_mb=256, sectors_per_cluster=8)
+#   games = img.root.mkdir('GAMES')
+#   games.add_file('ZEROBUG.CAS', data)
+#   games.add_file('SPACE~1.CAS', data, long_name='Space Invaders.cas')
+#   img.save('sdcard.img')
+#
+# or from the command line, copying files into the root folder:
+#
+#   python3 fatimage.py sdcard.img LAUNCHER.BIN GAME.CAS
+#
+
+import os
+import struct
+import random
+import argparse
+
+SECTOR = 512
+LBA0 = 2048
+RESERVED_SECTORS = 32
+NUMBER_OF_FATS = 2
+ROOT_CLUSTER = 2
+EOC = 0x0FFFFFFF
+
+ATTR_VOLUME_ID = 0x08
+ATTR_DIRECTORY = 0x10
+ATTR_ARCHIVE = 0x20
+
+PATTERNS = ('runs', 'interleave', 'scatter', 'reverse')
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='FAT32 image tool',
+                    description='Create a FAT32 SD-card image holding the given files')
+
+    parser.add_argument('image')
+    parser.add_argument('files', nargs='*')
+    parser.add_argument('-s', '--size', type=int, default=256, help='image size in MiB')
+    parser.add_argument('-c', '--cluster', type=int, default=8, help='sectors per cluster')
+    parser.add_argument('-f', '--fragment', type=int, default=0, help='split files in runs of this many clusters')
+    parser.add_argument('-p', '--pattern', choices=PATTERNS, default='runs', help='order of the runs')
+
+    args = parser.parse_args()
+
+    img = FatImage(size_mb=args.size, sectors_per_cluster=args.cluster,
+                   fragment=args.fragment, pattern=args.pattern)
+    for filename in args.files:
+        with open(filename, 'rb') as f:
+            img.root.add_file(os.path.basename(filename).upper(), f.read())
+    img.save(args.image)
+    print('Writing to: %s (%i clusters used)' % (args.image, img.clusters_used))
+
+def short_name(name):
+    """
+    Convert NAME.EXT into the 11 character directory entry form
+    """
+    base, _, ext = name.partition('.')
+    if not 0 < len(base) <= 8 or len(ext) > 3 or name != name.upper():
+        raise Exception('Not a valid 8.3 name: %s' % name)
+    return (base.ljust(8) + ext.ljust(3)).encode('ascii')
+
+def dir_entry(name11, attrib, cluster, size):
+    entry = bytearray(32)
+    entry[0x00:0x0B] = name11
+    entry[0x0B] = attrib
+    entry[0x0E:0x12] = struct.pack('<HH', 0x6000, 0x5A21)     # created 2025-01-01 12:00
+    entry[0x12:0x14] = struct.pack('<H', 0x5A21)
+    entry[0x14:0x16] = struct.pack('<H', cluster >> 16)
+    entry[0x16:0x1A] = struct.pack('<HH', 0x6000, 0x5A21)     # modified
+    entry[0x1A:0x1C] = struct.pack('<H', cluster & 0xFFFF)
+    entry[0x1C:0x20] = struct.pack('<L', size)
+    return entry
+
+def lfn_entries(long_name, name11):
+    """
+    Long file name entries preceding the 8.3 entry, in on-disk order
+    """
+    checksum = 0
+    for c in name11:
+        checksum = (((checksum & 1) << 7) + (checksum >> 1) + c) & 0xFF
+
+    chars = [ord(c) for c in long_name] + [0x0000]
+    chars += [0xFFFF] * (-len(chars) % 13)
+    parts = [chars[i:i+13] for i in range(0, len(long_name), 13)]
+
+    out = bytearray()
+    for seq in range(len(parts), 0, -1):
+        part = parts[seq-1]
+        entry = bytearray(32)
+        entry[0] = seq | (0x40 if seq == len(parts) else 0x00)
+        entry[0x0B] = 0x0F
+        entry[0x0D] = checksum
+        for k, offset in enumerate(list(range(1, 11, 2)) + list(range(14, 26, 2)) + [28, 30]):
+            entry[offset:offset+2] = part[k].to_bytes(2, 'little')
+        out += entry
+    return out
+
+class File:
+    def __init__(self, name, data, long_name=None, attrib=ATTR_ARCHIVE):
+        self.name = name
+        self.data = bytes(data)
+        self.long_name = long_name
+        self.attrib = attrib
+        self.cluster = 0
+
+    def dirents(self):
+        out = lfn_entries(self.long_name, short_name(self.name)) if self.long_name else bytearray()
+        return out + dir_entry(short_name(self.name), self.attrib, self.cluster, len(self.data))
+
+class Deleted(File):
+    """
+    Entries of a removed file: all start with 0xE5 and the file has no
+    clusters anymore
+    """
+    def __init__(self, name, long_name=None):
+        File.__init__(self, name, b'', long_name)
+
+    def dirents(self):
+        out = File.dirents(self)
+        for i in range(0, len(out), 32):
+            out[i] = 0xE5
+        return out
+
+class Gap:
+    """
+    Clusters left free between the allocations of the preceding and the
+    following children of a folder
+    """
+    def __init__(self, nclusters):
+        self.nclusters = nclusters
+
+class Folder:
+    def __init__(self, name, parent=None, long_name=None):
+        self.name = name
+        self.parent = parent
+        self.long_name = long_name
+        self.children = []
+        self.cluster = 0
+
+    def add_file(self, name, data, long_name=None, attrib=ATTR_ARCHIVE):
+        short_name(name)
+        f = File(name, data, long_name, attrib)
+        self.children.append(f)
+        return f
+
+    def add_deleted(self, name, long_name=None):
+        short_name(name)
+        self.children.append(Deleted(name, long_name))
+
+    def skip(self, nclusters):
+        self.children.append(Gap(nclusters))
+
+    def mkdir(self, name, long_name=None):
+        short_name(name)
+        d = Folder(name, self, long_name)
+        self.children.append(d)
+        return d
+
+    def entries(self):
+        """
+        Directory entries of this folder, clusters must have been assigned
+        """
+        out = bytearray()
+        if self.parent is None:
+            out += dir_entry(self.label, ATTR_VOLUME_ID, 0, 0)
+        else:
+            parent = 0 if self.parent.parent is None else self.parent.cluster
+            out += dir_entry(b'.          ', ATTR_DIRECTORY, self.cluster, 0)
+            out += dir_entry(b'..         ', ATTR_DIRECTORY, parent, 0)
+        for c in self.children:
+            if not isinstance(c, Gap):
+                out += c.dirents()
+        return out
+
+    def dirents(self):
+        out = lfn_entries(self.long_name, short_name(self.name)) if self.long_name else bytearray()
+        return out + dir_entry(short_name(self.name), ATTR_DIRECTORY, self.cluster, 0)
+
+    def size(self):
+        n = 1 if self.parent is None else 2
+        for c in self.children:
+            if isinstance(c, (File, Folder)):
+                n += 1 + (len(c.long_name) + 12) // 13 if c.long_name else 1
+        return 32 * n
+
+class FatImage:
+    def __init__(self, size_mb=256, sectors_per_cluster=8, fragment=0, pattern='runs', seed=0,
+                 label='P2000T'):
+        if sectors_per_cluster not in (1, 2, 4, 8, 16, 32, 64, 128):
+            raise Exception('Invalid number of sectors per cluster')
+        if pattern not in PATTERNS:
+            raise Exception('Unknown fragmentation pattern: %s' % pattern)
+
+        self.total_sectors = size_mb * 1024 * 1024 // SECTOR - LBA0
+        self.sectors_per_cluster = sectors_per_cluster
+        self.fragment = fragment
+        self.pattern = pattern
+        self.rng = random.Random(seed)
+        self.root = Folder('', None)
+        self.root.label = label.upper()[:11].ljust(11).encode('ascii')
+
+        # solve the size of a FAT for the number of clusters it has to cover
+        fat_sectors = 1
+        while True:
+            data_sectors = self.total_sectors - RESERVED_SECTORS - NUMBER_OF_FATS * fat_sectors
+            self.clusters = data_sectors // sectors_per_cluster
+            needed = ((self.clusters + 2) * 4 + SECTOR - 1) // SECTOR
+            if needed <= fat_sectors:
+                break
+            fat_sectors = needed
+        self.fat_sectors = fat_sectors
+        self.fat_lba = LBA0 + RESERVED_SECTORS
+        self.data_lba = self.fat_lba + NUMBER_OF_FATS * fat_sectors
+        self.fat = [0] * (self.clusters + 2)
+        self.fat[0] = 0x0FFFFFF8
+        self.fat[1] = EOC
+        self.clusters_used = 0
+        self.next_free = ROOT_CLUSTER
+        self.writes = []                    # (offset, data)
+
+    def cluster_bytes(self):
+        return self.sectors_per_cluster * SECTOR
+
+    def cluster_offset(self, cluster):
+        return (self.data_lba + (cluster - 2) * self.sectors_per_cluster) * SECTOR
+
+    def allocate(self, nbytes, fragment=0):
+        """
+        Allocate a chain for nbytes, contiguous or in runs of fragment
+        clusters, and return its list of clusters
+        """
+        n = self.nclusters(nbytes)
+        chain = []
+        while len(chain) < n:
+            run = n - len(chain) if not fragment else min(fragment, n - len(chain))
+            if self.next_free + run > self.clusters + 2:
+                raise Exception('Image is full')
+            chain += range(self.next_free, self.next_free + run)
+            self.next_free += run + (1 if fragment and len(chain) < n else 0)
+        self.link(chain)
+        return chain
+
+    def nclusters(self, nbytes):
+        return max(1, (nbytes + self.cluster_bytes() - 1) // self.cluster_bytes())
+
+    def allocate_files(self, files):
+        """
+        Allocate the chains of the files of a folder following the
+        fragmentation pattern
+        """
+        if not self.fragment or self.pattern == 'runs':
+            for f in files:
+                f.chain = self.allocate(len(f.data), self.fragment)
+            return
+
+        # cut every file in runs, then decide on the order of all runs
+        runs = []
+        for i, f in enumerate(files):
+            n = self.nclusters(len(f.data))
+            f.chain = []
+            for j in range(0, n, self.fragment):
+                runs.append((j, i, min(self.fragment, n - j)))
+        if self.pattern == 'interleave':
+            runs.sort()
+        elif self.pattern == 'scatter':
+            self.rng.shuffle(runs)
+        elif self.pattern == 'reverse':
+            runs.reverse()
+
+        # place the runs one after another, with a free cluster in between
+        # for the scattered ones
+        total = sum(r[2] for r in runs) + (len(runs) if self.pattern == 'scatter' else 0)
+        if self.next_free + total > self.clusters + 2:
+            raise Exception('Image is full')
+        start = {}
+        for r in runs:
+            start[r] = self.next_free
+            self.next_free += r[2] + (1 if self.pattern == 'scatter' else 0)
+        for r in sorted(runs, key=lambda r: (r[1], r[0])):
+            files[r[1]].chain += range(start[r], start[r] + r[2])
+        for f in files:
+            self.link(f.chain)
+
+    def link(self, chain):
+        for a, b in zip(chain, chain[1:]):
+            self.fat[a] = b
+        self.fat[chain[-1]] = EOC
+        self.clusters_used += len(chain)
+
+    def write_chain(self, chain, data):
+        cb = self.cluster_bytes()
+        for i, c in enumerate(chain):
+            block = data[i*cb:(i+1)*cb]
+            if block:
+                self.writes.append((self.cluster_offset(c), block))
+
+    def layout(self, folder):
+        """
+        Assign clusters to a folder, its files and (recursively) its subfolders
+        """
+        chain = self.allocate(folder.size())
+        folder.cluster = chain[0]
+        folder.chain = chain
+        files = []
+        for c in folder.children + [Gap(0)]:
+            if isinstance(c, File):
+                c.chain = []
+                if c.data:
+                    files.append(c)
+            elif isinstance(c, Gap):
+                self.allocate_files(files)
+                files = []
+                self.next_free += c.nclusters
+        for c in folder.children:
+            if isinstance(c, File):
+                c.cluster = c.chain[0] if c.chain else 0
+        for c in folder.children:
+            if isinstance(c, Folder):
+                self.layout(c)
+
+    def store(self, folder):
+        data = folder.entries()
+        self.write_chain(folder.chain, data + bytes(len(folder.chain) * self.cluster_bytes() - len(data)))
+        for c in folder.children:
+            if isinstance(c, File):
+                self.write_chain(c.chain, c.data)
+            elif isinstance(c, Folder):
+                self.store(c)
+
+    def save(self, filename):
+        self.layout(self.root)
+        self.store(self.root)
+
+        with open(filename, 'wb') as f:
+            f.truncate((LBA0 + self.total_sectors) * SECTOR)   # sparse file
+
+            f.seek(0)
+            f.write(self.mbr())
+            boot = self.boot_sector()
+            fsinfo = self.fsinfo()
+            for lba in (LBA0, LBA0 + 6):
+                f.seek(lba * SECTOR)
+                f.write(boot + fsinfo)
+
+            fat = struct.pack('<%iL' % len(self.fat), *self.fat)
+            for i in range(NUMBER_OF_FATS):
+                f.seek((self.fat_lba + i * self.fat_sectors) * SECTOR)
+                f.write(fat)
+
+            for offset, data in self.writes:
+                f.seek(offset)
+                f.write(data)
+
+    def mbr(self):
+        mbr = bytearray(SECTOR)
+        entry = struct.pack('<B3sB3sLL', 0x00, b'\xFE\xFF\xFF', 0x0C, b'\xFE\xFF\xFF',
+                            LBA0, self.total_sectors)
+        mbr[0x1BE:0x1CE] = entry
+        mbr[0x1FE:0x200] = b'\x55\xAA'
+        return mbr
+
+    def boot_sector(self):
+        bs = bytearray(SECTOR)
+        bs[0x00:0x03] = b'\xEB\x58\x90'
+        bs[0x03:0x0B] = b'MSWIN4.1'
+        struct.pack_into('<HBHBHHBHHHLL', bs, 0x0B,
+                         SECTOR, self.sectors_per_cluster, RESERVED_SECTORS,
+                         NUMBER_OF_FATS, 0, 0, 0xF8, 0, 63, 255, LBA0, self.total_sectors)
+        struct.pack_into('<LHHLHH', bs, 0x24, self.fat_sectors, 0, 0, ROOT_CLUSTER, 1, 6)
+        bs[0x40] = 0x80
+        bs[0x42] = 0x29
+        struct.pack_into('<L', bs, 0x43, 0x20000000)
+        bs[0x47:0x52] = self.root.label
+        bs[0x52:0x5A] = b'FAT32   '
+        bs[0x1FE:0x200] = b'\x55\xAA'
+        return bs
+
+    def fsinfo(self):
+        fs = bytearray(SECTOR)
+        struct.pack_into('<L', fs, 0, 0x41615252)
+        struct.pack_into('<LLL', fs, 484, 0x61417272,
+                         self.clusters - self.clusters_used, self.next_free)
+        struct.pack_into('<L', fs, 508, 0xAA550000)
+        return fs
+
+if __name__ == '__main__':
+    main()
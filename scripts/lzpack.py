@@ -0,0 +1,258 @@
+# -*- coding: utf-8 -*-
+
+#
+# Compress CAS and PRG files into CAZ and PRZ containers
+#
+# Container layout (all values little endian)
+#
+#   0x00  'L','Z'   signature
+#   0x02  type      'C' for a CAS program, 'P' for a PRG program
+#   0x03  version   1
+#   0x04  uint16    deploy address
+#   0x06  uint16    length of the uncompressed data
+#   0x08  uint16    CRC-16 (XMODEM) of the uncompressed data
+#   0x0A  uint16    length of the compressed stream
+#   0x0C            4 reserved bytes
+#   0x10            CAS only: first 256-byte preamble of the cassette file
+#   ....            compressed stream
+#
+# For CAS files, the uncompressed data is the program without the 256-byte
+# preambles, i.e. exactly what the launchers put in RAM bank 1. For PRG files
+# it is the complete (signed) PRG file.
+#
+# The compressed stream is a sequence of commands, each starting with a
+# control byte c:
+#
+#   c = 0x00            end of stream
+#   c = 0x01 - 0x7F     c literal bytes follow
+#   c = 0x80 - 0xBF     copy (c & 0x3F) + 2 bytes from distance d + 1, where
+#                       d is the next byte (distance 1 - 256)
+#   c = 0xC0 - 0xFF     copy (c & 0x3F) + 3 bytes from distance d, where d is
+#                       the next 16 bit word
+#
+# See src/lz.asm for the decoder.
+#
+
+import os
+import argparse
+
+HEADER_SIZE = 0x10
+CAS_RECORD = 0x500          # 256 byte preamble + 1024 bytes of data
+CAS_PREAMBLE = 0x100
+MAX_LITERALS = 0x7F
+SHORT_MIN, SHORT_MAX, SHORT_DIST = 2, 0x3F + 2, 0x100
+LONG_MIN, LONG_MAX, LONG_DIST = 3, 0x3F + 3, 0xFFFF
+MAX_CANDIDATES = 256
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='LZ pack tool',
+                    description='Compress a CAS or PRG file into a CAZ or PRZ container')
+
+    parser.add_argument('filename')           # positional argument
+    parser.add_argument('-o', '--output', help='output file (default: .CAZ / .PRZ next to input)')
+
+    args = parser.parse_args()
+
+    if not os.path.exists(args.filename):
+        print('File does not exist: %s' % args.filename)
+        return
+
+    with open(args.filename, 'rb') as f:
+        data = bytearray(f.read())
+
+    base, ext = os.path.splitext(args.filename)
+    container, deploy, payload, crc = pack(data, ext)
+    outext = '.CAZ' if ext.upper() == '.CAS' else '.PRZ'
+
+    outfile = args.output if args.output else base + (outext if ext.isupper() else outext.lower())
+    with open(outfile, 'wb') as f:
+        f.write(container)
+
+    print('Deploy address: 0x%04X' % deploy)
+    print('Data length: %i bytes' % len(payload))
+    print('CRC-16 checksum: 0x%04X' % crc)
+    print('Compressed: %i -> %i bytes (%.2fx)' % (len(data), len(container),
+        len(data) / len(container)))
+    print('Writing to: %s' % outfile)
+
+def pack(data, ext):
+    """
+    Build the CAZ or PRZ container of a CAS or PRG file, returns the
+    container, deploy address, uncompressed data and its checksum
+    """
+    if ext.upper() == '.CAS':
+        preamble, deploy, payload = parse_cas(data)
+        ftype = b'C'
+    elif ext.upper() == '.PRG':
+        preamble, deploy, payload = parse_prg(data)
+        ftype = b'P'
+    else:
+        raise Exception('Unsupported file type: %s' % ext)
+
+    stream = compress(payload)
+    if decompress(stream) != payload:
+        raise Exception('Round trip of compressed stream failed')
+
+    crc = crc16(payload)
+    header = bytearray(HEADER_SIZE)
+    header[0x00:0x02] = b'LZ'
+    header[0x02:0x03] = ftype
+    header[0x03] = 1
+    header[0x04:0x06] = deploy.to_bytes(2, 'little')
+    header[0x06:0x08] = len(payload).to_bytes(2, 'little')
+    header[0x08:0x0A] = crc.to_bytes(2, 'little')
+    header[0x0A:0x0C] = len(stream).to_bytes(2, 'little')
+
+    return header + preamble + stream, deploy, payload, crc
+
+def parse_cas(data):
+    """
+    Strip the preambles from a cassette file
+    """
+    if len(data) < CAS_RECORD:
+        raise Exception('CAS file too short')
+
+    preamble = data[0:CAS_PREAMBLE]
+    deploy = int.from_bytes(data[0x30:0x32], 'little')
+    length = int.from_bytes(data[0x32:0x34], 'little')
+
+    payload = bytearray()
+    for i in range(0, len(data), CAS_RECORD):
+        payload += data[i+CAS_PREAMBLE:i+CAS_RECORD]
+    if length > len(payload):
+        raise Exception('CAS file shorter than its program length')
+    if length > 0x8000:
+        raise Exception('CAS program does not fit in the RAM bank')
+
+    return preamble, deploy, payload[:length]
+
+def parse_prg(data):
+    """
+    Check the signature of a PRG file
+    """
+    if data[0x0000] != 0x50:
+        raise Exception('Invalid first byte: %02X' % data[0x0000])
+    if len(data) > 0x3D00:
+        raise Exception('PRG file too large')
+
+    return bytearray(), 0xA000, data
+
+def compress(data):
+    """
+    Greedy LZ compression with one step of lazy matching
+    """
+    out = bytearray()
+    literals = bytearray()
+    chains = {}
+
+    def flush():
+        while literals:
+            n = min(MAX_LITERALS, len(literals))
+            out.append(n)
+            out.extend(literals[:n])
+            del literals[:n]
+
+    def insert(pos):
+        if pos + 2 < len(data):
+            chains.setdefault(bytes(data[pos:pos+3]), []).append(pos)
+
+    def match_length(pos, src, maxlen):
+        n = 0
+        while n < maxlen and pos + n < len(data) and data[src + n] == data[pos + n]:
+            n += 1
+        return n
+
+    def find(pos):
+        """
+        Return (saving, length, distance) of the best match at pos
+        """
+        best = (0, 0, 0)
+
+        # short matches, also covering two byte matches
+        for dist in range(1, min(SHORT_DIST, pos) + 1):
+            n = match_length(pos, pos - dist, SHORT_MAX)
+            if n >= SHORT_MIN and n - 2 > best[0]:
+                best = (n - 2, n, dist)
+
+        # long matches
+        for src in reversed(chains.get(bytes(data[pos:pos+3]), [])[-MAX_CANDIDATES:]):
+            dist = pos - src
+            if dist > LONG_DIST:
+                break
+            n = match_length(pos, src, LONG_MAX)
+            if n - 3 > best[0]:
+                best = (n - 3, n, dist)
+
+        return best
+
+    pos = 0
+    while pos < len(data):
+        saving, length, dist = find(pos)
+        insert(pos)
+
+        # defer when the next position yields a clearly better match
+        if saving > 0 and find(pos + 1)[0] > saving + 1:
+            saving = 0
+
+        if saving > 0:
+            flush()
+            if dist <= SHORT_DIST and length <= SHORT_MAX:
+                out.append(0x80 | (length - 2))
+                out.append(dist - 1)
+            else:
+                out.append(0xC0 | (length - 3))
+                out.extend(dist.to_bytes(2, 'little'))
+            for i in range(1, length):
+                insert(pos + i)
+            pos += length
+        else:
+            literals.append(data[pos])
+            pos += 1
+
+    flush()
+    out.append(0x00)
+    return out
+
+def decompress(stream):
+    """
+    Reference decoder mirroring src/lz.asm
+    """
+    out = bytearray()
+    i = 0
+    while True:
+        c = stream[i]
+        i += 1
+        if c == 0:
+            return out
+        if c < 0x80:
+            out.extend(stream[i:i+c])
+            i += c
+            continue
+        if c < 0xC0:
+            length = (c & 0x3F) + 2
+            dist = stream[i] + 1
+            i += 1
+        else:
+            length = (c & 0x3F) + 3
+            dist = stream[i] | (stream[i+1] << 8)
+            i += 2
+        for _ in range(length):
+            out.append(out[-dist])
+
+def crc16(data):
+    crc = int(0)
+
+    poly = 0x1021
+
+    for c in data: # fetch byte
+        crc ^= (c << 8) # xor into top byte
+        for i in range(8): # prepare to rotate 8 bits
+            crc = crc << 1 # rotate
+            if crc & 0x10000:
+                crc = (crc ^ poly) & 0xFFFF # xor with XMODEN polynomic
+
+    return crc
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,118 @@
+# -*- coding: utf-8 -*-
+
+#
+# Generate synthetic SD-card images to benchmark the launchers with
+#
+# The image holds a chain of nested folders DIR1/DIR2/..., each holding the
+# requested number of programs (CAS or PRG files with valid preambles and
+# checksums). Between the programs, deleted directory entries (0xE5) are
+# left, and programs can carry long file names.
+#
+# A manifest lists every program as
+#
+#   <path> <size> <crc16 of the file> <crc16 in memory> [long name]
+#
+# where the CRC-16 in memory is taken over the data as the launchers put it
+# in RAM: the CAS data without its preambles or the complete PRG file.
+#
+# Example: a deep tree of heavily fragmented folders with 512 byte clusters
+#
+#   python3 mkcard.py card.img --cluster 1 --entries 500 --depth 4 \
+#       --fragment 2 --pattern interleave --lfn 0.5 --deleted 0.2
+#
+
+import os
+import random
+import argparse
+
+from fatimage import FatImage, PATTERNS, SECTOR
+from programs import make_cas, make_prg
+from lzpack import crc16, parse_cas
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='Card generator',
+                    description='Create a FAT32 image with synthetic programs')
+
+    parser.add_argument('image')
+    parser.add_argument('-s', '--size', type=int, default=512, help='image size in MiB')
+    parser.add_argument('-c', '--cluster', type=int, default=8, help='sectors per cluster')
+    parser.add_argument('-n', '--entries', type=int, default=100, help='programs per folder')
+    parser.add_argument('-d', '--depth', type=int, default=0, help='number of nested folders')
+    parser.add_argument('-f', '--fragment', type=int, default=0, help='split files in runs of this many clusters')
+    parser.add_argument('-p', '--pattern', choices=PATTERNS, default='runs', help='order of the runs')
+    parser.add_argument('--lfn', type=float, default=0.0, help='fraction of programs with a long name')
+    parser.add_argument('--deleted', type=float, default=0.0, help='deleted entries per program')
+    parser.add_argument('--prg', type=float, default=0.25, help='fraction of PRG programs')
+    parser.add_argument('--cas-size', type=int, default=16384, help='maximum CAS program length')
+    parser.add_argument('--prg-size', type=int, default=8192, help='maximum PRG file length')
+    parser.add_argument('--seed', type=int, default=2000)
+    parser.add_argument('-m', '--manifest', help='manifest file (default: image with .txt)')
+
+    args = parser.parse_args()
+
+    if args.cas_size > 0x8000 or args.prg_size > 0x3D00 or args.prg_size < 0x20:
+        raise Exception('Programs do not fit in memory')
+
+    rng = random.Random(args.seed)
+    img = FatImage(size_mb=args.size, sectors_per_cluster=args.cluster,
+                   fragment=args.fragment, pattern=args.pattern, seed=args.seed)
+
+    manifest = []
+    folder = img.root
+    path = ''
+    for level in range(args.depth + 1):
+        fill(folder, path, args, rng, manifest)
+        if level < args.depth:
+            folder = folder.mkdir('DIR%i' % (level + 1))
+            path += 'DIR%i/' % (level + 1)
+
+    img.save(args.image)
+
+    manifest_file = args.manifest if args.manifest else os.path.splitext(args.image)[0] + '.txt'
+    with open(manifest_file, 'w') as f:
+        for line in manifest:
+            f.write(line + '\n')
+
+    print('Writing to: %s (%i clusters of %i bytes used)' %
+          (args.image, img.clusters_used, args.cluster * SECTOR))
+    print('Manifest: %s (%i programs)' % (manifest_file, len(manifest)))
+    if img.clusters < 65525:
+        print('Warning: %i clusters is too few for FAT32 according to the '
+              'specification; hosts may refuse the image' % img.clusters)
+
+def fill(folder, path, args, rng, manifest):
+    """
+    Add programs and deleted entries to a folder
+    """
+    deleted = 0.0
+    for i in range(args.entries):
+        # deleted entries precede the program
+        deleted += args.deleted
+        while deleted >= 1.0 or (deleted > 0 and rng.random() < deleted):
+            folder.add_deleted('DEL%05i.CAS' % (i % 100000),
+                               long_name=long_name(i, '.cas') if rng.random() < args.lfn else None)
+            deleted -= 1.0
+        deleted = max(deleted, 0.0)
+
+        if rng.random() < args.prg:
+            ext = '.PRG'
+            data = make_prg(rng.randrange(0x20, args.prg_size + 1), rng)
+            memory = data
+        else:
+            ext = '.CAS'
+            data = make_cas('PROG%04i' % i, rng.randrange(1, args.cas_size + 1), rng)
+            memory = parse_cas(data)[2]
+
+        name = 'P%07i%s' % (i, ext)
+        lfn = long_name(i, ext.lower()) if rng.random() < args.lfn else None
+        folder.add_file(name, data, long_name=lfn)
+        manifest.append('%s%s %i 0x%04X 0x%04X %s' % (path, name, len(data), crc16(data),
+                        crc16(memory), lfn or ''))
+
+def long_name(i, ext):
+    words = ('Space', 'Invaders', 'Ghost', 'Hunt', 'Fruit', 'Machine', 'Adventure', 'Castle')
+    return '%s %s %i%s' % (words[i % 8], words[(i // 8) % 8], i, ext)
+
+if __name__ == '__main__':
+    main()
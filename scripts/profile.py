@@ -0,0 +1,266 @@
+# -*- coding: utf-8 -*-
+
+#
+# Generate the marker ids of the profiling builds and decode captured markers
+#
+# The profiling builds (make launcher-prof, make ezlaunch-prof) write the id of
+# a function or region listed in src/profile.list to PORT_PROFILE on entry and
+# the id with bit 7 set on exit. Such a capture, one "time value" pair per line
+# as written by p2000t-bench -p or exported from a logic analyser, is turned
+# into a flat profile and a call tree.
+#
+# A region only carries an entry marker: it is closed by the next entry of the
+# same region or by the exit of a function around it. Frames that are left
+# without a marker, e.g. by an early return, are closed in the same way.
+#
+# Usage:
+#
+#   python3 profile.py ids profile.list -o prof_ids              # prof_ids.h/.inc
+#   python3 profile.py table profile.list EZLAUNCH-PROF.map -o EZLAUNCH-PROF.ids
+#   python3 profile.py decode EZLAUNCH-PROF.ids capture.txt
+#   python3 profile.py decode EZLAUNCH-PROF.ids la.csv --scale 2500000 # seconds
+#
+
+import re
+import argparse
+
+MAX_ID = 0x7F
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Marker ids and profiles of the profiling builds')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('ids', help='generate the C and assembly id headers')
+    p.add_argument('list', help='list of profiled functions and regions')
+    p.add_argument('-o', '--output', required=True,
+                   help='base name of the generated .h and .inc files')
+
+    p = sub.add_parser('table', help='generate the id table of a linked build')
+    p.add_argument('list', help='list of profiled functions and regions')
+    p.add_argument('map', help='z88dk .map file of the profiling build')
+    p.add_argument('-o', '--output', required=True, help='id table')
+
+    p = sub.add_parser('decode', help='turn a capture into a profile')
+    p.add_argument('table', help='id table of the build')
+    p.add_argument('capture', help='captured markers, one "time value" per line')
+    p.add_argument('--scale', type=float, default=1.0,
+                   help='factor converting capture times into T-states')
+    p.add_argument('--depth', type=int, default=8,
+                   help='maximum depth of the call tree')
+
+    args = parser.parse_args()
+
+    if args.command == 'ids':
+        entries = read_list(args.list)
+        with open(args.output + '.h', 'w') as f:
+            f.write(header_c(entries))
+        with open(args.output + '.inc', 'w') as f:
+            f.write(header_asm(entries))
+    elif args.command == 'table':
+        entries = read_list(args.list)
+        symbols = read_map(args.map)
+        with open(args.output, 'w') as f:
+            f.write(table(entries, symbols))
+    else:
+        names, kinds = read_table(args.table)
+        events = read_capture(args.capture, args.scale)
+        flat, tree, unmatched = decode(events, names, kinds)
+        print_flat(flat, names)
+        print()
+        print_tree(tree, names, args.depth)
+        if unmatched:
+            print('\n%i exit marker(s) without a matching entry' % unmatched)
+
+def read_list(filename):
+    """
+    Functions and regions of the list, as (id, name, kind) in order
+    """
+    entries = []
+    with open(filename) as f:
+        for line in f:
+            words = line.split('#')[0].split()
+            if not words:
+                continue
+            if len(words) != 2 or words[1] not in ('function', 'region'):
+                raise Exception('Invalid line in %s: %s' % (filename, line.strip()))
+            if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', words[0]):
+                raise Exception('Invalid name in %s: %s' % (filename, words[0]))
+            entries.append((len(entries) + 1, words[0], words[1]))
+
+    if len(entries) > MAX_ID:
+        raise Exception('More than %i entries in %s' % (MAX_ID, filename))
+    return entries
+
+def header_c(entries):
+    lines = ['// generated by scripts/profile.py from profile.list, do not edit',
+             '#ifndef _PROF_IDS_H', '#define _PROF_IDS_H', '']
+    for id, name, kind in entries:
+        lines.append('#define %-32s %i' % ('PROF_' + name.upper(), id))
+    lines += ['', '#endif // _PROF_IDS_H', '']
+    return '\n'.join(lines)
+
+def header_asm(entries):
+    lines = ['; generated by scripts/profile.py from profile.list, do not edit']
+    for id, name, kind in entries:
+        lines.append('%-32s EQU %i' % ('PROF_' + name.upper(), id))
+    return '\n'.join(lines) + '\n'
+
+def read_map(filename):
+    """
+    Addresses of the symbols in a z88dk .map file
+    """
+    symbols = {}
+    with open(filename) as f:
+        for line in f:
+            # _name = $7123 ; addr, public, , main_c, code_compiler, main.c:36
+            m = re.match(r'^(\S+)\s*=\s*\$([0-9A-Fa-f]+)\s*;\s*addr', line)
+            if m:
+                symbols[m.group(1)] = int(m.group(2), 16)
+    return symbols
+
+def table(entries, symbols):
+    """
+    Id table: id, name, kind and the address of the function in this build;
+    functions that are not linked into the build get a dash
+    """
+    lines = ['# id  name                      kind       address']
+    for id, name, kind in entries:
+        addr = symbols.get('_' + name) if kind == 'function' else None
+        lines.append('%4i  %-25s %-10s %s' % (id, name, kind,
+                     '0x%04X' % addr if addr is not None else '-'))
+    return '\n'.join(lines) + '\n'
+
+def read_table(filename):
+    names = {}
+    kinds = {}
+    with open(filename) as f:
+        for line in f:
+            words = line.split('#')[0].split()
+            if len(words) >= 3:
+                names[int(words[0])] = words[1]
+                kinds[int(words[0])] = words[2]
+    return names, kinds
+
+def read_capture(filename, scale):
+    """
+    Markers as (time in T-states, value); lines that do not start with two
+    numbers, such as the header of a CSV export, are skipped
+    """
+    events = []
+    with open(filename) as f:
+        for line in f:
+            words = re.split(r'[\s,;]+', line.strip())
+            if len(words) < 2:
+                continue
+            try:
+                t = float(words[0]) * scale
+                v = number(words[1])
+            except ValueError:
+                continue
+            events.append((t, v & 0xFF))
+    return events
+
+def number(word):
+    """
+    Decimal, 0x-prefixed or h-suffixed hexadecimal value
+    """
+    word = word.lower()
+    if word.startswith('0x'):
+        return int(word, 16)
+    if word.endswith('h'):
+        return int(word[:-1], 16)
+    return int(word)
+
+class Node:
+    def __init__(self, id):
+        self.id = id
+        self.calls = 0
+        self.total = 0.0
+        self.self = 0.0
+        self.children = {}
+
+    def child(self, id):
+        if id not in self.children:
+            self.children[id] = Node(id)
+        return self.children[id]
+
+def decode(events, names, kinds):
+    """
+    Replay the markers into a call tree and a flat profile; the flat profile
+    holds per id the calls, the inclusive time (outermost frames only, such
+    that recursion is not counted twice) and the exclusive time
+    """
+    root = Node(0)
+    flat = {}
+    stack = []      # frames: [id, start, time of children, node]
+    unmatched = 0
+
+    def close(t):
+        id, start, children, node = stack.pop()
+        duration = t - start
+        node.calls += 1
+        node.total += duration
+        node.self += duration - children
+        f = flat.setdefault(id, [0, 0.0, 0.0])
+        f[0] += 1
+        if not any(frame[0] == id for frame in stack):
+            f[1] += duration
+        f[2] += duration - children
+        if stack:
+            stack[-1][2] += duration
+
+    for t, v in events:
+        id = v & MAX_ID
+        if id == 0:
+            continue
+        if v & 0x80:
+            if any(frame[0] == id for frame in stack):
+                while stack[-1][0] != id:
+                    close(t)
+                close(t)
+            else:
+                unmatched += 1
+        else:
+            if kinds.get(id) == 'region' and any(frame[0] == id for frame in stack):
+                while stack[-1][0] != id:
+                    close(t)
+                close(t)
+            parent = stack[-1][3] if stack else root
+            stack.append([id, t, 0.0, parent.child(id)])
+
+    # frames still open at the end of the capture
+    while stack:
+        close(events[-1][0])
+
+    return flat, root, unmatched
+
+def name_of(names, id):
+    return names.get(id, 'id%i' % id)
+
+def print_flat(flat, names):
+    total = sum(f[2] for f in flat.values()) or 1.0
+    print('Flat profile (T-states)')
+    print('%-25s %8s %12s %12s %10s %10s %6s' %
+          ('name', 'calls', 'total', 'self', 'total/call', 'self/call', 'self%'))
+    for id, (calls, incl, excl) in sorted(flat.items(), key=lambda x: -x[1][2]):
+        print('%-25s %8i %12.0f %12.0f %10.1f %10.1f %5.1f%%' %
+              (name_of(names, id), calls, incl, excl, incl / calls, excl / calls,
+               100.0 * excl / total))
+
+def print_tree(root, names, depth):
+    print('Call tree (T-states)')
+    print('%-35s %8s %12s %12s %10s' % ('name', 'calls', 'total', 'self', 'total/call'))
+
+    def walk(node, level):
+        for child in sorted(node.children.values(), key=lambda n: -n.total):
+            print('%-35s %8i %12.0f %12.0f %10.1f' %
+                  ('  ' * level + name_of(names, child.id), child.calls,
+                   child.total, child.self, child.total / child.calls))
+            if level + 1 < depth:
+                walk(child, level + 1)
+
+    walk(root, 0)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,72 @@
+# -*- coding: utf-8 -*-
+
+#
+# Build synthetic CAS and PRG programs for test and benchmark images
+#
+# The contents are pseudo-random but reproducible for a given random
+# generator, and are compressible to a similar degree as real programs.
+#
+
+from lzpack import crc16, parse_cas
+
+def payload(n, rng):
+    """
+    Program-like data: runs of a small alphabet with some repetition
+    """
+    out = bytearray()
+    while len(out) < n:
+        if out and rng.random() < 0.4:
+            start = rng.randrange(len(out))
+            out += out[start:start + rng.randrange(3, 24)]
+        else:
+            out += bytes(rng.choice(b'\x00\x01\x21\x3E\xC9\xCD\x20\x28\x7E\x23')
+                         for _ in range(rng.randrange(1, 16)))
+    return out[:n]
+
+def make_cas(name, length, rng):
+    """
+    Cassette file: records of a 256-byte preamble and 1024 bytes of data
+    """
+    data = payload(length, rng)
+    blocks = (length + 1023) // 1024
+    out = bytearray()
+    for i in range(blocks):
+        preamble = bytearray(0x100)
+        preamble[0x30:0x32] = (0x6547).to_bytes(2, 'little')
+        preamble[0x32:0x34] = length.to_bytes(2, 'little')
+        preamble[0x34:0x36] = length.to_bytes(2, 'little')
+        preamble[0x36:0x3E] = name[:8].ljust(8).encode('ascii')
+        preamble[0x3E:0x41] = b'BAS'
+        preamble[0x41] = ord('B')
+        preamble[0x47:0x4F] = name[8:16].ljust(8).encode('ascii')
+        preamble[0x4F] = blocks - i
+        out += preamble + data[i*1024:(i+1)*1024].ljust(1024, b'\x00')
+    return out
+
+def make_prg(length, rng):
+    """
+    Signed PRG file of which the entry point at 0xA010 returns right away
+    """
+    data = bytearray(0x10) + bytearray([0xC9]) + payload(length - 0x11, rng)
+    data[0x00] = 0x50
+    data[0x01:0x03] = (len(data) - 0x10).to_bytes(2, 'little')
+    data[0x03:0x05] = crc16(data[0x10:]).to_bytes(2, 'little')
+    return data
+
+def sign(data):
+    """
+    Set the last two bytes such that the CRC-16 over the whole file is zero
+    """
+    data[-2:] = crc16(data[:-2]).to_bytes(2, 'big')
+    return data
+
+def loaded_crc(data, ext):
+    """
+    CRC-16 of a program as the launchers put it in memory: the CAS data
+    without its preambles, the data of a CAD file or the complete PRG file
+    """
+    if ext.upper() == '.CAS':
+        return crc16(parse_cas(data)[2])
+    if ext.upper() == '.CAD':
+        return int.from_bytes(data[0x08:0x0A], 'little')
+    return crc16(data)
@@ -1,139 +1,214 @@
 # -*- coding: utf-8 -*-
 
-import os
-import struct
+#
+# Read the FAT32 file system of an SD-card image
+#
+# The image is mapped in memory, such that even images of many gigabytes are
+# read quickly. Used as a module:
+#
+#   vol = FatVolume('sdcard.img')
+#   for entry in vol.walk():
+#       print(entry.path, entry.size, vol.runs(entry.chain))
+#
+# or from the command line to list the volume:
+#
+#   python3 readfat.py sdcard.img
+#
 
 #
 # INSPIRATION: https://www.pjrc.com/tech/8051/ide/fat32.html
 #
 
-f = open(os.path.join('D:/', 'SDCARD', 'sdcard_rawdata_4G_cas_test04'), 'rb')
+import mmap
+import struct
+import argparse
+
 BYTES_PER_SECTOR = 512
+EOC = 0x0FFFFFF8
 
-def main():   
-    # grab MBR
-    data = get_sector(0)
-    
-    # establish LBA0 (start position first partition)
-    lba0 = struct.unpack('<L', data[454:458])[0]
-    print('LBA: 0x%04X' % (lba0 * BYTES_PER_SECTOR))
-    
-    # read VOLUME ID
-    data = get_sector(lba0)
-    bytes_per_sector = struct.unpack('<H', data[0x0B:0x0D])[0]
-    sectors_per_cluster = data[0x0D]
-    reserved_sectors = struct.unpack('<H', data[0x0E:0x10])[0]
-    number_of_fats = data[0x10]
-    sectors_per_fat = struct.unpack('<L', data[0x24:0x28])[0]
-    root_dir_first_cluster = struct.unpack('<L', data[0x2C:0x30])[0]
-    signature = struct.unpack('<H', data[0x1FE:0x200])[0]
-    
-    # list data
-    print('Reserved sectors: %i' % reserved_sectors)
-    print('Number of FATS: %i' % number_of_fats)
-    print('Sectors per FAT: %i' % sectors_per_fat)
-    print('Root dir first cluster: %i' % root_dir_first_cluster)
-    print('Signature: %04X %s' % (signature, 'OK' if signature == 0xAA55 else 'FAIL'))
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='FAT32 reader',
+                    description='List the contents of a FAT32 SD-card image')
+
+    parser.add_argument('image')
+
+    args = parser.parse_args()
+
+    vol = FatVolume(args.image)
+
+    print('LBA partition 1: 0x%08X' % vol.lba0)
+    print('Bytes per sector: %i' % vol.bytes_per_sector)
+    print('Sectors per cluster: %i' % vol.sectors_per_cluster)
+    print('Reserved sectors: %i' % vol.reserved_sectors)
+    print('Number of FATS: %i' % vol.number_of_fats)
+    print('Sectors per FAT: %i' % vol.sectors_per_fat)
+    print('Root dir first cluster: %i' % vol.root_dir_first_cluster)
+    print('Volume name: %s' % vol.label)
     print()
-    
-    # consolidate variables (all numbers are in 'sector-units')
-    fat_begin_lba = lba0 + reserved_sectors
-    cluster_begin_lba = lba0 + reserved_sectors + (number_of_fats * sectors_per_fat)
-    lba_addr_root_dir = cluster_begin_lba + (root_dir_first_cluster - 2) * sectors_per_cluster
-    
-    print('Start address LBA0: %08X' % (lba0 * bytes_per_sector))
-    print('Start address FAT: %08X' % (fat_begin_lba * bytes_per_sector))
-    print('Start address root directory: %08X' % (lba_addr_root_dir * bytes_per_sector))
-    
-    # print all the files in the root directory
-    ll = find_linked_list(fat_begin_lba, root_dir_first_cluster)
-    print(['%08X' % x for x in ll])
-    files = read_files_root_directory(cluster_begin_lba, ll, sectors_per_cluster)
-    
-    #ll = find_linked_list(fat_begin_lba, 0x000000BC)
-    #files = read_files_root_directory(cluster_begin_lba, ll, sectors_per_cluster)
-    
-    # try to open a file
-    # file = files[0]
-    # print(file)
-    # fll = find_linked_list(fat_begin_lba, file[2])
-    # print(fll)
-    # data = read_file(cluster_begin_lba, fll, file[1], sectors_per_cluster)
-    # print_data(data, 32)
-  
-def find_linked_list(fat_begin_lba, nextcluster):
-    clusters = []
-    while nextcluster < 0x0FFFFFF8 and nextcluster != 0:
-        clusters.append(nextcluster)
-        data = get_sector(fat_begin_lba + (nextcluster >> 7))
-        item = nextcluster & 0b01111111
-        nextcluster = struct.unpack('<L', data[item*4:(item+1)*4])[0]    
-
-    return clusters
-
-def read_files_root_directory(cluster_begin_lba, linked_list, sectors_per_cluster):
-    files = []
-    
-    for cluster in linked_list:
-        addr = cluster_begin_lba + (cluster - 2) * sectors_per_cluster
-        #print('Cluster addr: %08X' % addr)
-        for i in range(sectors_per_cluster):
-            data = get_sector(addr + i)
-            for j in range(0,512//32):
-                if data[j*32] == 0x00: # check if first byte is 0x00 -> end of dir
-                    print('End of directory byte: entry %i, sector %i' % (j,i))
-                    break
-                else:
-                    attrib = data[j*32+0x0B]
-                    binstring = "{:08b}".format(attrib)
-                    
-                    if attrib & 0x1F == 0x00 and data[j*32] != 0xE5: # this is a file
-                        try:
-                            name = data[j*32:j*32+8].decode('ascii') + "." + data[j*32+8:j*32+11].decode('ascii')
-                            size = struct.unpack('<L', data[j*32+28:(j+1)*32])[0]
-                            fch = struct.unpack('<H', data[j*32+0x14:j*32+0x16])[0]
-                            fcl = struct.unpack('<H', data[j*32+0x1A:j*32+0x1C])[0]
-                            fc = (fch << 16) | fcl
-                            files.append(
-                                (name, size, fc)
-                            )
-                            print('[%s] (%03i) %s %i bytes (%08X) 0x%02X' % (binstring, len(files), name, size, fc, attrib))
-                        except Exception as e:
-                            print('Error: %s (attrib=0x%02X)' % (e,attrib))
-                    elif attrib & 0x0F == 0x00 and attrib & (1 << 4): # this is a folder
-                        fch = struct.unpack('<H', data[j*32+0x14:j*32+0x16])[0]
-                        fcl = struct.unpack('<H', data[j*32+0x1A:j*32+0x1C])[0]
-                        fc = (fch << 16) | fcl
-                        print('[%s] (DIR) %s (%08X)' % (binstring,data[j*32:j*32+11].decode('ascii'),fc))
-    
-    return files
-
-def read_file(cluster_begin_lba, linked_list, nrbytes, sectors_per_cluster):
-    data = bytearray()
-
-    for cluster in linked_list:
-        addr = cluster_begin_lba + (cluster - 2) * sectors_per_cluster
-        for i in range(sectors_per_cluster):
-            sectordata = get_sector(addr + i)
-            data += sectordata
-    
-    return data[0:nrbytes]
-
-def print_data(data, nrlines):
-    for i in range(nrlines):
-        for j in range(0,16):
-            print('%02X ' % data[i*8+j], end='')
-        print('  ', end='')
-        for j in range(0,16):
-            if data[i*16+j] >= 32 and data[i*16+j] <= 126 :
-                print(chr(data[i*16+j]), end='')
+
+    for e in vol.walk():
+        print('%-40s %s %10s %8i cluster(s) %4i run(s)' % (
+              e.path, 'DIR ' if e.is_dir() else 'FILE',
+              '' if e.is_dir() else e.size, len(e.chain), len(vol.runs(e.chain))))
+
+class Entry:
+    """
+    File or folder found while walking the volume
+    """
+    def __init__(self, path, name, attrib, cluster, size, long_name):
+        self.path = path
+        self.name = name                # 8.3 name as NAME.EXT
+        self.attrib = attrib
+        self.cluster = cluster
+        self.size = size
+        self.long_name = long_name
+        self.chain = []
+        self.slots = 0                  # folders: directory entries in use
+        self.deleted = 0                # folders: deleted (0xE5) entries
+        self.children = []
+
+    def is_dir(self):
+        return bool(self.attrib & 0x10)
+
+class FatVolume:
+    def __init__(self, filename):
+        self.file = open(filename, 'rb')
+        self.data = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+
+        # MBR, first partition
+        if self.data[510:512] != b'\x55\xAA':
+            raise Exception('No master boot record found')
+        self.lba0 = struct.unpack_from('<L', self.data, 0x1C6)[0]
+        self.partition_sectors = struct.unpack_from('<L', self.data, 0x1CA)[0]
+
+        # volume ID
+        bs = self.sector(self.lba0)
+        (self.bytes_per_sector, self.sectors_per_cluster, self.reserved_sectors,
+         self.number_of_fats) = struct.unpack_from('<HBHB', bs, 0x0B)
+        self.sectors_per_fat = struct.unpack_from('<L', bs, 0x24)[0]
+        self.root_dir_first_cluster = struct.unpack_from('<L', bs, 0x2C)[0]
+        if self.bytes_per_sector != BYTES_PER_SECTOR or self.sectors_per_fat == 0:
+            raise Exception('Not a FAT32 volume')
+
+        # consolidate variables (all numbers are in 'sector-units')
+        self.fat_begin_lba = self.lba0 + self.reserved_sectors
+        self.cluster_begin_lba = self.fat_begin_lba + self.number_of_fats * self.sectors_per_fat
+        self.clusters = (self.lba0 + self.partition_sectors - self.cluster_begin_lba) // self.sectors_per_cluster
+
+        self.label = bs[0x47:0x52].decode('ascii', 'replace').strip()
+        first = self.sector(self.cluster_lba(self.root_dir_first_cluster))
+        if first[0x0B] & 0x08:
+            self.label = first[0:11].decode('ascii', 'replace').strip()
+
+    def close(self):
+        self.data.close()
+        self.file.close()
+
+    def sector(self, lba):
+        return self.data[lba * BYTES_PER_SECTOR:(lba + 1) * BYTES_PER_SECTOR]
+
+    def cluster_lba(self, cluster):
+        return self.cluster_begin_lba + (cluster - 2) * self.sectors_per_cluster
+
+    def cluster_bytes(self):
+        return self.sectors_per_cluster * BYTES_PER_SECTOR
+
+    def next_cluster(self, cluster):
+        return struct.unpack_from('<L', self.data, self.fat_begin_lba * BYTES_PER_SECTOR + cluster * 4)[0] & 0x0FFFFFFF
+
+    def chain(self, cluster):
+        """
+        Clusters of a chain, stops at loops and at the end of the volume
+        """
+        clusters = []
+        seen = set()
+        while 2 <= cluster < EOC and cluster < self.clusters + 2 and cluster not in seen:
+            clusters.append(cluster)
+            seen.add(cluster)
+            cluster = self.next_cluster(cluster)
+        return clusters
+
+    def read(self, chain, nrbytes=None):
+        cb = self.cluster_bytes()
+        out = bytearray()
+        for c in chain:
+            offset = self.cluster_lba(c) * BYTES_PER_SECTOR
+            out += self.data[offset:offset + cb]
+            if nrbytes is not None and len(out) >= nrbytes:
+                break
+        return bytes(out if nrbytes is None else out[:nrbytes])
+
+    @staticmethod
+    def runs(chain):
+        """
+        Split a chain in runs of consecutive clusters, as (first, length)
+        """
+        out = []
+        for c in chain:
+            if out and out[-1][0] + out[-1][1] == c:
+                out[-1] = (out[-1][0], out[-1][1] + 1)
             else:
-                print('.', end='')
-        print()
+                out.append((c, 1))
+        return out
+
+    def folder(self, entry):
+        """
+        Read the entries of a folder into entry.children
+        """
+        data = self.read(entry.chain)
+        lfn = {}
+        for i in range(0, len(data), 32):
+            d = data[i:i+32]
+            if d[0] == 0x00:
+                break
+            if d[0] == 0xE5:
+                entry.deleted += 1
+                lfn = {}
+                continue
+            entry.slots += 1
+            attrib = d[0x0B]
+            if attrib & 0x0F == 0x0F:
+                seq = d[0] & 0x1F
+                chars = d[1:11] + d[14:26] + d[28:32]
+                lfn[seq] = chars.decode('utf-16-le', 'replace').split('\x00')[0].replace('\uffff', '')
+                continue
+            if attrib & 0x08:
+                lfn = {}
+                continue
+
+            base = d[0:8].decode('ascii', 'replace').rstrip()
+            ext = d[8:11].decode('ascii', 'replace').rstrip()
+            name = base + ('.' + ext if ext else '')
+            long_name = ''.join(lfn[k] for k in sorted(lfn)) if lfn else None
+            lfn = {}
+            if name in ('.', '..'):
+                continue
+
+            cluster = struct.unpack_from('<H', d, 0x14)[0] << 16 | struct.unpack_from('<H', d, 0x1A)[0]
+            size = struct.unpack_from('<L', d, 0x1C)[0]
+            child = Entry(entry.path + name + ('/' if attrib & 0x10 else ''), name,
+                          attrib, cluster, size, long_name)
+            child.chain = self.chain(cluster)
+            entry.children.append(child)
+
+    def root(self):
+        entry = Entry('/', '', 0x10, self.root_dir_first_cluster, 0, None)
+        entry.chain = self.chain(self.root_dir_first_cluster)
+        return entry
+
+    def walk(self, entry=None):
+        """
+        Yield all folders and files, depth first, starting at the root
+        """
+        if entry is None:
+            entry = self.root()
+            yield entry
+        self.folder(entry)
+        for child in entry.children:
+            yield child
+            if child.is_dir():
+                yield from self.walk(child)
 
-def get_sector(sector_id):
-    f.seek(sector_id * BYTES_PER_SECTOR)
-    return f.read(BYTES_PER_SECTOR)
- 
 if __name__ == '__main__':
-    main()
\ No newline at end of file
+    main()
@@ -0,0 +1,412 @@
+# -*- coding: utf-8 -*-
+
+#
+# Static T-state analysis of the assembly kernels
+#
+# Every kernel listed in the budget file (src/kernels.budget) is traced from its
+# entry label through the source: forward jumps are followed, conditional
+# branches that leave a loop are assumed not taken, and a backward branch
+# closes a loop. The iteration count of a loop is taken from the budget file
+# or, for 8-bit counters (djnz, or dec r followed by jp/jr nz), from the
+# ld r,n in front of the loop. Calls to labels in the same file add the cost
+# of the called routine.
+#
+# The report lists the T-states of each kernel for its byte count, the
+# T-states per byte and the resulting throughput at the clock frequency of
+# commands.h. The script exits with an error when a kernel exceeds the
+# T-states per byte of its budget.
+#
+# Usage:
+#
+#   python3 tstates.py ../src/kernels.budget
+#   python3 tstates.py ../src/kernels.budget -v     # include the annotated trace
+#
+
+import os
+import re
+import sys
+import argparse
+
+REGS8 = ('a', 'b', 'c', 'd', 'e', 'h', 'l')
+REGS16 = ('bc', 'de', 'hl', 'sp', 'af')
+INDEX = ('ix', 'iy')
+INDEX8 = ('ixh', 'ixl', 'iyh', 'iyl')
+CONDITIONS = ('nz', 'z', 'nc', 'c', 'po', 'pe', 'p', 'm')
+ALU = ('add', 'adc', 'sub', 'sbc', 'and', 'xor', 'or', 'cp')
+SHIFT = ('rlc', 'rl', 'rrc', 'rr', 'sla', 'sra', 'srl', 'sll')
+DIRECTIVES = ('section', 'public', 'extern', 'global', 'include', 'defb', 'defw',
+              'defm', 'defs', 'db', 'dw', 'ds', 'org', 'assert', 'align', 'equ', 'defc')
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='T-state analyser',
+                    description='Report and check the T-states per byte of the assembly kernels')
+
+    parser.add_argument('budget', help='kernel budget file')
+    parser.add_argument('-f', '--frequency', type=int, help='clock frequency in Hz (default: __clock_freq of commands.h)')
+    parser.add_argument('-v', '--verbose', action='store_true', help='print the annotated trace of every kernel')
+
+    args = parser.parse_args()
+
+    folder = os.path.dirname(os.path.abspath(args.budget))
+    frequency = args.frequency if args.frequency else clock_frequency(os.path.join(folder, 'commands.h'))
+    kernels = read_budget(args.budget)
+
+    sources = {}
+    failed = []
+    print('%-24s %9s %6s %8s %9s %8s' % ('kernel', 'T-states', 'bytes', 'T/byte', 'bytes/s', 'budget'))
+    for k in kernels:
+        if k['file'] not in sources:
+            sources[k['file']] = Source(os.path.join(folder, k['file']))
+        src = sources[k['file']]
+
+        trace = []
+        n = k['bytes']
+        loops = {label: evaluate(expr, n) for label, expr in k['loops'].items()}
+        total = src.cost(k['label'], loops, trace, loop_only=k['scope'] == 'loop')
+
+        per_byte = total / n
+        status = ''
+        if per_byte > k['budget']:
+            status = ' EXCEEDED'
+            failed.append(k['name'])
+        print('%-24s %9i %6i %8.2f %9i %8.2f%s' % (k['name'], total, n, per_byte,
+              frequency / per_byte, k['budget'], status))
+
+        if args.verbose:
+            for count, t, line in trace:
+                print('    %8.1f x %2i  %s' % (count, t, line))
+
+    if failed:
+        print('Kernels over budget: %s' % ', '.join(failed))
+        sys.exit(1)
+
+def clock_frequency(header):
+    with open(header) as f:
+        m = re.search(r'#define\s+__clock_freq\s+(\d+)', f.read())
+    if not m:
+        raise Exception('No __clock_freq in %s' % header)
+    return int(m.group(1))
+
+def read_budget(filename):
+    """
+    Each line of the budget file holds: name, file, scope (routine or loop),
+    entry label, byte count, loop counts (label=expression in n, or -) and
+    the maximum T-states per byte
+    """
+    kernels = []
+    with open(filename) as f:
+        for line in f:
+            line = line.split('#')[0].split()
+            if not line:
+                continue
+            if len(line) != 7:
+                raise Exception('Invalid budget line: %s' % ' '.join(line))
+            loops = {}
+            if line[5] != '-':
+                for item in line[5].split(','):
+                    label, expr = item.split('=')
+                    loops[label] = expr
+            kernels.append({'name': line[0], 'file': line[1], 'scope': line[2],
+                            'label': line[3], 'bytes': int(line[4]), 'loops': loops,
+                            'budget': float(line[6])})
+    return kernels
+
+def evaluate(expr, n):
+    if not re.fullmatch(r'[n0-9+\-*/() ]+', expr):
+        raise Exception('Invalid loop count: %s' % expr)
+    return eval(expr, {'__builtins__': {}}, {'n': n})
+
+def number(s):
+    """
+    Value of a numeric literal, None for anything else
+    """
+    s = s.strip().lower()
+    try:
+        if s.startswith('$'):
+            return int(s[1:], 16)
+        if s.startswith('0x'):
+            return int(s, 16)
+        if s.endswith('h') and re.fullmatch(r'[0-9][0-9a-f]*h', s):
+            return int(s[:-1], 16)
+        return int(s)
+    except ValueError:
+        return None
+
+class Instruction:
+    def __init__(self, mnemonic, operands, text):
+        self.mnemonic = mnemonic
+        self.operands = operands
+        self.text = text
+
+    def target(self):
+        """
+        Label of a jump, call or djnz, ignoring any offset expression
+        """
+        if not self.operands:
+            return None
+        m = re.match(r'[A-Za-z_.][A-Za-z0-9_.]*', self.operands[-1])
+        return m.group(0) if m and self.operands[-1].lower() not in ('(hl)', '(ix)', '(iy)') else None
+
+    def condition(self):
+        if self.mnemonic in ('jp', 'jr', 'call', 'ret') and self.operands and \
+           self.operands[0].lower() in CONDITIONS and (self.mnemonic == 'ret' or len(self.operands) == 2):
+            return self.operands[0].lower()
+        return None
+
+class Source:
+    def __init__(self, filename):
+        self.filename = filename
+        self.instructions = []
+        self.labels = {}
+        self.costs = {}
+        self.parse()
+
+    def parse(self):
+        # conditional blocks are resolved for the default build, in which no
+        # symbols such as PROFILING are defined
+        skipping = []
+        with open(self.filename) as f:
+            for line in f:
+                text = line.split(';')[0].rstrip()
+                words = text.split()
+                if words and words[0].lower() in ('if', 'ifdef', 'ifndef'):
+                    skipping.append(words[0].lower() != 'ifndef')
+                    continue
+                if words and words[0].lower() == 'else':
+                    skipping[-1] = not skipping[-1]
+                    continue
+                if words and words[0].lower() == 'endif':
+                    skipping.pop()
+                    continue
+                if any(skipping):
+                    continue
+                m = re.match(r'\s*([A-Za-z_.][A-Za-z0-9_.]*):(.*)', text)
+                label = None
+                if m:
+                    label, text = m.group(1), m.group(2)
+                words = text.split(None, 1)
+                if words and (words[0].lower() in DIRECTIVES or
+                   (len(words) > 1 and words[1].split()[0].lower() in DIRECTIVES)):
+                    continue        # constants and data are not code labels
+                if label:
+                    self.labels[label] = len(self.instructions)
+                if not words:
+                    continue
+                mnemonic = words[0].lower()
+                if mnemonic == 'jmp':
+                    mnemonic = 'jp'
+                operands = [o.strip() for o in words[1].split(',')] if len(words) > 1 else []
+                self.instructions.append(Instruction(mnemonic, operands, text.strip()))
+
+    def trace(self, label):
+        """
+        Instruction indices from the label until the routine returns
+        """
+        if label not in self.labels:
+            raise Exception('Label %s not found in %s' % (label, self.filename))
+        path = []
+        i = self.labels[label]
+        while i < len(self.instructions) and len(path) < 10000:
+            ins = self.instructions[i]
+            path.append(i)
+            if ins.mnemonic in ('ret', 'reti', 'retn') and not ins.condition():
+                break
+            if ins.mnemonic == 'jp' and ins.operands and ins.operands[0].lower() in ('(hl)', '(ix)', '(iy)'):
+                break
+            if ins.mnemonic in ('jp', 'jr') and not ins.condition():
+                target = self.labels.get(ins.target())
+                if target is None:
+                    break           # jump out of this file
+                if target > i:
+                    i = target      # follow forward jumps
+                    continue
+            i += 1
+        return path
+
+    def loops(self, path):
+        """
+        (start, end) positions in the path of every backward branch
+        """
+        loops = []
+        for pos, i in enumerate(path):
+            ins = self.instructions[i]
+            if ins.mnemonic in ('jp', 'jr', 'djnz'):
+                target = self.labels.get(ins.target())
+                if target is not None and target <= i and target in path[:pos + 1]:
+                    loops.append((path.index(target), pos))
+        return loops
+
+    def iterations(self, path, start, end, counts):
+        labels = [l for l, i in self.labels.items() if i == path[start]]
+        for label in labels:
+            if label in counts:
+                return counts[label]
+
+        # 8-bit counter initialised in front of the loop
+        branch = self.instructions[path[end]]
+        reg = None
+        if branch.mnemonic == 'djnz':
+            reg = 'b'
+        elif end > 0 and branch.condition() == 'nz':
+            prev = self.instructions[path[end - 1]]
+            if prev.mnemonic == 'dec' and prev.operands[0].lower() in REGS8:
+                reg = prev.operands[0].lower()
+        if reg is not None:
+            for pos in range(start - 1, -1, -1):
+                ins = self.instructions[path[pos]]
+                if ins.mnemonic == 'ld' and ins.operands[0].lower() == reg:
+                    n = number(ins.operands[1])
+                    if n is not None:
+                        return n if n > 0 else 256
+                    break
+        raise Exception('Unknown iteration count of loop %s in %s' % ('/'.join(labels), self.filename))
+
+    def cost(self, label, counts, trace=None, loop_only=False):
+        """
+        T-states of the routine at label, or of the loop at label
+        """
+        path = self.trace(label)
+        loops = self.loops(path)
+        if loop_only:
+            outer = [l for l in loops if l[0] == 0]
+            if not outer:
+                raise Exception('No loop at %s in %s' % (label, self.filename))
+            end = max(l[1] for l in outer)
+            path = path[:end + 1]
+            loops = [l for l in loops if l[1] <= end]
+
+        # number of times each position is executed
+        multiplicity = [1.0] * len(path)
+        closing = {}
+        for start, end in loops:
+            n = self.iterations(path, start, end, counts)
+            for pos in range(start, end + 1):
+                multiplicity[pos] *= n
+            closing[end] = n
+
+        total = 0.0
+        for pos, i in enumerate(path):
+            ins = self.instructions[i]
+            m = multiplicity[pos]
+            taken, not_taken = timing(ins)
+            if pos in closing:
+                t = taken * m * (1 - 1 / closing[pos]) + not_taken * m / closing[pos]
+            else:
+                t = not_taken * m
+            if ins.mnemonic == 'call' and ins.target() in self.labels:
+                key = ins.target()
+                if key not in self.costs:
+                    self.costs[key] = self.cost(key, counts)
+                t += self.costs[key] * m
+            total += t
+            if trace is not None:
+                trace.append((m, round(t / m), ins.text))
+        return total
+
+def timing(ins):
+    """
+    T-states of an instruction as (taken, not taken); both are equal for
+    anything but conditional branches
+    """
+    mn = ins.mnemonic
+    ops = [o.lower().replace(' ', '') for o in ins.operands]
+
+    def kind(o):
+        if o in REGS8:
+            return 'r'
+        if o in INDEX8:
+            return 'x8'
+        if o == '(hl)':
+            return '(hl)'
+        if re.fullmatch(r'\((ix|iy)([+-].*)?\)', o):
+            return '(ix)'
+        if o in ('(bc)', '(de)'):
+            return '(rr)'
+        if o in ('(sp)',):
+            return '(sp)'
+        if o == '(c)':
+            return '(c)'
+        if o in ('bc', 'de', 'hl', 'sp', 'af'):
+            return 'rr'
+        if o in INDEX:
+            return 'ix'
+        if o in ('i', 'r'):
+            return 'ir'
+        if o.startswith('('):
+            return '(nn)'
+        return 'n'
+
+    k = [kind(o) for o in ops]
+    simple = {'nop': 4, 'halt': 4, 'di': 4, 'ei': 4, 'daa': 4, 'cpl': 4, 'ccf': 4,
+              'scf': 4, 'rlca': 4, 'rrca': 4, 'rla': 4, 'rra': 4, 'exx': 4, 'neg': 8,
+              'im': 8, 'rld': 18, 'rrd': 18, 'ldi': 16, 'ldd': 16, 'cpi': 16, 'cpd': 16,
+              'ini': 16, 'ind': 16, 'outi': 16, 'outd': 16, 'reti': 14, 'retn': 14, 'rst': 11}
+    repeat = {'ldir': 21, 'lddr': 21, 'cpir': 21, 'cpdr': 21, 'inir': 21, 'indr': 21,
+              'otir': 21, 'otdr': 21}
+
+    if mn in simple:
+        return simple[mn], simple[mn]
+    if mn in repeat:
+        # a single iteration, the count is not known statically
+        return 16, 16
+    if mn == 'ld':
+        d, s = k
+        table = {('r', 'r'): 4, ('r', 'n'): 7, ('r', '(hl)'): 7, ('(hl)', 'r'): 7,
+                 ('(hl)', 'n'): 10, ('r', '(rr)'): 7, ('(rr)', 'r'): 7, ('r', '(nn)'): 13,
+                 ('(nn)', 'r'): 13, ('r', '(ix)'): 19, ('(ix)', 'r'): 19, ('(ix)', 'n'): 19,
+                 ('rr', 'n'): 10, ('ix', 'n'): 14, ('ix', '(nn)'): 20, ('(nn)', 'ix'): 20,
+                 ('x8', 'r'): 8, ('r', 'x8'): 8, ('x8', 'x8'): 8, ('x8', 'n'): 11,
+                 ('r', 'ir'): 9, ('ir', 'r'): 9, ('rr', 'rr'): 6, ('rr', 'ix'): 10}
+        if (d, s) == ('rr', '(nn)'):
+            return (16, 16) if ops[0] == 'hl' else (20, 20)
+        if (d, s) == ('(nn)', 'rr'):
+            return (16, 16) if ops[1] == 'hl' else (20, 20)
+        return table[(d, s)], table[(d, s)]
+    if mn in ('push', 'pop'):
+        t = (15 if mn == 'push' else 14) if k[0] == 'ix' else (11 if mn == 'push' else 10)
+        return t, t
+    if mn == 'ex':
+        t = {'(sp)': 23 if ops[1] in INDEX else 19}.get(k[0], 4)
+        return t, t
+    if mn in ALU:
+        if len(ops) == 2 and k[0] in ('rr', 'ix'):
+            t = 11 if mn == 'add' and k[0] == 'rr' else 15
+            return t, t
+        s = k[-1]
+        t = {'r': 4, 'n': 7, '(hl)': 7, '(ix)': 19, 'x8': 8}[s]
+        return t, t
+    if mn in ('inc', 'dec'):
+        t = {'r': 4, '(hl)': 11, '(ix)': 23, 'rr': 6, 'ix': 10, 'x8': 8}[k[0]]
+        return t, t
+    if mn in SHIFT:
+        t = {'r': 8, '(hl)': 15, '(ix)': 23}[k[-1]]
+        return t, t
+    if mn == 'bit':
+        t = {'r': 8, '(hl)': 12, '(ix)': 20}[k[-1]]
+        return t, t
+    if mn in ('set', 'res'):
+        t = {'r': 8, '(hl)': 15, '(ix)': 23}[k[-1]]
+        return t, t
+    if mn == 'jp':
+        if k[0] in ('(hl)',):
+            return 4, 4
+        if k[0] == '(ix)':
+            return 8, 8
+        return 10, 10
+    if mn == 'jr':
+        return (12, 7) if ins.condition() else (12, 12)
+    if mn == 'djnz':
+        return 13, 8
+    if mn == 'call':
+        return (17, 10) if ins.condition() else (17, 17)
+    if mn == 'ret':
+        return (11, 5) if ins.condition() else (10, 10)
+    if mn == 'in':
+        return (12, 12) if k[1] == '(c)' else (11, 11)
+    if mn == 'out':
+        return (12, 12) if k[0] == '(c)' else (11, 11)
+    raise Exception('Unknown instruction: %s' % ins.text)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,130 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#include "bootcfg.h"
+#include "sdcard.h"
+
+uint32_t _preload_cluster = 0;
+
+static uint16_t _bootcfg_size = 0;      // bytes of the file at BOOTCFG_RAM
+static uint16_t _bootcfg_pos = 0;       // offset of the next line
+
+// names of the keys, in the order of their BOOTCFG_* values
+static const char* const _bootcfg_keys[] = {
+    "FOLDER", "AUTOBOOT", "VERBOSE", "WARM", "PRELOAD", "RUN", "SORT"
+};
+
+/**
+ * @brief Read the configuration file into BOOTCFG_RAM and rewind it
+ *
+ * @param lba  sector address of the first sector of the file
+ * @param size size of the file in bytes
+ * @return uint8_t 0 on success, 1 upon a read error, BOOTCFG_TOOLONG when the
+ *         file exceeds BOOTCFG_MAXSIZE bytes (nothing is read)
+ */
+uint8_t bootcfg_open(uint32_t lba, uint32_t size) {
+    _bootcfg_pos = 0;
+    _bootcfg_size = 0;
+    if(size > BOOTCFG_MAXSIZE) {
+        return BOOTCFG_TOOLONG;
+    }
+    _bootcfg_size = size;
+    if(_bootcfg_size != 0 && read_sector_to(lba, BOOTCFG_RAM) != 0xFE) {
+        _bootcfg_size = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse the next setting of the configuration file
+ *
+ * @param value receives the value, without surrounding whitespace, of at
+ *              most BOOTCFG_VALUE-1 characters
+ * @return uint8_t one of the BOOTCFG_* keys, BOOTCFG_END after the last line
+ */
+uint8_t bootcfg_next(char* value) {
+    while(_bootcfg_pos < _bootcfg_size) {
+        // collect the line, upper casing the key
+        char key[9];
+        uint8_t keylen = 0;
+        uint8_t len = 0;
+        uint8_t in_value = 0;
+        while(_bootcfg_pos < _bootcfg_size) {
+            char c = ram_read_uint8_t(BOOTCFG_RAM + _bootcfg_pos++);
+            if(c == '\n' || c == '\r') {
+                break;
+            }
+            if(in_value) {
+                if(len < BOOTCFG_VALUE - 1 && (len != 0 || (c != ' ' && c != '\t'))) {
+                    value[len++] = c;
+                }
+            } else if(c == '=') {
+                in_value = 1;
+            } else if(c != ' ' && c != '\t' && keylen < 8) {
+                key[keylen++] = (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+            }
+        }
+
+        // skip empty lines, comments and lines without a value assignment
+        if(!in_value || keylen == 0 || key[0] == '#' || key[0] == ';') {
+            continue;
+        }
+        while(len != 0 && (value[len-1] == ' ' || value[len-1] == '\t')) {
+            len--;
+        }
+        value[len] = 0x00;
+        key[keylen] = 0x00;
+
+        for(uint8_t i=0; i<sizeof(_bootcfg_keys) / sizeof(char*); i++) {
+            if(strcmp(key, _bootcfg_keys[i]) == 0) {
+                return BOOTCFG_FOLDER + i;
+            }
+        }
+        return BOOTCFG_UNKNOWN;
+    }
+    return BOOTCFG_END;
+}
+
+/**
+ * @brief Parse a comma-separated WARM list
+ *
+ * @param value list of cache names
+ * @return uint8_t combination of the BOOTCFG_WARM_* flags
+ */
+uint8_t bootcfg_warm(const char* value) {
+    uint8_t flags = 0;
+    while(*value) {
+        while(*value == ' ' || *value == ',') {
+            value++;
+        }
+        if(memcmp(value, "FAT", 3) == 0) {
+            flags |= BOOTCFG_WARM_FAT;
+        } else if(memcmp(value, "DIR", 3) == 0) {
+            flags |= BOOTCFG_WARM_DIR;
+        }
+        while(*value && *value != ',') {
+            value++;
+        }
+    }
+    return flags;
+}
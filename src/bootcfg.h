@@ -0,0 +1,101 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _BOOTCFG_H
+#define _BOOTCFG_H
+
+/*
+ * Optional boot configuration of the launchers, read once after mounting
+ * from P2000T.CFG in the root folder. Every line holds a KEY=value pair;
+ * empty lines and lines starting with '#' or ';' are ignored. The keys are
+ *
+ *     FOLDER    start folder
+ *     AUTOBOOT  program to boot, when empty there is no AUTOBOOT.CAS scan
+ *     VERBOSE   0 clears the start-up lines (launcher)
+ *     WARM      caches to fill for the start folder, e.g. FAT,DIR
+ *     PRELOAD   program to keep in the cassette RAM bank
+ *     RUN       command to execute (launcher), may be repeated; at most
+ *               INPUTLENGTH characters, longer lines are rejected
+ *     SORT      1 lists folders in sorted order (fatsort.h)
+ *
+ * Paths are relative to the root folder and consist of DOS 8.3 names. The
+ * file is limited to a single sector (BOOTCFG_MAXSIZE bytes), which is kept
+ * at BOOTCFG_RAM while the lines are processed; a longer file is rejected as
+ * a whole rather than being cut off in the middle of a line.
+ */
+
+#include <stdint.h>
+
+#include "ram.h"
+
+#define BOOTCFG_BASENAME    "P2000T  "
+#define BOOTCFG_EXT         "CFG"
+#define BOOTCFG_RAM         SDCACHE7    // no file handles are open at boot
+#define BOOTCFG_VALUE       40          // buffer size of a value
+#define BOOTCFG_MAXSIZE     512         // one sector, the size of BOOTCFG_RAM
+#define BOOTCFG_TOOLONG     2           // bootcfg_open: file exceeds BOOTCFG_MAXSIZE
+
+// keys returned by bootcfg_next
+#define BOOTCFG_END         0
+#define BOOTCFG_UNKNOWN     1
+#define BOOTCFG_FOLDER      2
+#define BOOTCFG_AUTOBOOT    3
+#define BOOTCFG_VERBOSE     4
+#define BOOTCFG_WARM        5
+#define BOOTCFG_PRELOAD     6
+#define BOOTCFG_RUN         7
+#define BOOTCFG_SORT        8
+
+// caches listed by WARM
+#define BOOTCFG_WARM_FAT    0x01        // FAT sector of the start folder
+#define BOOTCFG_WARM_DIR    0x02        // directory of the start folder
+
+// first cluster of the program held in the cassette RAM bank by PRELOAD,
+// 0 when the bank holds no (or no longer the) preloaded program
+extern uint32_t _preload_cluster;
+
+/**
+ * @brief Read the configuration file into BOOTCFG_RAM and rewind it
+ *
+ * @param lba  sector address of the first sector of the file
+ * @param size size of the file in bytes
+ * @return uint8_t 0 on success, 1 upon a read error, BOOTCFG_TOOLONG when the
+ *         file exceeds BOOTCFG_MAXSIZE bytes (nothing is read)
+ */
+uint8_t bootcfg_open(uint32_t lba, uint32_t size);
+
+/**
+ * @brief Parse the next setting of the configuration file
+ *
+ * @param value receives the value, without surrounding whitespace, of at
+ *              most BOOTCFG_VALUE-1 characters
+ * @return uint8_t one of the BOOTCFG_* keys, BOOTCFG_END after the last line
+ */
+uint8_t bootcfg_next(char* value);
+
+/**
+ * @brief Parse a comma-separated WARM list
+ *
+ * @param value list of cache names
+ * @return uint8_t combination of the BOOTCFG_WARM_* flags
+ */
+uint8_t bootcfg_warm(const char* value);
+
+#endif // _BOOTCFG_H
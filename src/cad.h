@@ -0,0 +1,54 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+
+#ifndef _CAD_H
+#define _CAD_H
+
+/*
+ * Direct-load CAD files, produced from CAS files by scripts/cas2cad.py. A CAD
+ * file holds the program without the cassette preambles, starting at the
+ * second sector, such that it is streamed sector by sector into the RAM bank
+ * without any de-interleaving. The first sector holds the header and the
+ * first CAS preamble, which is kept for display.
+ *
+ *   0x000  'C','D'   signature
+ *   0x002  uint8_t   version
+ *   0x003  uint8_t   reserved
+ *   0x004  uint16_t  deploy address
+ *   0x006  uint16_t  program length
+ *   0x008  uint16_t  CRC-16 of the program
+ *   0x00A            6 reserved bytes
+ *   0x010            first 256-byte preamble of the cassette file
+ *   0x200            program data
+ */
+
+#define CAD_DEPLOY      0x04
+#define CAD_LENGTH      0x06
+#define CAD_CRC16       0x08
+#define CAD_PREAMBLE    0x10
+#define CAD_DATA        0x200
+
+// the first sector is loaded above the program, at the metadata used by launch_cas
+#define CAD_HEADER_RAM  0x8000
+#define CAD_MAX_SECTORS (1 + 0x8000 / 0x200)
+
+#endif // _CAD_H
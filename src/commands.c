@@ -21,18 +21,42 @@
 #include "commands.h"
 #include "launch_cas.h"
 #include "flash_utils.h"
-
-char __lastinput[INPUTLENGTH];
+#include "sdapi.h"
+#include "fatwrite.h"
+#include "lz.h"
+#include "progress.h"
+#include "fatview.h"
+#include "bootcfg.h"
+#include "fatsort.h"
+#include "fatpath.h"
+#include "freespace.h"
+#include "rom.h"
+#include "trace.h"
+
+char __lastinput[INPUTLENGTH+1];
 
 // set list of commands
 char* __commands[] = {
     "ls",
     "lscas",
     "cd",
+    "sort",
     "run",
     "load",
+#ifdef FAT_WRITE
+    "save",
+#endif
     "ledtest",
     "flash",
+#ifdef BENCHMARK
+    "bench",
+#endif
+    "cardinfo",
+    "df",
+    "vol",
+#ifdef TRACING
+    "trace",
+#endif
     "help",
 };
 
@@ -41,10 +65,23 @@ void (*__operations[])(void) = {
     command_ls,
     command_lscas,
     command_cd,
+    command_sort,
     command_run,
     command_load,
+#ifdef FAT_WRITE
+    command_save,
+#endif
     command_ledtest,
     command_flash,
+#ifdef BENCHMARK
+    command_bench,
+#endif
+    command_cardinfo,
+    command_df,
+    command_vol,
+#ifdef TRACING
+    command_trace,
+#endif
     command_help,
 };
 
@@ -69,40 +106,63 @@ void command_lscas(void) {
 }
 
 /**
- * @brief change directory to folder indicated by id
+ * @brief change directory to folder indicated by id or by path
  */
 void command_cd(void) {
     static const char err[] = "Invalid entry or not a directory";
 
-    int id = atoi(&__lastinput[2]);
-    _current_attrib = 0x00;
+    const char* arg = strstrip(&__lastinput[2]);
+    uint32_t clus;
+
+    if(*arg >= '0' && *arg <= '9') {
+        _current_attrib = 0x00;
+        clus = read_folder(atoi(arg), 0);
+        if(clus == _root_dir_first_cluster || !(_current_attrib & (1 << 4))) {
+            print_error(err);
+            return;
+        }
+        if(clus == 0) { // if zero, this is the root directory
+            clus = _root_dir_first_cluster;
+        }
 
-    uint32_t clus = read_folder(id, 0);
-    if(clus != _root_dir_first_cluster) {
-        if(_current_attrib & (1 << 4)) {
-            if(clus == 0) { // if zero, this is the root directory
-                _current_folder_cluster = _root_dir_first_cluster;
-            } else {
-                _current_folder_cluster = clus;
+        // keep the recent stack leading to the new folder
+        if(_base_name[0] == '.') {
+            const RecentFolder* r = recent_pop();
+            if(r == NULL || r->folder != clus) {
+                recent_reset();
             }
         } else {
-            print_error(err);
+            recent_push(_current_folder_cluster, 0, 0);
         }
     } else {
-        print_error(err);
+        clus = resolve_path(arg, 1);
+        if(clus == 0) {
+            print_error(err);
+            return;
+        }
     }
+
+    _current_folder_cluster = clus;
+    _handle_table_cluster = 0; // ids of the previous listing expire
 }
 
-void command_flash(void) {
-    int fileid = atoi(&__lastinput[5]); // file nr
+/**
+ * @brief Toggle listing folders in sorted order
+ */
+void command_sort(void) {
+    _sort_enabled = !_sort_enabled;
+    _handle_table_cluster = 0; // ids of the previous listing expire
+    print(_sort_enabled ? "Folders are listed sorted" : "Folders are listed in disk order");
+}
 
+void command_flash(void) {
     // find a file and store its cluster structure into the linked list
-    if(read_file_metadata(fileid) != 0) {
+    if(read_file_metadata(&__lastinput[5]) != 0) {
         return;
     }
 
     if ((memcmp(_base_name, "LAUNCHER", 8) == 0 || memcmp(_base_name, "EZLAUNCH", 8) == 0) && memcmp(_ext, "BIN", 3 ) == 0) {
-        if (flash_rom(_linkedlist[0])) {
+        if (flash_rom(_cluster_current_file)) {
             print("Press any key to restart");
             wait_for_key();
             call_addr(0x1010); //cold reset after firmware flashing
@@ -119,26 +179,55 @@ void command_flash(void) {
 void command_loadrun(unsigned type) {
     print_recall("Searching file...");
 
-    int fileid = atoi(&__lastinput[type ? 3 : 4]); // file nr after LOAD / RUN
-
     // find a file and store its cluster structure into the linked list
-    if(read_file_metadata(fileid) != 0) {
+    if(read_file_metadata(&__lastinput[type ? 3 : 4]) != 0) { // after LOAD / RUN
         return;
     }
 
-    if(memcmp(_ext, "CAS", 3) == 0) {
+    const uint8_t compressed = memcmp(_ext, "CAZ", 3) == 0 || memcmp(_ext, "PRZ", 3) == 0;
+    const uint8_t direct = memcmp(_ext, "CAD", 3) == 0;
+    LZHEADER header;
+
+    if(memcmp(_ext, "CAS", 3) == 0 || memcmp(_ext, "CAZ", 3) == 0 || direct) {
         sprintf(termbuffer, "Filename:%c%.22s", COL_CYAN, _filename);
         terminal_printtermbuffer();
         sprintf(termbuffer, "Filesize: %lu bytes", _filesize_current_file);
         terminal_printtermbuffer();
 
+        // the program preloaded at boot is still in the cassette bank
+        const uint8_t preloaded = _cluster_current_file == _preload_cluster;
+        _preload_cluster = 0;
+
         set_ram_bank(RAM_BANK_CASSETTE);
-        store_cas_ram(_linkedlist[0], 0x0000);
+        if(preloaded) {
+            print("Preloaded at boot");
+        } else if(compressed) {
+            progress_line("Decompressing ", (_filesize_current_file + 511) / 512);
+            const uint8_t corrupt = lz_load(_cluster_current_file, (_filesize_current_file + 511) / 512,
+                                            LZ_TYPE_CAS, &header);
+            progress_stop();
+            if(corrupt) {
+                set_ram_bank(0);
+                print_error("Corrupt compressed file");
+                return;
+            }
+            print("Decompressed");
+        } else if(direct) {
+            if(store_cad_ram(_cluster_current_file) != 0) {
+                set_ram_bank(0);
+                print_error("Invalid CAD file");
+                return;
+            }
+        } else if(store_cas_ram(_cluster_current_file, 0x0000) != 0) {
+            set_ram_bank(0);
+            print_error("Read error");
+            return;
+        }
 
         uint16_t deploy_addr = ram_read_uint16_t(0x8000);
         uint16_t file_length = ram_read_uint16_t(0x8002);
 
-        if(memory[0x605C] == 1 && _filesize_current_file > MAX_BYTES_16K) {
+        if(memory[0x605C] == 1 && (compressed || direct ? file_length : _filesize_current_file) > MAX_BYTES_16K) {
             print_error("File too large to load");
             return;
         }
@@ -160,7 +249,7 @@ void command_loadrun(unsigned type) {
         // and then start it by calling Run (0x28d4) or "warm" Reset (0x1FC6)
         // see "ROM routines BASIC.pdf" section 7.2
         launch_cas(type ? 0x28d4 : 0x1FC6);
-    } else if(memcmp(_ext, "PRG", 3) == 0) {
+    } else if(memcmp(_ext, "PRG", 3) == 0 || memcmp(_ext, "PRZ", 3) == 0) {
         if(memory[0x605C] < 2) {
             print_error("At least 32kb of memory required.");
             return;
@@ -175,7 +264,20 @@ void command_loadrun(unsigned type) {
         // copy program
         sprintf(termbuffer, "Deploying program at %c0xA000", COL_CYAN);
         terminal_printtermbuffer();
-        store_prg_intram(_linkedlist[0], PROGRAM_LOCATION);
+        if(compressed) {
+            progress_line("Decompressing ", (_filesize_current_file + 511) / 512);
+            const uint8_t corrupt = lz_load(_cluster_current_file, (_filesize_current_file + 511) / 512,
+                                            LZ_TYPE_PRG, &header);
+            progress_stop();
+            if(corrupt) {
+                print_error("Corrupt compressed file");
+                return;
+            }
+            print("Decompressed");
+        } else if(store_prg_intram(_cluster_current_file, PROGRAM_LOCATION) != 0) {
+            print_error("Read error");
+            return;
+        }
 
         // verify that the signature is correct
         if(memory[PROGRAM_LOCATION] != 0x50) {
@@ -183,8 +285,10 @@ void command_loadrun(unsigned type) {
             return;
         }
 
-        // verify that the CRC-16 checksum matches
-        if(crc16_intram(&memory[0xA010], read_uint16_t(&memory[0xA001])) != 
+        // verify that the CRC-16 checksum matches, which is superfluous when
+        // every sector has arrived and passed the checksum of its block
+        if((compressed || !sd_verify) &&
+           crc16_intram(&memory[0xA010], read_uint16_t(&memory[0xA001])) != 
                         read_uint16_t(&memory[0xA003])) {
             print_error("CRC16 checksum failed");
             return;
@@ -197,17 +301,26 @@ void command_loadrun(unsigned type) {
         // transfer copy of current screen to external RAM
         copy_to_ram(vidmem, VIDMEM_CACHE, 0x1000);
 
-        // launch the program
+        // expose the SD-card routines to the program and launch it
         //memset(&memory[0xA000], 0x00, 0x200);
+        sdapi_install();
         call_program(PROGRAM_LOCATION + 0x10);
 
         // retrieve copy of current screen
         copy_from_ram(VIDMEM_CACHE, vidmem, 0x1000);
 
+        // the program may have used the external RAM
+        sdapi_release();
+        _handle_table_cluster = 0;
+        dircache_reset();
+        freespace_mount(); // the program may have written to the card
+        _fat_cache_lba = FAT_CACHE_INVALID;
+        _preload_cluster = 0;
+
         // clean up memory including stack program stack
         memset(&memory[0xA000], 0x00, 0xDF00 - 0xA000);
     } else {
-        print_error("Can only run CAS or PRG files.");
+        print_error("Can only run CAS, CAZ, CAD, PRG or PRZ files.");
     }
 }
 
@@ -219,6 +332,102 @@ void command_run(void) {
     command_loadrun(1);
 }
 
+#ifdef FAT_WRITE
+/**
+ * @brief Check that a BASIC program lies between start and end, by following
+ *        the links of its lines up to the terminating null link
+ *
+ * @param start first byte of the program
+ * @param end   first byte after the program
+ * @return uint8_t 1 if a non-empty program is found
+ */
+static uint8_t basic_program_valid(uint16_t start, uint16_t end) {
+    uint16_t p = start;
+    uint16_t link;
+
+    // the launcher overwrites everything from BASIC_TOP onwards
+    if(start < LOWMEM || end > BASIC_TOP || start + 2 > end) {
+        return 0;
+    }
+
+    while((link = read_uint16_t(&memory[p])) != 0) {
+        if(link <= p || link + 2 > end) {
+            return 0;
+        }
+        p = link;
+    }
+    return p != start;
+}
+
+/**
+ * @brief Save the BASIC program in memory as a CAS file in the current folder
+ */
+void command_save(void) {
+    static char* const errors[] = {"File already exists", "Disk full", "Write error"};
+    char* name = &__lastinput[5];
+    char basename[8];
+    uint16_t addr = 0x0000;
+    uint8_t i;
+
+    if(!_flag_sdcard_mounted) {
+        print_error("No SD card mounted");
+        return;
+    }
+
+    // name of 1 to 8 letters, digits, '-' or '_'
+    memset(basename, ' ', 8);
+    for(i=0; name[i] != 0; i++) {
+        const char c = (name[i] >= 'a' && name[i] <= 'z') ? name[i] - 0x20 : name[i];
+        if(i == 8 || !((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            break;
+        }
+        basename[i] = name[i] = c;
+    }
+    if(i == 0 || name[i] != 0) {
+        print_error("Usage: save NAME");
+        return;
+    }
+
+    const uint16_t start = read_uint16_t(&memory[BASIC_TXTTAB]);
+    const uint16_t end = read_uint16_t(&memory[BASIC_VARTAB]);
+    if(!basic_program_valid(start, end)) {
+        print_error("No BASIC program in memory");
+        return;
+    }
+
+    // records of a preamble and 1024 bytes of data, as the cassette holds them
+    const uint16_t length = end - start;
+    const uint8_t nrblocks = (length + 1023) >> 10;
+    _preload_cluster = 0;
+    set_ram_bank(RAM_BANK_CASSETTE);
+    for(i=0; i<nrblocks; i++) {
+        const uint16_t offset = (uint16_t)i << 10;
+        ram_write_uint8_t(addr, 0x00);
+        ram_transfer(addr, addr + 1, 0x500 - 1);
+        ram_write_uint16_t(addr + 0x30, start);
+        ram_write_uint16_t(addr + 0x32, length);
+        ram_write_uint16_t(addr + 0x34, length);
+        copy_to_ram(basename, addr + 0x36, 8);
+        copy_to_ram("BASB", addr + 0x3E, 4);
+        copy_to_ram("        ", addr + 0x47, 8);
+        ram_write_uint8_t(addr + 0x4F, nrblocks - i);
+        copy_to_ram(&memory[start + offset], addr + 0x100,
+                    length - offset < 1024 ? length - offset : 1024);
+        addr += 0x500;
+    }
+    set_ram_bank(RAM_BANK_CACHE);
+
+    sprintf(termbuffer, "Saving %s.CAS, %u bytes", name, length);
+    terminal_printtermbuffer();
+    const uint8_t res = fat_write_file(basename, "CAS", RAM_BANK_CASSETTE, 0x0000, addr);
+    if(res != WRITE_OK) {
+        print_error(errors[res - 1]);
+        return;
+    }
+    print("Done");
+}
+#endif
+
 /**
  * @brief Test burning of read and write LEDs
  * 
@@ -233,6 +442,344 @@ void command_ledtest(void) {
     z80_outp(PORT_LED_IO, 0x00);
 }
 
+#ifdef BENCHMARK
+/**
+ * @brief Wait for the start of the next interrupt tick
+ *
+ * @return uint16_t tick counter
+ */
+static uint16_t bench_tick(void) {
+    const uint16_t start = read_uint16_t(&memory[0x6010]);
+    uint16_t now;
+    while((now = read_uint16_t(&memory[0x6010])) == start) {}
+    return now;
+}
+
+/**
+ * @brief Print the throughput of a path measured since tick start
+ *
+ * @param path    description of the path
+ * @param nrbytes number of bytes transferred
+ * @param start   tick counter at the start of the transfer
+ */
+static void bench_report(const char* path, uint32_t nrbytes, uint16_t start) {
+    uint16_t ticks = read_uint16_t(&memory[0x6010]) - start;
+    if(ticks == 0) {
+        ticks = 1;
+    }
+
+    // tenths of KiB/s
+    const uint32_t rate = nrbytes * (10000 / TIMER_INTERVAL) / 1024 / ticks;
+    sprintf(termbuffer, "%-20s%c%4lu.%lu KiB/s", path, COL_CYAN, rate / 10, rate % 10);
+    terminal_printtermbuffer();
+}
+
+/**
+ * @brief Measure the throughput of the I/O paths and the latency of single
+ *        sector reads, using the 20 ms interrupt tick
+ *
+ * The second RAM bank serves as scratch space and the sectors are read from
+ * the FAT, such that the contents of the card are not affected.
+ */
+void command_bench(void) {
+    uint8_t samples = atoi(&__lastinput[5]);
+    uint8_t latency[BENCH_MAX_SAMPLES];
+    const uint8_t intram = memory[0x605C] >= 2;
+    uint16_t start;
+    uint16_t i;
+
+    if(!_flag_sdcard_mounted) {
+        print_error("No SD card mounted");
+        return;
+    }
+    if(samples == 0 || samples > BENCH_MAX_SAMPLES) {
+        samples = 16;
+    }
+
+    _preload_cluster = 0;
+    set_ram_bank(RAM_BANK_CASSETTE);
+
+    // single block reads (CMD17)
+    start = bench_tick();
+    for(i=0; i<BENCH_SECTORS; i++) {
+        read_sector_to(_fat_begin_lba + i, i * 0x200);
+    }
+    bench_report("SD > ext RAM (17)", BENCH_SECTORS * 512UL, start);
+
+    // multiple block read (CMD18), as used by the loaders unless the card
+    // profile has turned it off
+    const char* label = intram ? "SD > int RAM (18)" : "SD > ext RAM (18)";
+    if(!sd_multiblock) {
+        sprintf(termbuffer, "%-20s%c     off", label, COL_CYAN);
+        terminal_printtermbuffer();
+    } else {
+        start = bench_tick();
+        i = 0;
+        open_command();
+        if(cmd18(_fat_begin_lba) == 0xFE) {
+            for(; i<BENCH_SECTORS; i++) {
+                if(i != 0 && wait_data_token() != 0xFE) {
+                    break;
+                }
+                if(intram) {
+                    fast_sd_to_intram_full(PROGRAM_LOCATION);
+                } else {
+                    fast_sd_to_ram_full(i * 0x200);
+                }
+            }
+            cmd12();
+        }
+        close_command();
+        if(i == 0) {
+            print_error("CMD18 read failed");
+        } else {
+            bench_report(label, i * 512UL, start);
+        }
+    }
+
+    // copies between internal and external RAM, 4 KiB at a time
+    start = bench_tick();
+    for(i=0; i<8; i++) {
+        copy_to_ram((uint8_t*)0x0000, i * 0x1000, 0x1000);
+    }
+    bench_report("int > ext RAM", 0x8000, start);
+
+    if(intram) {
+        start = bench_tick();
+        for(i=0; i<8; i++) {
+            copy_from_ram(i * 0x1000, (uint8_t*)PROGRAM_LOCATION, 0x1000);
+        }
+        bench_report("ext > int RAM", 0x8000, start);
+    }
+
+    start = bench_tick();
+    for(i=0; i<0x800; i++) {
+        rom_read_byte(i);
+    }
+    bench_report("ROM read", 0x800, start);
+
+    start = bench_tick();
+    crc16_intram((uint8_t*)0x0000, 0x1000);
+    bench_report("CRC-16", 0x1000, start);
+
+    // latency of single sector reads spread over the FAT, timed per group of
+    // reads to overcome the resolution of the tick
+    for(uint8_t s=0; s<samples; s++) {
+        start = bench_tick();
+        for(i=0; i<BENCH_LATENCY; i++) {
+            read_sector_to(_fat_begin_lba + ((uint32_t)(s * BENCH_LATENCY + i) * 37) % _sectors_per_fat, 0x0000);
+        }
+        const uint16_t ticks = read_uint16_t(&memory[0x6010]) - start;
+        latency[s] = ticks > 0xFF ? 0xFF : ticks;
+
+        // keep the samples sorted
+        for(uint8_t j=s; j>0 && latency[j-1] > latency[j]; j--) {
+            const uint8_t tmp = latency[j];
+            latency[j] = latency[j-1];
+            latency[j-1] = tmp;
+        }
+    }
+
+    set_ram_bank(RAM_BANK_CACHE);
+
+    // tenths of a millisecond per read
+    const uint8_t pct[3] = {latency[samples / 2], latency[samples * 9 / 10], latency[samples - 1]};
+    uint16_t ms[3];
+    for(i=0; i<3; i++) {
+        ms[i] = pct[i] * (TIMER_INTERVAL * 10 / BENCH_LATENCY);
+    }
+    sprintf(termbuffer, "Read latency (%u):%c%u.%u %u.%u %u.%u ms", samples, COL_CYAN,
+            ms[0] / 10, ms[0] % 10, ms[1] / 10, ms[1] % 10, ms[2] / 10, ms[2] % 10);
+    terminal_printtermbuffer();
+    print("(median, 90th percentile, maximum)");
+
+    sprintf(termbuffer, "Read retries/errors:%c%u / %u", COL_CYAN, sd_retries, sd_errors);
+    terminal_printtermbuffer();
+}
+
+#endif
+
+/**
+ * @brief Show the profile of the mounted card as established by sd_probe
+ */
+void command_cardinfo(void) {
+    // multipliers of the TAAC and TRAN_SPEED fields of the CSD, times ten
+    static const uint8_t mult[16] = {0, 10, 12, 13, 15, 20, 25, 30,
+                                     35, 40, 45, 50, 55, 60, 70, 80};
+    const uint8_t *csd = _sd_card.csd;
+    const uint8_t *cid = _sd_card.cid;
+    uint32_t val;
+    uint8_t i;
+
+    if(!_flag_sdcard_mounted) {
+        print_error("No SD card mounted");
+        return;
+    }
+
+    sprintf(termbuffer, "Type:%c%s v%c, %lu MiB", COL_CYAN,
+            _sd_card.flags & SD_CARD_SDHC ? "SDHC/SDXC" : "SDSC",
+            _sd_card.flags & SD_CARD_V2 ? '2' : '1', _sd_card.sectors >> 11);
+    terminal_printtermbuffer();
+
+    if(_sd_card.flags & SD_CARD_REGS) {
+        sprintf(termbuffer, "Product:%c%.5s rev %u.%u (%02X %.2s)", COL_CYAN, &cid[3],
+                cid[8] >> 4, cid[8] & 0x0F, cid[0], &cid[1]);
+        terminal_printtermbuffer();
+        sprintf(termbuffer, "Serial:%c%02X%02X%02X%02X, %u/%02u", COL_CYAN,
+                cid[9], cid[10], cid[11], cid[12],
+                2000 + ((cid[13] & 0x0F) << 4 | cid[14] >> 4), cid[14] & 0x0F);
+        terminal_printtermbuffer();
+
+        // access time in units of 0.1 ns, from units of 1 ns
+        val = mult[(csd[1] >> 3) & 0x0F];
+        for(i = csd[1] & 0x07; i > 0; i--) {
+            val *= 10;
+        }
+        sprintf(termbuffer, "Access:%c%lu.%lu us + %u clocks", COL_CYAN,
+                val / 10000, val / 1000 % 10, csd[2] * 100);
+        terminal_printtermbuffer();
+
+        // transfer rate in units of 10 kbit/s, from units of 100 kbit/s
+        val = mult[(csd[3] >> 3) & 0x0F];
+        for(i = csd[3] & 0x07; i > 0; i--) {
+            val *= 10;
+        }
+        sprintf(termbuffer, "Max clock:%c%lu.%lu MHz", COL_CYAN, val / 100, val / 10 % 10);
+        terminal_printtermbuffer();
+    }
+
+    sprintf(termbuffer, "Token wait:%c%u/%u/%u polls", COL_CYAN,
+            _sd_card.wait_min, _sd_card.wait_median, _sd_card.wait_max);
+    terminal_printtermbuffer();
+    print("(minimum, median, maximum)");
+    sprintf(termbuffer, "Timeout:%c%u polls, %s", COL_CYAN, sd_read_timeout,
+            sd_multiblock ? "CMD18" : "CMD17");
+    terminal_printtermbuffer();
+    sprintf(termbuffer, "Read retries/errors:%c%u / %u", COL_CYAN, sd_retries, sd_errors);
+    terminal_printtermbuffer();
+}
+
+/**
+ * @brief Print the free space of the partition, finishing the count of the
+ *        free clusters when the idle scan has not completed it
+ */
+static void print_free_space(void) {
+    if(_free_clusters == FREE_UNKNOWN) {
+        progress_line("Counting ", freespace_remaining());
+        while(_free_clusters == FREE_UNKNOWN && freespace_scan(1)) {
+            progress_update(freespace_remaining());
+        }
+        progress_stop();
+        if(_free_clusters == FREE_UNKNOWN) {
+            print_error("Cannot read the FAT");
+            return;
+        }
+    }
+
+    sprintf(termbuffer, "Free:%c%lu of %lu MiB", COL_CYAN,
+            (_free_clusters << _cluster_shift) >> 11, (_total_clusters << _cluster_shift) >> 11);
+    terminal_printtermbuffer();
+}
+
+/**
+ * @brief Show the free space of the partition
+ */
+void command_df(void) {
+    if(!_flag_sdcard_mounted) {
+        print_error("No SD card mounted");
+        return;
+    }
+    print_free_space();
+}
+
+/**
+ * @brief Show the label, the geometry and the free space of the partition
+ */
+void command_vol(void) {
+    if(!_flag_sdcard_mounted) {
+        print_error("No SD card mounted");
+        return;
+    }
+
+    // label and serial number of the volume ID (boot sector)
+    if(read_sector(_fat_begin_lba - _reserved_sectors) == 0xFE) {
+        char label[11];
+        copy_from_ram(SDCACHE0 + 0x47, label, 11);
+        sprintf(termbuffer, "Volume:%c%.11s", COL_CYAN, label);
+        terminal_printtermbuffer();
+        sprintf(termbuffer, "Serial:%c%04X-%04X", COL_CYAN,
+                ram_read_uint16_t(SDCACHE0 + 0x45), ram_read_uint16_t(SDCACHE0 + 0x43));
+        terminal_printtermbuffer();
+    }
+
+    sprintf(termbuffer, "Cluster size:%c%lu bytes", COL_CYAN, (uint32_t)_sectors_per_cluster << 9);
+    terminal_printtermbuffer();
+    sprintf(termbuffer, "Clusters:%c%lu", COL_CYAN, _total_clusters);
+    terminal_printtermbuffer();
+
+    print_free_space();
+    if(_free_clusters == FREE_UNKNOWN) {
+        return;
+    }
+    sprintf(termbuffer, "Free clusters:%c%lu (%s)", COL_CYAN, _free_clusters,
+            _free_source == FREE_FSINFO ? "FSInfo" : "FAT scan");
+    terminal_printtermbuffer();
+    if(_free_hint != FREE_UNKNOWN) {
+        sprintf(termbuffer, "Next free:%c%lu", COL_CYAN, _free_hint);
+        terminal_printtermbuffer();
+    }
+}
+
+#ifdef TRACING
+/**
+ * @brief Print an entry of the trace, with its start time relative to boot
+ *
+ * @param entry trace entry
+ * @param t0    ticks at the start of the boot timeline
+ */
+static void trace_print(const TRACEENTRY* entry, uint16_t t0) {
+    sprintf(termbuffer, "%-10s%c%6lu ms %5lu ms %c%04X", trace_name(entry->id), COL_CYAN,
+            (uint32_t)(uint16_t)(entry->start - t0) * TRACE_TICK_MS,
+            (uint32_t)(uint16_t)(entry->end - entry->start) * TRACE_TICK_MS,
+            COL_WHITE, entry->arg);
+    terminal_printtermbuffer();
+}
+
+/**
+ * @brief Print the boot timeline and the most recent operations of the trace
+ *
+ * Times are multiples of the 20 ms interrupt tick.
+ */
+void command_trace(void) {
+    uint8_t n = atoi(&__lastinput[5]);
+    TRACEENTRY entry;
+    uint16_t t0 = 0;
+    uint8_t i;
+
+    if(n == 0) {
+        n = 10;
+    }
+
+    print("Boot:");
+    for(i=0; trace_get(1, i, &entry) == 0; i++) {
+        if(i == 0) {
+            t0 = entry.start;
+        }
+        trace_print(&entry, t0);
+    }
+
+    // oldest first
+    print("Recent:");
+    while(n > 0 && trace_get(0, n-1, &entry) != 0) {
+        n--;
+    }
+    while(n > 0) {
+        trace_get(0, --n, &entry);
+        trace_print(&entry, t0);
+    }
+}
+#endif
+
 /**
  * @brief Dump system RAM to the screen
  * 
@@ -259,7 +806,7 @@ void command_help(void) {
  */
 void execute_command(void) {
     // create copy of the input and flush input buffer
-    memcpy(__lastinput, __input, INPUTLENGTH);
+    memcpy(__lastinput, __input, INPUTLENGTH+1);
     memset(__input, 0x00, INPUTLENGTH+1);
     __inputpos = 0;
     strrstrip(__lastinput);
@@ -298,14 +845,23 @@ void execute_command(void) {
 // *****************************************************************************
 
 /**
- * @brief Read the metadata of a file identified by id
+ * @brief Read the metadata of a file identified by id or by path
  * 
- * @param file_id iterator corresponding to ith file in folder
+ * @param arg id of the file in the current folder or its path
  * @return uint8_t whether file can be read, 0 true, 1 false
  */
-uint8_t read_file_metadata(int16_t file_id) {
+uint8_t read_file_metadata(const char* arg) {
+    arg = strstrip(arg);
 
-    uint32_t cluster = read_folder(file_id, 0);
+    uint32_t cluster;
+    if(*arg >= '0' && *arg <= '9') {
+        cluster = read_folder(atoi(arg), 0);
+    } else {
+        cluster = resolve_path(arg, 0);
+        if(cluster == 0) {
+            cluster = _root_dir_first_cluster;
+        }
+    }
     if(cluster == _root_dir_first_cluster) {
         print_error("Could not find file");
         return 1;
@@ -316,7 +872,5 @@ uint8_t read_file_metadata(int16_t file_id) {
         return 1;
     }
 
-    build_linked_list(cluster);
-
     return 0;
 }
\ No newline at end of file
@@ -38,9 +38,17 @@
 
 #define __clock_freq 2500000
 
-extern char __lastinput[INPUTLENGTH];
+#define BENCH_SECTORS       64  // sectors read per throughput measurement (BENCHMARK)
+#define BENCH_LATENCY       8   // single sector reads per latency sample
+#define BENCH_MAX_SAMPLES   64
 
-void commands_ls(void);
+extern char __lastinput[INPUTLENGTH+1];
+
+/**
+ * @brief List contents of a folder
+ * 
+ */
+void command_ls(void);
 
 /**
  * @brief List contents of a folder and parse CAS files
@@ -49,10 +57,15 @@ void commands_ls(void);
 void command_lscas(void);
 
 /**
- * @brief change directory to folder indicated by id
+ * @brief change directory to folder indicated by id or by path
  */
 void command_cd(void);
 
+/**
+ * @brief Toggle listing folders in sorted order
+ */
+void command_sort(void);
+
 /**
  * @brief Flash a file to the ROM chip
  * 
@@ -65,12 +78,60 @@ void command_flash(void);
  */
 void command_run(void);
 
+/**
+ * @brief Load a (CAS) file into memory and return to BASIC
+ * 
+ */
+void command_load(void);
+
+#ifdef FAT_WRITE
+/**
+ * @brief Save the BASIC program in memory as a CAS file in the current folder
+ *
+ */
+void command_save(void);
+#endif
+
 /**
  * @brief Test burning of read and write LEDs
  * 
  */
 void command_ledtest(void);
 
+#ifdef BENCHMARK
+/**
+ * @brief Measure the throughput of the I/O paths and the sector read latency
+ * 
+ */
+void command_bench(void);
+#endif
+
+/**
+ * @brief Show the capabilities and the read latency of the mounted card
+ * 
+ */
+void command_cardinfo(void);
+
+/**
+ * @brief Show the free space of the partition
+ * 
+ */
+void command_df(void);
+
+/**
+ * @brief Show the label, the geometry and the free space of the partition
+ * 
+ */
+void command_vol(void);
+
+#ifdef TRACING
+/**
+ * @brief Show the boot timeline and the most recent traced operations
+ * 
+ */
+void command_trace(void);
+#endif
+
 /**
  * @brief Show brief help message on screen
  * 
@@ -88,12 +149,12 @@ void execute_command(void);
 // *****************************************************************************
 
 /**
- * @brief Read the metadata of a file identified by id
+ * @brief Read the metadata of a file identified by id or by path
  * 
- * @param file_id iterator corresponding to ith file in folder
+ * @param arg id of the file in the current folder or its path
  * @return uint8_t whether file can be read, 0 true, 1 false
  */
-uint8_t read_file_metadata(int16_t file_id);
+uint8_t read_file_metadata(const char* arg);
 
 /**
  * @brief Convert hexcode to unsigned 16 bit integer
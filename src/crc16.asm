@@ -24,6 +24,7 @@ INCLUDE "ports.inc"
 
 PUBLIC _crc16_intram
 PUBLIC _crc16_romchip
+PUBLIC _crc16_extram
 
 ;-------------------------------------------------------------------------------
 ; Generate a 16 bit checksum of internal RAM
@@ -107,4 +108,34 @@ nextbyte_rom:
     ex de,hl                    ; swap de and hl such that hl contains crc
     ld a,0x00
     out (LED_IO),a              ; turn ROM led off
-    ret                         ; return value is stored in hl
\ No newline at end of file
+    ret                         ; return value is stored in hl
+
+;-------------------------------------------------------------------------------
+; Generate a 16 bit checksum of the active bank of the external RAM
+;
+; input:  bc - number of bytes
+;         hl - start of memory address
+; output: hl - crc16 checksum
+; uses: a, bc, de, hl
+;-------------------------------------------------------------------------------
+_crc16_extram:
+    pop de                      ; return address
+    pop hl                      ; ramptr
+    pop bc                      ; number of bytes
+    push de                     ; put return address back on stack
+    ld de,$0000                 ; set de to $0000
+nextbyte_extram:
+    push bc                     ; push counter onto stack
+    ld a,h                      ; set upper address memory
+    out (ADDR_HIGH),a
+    ld a,l                      ; set lower address memory
+    out (ADDR_LOW),a
+    in a, (RAM_IO)              ; read byte from ram chip
+    call calc_byte
+    pop bc                      ; get counter back from stack
+    dec bc                      ; decrement counter
+    ld a,b                      ; check if counter is zero
+    or c
+    jp nz,nextbyte_extram       ; if not zero, go to next byte
+    ex de,hl                    ; swap de and hl such that hl contains crc
+    ret                         ; return value is stored in hl
@@ -41,4 +41,13 @@ uint16_t crc16_intram(uint8_t *addr, uint16_t nrbytes) __z88dk_callee;
  */
 uint16_t crc16_romchip(uint16_t addr, uint16_t nrbytes) __z88dk_callee;
 
+/**
+ * @brief Calculate CRC16 checksum on the active bank of the external RAM
+ *
+ * @param addr start address
+ * @param nrbytes number of bytes to evaluate
+ * @return uint16_t CRC-16 checksum
+ */
+uint16_t crc16_extram(uint16_t addr, uint16_t nrbytes) __z88dk_callee;
+
 #endif // _CRC16_H
\ No newline at end of file
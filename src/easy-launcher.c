@@ -18,7 +18,6 @@
  *                                                                        *
  **************************************************************************/
 
-#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <z80.h>
@@ -29,24 +28,35 @@
 #include "memory.h"
 #include "ram.h"
 #include "rom.h"
-#include "fat32-easy.h"
+#include "fat32.h"
 #include "launch_cas.h"
+#include "lz.h"
 #include "sst39sf.h"
-
-// set printf io
-#pragma printf "%d %c %s %lu"
+#include "trace.h"
+#include "format.h"
+#include "progress.h"
+#include "bootcfg.h"
+#include "fatsort.h"
+#include "fatpath.h"
 
 // helper function prototypes
 void show_status(const char* str);
+void show_progress(const char* str);
+void show_footer(void);
 void highlight_refresh(void);
 void update_screen(uint8_t count_pages);
 void clearscreen(void);
 void update_pagination(void);
-void store_file_rom(uint16_t rom_addr);
-uint8_t flash_rom(uint16_t cluster);
-void start_selected_cas(uint8_t only_load);
+void store_file_rom(uint32_t cluster, uint16_t rom_addr);
+uint8_t flash_rom(uint32_t cluster);
+uint8_t load_cassette(uint32_t cluster);
+void start_selected_cas(uint32_t cluster, uint8_t only_load);
+uint8_t boot(void);
 // key handling functions
 void handle_key_H(void);
+#ifdef TRACING
+void handle_key_T(void);
+#endif
 void handle_key_down(void);
 void handle_key_up(void);
 void handle_key_right(void);
@@ -79,31 +89,96 @@ void init(void) {
     z80_outp(PORT_LED_IO, 0x00);
 
     // activate and mount sd card
-    uint32_t lba0;
-    if(init_sdcard() != 0 || (lba0 = read_mbr()) == 0) {
+    uint32_t lba0 = 0;
+    TRACE_BEGIN();
+    const uint8_t status = init_sdcard();
+    TRACE_STEP(TRACE_SDCARD, status);
+    if(status == 0) {
+        lba0 = read_mbr();
+        TRACE_STEP(TRACE_MBR, lba0);
+    }
+    if(lba0 == 0) {
         show_status("\001Geen FAT32 SD-card gevonden.");
         for(;;){}
     }
     read_partition(lba0);
+    TRACE_END(TRACE_PARTITION, _sectors_per_cluster);
+}
+
+/**
+ * @brief Apply the boot configuration P2000T.CFG of the root folder (see
+ *        bootcfg.h) and boot a program when requested
+ *
+ * FOLDER, AUTOBOOT, PRELOAD and SORT are applied; the start folder is always
+ * warmed by displaying it and VERBOSE and RUN concern the LAUNCHER only.
+ * Without a configuration file, or when it does not mention AUTOBOOT, the
+ * root folder is searched for AUTOBOOT.CAS. Returns when no program has
+ * been booted.
+ *
+ * @return uint8_t whether the pages of the current folder have been counted
+ */
+uint8_t boot(void) {
+    char value[BOOTCFG_VALUE];
+    uint8_t settings = 0;
+    uint8_t autoboot_set = 0;
+    uint32_t autoboot = 0;
+
+    TRACE_BEGIN();
+    uint32_t fcl = find_file(_root_dir_first_cluster, BOOTCFG_BASENAME, BOOTCFG_EXT);
+    if(fcl != 0 && bootcfg_open(calculate_sector_address(fcl, 0), _filesize_current_file) == 0) {
+        uint8_t key;
+        while((key = bootcfg_next(value)) != BOOTCFG_END) {
+            settings++;
+            if(key == BOOTCFG_FOLDER) {
+                fcl = find_path(value);
+                if(fcl != 0 && (_current_attrib & 0x10)) {
+                    _current_folder_cluster = fcl;
+                }
+            } else if(key == BOOTCFG_AUTOBOOT) {
+                autoboot_set = 1;
+                autoboot = value[0] != 0x00 ? find_path(value) : 0;
+            } else if(key == BOOTCFG_SORT) {
+                _sort_enabled = value[0] == '1';
+            } else if(key == BOOTCFG_PRELOAD) {
+                fcl = find_path(value);
+                if(fcl != 0 && !(_current_attrib & 0x10)) {
+                    show_progress("\003Programma laden ");
+                    if(load_cassette(fcl) == 0) {
+                        _preload_cluster = fcl;
+                    }
+                    progress_stop();
+                }
+            }
+        }
+    }
+    TRACE_STEP(TRACE_CONFIG, settings);
+
+    // check if there is a file called "AUTOBOOT.CAS" in the root folder; an
+    // unsuccessful lookup has counted the pages of the root folder
+    uint8_t counted = 0;
+    if(!autoboot_set) {
+        autoboot = find_file(_root_dir_first_cluster, "AUTOBOOT", "CAS");
+        counted = autoboot == 0 && _current_folder_cluster == _root_dir_first_cluster;
+    }
+    TRACE_END(TRACE_AUTOBOOT, autoboot != 0);
+
+    build_linked_list(_current_folder_cluster);
+    if(autoboot != 0 && !(_current_attrib & 0x10)) {
+        start_selected_cas(autoboot, 0);
+    }
+
+    return counted;
 }
 
 void main(void) {
     // initialize SD card
     init();
     keymem[0x0C] = 0; //clear key buffer
-    build_linked_list(_current_folder_cluster);
-
-    // check if there is a file called "AUTOBOOT.CAS".
-    // if so, immediately launch this CAS file
-    uint32_t fcl = find_file_by_name(1, "AUTOBOOT", "CAS");
-    if(fcl != _root_dir_first_cluster) {
-        build_linked_list(fcl);
-        start_selected_cas(0);
-    }
 
-    // display the first page of the root directory
-    // note: counting pages was already done in find_file_by_name, so no need to do it again
-    update_screen(0); 
+    // apply P2000T.CFG and boot straight into a program when requested,
+    // then display the first page of the start folder; its pages only need
+    // to be counted when the lookups of boot did not already do so
+    update_screen(!boot());
     
     // put in infinite loop and wait for program selection
     for(;;) {
@@ -114,6 +189,11 @@ void main(void) {
             if (key0 == 9) { // H key
                 handle_key_H();
             }
+#ifdef TRACING
+            if (key0 == 37) { // T key
+                handle_key_T();
+            }
+#endif
             // key down
             if(key0 == 21)  {
                 handle_key_down();
@@ -179,6 +259,14 @@ void clearscreen(void) {
     for (uint8_t i = 2; i < 22; i++) {
         strcpy(vidmem + 0x50*i, "\004\x1D");
     }
+    show_footer();
+}
+
+/**
+ * @brief Write the footer, replacing any status message
+ */
+void show_footer(void) {
+    memset(vidmem + 0x50 * 23, 0x00, 0x50);
     strcpy(vidmem + 0x50*23 + 20, "\002 Toets H voor Hulp");
 }
 
@@ -188,8 +276,12 @@ void clearscreen(void) {
  * This function updates the pagination text at the top-left of the screen
  */
 void update_pagination(void) {
-    char pagina_str[32];
-    sprintf(pagina_str, "\003Pagina %d/%d", page_num, _num_of_pages);
+    char pagina_str[16];
+    char* p = fmt_str(pagina_str, "\003Pagina ", 8);
+    p = fmt_u16(p, page_num, 0);
+    *p++ = '/';
+    p = fmt_u16(p, _num_of_pages, 0);
+    *p = 0;
     strcpy(vidmem + 39 - strlen(pagina_str), pagina_str);
 }
 
@@ -205,6 +297,17 @@ void show_status(const char* str) {
     strcpy(vidmem + 0x50 * 23, str);
 }
 
+/**
+ * @brief Show a status message followed by a progress indicator for the
+ *        sectors of the selected file; str and the indicator share the line
+ *
+ * @param str status message of at most 40 - PROGRESS_WIDTH characters
+ */
+void show_progress(const char* str) {
+    show_status(str);
+    progress_start(vidmem + 0x50 * 23 + strlen(str), (_filesize_current_file + 511) / 512);
+}
+
 /**
  * @brief Flash the external ROM with a new firmware
  * 
@@ -213,8 +316,7 @@ void show_status(const char* str) {
  * 
  * @return 1 on success, 0 on failure
  */
-uint8_t flash_rom(uint16_t cluster) {
-    build_linked_list(cluster);
+uint8_t flash_rom(uint32_t cluster) {
     set_rom_bank(ROM_BANK_DEFAULT);
     set_ram_bank(RAM_BANK_CACHE);
     uint16_t rom_id = sst39sf_get_device_id();
@@ -225,7 +327,7 @@ uint8_t flash_rom(uint16_t cluster) {
             sst39sf_wipe_sector(0x1000 * i);
         }
         // copying from SD-CARD to ROM
-        store_file_rom(0x0000);
+        store_file_rom(cluster, 0x0000);
         return 1;
     } else {
         show_status("\001Onbekend SST39SF apparaatnummer.");
@@ -236,30 +338,19 @@ uint8_t flash_rom(uint16_t cluster) {
 /**
  * @brief Store a file in the external ROM
  * 
+ * @param cluster  first cluster of the file
  * @param rom_addr first position in ROM to store the file
- * 
- * @return number of sectors stored
  */
-void store_file_rom(uint16_t rom_addr) {
-    // count number of sectors
-    uint8_t total_sectors = (_filesize_current_file + 511) / 512;
-
-    uint8_t ctr = 0;    // counter for clusters
-    uint8_t scctr = 0;  // counter for sectors
-    while(_linkedlist[ctr] != 0xFFFFFFFF && ctr < 16) {
-        const uint32_t caddr = calculate_sector_address(_linkedlist[ctr], 0);
-        for(uint8_t i=0; i<_sectors_per_cluster; i++) {
-            // directly transfer data to ROM chip
-            open_command();
-            cmd17(caddr + i);
-            fast_sd_to_rom_full(rom_addr);
-            close_command();
-            // increment memory pointer
-            rom_addr += 0x200;
-            if(++scctr == total_sectors) return;
-        }
-        ctr++;
+void store_file_rom(uint32_t cluster, uint16_t rom_addr) {
+    show_progress("\003ROM flashen ");
+    stream_open(cluster, (_filesize_current_file + 511) / 512);
+    while(stream_next_sector()) {
+        // directly transfer data to ROM chip
+        fast_sd_to_rom_full(rom_addr);
+        rom_addr += 0x200;
     }
+    stream_close();
+    progress_stop();
 }
 
 /**
@@ -283,6 +374,66 @@ void handle_key_H(void) {
     update_screen(0);
 }
 
+#ifdef TRACING
+/**
+ * @brief Print an entry of the trace on a row of the screen
+ *
+ * @param row   row on the screen
+ * @param entry trace entry
+ * @param t0    ticks at the start of the boot timeline
+ */
+static void trace_row(uint8_t row, const TRACEENTRY* entry, uint16_t t0) {
+    char* p = vidmem + 0x50*row;
+    *p++ = COL_YELLOW;
+    p = fmt_pad(p, trace_name(entry->id), 10);
+    *p++ = COL_CYAN;
+    p = fmt_u32(p, (uint32_t)(uint16_t)(entry->start - t0) * TRACE_TICK_MS, 6);
+    p = fmt_str(p, " ms ", 4);
+    p = fmt_u32(p, (uint32_t)(uint16_t)(entry->end - entry->start) * TRACE_TICK_MS, 5);
+    p = fmt_str(p, " ms ", 4);
+    *p++ = COL_WHITE;
+    p = fmt_u16(p, entry->arg, 0);
+    *p = 0;
+}
+
+/**
+ * @brief Handle the T key press
+ *
+ * Shows the boot timeline followed by the most recent traced operations,
+ * oldest first, until the screen is full.
+ */
+void handle_key_T(void) {
+    TRACEENTRY entry;
+    uint16_t t0 = 0;
+    uint8_t row = 2;
+    uint8_t i;
+
+    clearscreen();
+    strcpy(vidmem, "\003Trace (ms)");
+    for(i=0; trace_get(1, i, &entry) == 0; i++) {
+        if(i == 0) {
+            t0 = entry.start;
+        }
+        trace_row(row++, &entry, t0);
+    }
+
+    row++;
+    i = 23 - row;
+    while(i > 0 && trace_get(0, i-1, &entry) != 0) {
+        i--;
+    }
+    while(i > 0) {
+        trace_get(0, --i, &entry);
+        trace_row(row++, &entry, t0);
+    }
+
+    while(keymem[0x0C] == 0) {} // wait until a key is pressed
+    keymem[0x0C] = 0;
+
+    update_screen(0);
+}
+#endif
+
 /**
  * @brief Handle the key down press
  * 
@@ -369,12 +520,44 @@ void color_selected_file_red(void) {
     vidmem[0x50*(highlight_id + DISPLAY_OFFSET) + 2] = 0x01; // color file red
 }
 
-void start_selected_cas(uint8_t only_load) {
+/**
+ * @brief Load the active CAS, CAZ or CAD file into the cassette RAM bank,
+ *        unless it is the program that was preloaded at boot
+ *
+ * @param cluster first cluster of the file
+ * @return uint8_t 0 on success, 1 for a corrupt compressed file or an
+ *         invalid direct-load file
+ */
+uint8_t load_cassette(uint32_t cluster) {
+    LZHEADER header;
+    uint8_t result = 0;
+
+    if (cluster == _preload_cluster) {
+        return 0;
+    }
+    _preload_cluster = 0;
+
     // set RAM bank to CASSETTE
     set_ram_bank(RAM_BANK_CASSETTE);
-    show_status("\003Programma laden...");
-    store_cas_ram(_linkedlist[0], 0x0000);
+    if (memcmp(_ext, "CAZ", 3) == 0) {
+        result = lz_load(cluster, (_filesize_current_file + 511) / 512, LZ_TYPE_CAS, &header);
+    } else if (memcmp(_ext, "CAD", 3) == 0) {
+        result = store_cad_ram(cluster);
+    } else {
+        result = store_cas_ram(cluster, 0x0000);
+    }
     set_ram_bank(RAM_BANK_CACHE);
+    return result;
+}
+
+void start_selected_cas(uint32_t cluster, uint8_t only_load) {
+    show_progress("\003Programma laden ");
+    const uint8_t result = load_cassette(cluster);
+    progress_stop();
+    if (result != 0) {
+        color_selected_file_red();
+        return;
+    }
     // either return to Basic or RUN
     launch_cas(only_load ? 0x1FC6 : 0x28d4);
 }
@@ -389,16 +572,29 @@ void start_selected_cas(uint8_t only_load) {
  * @param key0 The key pressed (space or enter)
  */
 void handle_key_select(uint8_t key0) {
-    uint32_t cluster = find_file(page_num, highlight_id + PAGE_SIZE * (page_num-1));
+    uint32_t cluster = read_folder(highlight_id + PAGE_SIZE * (page_num-1), 0);
     if(cluster != _root_dir_first_cluster) {
         if(_current_attrib & 0x10) {
             if(cluster == 0) { // if zero, this is the root directory
-                _current_folder_cluster = _root_dir_first_cluster;
+                cluster = _root_dir_first_cluster;
+            }
+
+            // return to the position of a folder that is left upwards, start
+            // at the first item of any other folder
+            const RecentFolder* r = NULL;
+            if(_base_name[0] == '.') {
+                r = recent_pop();
+                if(r != NULL && r->folder != cluster) {
+                    recent_reset();
+                    r = NULL;
+                }
             } else {
-                _current_folder_cluster = cluster;
+                recent_push(_current_folder_cluster, page_num, highlight_id);
             }
-            page_num = 1;
-            highlight_id = 1; // highlight first item in newly loaded folder
+            page_num = r != NULL ? r->page : 1;
+            highlight_id = r != NULL ? r->row : 1;
+
+            _current_folder_cluster = cluster;
             build_linked_list(_current_folder_cluster);
             update_screen(1);
         }
@@ -407,43 +603,64 @@ void handle_key_select(uint8_t key0) {
                 show_status("\003Firmware vernieuwen...");
                 if (flash_rom(cluster))
                     call_addr(0x1010); //cold reset after firmware flashing
-                goto restore_state;
+                return;
             }
 
-            if (memcmp(_ext, "CAS", 3) != 0 && memcmp(_ext, "PRG", 3) != 0) {
+            const uint8_t cas = memcmp(_ext, "CAS", 3) == 0 || memcmp(_ext, "CAZ", 3) == 0 ||
+                                memcmp(_ext, "CAD", 3) == 0;
+            const uint8_t prz = memcmp(_ext, "PRZ", 3) == 0;
+            if (!cas && !prz && memcmp(_ext, "PRG", 3) != 0) {
                 // unsupported file type
                 color_selected_file_red();
                 return;
             }
 
-            if (memcmp(_ext, "PRG", 3) == 0 && memory[0x605C] < 2) {
+            if (!cas && memory[0x605C] < 2) {
                 // no extension RAM found to load PRG into
                 color_selected_file_red();
                 return;
             }
 
-            build_linked_list(cluster); // update _linkedlist for store_cas_ram, store_prg_intram or flash_rom
-
-            if (memcmp(_ext, "CAS", 3) == 0) {
-                start_selected_cas(key0 == 32);  // if CODE was pressed, load and return to Basic, otherwise load and run
+            if (cas) {
+                start_selected_cas(cluster, key0 == 32);  // if CODE was pressed, load and return to Basic, otherwise load and run
+                return; // only returns when loading failed
             }
 
             // load PRG file into internal RAM
-            store_prg_intram(_linkedlist[0], PROGRAM_LOCATION);
+            show_progress("\003Programma laden ");
+            if (prz) {
+                LZHEADER header;
+                if (lz_load(cluster, (_filesize_current_file + 511) / 512, LZ_TYPE_PRG, &header) != 0) {
+                    progress_stop();
+                    color_selected_file_red();
+                    return;
+                }
+            } else if (store_prg_intram(cluster, PROGRAM_LOCATION) != 0) {
+                progress_stop();
+                color_selected_file_red();
+                return;
+            }
+            progress_stop();
 
             // verify that the signature is correct
             if(memory[PROGRAM_LOCATION] != 0x50) {
                 color_selected_file_red();
-                goto restore_state;
+                return;
             }
 
+            show_footer();
             copy_to_ram(vidmem, VIDMEM_CACHE, 0x1000); // save the current video memory state
             call_addr(PROGRAM_LOCATION + 0x10); // launch the PRG program
             copy_from_ram(VIDMEM_CACHE, vidmem, 0x1000); //r estore the video memory state
             keymem[0x0C] = 0; // clear the key buffer
-            
-restore_state:
-            build_linked_list(_current_folder_cluster); // rebuild the linked list for the current folder
+
+            // the program may have used the memory holding the FAT cache, the
+            // preloaded program, the sorted view and the linked list of the
+            // current folder
+            _fat_cache_lba = FAT_CACHE_INVALID;
+            _preload_cluster = 0;
+            _handle_table_cluster = 0;
+            build_linked_list(_current_folder_cluster);
         }
     }
 }
\ No newline at end of file
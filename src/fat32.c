@@ -1,6 +1,7 @@
 /**************************************************************************
  *                                                                        *
- *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *   Author(s): Ivo Filot <ivo@ivofilot.nl>                               *
+ *              Dion Olsthoorn <@dionoid>                                 *
  *                                                                        *
  *   P2000T-SDCARD is free software:                                      *
  *   you can redistribute it and/or modify it under the terms of the      *
@@ -19,9 +20,22 @@
  **************************************************************************/
 
 #include "fat32.h"
+#include "fatview.h"
+#include "cad.h"
+#include "trace.h"
+#include "prof.h"
+#include "format.h"
+#include "progress.h"
+#ifdef FAT_SORT
+#include "fatsort.h"
+#endif
+#ifdef FAT_PATHS
+#include "fatpath.h"
+#endif
 
 uint16_t _bytes_per_sector = 0;
 uint8_t _sectors_per_cluster = 0;
+uint8_t _cluster_shift = 0;
 uint16_t _reserved_sectors = 0;
 uint8_t _number_of_fats = 0;
 uint32_t _sectors_per_fat = 0;
@@ -36,6 +50,64 @@ uint8_t _filename[MAX_LFN_LENGTH+1];
 char _ext[4] = {0};
 char _base_name[9] = {0};
 uint8_t _current_attrib = 0;
+uint32_t _cluster_current_file = 0;
+#if defined(FAT_LIST) || defined(FAT_SORT)
+uint32_t _handle_table_cluster = 0;
+uint16_t _handle_table_count = 0;
+#endif
+#ifdef FAT_SORT
+static uint8_t _handle_table_sorted = 0; // whether the table holds a sorted view
+#endif
+#ifdef FAT_PAGES
+uint8_t _num_of_pages = 1;
+#endif
+uint32_t _fat_cache_lba = FAT_CACHE_INVALID;
+uint32_t _fsinfo_lba = 0;
+uint32_t _total_clusters = 0;
+static uint8_t _fat_cache_bank = 0;
+
+// state of the sector stream, see stream_open
+static uint32_t _stream_cluster = 0;    // first cluster of the next run
+static uint16_t _stream_remaining = 0;  // sectors left in the stream
+static uint16_t _stream_run = 0;        // sectors left in the active run
+static uint8_t _stream_active = 0;      // whether a multiple block read is open
+static uint32_t _stream_lba = 0;        // sector address of the next sector
+static uint32_t _stream_retry_lba = 0;  // sector address of the last retry
+static uint8_t _stream_attempts = 0;    // retries of that sector
+
+#define SCAN_COUNT 0x80 // scan_folder: count the pages of the folder (FAT_PAGES)
+#define SCAN_SORT  0x40 // scan_folder: add the entries to the sorted view (FAT_SORT)
+
+/**
+ * @brief Build the display name of the active entry from its DOS 8.3 name
+ */
+void format_sfn_filename(void) {
+    memcpy(_filename, _base_name, 8); // copy base name
+    memcpy(&_filename[9], _ext, 4); // copy extension (incl terminator)
+    // if file, inject dot before extension
+    _filename[8] = (_current_attrib & 0x10) ? '\0' : '.';
+    // remove superfluous spaces before extension
+    uint8_t k = 0;
+    for (k = 7; k >= 1 && _filename[k] == ' '; k--);
+    if (k < 7) memcpy(&_filename[k+1], &_filename[8], 5);
+}
+
+/**
+ * @brief Make the directory entry at loc the active file; its DOS 8.3 name
+ *        has already been copied to _base_name and _ext
+ *
+ * @param loc       external memory address of the directory entry
+ * @param lfn_found whether _filename holds the long file name of the entry
+ * @return uint32_t first cluster of the entry
+ */
+static uint32_t take_entry(uint16_t loc, uint8_t lfn_found) {
+    _filesize_current_file = ram_read_uint32_t(loc + 0x1C);
+    if(!lfn_found) {
+        format_sfn_filename();
+    }
+    _cluster_current_file = grab_cluster_address_from_fileblock(loc);
+    return _cluster_current_file;
+}
 
 /**
  * @brief Read the Master Boot Record
@@ -59,8 +131,10 @@ uint32_t read_mbr(void) {
  * @param lba0 address of the partition
  */
 void read_partition(uint32_t lba0) {
+#ifdef FAT_VERBOSE
     // inform the reader that we are about to read partition 1
     print("Reading partition 1");
+#endif
 
     // read the volume ID (first sector of the partition)
     read_sector(lba0);
@@ -68,102 +142,132 @@ void read_partition(uint32_t lba0) {
     // collect data
     _bytes_per_sector = ram_read_uint16_t(SDCACHE0 + 0x0B);
     _sectors_per_cluster = ram_read_uint8_t(SDCACHE0 + 0x0D);
+    _cluster_shift = 0;
+    while((1 << _cluster_shift) < _sectors_per_cluster) {
+        _cluster_shift++;
+    }
     _reserved_sectors = ram_read_uint16_t(SDCACHE0 + 0x0E);
     _number_of_fats = ram_read_uint8_t(SDCACHE0 + 0x10);
     _sectors_per_fat = ram_read_uint32_t(SDCACHE0 + 0x24);
     _root_dir_first_cluster = ram_read_uint32_t(SDCACHE0 + 0x2C);
     _current_folder_cluster = _root_dir_first_cluster;
-    uint16_t signature = ram_read_uint16_t(SDCACHE0 + 0x1FE);
-
-    // print data
-    // sprintf(termbuffer, "LBA partition 1:%c%08lX", COL_GREEN, lba0);
-    // terminal_printtermbuffer();
-
-    // sprintf(termbuffer, "Bytes per sector:%c%i", COL_GREEN, _bytes_per_sector);
-    // terminal_printtermbuffer();
-
-    // sprintf(termbuffer, "Sectors per cluster:%c%i", COL_GREEN, _sectors_per_cluster);
-    // terminal_printtermbuffer();
-
-    // sprintf(termbuffer, "Reserved sectors:%c%i", COL_GREEN, _reserved_sectors);
-    // terminal_printtermbuffer();
+#if defined(FAT_LIST) || defined(FAT_SORT)
+    _handle_table_cluster = 0; // invalidate handle table upon (re)mount
+#endif
+#ifdef FAT_PATHS
+    dircache_reset();
+    recent_reset();
+#endif
+    _fat_cache_lba = FAT_CACHE_INVALID;
+    _fsinfo_lba = lba0 + ram_read_uint16_t(SDCACHE0 + 0x30);
+    const uint32_t total_sectors = ram_read_uint32_t(SDCACHE0 + 0x20);
 
-    // sprintf(termbuffer, "Number of FATS:%c%i", COL_GREEN, _number_of_fats);
-    // terminal_printtermbuffer();
-
-    // sprintf(termbuffer, "Sectors per FAT:%c%lu", COL_GREEN, _sectors_per_fat);
-    // terminal_printtermbuffer();
+    // consolidate variables
+    _fat_begin_lba = lba0 + _reserved_sectors;
+    _SECTOR_begin_lba = lba0 + _reserved_sectors + (_number_of_fats * _sectors_per_fat);
+    _lba_addr_root_dir = calculate_sector_address(_root_dir_first_cluster, 0);
+    _total_clusters = (total_sectors - (_SECTOR_begin_lba - lba0)) >> _cluster_shift;
+    _flag_sdcard_mounted = 1;
 
+#ifdef FAT_VERBOSE
     // calculate the total capacity on the partition; this corresponds to the
     // each FAT holds a number of sectors
     // each sector can refer to 128 clusters (128 x 32 = 512 bytes)
     // each cluster hosts a number of sectors
     // each sector has a specific sectors size (512 bytes for FAT32)
-    sprintf(termbuffer, "Partition size:%c%lu MiB", COL_GREEN, (_sectors_per_fat * _sectors_per_cluster * _bytes_per_sector) >> 13 );
+    char* p = fmt_str(termbuffer, "Partition size:", 15);
+    *p++ = COL_GREEN;
+    p = fmt_u32(p, (_sectors_per_fat * _sectors_per_cluster * _bytes_per_sector) >> 13, 0);
+    p = fmt_str(p, " MiB", 4);
+    *p = 0;
     terminal_printtermbuffer();
 
-    // sprintf(termbuffer, "Root first cluster:%c%08lX", COL_GREEN, _root_dir_first_cluster);
-    // terminal_printtermbuffer();
-
-    // sprintf(termbuffer, "Signature:%c%04X", COL_GREEN, signature);
-    // terminal_printtermbuffer();
-
-    // consolidate variables
-    _fat_begin_lba = lba0 + _reserved_sectors;
-    _SECTOR_begin_lba = lba0 + _reserved_sectors + (_number_of_fats * _sectors_per_fat);
-    _lba_addr_root_dir = calculate_sector_address(_root_dir_first_cluster, 0);
-
     // read first sector of first partition to establish volume name
     read_sector(_lba_addr_root_dir);
 
     // volume name is written as the first 11 bytes
     char volume_name[11];
-    copy_from_ram(SDCACHE0, volume_name, 11);
-    sprintf(termbuffer, "Volume name:%c%.11s", COL_GREEN, volume_name);
+    copy_from_ram(SDCACHE0, (uint8_t*)volume_name, 11);
+    p = fmt_str(termbuffer, "Volume name:", 12);
+    *p++ = COL_GREEN;
+    p = fmt_str(p, volume_name, 11);
+    *p = 0;
     terminal_printtermbuffer();
     memcpy(&vidmem[0x50+39-11], volume_name, 11);
-
-    _flag_sdcard_mounted = 1;
+#endif
 }
 
 /**
- * @brief Read the contents of the folder starting at address cluster and:
- *        - when file_id < 0, scan the directory and output the list of files
- *        - when file_id == 0, search for a file identified by basename_find and ext_find
- *        - when file_id > 0, search for a file identified by file id
-
- * @brief Find a file identified by BASENAME and EXT in the folder correspond
- *        to the cluster address
- * 
- * @param cluster        folder's first cluster address
+ * @brief Scan the folder held in the linked list and:
+ *        - when file_id > 0, return the cluster address of the file id
+ *        - when basename_find is set, return the cluster address of the file
+ *          identified by basename_find and ext_find
+ *        - with SCAN_SORT in mode, add all entries to the sorted view
+ *        - otherwise list the folder using list_entry: all entries with
+ *          FAT_LIST, the entries of page page_number with FAT_PAGES
+ *
+ * With FAT_PAGES and SCAN_COUNT in mode, the pages of the folder are counted
+ * and the cluster and file count at which each page starts are cached in
+ * SDCACHE2 and SDCACHE3; without it, the scan of a page starts there.
+ *
+ * @param page_number    page to list or to start at (FAT_PAGES), 0 for the
+ *                       start of the folder
  * @param file_id        ith file in the folder
- * @param casrun         whether we are performing a run with CAS file metadata scan
  * @param basename_find  first 8 bytes of the file to find
  * @param ext_find       3 byte extension of the file to find
- * @return uint32_t      cluster address of the file
+ * @param mode           casrun of read_folder (FAT_LIST), SCAN_COUNT or
+ *                       SCAN_SORT
+ * @return uint32_t      first cluster of the entry or _root_dir_first_cluster
+ *                       if not found
  */
-uint32_t read_folder_int(uint32_t cluster, int16_t file_id, uint8_t casrun, const char* basename_find, const char* ext_find) {
-
-    // build linked list for the cluster addr
-    build_linked_list(cluster);
+static uint32_t scan_folder(uint8_t page_number, uint16_t file_id, const char* basename_find,
+                            const char* ext_find, uint8_t mode) {
+    PROF_ENTER(PROF_SCAN_FOLDER);
 
     // loop over the clusters and read directory contents
+#ifdef FAT_SORT
+    const uint8_t collect = mode & SCAN_SORT; // whether the sorted view is built
+#else
+    const uint8_t collect = 0;
+#endif
+#if defined(FAT_LIST) || defined(FAT_PAGES)
+    const uint8_t listing = file_id == 0 && basename_find == NULL && !collect;
+#endif
     uint8_t ctr = 0;                // counter over clusters
     uint16_t fctr = 0;              // counter over directory entries (files and folders)
-    uint32_t totalfilesize = 0;     // collect size of files in folder
     uint8_t stopreading = 0;        // whether to break of reading procedure
     uint8_t firstPos = 0;
-    uint8_t lfn_found = 0; 
+    uint8_t lfn_found = 0;
+    uint8_t show = 0;               // whether the entry is listed
+#ifdef FAT_PAGES
+    const uint16_t page_first = (uint16_t)(page_number - 1) * PAGE_SIZE; // entries before the page
+    uint16_t shown = 0;             // entries listed on the page
+    uint8_t pages = 1;              // pages counted
+    uint16_t ctr_fctr = 0;          // entries before the current cluster
+    uint8_t entry_ctr = 0xFF;       // cluster holding the first LFN entry of the pending entry
+    uint16_t entry_fctr = 0;        // entries before that cluster
+
+    if(!(mode & SCAN_COUNT) && page_number > 1) {
+        // look up cached jump table for fast page access
+        ctr = ram_read_uint8_t(SDCACHE2 + page_number - 1);
+        fctr = ram_read_uint16_t(SDCACHE3 + 2 * (page_number - 1));
+    }
+#else
+    (void)page_number;
+#endif
+
+    while(ctr < F_LL_SIZE && _linkedlist[ctr] != 0xFFFFFFFF && stopreading == 0) {
+#ifdef FAT_PAGES
+        ctr_fctr = fctr;
+#endif
 
-    while(_linkedlist[ctr] != 0xFFFFFFFF && ctr < F_LL_SIZE && stopreading == 0) {
-        
-        // print cluster number and address
         uint32_t caddr = calculate_sector_address(_linkedlist[ctr], 0);
 
         // loop over all sectors per cluster
         for(uint8_t i=0; i<_sectors_per_cluster && stopreading == 0; i++) {
             read_sector(caddr++);            // read next sector data
             for(uint16_t loc=SDCACHE0; loc<SDCACHE0+16*32; loc+=32) { // 16 file tables per sector
+                PROF_ENTER(PROF_SCAN_ENTRY);
                 // check first position
                 firstPos = ram_read_uint8_t(loc);
                 _current_attrib = ram_read_uint8_t(loc + 0x0B);    // attrib byte
@@ -179,133 +283,325 @@ uint32_t read_folder_int(uint32_t cluster, int16_t file_id, uint8_t casrun, cons
                     break;
                 }
 
+#ifdef FAT_LIST
+                show = listing && mode != LIST_QUIET;
+#endif
+#ifdef FAT_PAGES
+                show = listing && fctr >= page_first && shown < PAGE_SIZE;
+#endif
+
+#ifdef FAT_LFN
                 // check for LFN entry
                 if ((_current_attrib & 0x0F) == 0x0F) {
-                    if (file_id < 0 || file_id == fctr+1) {
+#ifdef FAT_PAGES
+                    if (firstPos & 0x40) {  // last LFN part, stored first
+                        entry_ctr = ctr;
+                        entry_fctr = ctr_fctr;
+                    }
+#endif
+                    if (show || collect || file_id == fctr+1) {
                         if (!lfn_found) {
                             lfn_found = 1;  // indicate LNF found
                             memset(_filename, 0, MAX_LFN_LENGTH+1);
                         }
                         uint8_t seq = firstPos & 0x1F;  // LFN sequence number
                         uint8_t k = 0;
-                        if (seq <= 2) {
+                        if (seq <= MAX_LFN_LENGTH / 13) { // the first 26 characters are shown
                             // extract characters from LFN entry
                             for (k = 0; k < 5; k++) _filename[(seq - 1) * 13 + k] = ram_read_uint8_t(loc + 1 + k * 2);
                             for (k = 0; k < 6; k++) _filename[(seq - 1) * 13 + 5 + k] = ram_read_uint8_t(loc + 14 + k * 2);
                             for (k = 0; k < 2; k++) _filename[(seq - 1) * 13 + 11 + k] = ram_read_uint8_t(loc + 28 + k * 2);
                         }
-                        continue;
                     }
+                    continue;
                 }
+#endif
 
                 // check for non-hidden, non-system, non-volumeID SFN entry
-                if((_current_attrib & 0b00001110) == 0) {
-                    if(firstPos != '.' || ram_read_uint8_t(loc+1) == '.') { // skip dotfiles but keep ".." parent folder
-                        // capture metadata
-                        fctr++;
-                        if (file_id < 0 || fctr == file_id || file_id == 0) {
-                            const uint32_t fc = grab_cluster_address_from_fileblock(loc);
-                            _filesize_current_file = ram_read_uint32_t(loc + 0x1C);
-                            totalfilesize += _filesize_current_file;
-                            
-                            // copy DOS base name and extension
-                            copy_from_ram(loc, _base_name, 8);
-                            copy_from_ram(loc+0x08, _ext, 3);
-
-                            if (file_id == 0) {
-                                if (memcmp(basename_find, _base_name, 8) == 0 && memcmp(ext_find, _ext, 3) == 0) {
-                                    return fc;
-                                } else {
-                                    continue;
-                                }
-                            }
+                if((_current_attrib & 0b00001110) == 0 &&
+                   (firstPos != '.' || ram_read_uint8_t(loc+1) == '.')) { // skip dotfiles but keep ".." parent folder
+                    fctr++;
+#ifdef FAT_LIST
+                    if (listing && fctr <= HANDLE_TABLE_ENTRIES) {
+                        // store directory entry for later id lookups
+                        ram_transfer(loc, HANDLE_TABLE + ((fctr - 1) << 5), 32);
+                        _handle_table_count = fctr;
+                    }
+#endif
 
-                            // if no LFN found, the SFN filename needs to be formatted
-                            if (!lfn_found) {
-                                memcpy(_filename, _base_name, 8); // copy base name
-                                memcpy(&_filename[9], _ext, 4); // copy extension (incl terminator)
-                                // if file, inject dot before extension
-                                _filename[8] = (_current_attrib & 0x10) ? '\0' : '.';
-                                // remove superfluous spaces before extension
-                                uint8_t k = 0;
-                                for (k = 7; k >= 1 && _filename[k] == ' '; k--);
-                                if (k < 7) memcpy(&_filename[k+1], &_filename[8], 5);
-                            }
+                    if (show || collect || fctr == file_id || basename_find != NULL) {
+                        // copy DOS base name and extension
+                        copy_from_ram(loc, (uint8_t*)_base_name, 8);
+                        copy_from_ram(loc+0x08, (uint8_t*)_ext, 3);
 
-                            if(file_id < 0) {
-                                if(_current_attrib & 0x10) { // directory entry
-                                    sprintf(termbuffer, "%c%3u%c%-24.24s%c (dir)", COL_YELLOW, fctr, COL_WHITE, _filename, COL_CYAN);
-                                } else {             // file entry
-                                    if(casrun == 1 && memcmp(_ext, "CAS", 3) == 0) {    // cas file
-                                        // read from SD card once more and extract CAS data
-                                        read_sector_to(calculate_sector_address(fc, 0), SDCACHE1);
-
-                                        // grab CAS metadata
-                                        uint8_t casname[16];
-                                        uint8_t ext[3];
-                                        copy_from_ram(SDCACHE1 + 0x36, casname, 8);
-                                        copy_from_ram(SDCACHE1 + 0x47, &casname[8], 8);
-                                        copy_from_ram(SDCACHE1 + 0x3E, ext, 3);
-
-                                        // replace terminating characters (0x00) by spaces (0x20)
-                                        replace_bytes(casname, 0x00, 0x20, 16);
-                                        replace_bytes(ext, 0x00, 0x20, 3);
-
-                                        const uint16_t filesize = ram_read_uint16_t(SDCACHE1 + 0x32);
-                                        const uint8_t blocks = ram_read_uint8_t(SDCACHE1 + 0x4F);
-                                        sprintf(termbuffer, "%c%3u%c%.16s %.3s%c%2i  %6u", COL_GREEN, fctr, COL_YELLOW, casname, ext, COL_CYAN, blocks, filesize);
-                                    } else { // non-cas file or not a cas run
-                                        sprintf(termbuffer, "%c%3u%c%-24.24s%c%6lu", COL_GREEN, fctr, COL_WHITE, _filename, COL_YELLOW, _filesize_current_file);
-                                    }
-                                }
-                                terminal_printtermbuffer();
-
-                                if(fctr % 16 == 0) {
-                                    print_recall("-- Press key to continue, q to quit --");
-                                    if(wait_for_key_fixed(3) == 1) {
-                                        stopreading = 1;
-                                        break;
-                                    }
-                                }
-                            }
+                        if (fctr == file_id || (basename_find != NULL &&
+                            memcmp(basename_find, _base_name, 8) == 0 && memcmp(ext_find, _ext, 3) == 0)) {
+                            PROF_RETURN(PROF_SCAN_FOLDER, take_entry(loc, lfn_found));
+                        }
+                    }
 
-                            if(fctr == file_id) {
-                                return fc;
+#ifdef FAT_SORT
+                    if (collect) {
+                        take_entry(loc, lfn_found);
+                        if (sort_add()) {
+                            stopreading = 1; // the folder does not fit in the view
+                            break;
+                        }
+                    }
+#endif
+
+                    if (show) {
+                        take_entry(loc, lfn_found);
+#ifdef FAT_PAGES
+                        if (list_entry(++shown, mode)) {
+#else
+                        if (list_entry(fctr, mode)) {
+#endif
+                            stopreading = 1;
+                            break;
+                        }
+                    }
+
+#ifdef FAT_PAGES
+                    if (mode & SCAN_COUNT) {
+                        // cache ctr and fctr for this page; a page starts at the
+                        // cluster holding the first LFN entry of its first entry,
+                        // which may precede the cluster of the SFN entry
+                        if ((fctr-1) % PAGE_SIZE == 0) {
+                            if (fctr > 1) pages++;
+                            if (entry_ctr == 0xFF) {
+                                entry_ctr = ctr;
+                                entry_fctr = ctr_fctr;
                             }
+                            ram_write_uint8_t(SDCACHE2 + pages-1, entry_ctr);
+                            ram_write_uint16_t(SDCACHE3 + 2 * (pages-1), entry_fctr);
                         }
+                    } else if (listing && shown == PAGE_SIZE) {
+                        stopreading = 1; // when full page is displayed, exit
+                        break;
                     }
+#endif
                 }
-                lfn_found = 0; // reset LFN tracking 
+                lfn_found = 0; // reset LFN tracking
+#ifdef FAT_PAGES
+                entry_ctr = 0xFF;
+#endif
             }
+            PROF_EXIT(PROF_SCAN_ENTRY);
         }
         ctr++;  // next cluster
     }
 
-    if (file_id == 0) return 0; // if file_id is 0, we return 0 to indicate no file found
+#ifdef FAT_PAGES
+    // a counting scan only ends here after the complete folder
+    if (mode & SCAN_COUNT) {
+        _num_of_pages = pages;
+    }
+#endif
+#ifdef FAT_LIST
+    if (listing && mode != LIST_QUIET) {
+        list_summary(fctr);
+    }
+#endif
 
-    if(file_id < 0) {
-        sprintf(termbuffer, "%6u File(s) %10lu Bytes", fctr, totalfilesize);
-        terminal_printtermbuffer();
+    PROF_RETURN(PROF_SCAN_FOLDER, _root_dir_first_cluster);
+}
+
+#ifdef FAT_SORT
+/**
+ * @brief Provide the sorted view of the current folder, of which the linked
+ *        list has been built, when sorting is enabled; the folder is only
+ *        scanned when the handle table does not hold it yet
+ *
+ * @return uint8_t 1 when the folder is served from its sorted view, 0 when
+ *         sorting is disabled or the folder does not fit in the view
+ */
+static uint8_t sort_folder(void) {
+    if(!_sort_enabled) {
+        return 0;
     }
 
-    return _root_dir_first_cluster;
+    if(_handle_table_cluster != _current_folder_cluster) {
+        TRACE_BEGIN();
+        sort_reset();
+        scan_folder(0, 0, NULL, NULL, SCAN_SORT);
+        _handle_table_sorted = sort_view();
+        _handle_table_cluster = _current_folder_cluster;
+        _handle_table_count = _handle_table_sorted ? _sort_count : 0;
+        TRACE_END(TRACE_SORT, _sort_count);
+    }
+    return _handle_table_sorted;
+}
+#endif // FAT_SORT
+
+#ifdef FAT_LIST
+#ifdef FAT_SORT
+/**
+ * @brief List the sorted view of the current folder on the terminal
+ *
+ * @param casrun whether to show CAS file metadata, LIST_QUIET for no output
+ */
+static void list_view(uint8_t casrun) {
+    uint16_t n = 0;
+
+    if(casrun == LIST_QUIET) {
+        return;
+    }
+    while(n < _handle_table_count) {
+        sort_entry(++n);
+        if(list_entry(n, casrun)) {
+            break;
+        }
+    }
+    list_summary(n);
 }
+#endif
 
 /**
- * @brief Read the contents of the root folder and search for a file identified 
- *        by file id. When a negative file_id is supplied, the directory is
- *        simply scanned and the list of files are outputted to the screen.
+ * @brief Read the contents of the current folder and search for a file
+ *        identified by file id. When a negative file_id is supplied, the
+ *        directory is simply scanned and the list of files are outputted to
+ *        the screen.
  * 
  * @param file_id ith file in the folder
+ * @param casrun  whether we are performing a run with CAS file metadata scan,
+ *                LIST_QUIET only fills the handle table
  * @return uint32_t first cluster of the file or directory
  */
 uint32_t read_folder(int16_t file_id, uint8_t casrun) {
-    return read_folder_int(_current_folder_cluster, file_id, casrun, NULL, NULL);
+    if(file_id == 0) {
+        return _root_dir_first_cluster;
+    }
+
+#ifdef FAT_SORT
+    // with sorting, listings and ids are served from the sorted view
+    if(_sort_enabled) {
+        if(_handle_table_cluster != _current_folder_cluster) {
+            build_linked_list(_current_folder_cluster);
+        }
+        if(sort_folder()) {
+            if(file_id > 0) {
+                return file_id <= _handle_table_count ? sort_entry(file_id) :
+                                                        _root_dir_first_cluster;
+            }
+            list_view(casrun);
+            return _root_dir_first_cluster;
+        }
+    }
+#endif
+
+    // ids covered by the last listing of this folder need no directory scan
+    if(file_id > 0 && _handle_table_cluster == _current_folder_cluster &&
+       file_id <= _handle_table_count) {
+        return read_handle(file_id);
+    }
+
+    // a listing (re)builds the handle table for this folder
+    if(file_id < 0) {
+        _handle_table_cluster = _current_folder_cluster;
+        _handle_table_count = 0;
+    }
+
+    TRACE_BEGIN();
+    build_linked_list(_current_folder_cluster);
+    const uint32_t fc = scan_folder(0, file_id < 0 ? 0 : file_id, NULL, NULL, casrun);
+    TRACE_END(TRACE_SCAN, file_id);
+    return fc;
+}
+
+/**
+ * @brief Resolve a file id using the handle table of the last folder listing
+ *        without accessing the SD card. The caller is responsible for checking
+ *        that the table is valid for the current folder and covers file_id.
+ *
+ * @param file_id ith file in the folder
+ * @return uint32_t first cluster of the file
+ */
+uint32_t read_handle(uint16_t file_id) {
+    const uint16_t loc = HANDLE_TABLE + ((file_id - 1) << 5);
+
+    _current_attrib = ram_read_uint8_t(loc + 0x0B);
+    copy_from_ram(loc, (uint8_t*)_base_name, 8);
+    copy_from_ram(loc+0x08, (uint8_t*)_ext, 3);
+    return take_entry(loc, 0);
+}
+#endif // FAT_LIST
+
+#ifdef FAT_PAGES
+#ifdef FAT_SORT
+/**
+ * @brief Display a page of the sorted view of the current folder
+ *
+ * @param page_number page number to display
+ */
+static void list_view(uint8_t page_number) {
+    uint16_t id = (uint16_t)(page_number - 1) * PAGE_SIZE;
+
+    _num_of_pages = _handle_table_count == 0 ? 1 : (_handle_table_count + PAGE_SIZE - 1) / PAGE_SIZE;
+    for(uint8_t row=1; row<=PAGE_SIZE && id<_handle_table_count; row++) {
+        sort_entry(++id);
+        list_entry(row, 0);
+    }
 }
+#endif
+
+/**
+ * @brief Display a page of the current folder, of which the linked list has
+ *        been built
+ * 
+ * @param page_number page number to display
+ * @param count_pages whether to count the number of pages in the folder
+ */
+void display_folder(uint8_t page_number, uint8_t count_pages) {
+#ifdef FAT_SORT
+    // a folder that does not fit in the view has its pages counted instead
+    count_pages |= _sort_enabled && _handle_table_cluster != _current_folder_cluster;
+    if(sort_folder()) {
+        list_view(page_number);
+        return;
+    }
+#endif
+
+    TRACE_BEGIN();
+    scan_folder(page_number, 0, NULL, NULL, count_pages ? SCAN_COUNT : 0);
+    TRACE_END(TRACE_SCAN, page_number);
+}
+
+/**
+ * @brief Find a file identified by file id in the current folder, of which
+ *        the linked list has been built; the scan starts at the page of the id
+ * 
+ * @param file_id ith file in the folder
+ * @param casrun  unused
+ * @return uint32_t first cluster of the file or _root_dir_first_cluster if
+ *         not found
+ */
+uint32_t read_folder(int16_t file_id, uint8_t casrun) {
+    (void)casrun;
+    if(file_id <= 0) {
+        return _root_dir_first_cluster;
+    }
+
+#ifdef FAT_SORT
+    if(sort_folder()) {
+        return file_id <= _handle_table_count ? sort_entry(file_id) : _root_dir_first_cluster;
+    }
+#endif
+
+    TRACE_BEGIN();
+    const uint32_t fc = scan_folder((file_id - 1) / PAGE_SIZE + 1, file_id, NULL, NULL, 0);
+    TRACE_END(TRACE_SCAN, file_id);
+    return fc;
+}
+#endif // FAT_PAGES
 
 /**
  * @brief Find a file identified by BASENAME and EXT in the folder correspond
  *        to the cluster address
+ *
+ * The linked list is left at the folder searched. With FAT_PAGES, a search
+ * of the current folder that does not find the file has also counted its
+ * pages.
  * 
  * @param cluster   cluster address
  * @param basename  first 8 bytes of the file
@@ -313,7 +609,82 @@ uint32_t read_folder(int16_t file_id, uint8_t casrun) {
  * @return uint32_t cluster address of the file or 0 if not found
  */
 uint32_t find_file(uint32_t cluster, const char* basename_find, const char* ext_find) {
-    return read_folder_int(cluster, 0, 0, basename_find, ext_find);
+    TRACE_BEGIN();
+    build_linked_list(cluster);
+#ifdef FAT_PAGES
+    uint32_t fc = scan_folder(0, 0, basename_find, ext_find,
+                              cluster == _current_folder_cluster ? SCAN_COUNT : 0);
+#else
+    uint32_t fc = scan_folder(0, 0, basename_find, ext_find, 0);
+#endif
+    if(fc == _root_dir_first_cluster) {
+        fc = 0; // only the root folder starts at this cluster
+    }
+    TRACE_END(TRACE_FIND, fc != 0);
+    return fc;
+}
+
+/**
+ * @brief Split the next component off a path into a DOS 8.3 base name and
+ *        extension, upper cased and padded with spaces
+ *
+ * @param path     path of which the components are separated by '/'
+ * @param basename receives the 8 byte base name
+ * @param ext      receives the 3 byte extension
+ * @return const char* remainder of the path after the separator
+ */
+const char* path_component(const char* path, char* basename, char* ext) {
+    memset(basename, ' ', 8);
+    memset(ext, ' ', 3);
+
+    char* dest = basename;
+    uint8_t room = 8;
+    uint8_t in_ext = 0;
+    for(; *path != 0x00 && *path != '/'; path++) {
+        char c = *path;
+        if(c == '.' && !in_ext) {
+            dest = ext;
+            room = 3;
+            in_ext = 1;
+        } else if(room != 0) {
+            *dest++ = (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+            room--;
+        }
+    }
+    return *path == '/' ? path + 1 : path;
+}
+
+/**
+ * @brief Find a file or folder by its path relative to the root folder, for
+ *        example "GAMES/PACMAN.CAS"
+ *
+ * The metadata of the entry (_current_attrib, _filesize_current_file, ...)
+ * is set as by find_file. The linked list is left at the last folder
+ * searched.
+ *
+ * @param path     components are DOS 8.3 names separated by '/'
+ * @return uint32_t first cluster of the entry or 0 if not found
+ */
+uint32_t find_path(const char* path) {
+    char basename[8];
+    char ext[3];
+    uint32_t cluster = _root_dir_first_cluster;
+
+    _current_attrib = 0x10;
+    while(*path == '/') {
+        path++;
+    }
+    while(*path != 0x00) {
+        if(!(_current_attrib & 0x10)) {
+            return 0; // a file cannot contain further components
+        }
+        path = path_component(path, basename, ext);
+        cluster = find_file(cluster, basename, ext);
+        if(cluster == 0) {
+            return 0;
+        }
+    }
+    return cluster;
 }
 
 /**
@@ -324,6 +695,8 @@ uint32_t find_file(uint32_t cluster, const char* basename_find, const char* ext_
 void build_linked_list(uint32_t nextcluster) {
     // counter over clusters
     uint8_t ctr = 0;
+    TRACE_BEGIN();
+    PROF_ENTER(PROF_BUILD_LINKED_LIST);
 
     // clear previous linked list
     memset(_linkedlist, 0xFF, F_LL_SIZE * sizeof(uint32_t));
@@ -331,11 +704,34 @@ void build_linked_list(uint32_t nextcluster) {
     // try grabbing next cluster
     while(nextcluster < 0x0FFFFFF8 && nextcluster != 0 && ctr < F_LL_SIZE) {
         _linkedlist[ctr] = nextcluster;
-        read_sector(_fat_begin_lba + (nextcluster >> 7));
-        uint8_t item = nextcluster & 0b01111111;
-        nextcluster = ram_read_uint32_t(item * 4);
+        nextcluster = read_next_cluster(nextcluster);
         ctr++;
     }
+    TRACE_END(TRACE_CHAIN, ctr);
+    PROF_EXIT(PROF_BUILD_LINKED_LIST);
+}
+
+/**
+ * @brief Look up the successor of a cluster in the FAT
+ * 
+ * @param cluster current cluster
+ * @return uint32_t next cluster, values >= 0x0FFFFFF8 mark the end of the chain
+ */
+uint32_t read_next_cluster(uint32_t cluster) {
+    const uint32_t lba = fat_sector_of(cluster);
+
+    // consecutive clusters share a FAT sector, hence only read it when the
+    // lookup moves to another FAT sector or another ram bank
+    if(lba != _fat_cache_lba || ram_bank != _fat_cache_bank) {
+        if(read_sector_to(lba, FATCACHE) != 0xFE) {
+            _fat_cache_lba = FAT_CACHE_INVALID;
+            return 0x0FFFFFFF; // terminate the chain on a read error
+        }
+        _fat_cache_lba = lba;
+        _fat_cache_bank = ram_bank;
+    }
+
+    return ram_read_uint32_t(FATCACHE + FAT_ENTRY_OFFSET(cluster));
 }
 
 /**
@@ -346,7 +742,7 @@ void build_linked_list(uint32_t nextcluster) {
  * @return uint32_t sector address (512 byte address)
  */
 uint32_t calculate_sector_address(uint32_t cluster, uint8_t sector) {
-    return _SECTOR_begin_lba + (cluster - 2) * _sectors_per_cluster + sector;   
+    return cluster_to_lba(cluster) + sector;
 }
 
 /**
@@ -360,124 +756,305 @@ uint32_t grab_cluster_address_from_fileblock(uint16_t loc) {
 }
 
 /**
- * @brief Store a file in the external ram
- * 
- * @param faddr    cluster address of the file
- * @param ram_addr first position in ram to store the file
- * @param verbose  whether to show progress
+ * @brief Prepare streaming the first nrsectors sectors of a cluster chain
+ *
+ * The chain is not resolved up front; stream_next_sector looks up the next
+ * cluster only when the previous run has been streamed.
+ *
+ * @param cluster   first cluster of the file
+ * @param nrsectors number of sectors to stream
  */
-void store_cas_ram(uint32_t faddr, uint16_t ram_addr) {
-    build_linked_list(faddr);
+void stream_open(uint32_t cluster, uint16_t nrsectors) {
+    _stream_cluster = cluster;
+    _stream_remaining = nrsectors;
+    _stream_run = 0;
+    _stream_active = 0;
+    _stream_attempts = 0;
+}
 
-    // count number of clusters
-    uint8_t ctr = 0;
-    uint8_t total_sectors = (_filesize_current_file + 511) / 512;
-    uint32_t caddr = 0;
-    uint16_t nbytes = 0;    // count number of bytes
-    uint8_t sector_ctr = 0; // counter sector
-    uint8_t first_sector = 1; // whether this is the first sector
-
-    ctr = 0;
-    while(_linkedlist[ctr] != 0xFFFFFFFF && ctr < 16 && nbytes < _filesize_current_file) {
-
-        // calculate address of sector
-        caddr = calculate_sector_address(_linkedlist[ctr], 0);
-
-        // loop over all sectors given a cluster and copy the data to RAM
-        for(uint8_t i=0; i<_sectors_per_cluster; i++) {
-
-            read_sector_to(caddr + i, ram_addr); // read sector data (512 bytes) to external ram address
-            switch(sector_ctr % 5) {
-            case 0:
-                // preamble is first 0x100 bytes of sector
-                if (first_sector) {
-                    // first sector, copy the preamble's transfer address and length
-                    ram_write_uint16_t(0x8000, ram_read_uint16_t(SDCACHE0 + 0x0030));
-                    ram_write_uint16_t(0x8002, ram_read_uint16_t(SDCACHE0 + 0x0032));
-                    first_sector = 0;
-                }
-                ram_transfer(ram_addr + 0x100, ram_addr, 0x100);
-                ram_addr += 256;
-                break;
-            case 2:
-                // preamble is last 0x100 bytes of sector
-                ram_addr += 256;
-                break;
-            default: // 1,3,4 are complete blocks
-                ram_addr += 512;
-                break;
-            }
+/**
+ * @brief Position the SD card at the data of the next sector of the stream,
+ *        which the caller then collects using one of the fast_sd_to_* routines
+ *
+ * Contiguous clusters are merged into a single run that is read using one
+ * multiple block read (CMD18), or sector by sector using CMD17 on cards that
+ * do not support multiple block reads (see sd_probe). An active progress
+ * indicator is updated with the number of sectors still to go.
+ *
+ * @return uint8_t 1 if a sector is available, 0 at the end of the stream or
+ *         upon a read error, which is counted in sd_errors
+ */
+uint8_t stream_next_sector(void) {
+    progress_update(_stream_remaining);
 
-            sprintf(termbuffer, "Loading %i / %i sectors", sector_ctr, total_sectors);
-            terminal_redoline();
+    if(_stream_remaining == 0) {
+        return 0;
+    }
+
+    if(_stream_run == 0) {
+        stream_close();
 
-            nbytes += 512;
-            if(nbytes >= _filesize_current_file) {
+        if(_stream_cluster < 2 || _stream_cluster >= 0x0FFFFFF8) {
+            _stream_remaining = 0; // chain is shorter than the file
+            return 0;
+        }
+
+        // extend the run for as long as the chain is contiguous, but no
+        // further than the remaining sectors require
+        const uint16_t needed = (_stream_remaining + _sectors_per_cluster - 1) >> _cluster_shift;
+        const uint32_t start = _stream_cluster;
+        uint32_t cluster = start;
+        uint16_t nrclusters = 1;
+        while(nrclusters < needed) {
+            _stream_cluster = read_next_cluster(cluster);
+            if(_stream_cluster != cluster + 1) {
                 break;
             }
-            sector_ctr++;
+            cluster = _stream_cluster;
+            nrclusters++;
         }
 
-        ctr++;
+        _stream_run = nrclusters << _cluster_shift;
+        if(_stream_run > _stream_remaining) {
+            _stream_run = _stream_remaining;
+        }
+
+        _stream_lba = calculate_sector_address(start, 0);
     }
 
-    sprintf(termbuffer, "Done loading %i / %i sectors", 
-                total_sectors, total_sectors);
-    terminal_printtermbuffer();
+    // cards without multiple block reads get a single block read per sector
+    if(!sd_multiblock) {
+        stream_close();
+    }
+
+    // (re)open the multiple block read at the next sector of the run
+    if(!_stream_active) {
+        open_command();
+        _stream_active = 1;
+        if((sd_multiblock ? cmd18(_stream_lba) : cmd17(_stream_lba)) != 0xFE) {
+            stream_close();
+            _stream_remaining = 0;
+            sd_errors++;
+            return 0;
+        }
+    } else if(wait_data_token() != 0xFE) {
+        stream_close();
+        _stream_remaining = 0;
+        sd_errors++;
+        return 0;
+    }
+
+    _stream_lba++;
+    _stream_run--;
+    _stream_remaining--;
+    return 1;
 }
 
 /**
- * @brief Store a file in the internal ram
+ * @brief Rewind the stream by one sector after the collected sector turned out
+ *        to be corrupt, such that stream_next_sector reads it again
+ *
+ * A sector is tried again up to SD_RETRIES times, after which it is counted in
+ * sd_errors and the loader abandons the load rather than keep the corrupt
+ * sector.
+ *
+ * @return uint8_t 1 if the sector is read again, 0 if it is given up on
+ */
+uint8_t stream_retry(void) {
+    stream_close();
+    if(_stream_lba - 1 != _stream_retry_lba) {
+        _stream_retry_lba = _stream_lba - 1;
+        _stream_attempts = 0;
+    }
+    if(_stream_attempts == SD_RETRIES) {
+        _stream_attempts = 0;
+        sd_errors++;
+        return 0;
+    }
+    _stream_attempts++;
+    sd_retries++;
+
+    _stream_lba--;
+    _stream_run++;
+    _stream_remaining++;
+    return 1;
+}
+
+/**
+ * @brief Terminate the multiple block read of the stream, if any
+ */
+void stream_close(void) {
+    if(_stream_active) {
+        if(sd_multiblock) {
+            cmd12();
+        }
+        close_command();
+        _stream_active = 0;
+    }
+}
+
+/**
+ * @brief Store a file in the external ram
  * 
  * @param faddr    cluster address of the file
  * @param ram_addr first position in ram to store the file
+ * @return uint8_t 0 on success, 1 if not every sector was read intact
  */
-void store_prg_intram(uint32_t faddr, uint16_t ram_addr) {
-    build_linked_list(faddr);
+uint8_t store_cas_ram(uint32_t faddr, uint16_t ram_addr) {
+    const uint16_t total_sectors = (_filesize_current_file + 511) / 512;
+    uint16_t sector_ctr = 0; // counter sector
+
+#ifdef FAT_VERBOSE
+    progress_line("Loading ", total_sectors);
+#endif
+    TRACE_BEGIN();
+    stream_open(faddr, total_sectors);
+    while(stream_next_sector()) {
+        // read sector data (512 bytes) to external ram address
+        if(fast_sd_to_ram_full(ram_addr) != 0) {
+            if(stream_retry()) {
+                continue;
+            }
+            break; // the sector stays corrupt
+        }
+        switch(sector_ctr % 5) {
+        case 0:
+            // preamble is first 0x100 bytes of sector
+            if (sector_ctr == 0) {
+                // first sector, copy the preamble's transfer address and length
+                ram_write_uint16_t(0x8000, ram_read_uint16_t(ram_addr + 0x0030));
+                ram_write_uint16_t(0x8002, ram_read_uint16_t(ram_addr + 0x0032));
+            }
+            ram_transfer(ram_addr + 0x100, ram_addr, 0x100);
+            ram_addr += 256;
+            break;
+        case 2:
+            // preamble is last 0x100 bytes of sector
+            ram_addr += 256;
+            break;
+        default: // 1,3,4 are complete blocks
+            ram_addr += 512;
+            break;
+        }
 
-    // count number of clusters
-    uint8_t ctr = 0;
-    uint8_t cursec = 0;
-    uint8_t total_sectors = (_filesize_current_file + 511) / 512;
-    uint32_t caddr = 0;
-    uint16_t nbytes = 0;    // count number of bytes
+        sector_ctr++;
+    }
+    stream_close();
+#ifdef FAT_VERBOSE
+    progress_stop();
+#endif
+    TRACE_END(TRACE_LOAD_CAS, sector_ctr);
+
+#ifdef FAT_VERBOSE
+    format_sectors("Done loading ", sector_ctr, total_sectors);
+    terminal_printtermbuffer();
+#endif
 
-    ctr = 0;
-    while(_linkedlist[ctr] != 0xFFFFFFFF && ctr < 16 && nbytes < _filesize_current_file) {
+    return sector_ctr != total_sectors;
+}
 
-        // calculate address of sector
-        caddr = calculate_sector_address(_linkedlist[ctr], 0);
+/**
+ * @brief Store a CAD file in the external ram
+ *
+ * The header sector is placed at CAD_HEADER_RAM, after which the program is
+ * streamed to the start of the active RAM bank. Its deploy address and
+ * length are stored at 0x8000 and 0x8002, as done by store_cas_ram.
+ *
+ * @param faddr    cluster address of the file
+ * @return uint8_t 0 on success, 1 if the file is invalid or not every sector
+ *         was read intact
+ */
+uint8_t store_cad_ram(uint32_t faddr) {
+    const uint16_t total_sectors = (_filesize_current_file + 511) / 512;
+    uint16_t sector_ctr = 0; // counter sector
+    uint16_t ram_addr = CAD_HEADER_RAM;
 
-        sprintf(termbuffer, "Copying program to %04X", ram_addr);
-        terminal_printtermbuffer();
+    if(total_sectors < 2 || total_sectors > CAD_MAX_SECTORS) {
+        return 1;
+    }
 
-        // loop over all sectors given a cluster and copy the data to RAM
-        for(uint8_t i=0; i<_sectors_per_cluster; i++) {
+#ifdef FAT_VERBOSE
+    progress_line("Loading ", total_sectors);
+#endif
+    TRACE_BEGIN();
+    stream_open(faddr, total_sectors);
+    while(stream_next_sector()) {
+        // read sector data (512 bytes) to external ram address
+        if(fast_sd_to_ram_full(ram_addr) != 0) {
+            if(stream_retry()) {
+                continue;
+            }
+            break; // the sector stays corrupt
+        }
+        ram_addr = sector_ctr == 0 ? 0x0000 : ram_addr + 0x200;
+
+        sector_ctr++;
+    }
+    stream_close();
+#ifdef FAT_VERBOSE
+    progress_stop();
+#endif
+    TRACE_END(TRACE_LOAD_CAD, sector_ctr);
+
+#ifdef FAT_VERBOSE
+    format_sectors("Done loading ", sector_ctr, total_sectors);
+    terminal_printtermbuffer();
+#endif
+
+    const uint16_t deploy_addr = ram_read_uint16_t(CAD_HEADER_RAM + CAD_DEPLOY);
+    const uint16_t length = ram_read_uint16_t(CAD_HEADER_RAM + CAD_LENGTH);
+    if(sector_ctr != total_sectors ||
+       ram_read_uint8_t(CAD_HEADER_RAM) != 'C' || ram_read_uint8_t(CAD_HEADER_RAM + 1) != 'D' ||
+       length > (total_sectors - 1) * 0x200) {
+        return 1;
+    }
+    ram_write_uint16_t(0x8000, deploy_addr);
+    ram_write_uint16_t(0x8002, length);
 
-            // copy sector over to internal memory
-            open_command();
-            cmd17(caddr);
-            fast_sd_to_intram_full(ram_addr);
-            close_command();
+    return 0;
+}
 
-            // increment ram pointer
-            ram_addr += 0x200;
+/**
+ * @brief Store a file in the internal ram
+ * 
+ * @param faddr    cluster address of the file
+ * @param ram_addr first position in ram to store the file
+ * @return uint8_t 0 on success, 1 if not every sector was read intact
+ */
+uint8_t store_prg_intram(uint32_t faddr, uint16_t ram_addr) {
+    const uint16_t total_sectors = (_filesize_current_file + 511) / 512;
+    uint16_t cursec = 0;
 
-            sprintf(termbuffer, "Loading %i / %i sectors", cursec, total_sectors);
-            terminal_redoline();
+#ifdef FAT_VERBOSE
+    *fmt_hex16(fmt_str(termbuffer, "Copying program to ", 19), ram_addr) = 0;
+    terminal_printtermbuffer();
 
-            nbytes += 512;
-            if(nbytes >= _filesize_current_file) {
-                break;
+    progress_line("Loading ", total_sectors);
+#endif
+    TRACE_BEGIN();
+    stream_open(faddr, total_sectors);
+    while(stream_next_sector()) {
+        // copy sector over to internal memory
+        if(fast_sd_to_intram_full(ram_addr) != 0) {
+            if(stream_retry()) {
+                continue;
             }
-            caddr++;
-            cursec++;
+            break; // the sector stays corrupt
         }
+        ram_addr += 0x200;
 
-        ctr++;
+        cursec++;
     }
-
-    sprintf(termbuffer, "Done loading %i / %i sectors", 
-                total_sectors, total_sectors);
+    stream_close();
+#ifdef FAT_VERBOSE
+    progress_stop();
+#endif
+    TRACE_END(TRACE_LOAD_PRG, cursec);
+
+#ifdef FAT_VERBOSE
+    format_sectors("Done loading ", cursec, total_sectors);
     terminal_printtermbuffer();
-}
\ No newline at end of file
+#endif
+
+    return cursec != total_sectors;
+}
@@ -21,12 +21,37 @@
 #ifndef _FAT32_H
 #define _FAT32_H
 
+/*
+ * FAT32 engine of the LAUNCHER, EZLAUNCH and FLASHER. Each target selects the
+ * features it uses at compile time:
+ *
+ *   FAT_VERBOSE  mount and load messages on the terminal
+ *   FAT_LFN      long file names in listings
+ *   FAT_LIST     terminal listings and the handle table (read_folder)
+ *   FAT_CASINFO  CAS metadata in terminal listings (lscas)
+ *   FAT_PAGES    paged listings of EZLAUNCH (display_folder, read_folder)
+ *   FAT_SORT     sorted views of folders (fatsort.h), when _sort_enabled
+ *   FAT_PATHS    paths relative to the current folder and a cache of the
+ *                directory entries they resolve (fatpath.h)
+ *
+ * Listings are presented by list_entry and list_summary (see fatview.h), of
+ * which fatview-term.c implements the terminal and fatview-easy.c the screen
+ * of EZLAUNCH.
+ */
+
+#if defined(FAT_LIST) && defined(FAT_PAGES)
+#error "FAT_LIST and FAT_PAGES are mutually exclusive"
+#endif
+
 #define F_LL_SIZE               16
-#define MAX_LFN_LENGTH          26 // 2 * 13
+#define MAX_LFN_LENGTH          26 // 2 * 13 (LFN entries come in 13 byte chunks)
+#define PAGE_SIZE               18 // max number of files displayed on a page
+#define DISPLAY_OFFSET           2 // line-offset in the video memory for displaying files
 
 #include "sdcard.h"
 #include "util.h"
 #include "ram.h"
+#include "fatlba.h"
 
 // global variables for the FAT
 extern uint16_t _bytes_per_sector;
@@ -47,6 +72,29 @@ extern uint8_t _filename[]; // filename buffer
 extern char _base_name[9]; // DOS 8.3 base name (8 chars, uppercased)
 extern char _ext[4]; // file extension (3 chars, uppercased)
 extern uint8_t _current_attrib;
+extern uint32_t _cluster_current_file;
+
+#if defined(FAT_LIST) || defined(FAT_SORT)
+// handle table holding the directory entries of the last folder listing or,
+// with FAT_SORT, the sorted view of a folder
+extern uint32_t _handle_table_cluster; // folder cluster of the table, 0 if invalid
+extern uint16_t _handle_table_count;   // number of entries in the table
+#endif
+
+#ifdef FAT_PAGES
+extern uint8_t _num_of_pages; // number of pages in the current folder
+#endif
+
+#define LIST_QUIET 2   // read_folder: fill the handle table without output
+
+// FAT sector held at FATCACHE, see read_next_cluster
+extern uint32_t _fat_cache_lba;
+
+#define FAT_CACHE_INVALID 0xFFFFFFFF
+
+// free space bookkeeping of the partition, used by the write engine
+extern uint32_t _fsinfo_lba;      // sector address of the FSInfo sector
+extern uint32_t _total_clusters;  // number of data clusters, numbered from 2
 
 /**
  * @brief Read the Master Boot Record
@@ -63,21 +111,53 @@ uint32_t read_mbr(void);
  */
 void read_partition(uint32_t lba0);
 
+#if defined(FAT_LIST) || defined(FAT_PAGES)
 /**
- * @brief Read the contents of the root folder and search for a file identified 
- *        by file id. When a negative file_id is supplied, the directory is
- *        simply scanned and the list of files are outputted to the screen.
+ * @brief Search the current folder for a file identified by file id. With
+ *        FAT_LIST, a negative file_id lists the folder on the terminal; with
+ *        FAT_PAGES, the linked list of the folder has been built and the scan
+ *        starts at the page of the id.
  * 
  * @param file_id ith file in the folder
- * @param casrun whether we are performing a run with CAS file metadata scan
- * @return uint32_t first cluster of the file
+ * @param casrun  whether we are performing a run with CAS file metadata scan,
+ *                LIST_QUIET only fills the handle table (FAT_LIST)
+ * @return uint32_t first cluster of the file or _root_dir_first_cluster if
+ *         not found
  */
 uint32_t read_folder(int16_t file_id, uint8_t casrun);
+#endif
+
+#ifdef FAT_LIST
+/**
+ * @brief Resolve a file id using the handle table of the last folder listing
+ *        without accessing the SD card. The caller is responsible for checking
+ *        that the table is valid for the current folder and covers file_id.
+ *
+ * @param file_id ith file in the folder
+ * @return uint32_t first cluster of the file
+ */
+uint32_t read_handle(uint16_t file_id);
+#endif
+
+#ifdef FAT_PAGES
+/**
+ * @brief Display a page of the current folder, of which the linked list has
+ *        been built
+ * 
+ * @param page_number page number to display
+ * @param count_pages whether to count the number of pages in the folder
+ */
+void display_folder(uint8_t page_number, uint8_t count_pages);
+#endif
 
 /**
  * @brief Find a file identified by BASENAME and EXT in the folder correspond
  *        to the cluster address
  * 
+ * The linked list is left at the folder searched. With FAT_PAGES, a search
+ * of the current folder that does not find the file has also counted its
+ * pages.
+ *
  * @param cluster   cluster address
  * @param basename  first 8 bytes of the file
  * @param ext       3 byte extension of the file
@@ -85,6 +165,32 @@ uint32_t read_folder(int16_t file_id, uint8_t casrun);
  */
 uint32_t find_file(uint32_t cluster, const char* basename, const char* ext);
 
+/**
+ * @brief Build the display name of the active entry (_filename) from its DOS
+ *        8.3 name in _base_name and _ext
+ */
+void format_sfn_filename(void);
+
+/**
+ * @brief Split the next component off a path into a DOS 8.3 base name and
+ *        extension, upper cased and padded with spaces
+ *
+ * @param path     path of which the components are separated by '/'
+ * @param basename receives the 8 byte base name
+ * @param ext      receives the 3 byte extension
+ * @return const char* remainder of the path after the separator
+ */
+const char* path_component(const char* path, char* basename, char* ext);
+
+/**
+ * @brief Find a file or folder by its path relative to the root folder, for
+ *        example "GAMES/PACMAN.CAS"
+ *
+ * @param path     components are DOS 8.3 names separated by '/'
+ * @return uint32_t first cluster of the entry or 0 if not found
+ */
+uint32_t find_path(const char* path);
+
 /**
  * @brief Build a linked list of sector addresses starting from a root address
  * 
@@ -92,6 +198,15 @@ uint32_t find_file(uint32_t cluster, const char* basename, const char* ext);
  */
 void build_linked_list(uint32_t nextcluster);
 
+/**
+ * @brief Look up the successor of a cluster in the FAT; the most recently used
+ *        FAT sector is kept at FATCACHE of the active ram bank
+ * 
+ * @param cluster current cluster
+ * @return uint32_t next cluster, values >= 0x0FFFFFF8 mark the end of the chain
+ */
+uint32_t read_next_cluster(uint32_t cluster);
+
 /**
  * @brief Calculate the sector address from cluster and sector
  * 
@@ -108,20 +223,62 @@ uint32_t calculate_sector_address(uint32_t cluster, uint8_t sector);
  */
 uint32_t grab_cluster_address_from_fileblock(uint16_t loc);
 
+/**
+ * @brief Prepare streaming the first nrsectors sectors of a cluster chain
+ *
+ * @param cluster   first cluster of the file
+ * @param nrsectors number of sectors to stream
+ */
+void stream_open(uint32_t cluster, uint16_t nrsectors);
+
+/**
+ * @brief Position the SD card at the data of the next sector of the stream,
+ *        which the caller then collects using one of the fast_sd_to_* routines
+ *
+ * @return uint8_t 1 if a sector is available, 0 at the end of the stream or
+ *         upon a read error, which is counted in sd_errors
+ */
+uint8_t stream_next_sector(void);
+
+/**
+ * @brief Rewind the stream by one sector after the collected sector turned out
+ *        to be corrupt
+ *
+ * @return uint8_t 1 if the sector is read again, 0 after SD_RETRIES attempts,
+ *         upon which the caller abandons the load
+ */
+uint8_t stream_retry(void);
+
+/**
+ * @brief Terminate the multiple block read of the stream, if any
+ */
+void stream_close(void);
+
 /**
  * @brief Store a CAS file in the external ram
  * 
  * @param faddr    cluster address of the file
  * @param ram_addr first position in ram to store the file
+ * @return uint8_t 0 on success, 1 if not every sector was read intact
+ */
+uint8_t store_cas_ram(uint32_t faddr, uint16_t ram_addr);
+
+/**
+ * @brief Store a CAD file in the external ram
+ * 
+ * @param faddr    cluster address of the file
+ * @return uint8_t 0 on success, 1 if the file is invalid or not every sector
+ *         was read intact
  */
-void store_cas_ram(uint32_t faddr, uint16_t ram_addr);
+uint8_t store_cad_ram(uint32_t faddr);
 
 /**
  * @brief Store a PRG file in internal ram
  * 
  * @param faddr    cluster address of the file
  * @param ram_addr first position in ram to store the file
+ * @return uint8_t 0 on success, 1 if not every sector was read intact
  */
-void store_prg_intram(uint32_t faddr, uint16_t ram_addr);
+uint8_t store_prg_intram(uint32_t faddr, uint16_t ram_addr);
 
 #endif // _FAT32_H
\ No newline at end of file
@@ -0,0 +1,215 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+#include "fatfile.h"
+
+FILEHANDLE _file_handles[FILE_MAX_HANDLES];
+
+/**
+ * @brief Open a file for reading
+ *
+ * The cluster chain is probed once upon opening to establish how many leading
+ * clusters are contiguous. As consecutive clusters share a FAT sector, this
+ * costs a single FAT sector read per 128 clusters for unfragmented files.
+ *
+ * @param cluster  first cluster of the file
+ * @param filesize size of the file in bytes
+ * @return int8_t handle id or -1 if no handle is available or the file is
+ *         larger than FILE_MAX_SIZE
+ */
+int8_t file_open(uint32_t cluster, uint32_t filesize) {
+    int8_t fh = 0;
+
+    // sectors of a file are numbered in 16 bits
+    if(filesize > FILE_MAX_SIZE) {
+        return -1;
+    }
+
+    for(fh=0; fh<FILE_MAX_HANDLES; fh++) {
+        if(!_file_handles[fh].in_use) {
+            break;
+        }
+    }
+    if(fh == FILE_MAX_HANDLES) {
+        return -1;
+    }
+
+    FILEHANDLE* f = &_file_handles[fh];
+    const uint16_t nrsectors = (filesize + 511) >> 9;
+    const uint16_t nrclusters = (nrsectors + _sectors_per_cluster - 1) >> _cluster_shift;
+
+    f->in_use = 1;
+    f->first_cluster = cluster;
+    f->filesize = filesize;
+    f->pos = 0;
+    f->buffered_sector = FILE_NO_SECTOR;
+
+    // walk the chain until it is no longer contiguous
+    f->run = 1;
+    while(f->run < nrclusters) {
+        const uint32_t next = read_next_cluster(cluster);
+        if(next != cluster + 1) {
+            break;
+        }
+        cluster = next;
+        f->run++;
+    }
+    f->cluster = cluster;
+    f->cluster_idx = f->run - 1;
+
+    return fh;
+}
+
+/**
+ * @brief Release a file handle
+ *
+ * @param fh handle id
+ */
+void file_close(uint8_t fh) {
+    _file_handles[fh].in_use = 0;
+}
+
+/**
+ * @brief Set the read position of a file
+ *
+ * @param fh     handle id
+ * @param offset byte offset from the start of the file
+ * @return uint8_t 0 on success, 1 if the offset lies beyond the end of file
+ */
+uint8_t file_seek(uint8_t fh, uint32_t offset) {
+    if(offset > _file_handles[fh].filesize) {
+        return 1;
+    }
+
+    _file_handles[fh].pos = offset;
+    return 0;
+}
+
+/**
+ * @brief Resolve a sector of a file to its sector address on the SD card
+ *
+ * @param fh     handle id
+ * @param sector sector relative to the start of the file
+ * @return uint32_t sector address, or FILE_NO_ADDRESS when the cluster chain
+ *         ends before the sector or cannot be read
+ */
+uint32_t file_sector_address(uint8_t fh, uint16_t sector) {
+    FILEHANDLE* f = &_file_handles[fh];
+    const uint16_t idx = sector >> _cluster_shift;
+    const uint8_t sub = sector & (_sectors_per_cluster - 1);
+
+    // contiguous part of the file
+    if(idx < f->run) {
+        return calculate_sector_address(f->first_cluster + idx, sub);
+    }
+
+    // otherwise follow the chain, going back to the end of the contiguous part
+    // when the requested cluster lies before the last visited one
+    if(idx < f->cluster_idx) {
+        f->cluster = f->first_cluster + f->run - 1;
+        f->cluster_idx = f->run - 1;
+    }
+    while(f->cluster_idx < idx) {
+        const uint32_t next = read_next_cluster(f->cluster);
+        if(next < 2 || next >= 0x0FFFFFF8) {
+            return FILE_NO_ADDRESS; // end of chain or a FAT read error
+        }
+        f->cluster = next;
+        f->cluster_idx++;
+    }
+
+    return calculate_sector_address(f->cluster, sub);
+}
+
+/**
+ * @brief Number of sectors that can be read from sector onwards, capped by
+ *        the end of file
+ *
+ * @param fh     handle id
+ * @param sector sector relative to the start of the file
+ * @param count  requested number of sectors
+ * @return uint8_t number of sectors available
+ */
+uint8_t file_sectors_left(uint8_t fh, uint16_t sector, uint8_t count) {
+    const uint16_t nrsectors = (_file_handles[fh].filesize + 511) >> 9;
+
+    if(sector >= nrsectors) {
+        return 0;
+    }
+    if(nrsectors - sector < count) {
+        return nrsectors - sector;
+    }
+    return count;
+}
+
+/**
+ * @brief Read bytes from the current position into internal RAM
+ *
+ * Whole sectors are streamed directly into internal RAM; partial sectors are
+ * read into the buffer of the handle and kept there such that subsequent
+ * small reads from the same sector do not touch the SD card.
+ *
+ * @param fh      handle id
+ * @param dest    internal RAM address
+ * @param nrbytes number of bytes to read
+ * @return uint16_t number of bytes read, fewer than nrbytes upon a read error
+ */
+uint16_t file_read(uint8_t fh, uint8_t* dest, uint16_t nrbytes) {
+    FILEHANDLE* f = &_file_handles[fh];
+    const uint16_t buffer = FILE_BUFFER + ((uint16_t)fh << 9);
+    uint16_t nbytes = 0;
+
+    if(f->filesize - f->pos < nrbytes) {
+        nrbytes = f->filesize - f->pos;
+    }
+
+    while(nbytes < nrbytes) {
+        const uint16_t sector = f->pos >> 9;
+        const uint16_t offset = f->pos & 0x1FF;
+        uint16_t chunk = 0x200 - offset;
+        if(chunk > nrbytes - nbytes) {
+            chunk = nrbytes - nbytes;
+        }
+
+        if(chunk == 0x200 && sector != f->buffered_sector) {
+            const uint32_t addr = file_sector_address(fh, sector);
+            if(addr == FILE_NO_ADDRESS || read_sector_intram(addr, (uint16_t)(uintptr_t)dest) != 0xFE) {
+                break;
+            }
+        } else {
+            if(sector != f->buffered_sector) {
+                const uint32_t addr = file_sector_address(fh, sector);
+                if(addr == FILE_NO_ADDRESS || read_sector_to(addr, buffer) != 0xFE) {
+                    f->buffered_sector = FILE_NO_SECTOR;
+                    break;
+                }
+                f->buffered_sector = sector;
+            }
+            copy_from_ram(buffer + offset, dest, chunk);
+        }
+
+        f->pos += chunk;
+        dest += chunk;
+        nbytes += chunk;
+    }
+
+    return nbytes;
+}
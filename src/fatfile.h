@@ -0,0 +1,118 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+#ifndef _FATFILE_H
+#define _FATFILE_H
+
+/*
+ * Byte-granular, seekable access to files on the FAT32 partition. A file is
+ * opened from its first cluster and size (as produced by read_folder or
+ * find_file) and can subsequently be read from any offset. Each handle keeps
+ * one sector of read-ahead in external RAM, such that small reads only touch
+ * the SD card when they cross a sector boundary.
+ *
+ * Offsets are translated to clusters in constant time within the contiguous
+ * leading part of a file; beyond that, the cluster chain is followed from the
+ * last visited position. All routines expect RAM bank 0 to be selected.
+ */
+
+#include <stdint.h>
+
+#include "fat32.h"
+#include "ram.h"
+
+#define FILE_MAX_HANDLES    4
+#define FILE_BUFFER         SDCACHE4    // 512 byte buffer per handle (SDCACHE4-7)
+#define FILE_NO_SECTOR      0xFFFF
+#define FILE_NO_ADDRESS     0xFFFFFFFF  // file_sector_address: chain ends early or is unreadable
+#define FILE_MAX_SIZE       0x1FFFE00   // 65535 sectors, as sectors are counted in 16 bits
+
+typedef struct {
+    uint8_t in_use;             // whether the handle is taken
+    uint32_t first_cluster;     // first cluster of the file
+    uint32_t filesize;          // file size in bytes
+    uint32_t pos;               // read position in bytes
+    uint32_t cluster;           // last visited cluster in the chain ...
+    uint16_t cluster_idx;       // ... and its position in the chain
+    uint16_t run;               // number of leading clusters that are contiguous
+    uint16_t buffered_sector;   // file sector held in the buffer
+} FILEHANDLE;
+
+extern FILEHANDLE _file_handles[FILE_MAX_HANDLES];
+
+/**
+ * @brief Open a file for reading
+ *
+ * @param cluster  first cluster of the file
+ * @param filesize size of the file in bytes
+ * @return int8_t handle id or -1 if no handle is available or the file is
+ *         larger than FILE_MAX_SIZE
+ */
+int8_t file_open(uint32_t cluster, uint32_t filesize);
+
+/**
+ * @brief Release a file handle
+ *
+ * @param fh handle id
+ */
+void file_close(uint8_t fh);
+
+/**
+ * @brief Set the read position of a file
+ *
+ * @param fh     handle id
+ * @param offset byte offset from the start of the file
+ * @return uint8_t 0 on success, 1 if the offset lies beyond the end of file
+ */
+uint8_t file_seek(uint8_t fh, uint32_t offset);
+
+/**
+ * @brief Read bytes from the current position into internal RAM
+ *
+ * @param fh      handle id
+ * @param dest    internal RAM address
+ * @param nrbytes number of bytes to read
+ * @return uint16_t number of bytes read, fewer than nrbytes upon a read error
+ */
+uint16_t file_read(uint8_t fh, uint8_t* dest, uint16_t nrbytes);
+
+/**
+ * @brief Resolve a sector of a file to its sector address on the SD card
+ *
+ * @param fh     handle id
+ * @param sector sector relative to the start of the file
+ * @return uint32_t sector address, or FILE_NO_ADDRESS when the cluster chain
+ *         ends before the sector or cannot be read
+ */
+uint32_t file_sector_address(uint8_t fh, uint16_t sector);
+
+/**
+ * @brief Number of sectors that can be read from sector onwards, capped by
+ *        the end of file
+ *
+ * @param fh     handle id
+ * @param sector sector relative to the start of the file
+ * @param count  requested number of sectors
+ * @return uint8_t number of sectors available
+ */
+uint8_t file_sectors_left(uint8_t fh, uint16_t sector, uint8_t count);
+
+#endif // _FATFILE_H
@@ -0,0 +1,86 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+SECTION code_user
+
+PUBLIC _cluster_to_lba
+PUBLIC _fat_sector_of
+
+EXTERN __cluster_shift
+EXTERN __SECTOR_begin_lba
+EXTERN __fat_begin_lba
+
+;-------------------------------------------------------------------------------
+; Sector address of the first sector of a cluster
+;
+; uint32_t cluster_to_lba(uint32_t cluster) __z88dk_fastcall;
+;
+; DEHL - cluster number, replaced by the sector address
+;-------------------------------------------------------------------------------
+_cluster_to_lba:
+    ld bc,2
+    or a
+    sbc hl,bc               ; cluster - 2
+    jr nc,ctlnoborrow
+    dec de
+ctlnoborrow:
+    ld a,(__cluster_shift)  ; sectors per cluster is a power of two
+    or a
+    jr z,ctladd
+    ld b,a
+ctlshift:
+    add hl,hl               ; DEHL << 1
+    rl e
+    rl d
+    djnz ctlshift
+ctladd:
+    ld bc,(__SECTOR_begin_lba)
+    add hl,bc
+    ex de,hl
+    ld bc,(__SECTOR_begin_lba+2)
+    adc hl,bc
+    ex de,hl
+    ret
+
+;-------------------------------------------------------------------------------
+; Sector address of the FAT sector holding the entry of a cluster; a FAT
+; sector holds 128 entries of 4 bytes
+;
+; uint32_t fat_sector_of(uint32_t cluster) __z88dk_fastcall;
+;
+; DEHL - cluster number, replaced by the sector address
+;-------------------------------------------------------------------------------
+_fat_sector_of:
+    add hl,hl               ; cluster << 1, bit 31 ends up in the carry
+    rl e
+    rl d
+    ld l,h                  ; >> 8 by moving bytes
+    ld h,e
+    ld e,d
+    ld a,0
+    rla                     ; bit 31 of the cluster number
+    ld d,a
+    ld bc,(__fat_begin_lba)
+    add hl,bc
+    ex de,hl
+    ld bc,(__fat_begin_lba+2)
+    adc hl,bc
+    ex de,hl
+    ret
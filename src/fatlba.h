@@ -0,0 +1,54 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FATLBA_H
+#define _FATLBA_H
+
+/*
+ * Cluster and sector arithmetic shared by both FAT32 engines. The number of
+ * sectors per cluster is a power of two, hence cluster offsets are computed
+ * with shifts rather than 32-bit multiplications and divisions.
+ */
+
+#include <stdint.h>
+
+// log2 of the number of sectors per cluster, set by read_partition
+extern uint8_t _cluster_shift;
+
+// byte offset of the FAT entry of a cluster within its FAT sector
+#define FAT_ENTRY_OFFSET(cluster) ((uint16_t)((uint8_t)(cluster) & 0x7F) << 2)
+
+/**
+ * @brief Sector address of the first sector of a cluster
+ *
+ * @param cluster cluster number (>= 2)
+ * @return uint32_t _SECTOR_begin_lba + (cluster - 2) << _cluster_shift
+ */
+uint32_t cluster_to_lba(uint32_t cluster) __z88dk_fastcall;
+
+/**
+ * @brief Sector address of the FAT sector holding the entry of a cluster
+ *
+ * @param cluster cluster number
+ * @return uint32_t _fat_begin_lba + cluster / 128
+ */
+uint32_t fat_sector_of(uint32_t cluster) __z88dk_fastcall;
+
+#endif // _FATLBA_H
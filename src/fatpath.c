@@ -0,0 +1,220 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#include "fatpath.h"
+
+uint8_t _recent_depth = 0;
+static RecentFolder _recent[RECENT_DEPTH];
+
+#ifdef FAT_PATHS
+static uint8_t _dircache_count = 0;     // records in use
+static uint8_t _dircache_next = 0;      // record replaced next when all are in use
+#endif
+
+/**
+ * @brief Empty the recent stack, after moving to a folder that is not a
+ *        subfolder or the parent of the current folder
+ */
+void recent_reset(void) {
+    _recent_depth = 0;
+}
+
+/**
+ * @brief Push a folder that is left for one of its subfolders; the oldest
+ *        folder is dropped when the stack is full
+ *
+ * @param folder first cluster of the folder that is left
+ * @param page   page shown
+ * @param row    highlighted row
+ */
+void recent_push(uint32_t folder, uint8_t page, uint8_t row) {
+    if(_recent_depth == RECENT_DEPTH) {
+        memmove(&_recent[0], &_recent[1], (RECENT_DEPTH - 1) * sizeof(RecentFolder));
+        _recent_depth--;
+    }
+    RecentFolder* r = &_recent[_recent_depth++];
+    r->folder = folder;
+    r->page = page;
+    r->row = row;
+}
+
+/**
+ * @brief Pop the folder on top of the recent stack
+ *
+ * @return const RecentFolder* folder that was left, NULL when the stack is
+ *         empty
+ */
+const RecentFolder* recent_pop(void) {
+    if(_recent_depth == 0) {
+        return NULL;
+    }
+    return &_recent[--_recent_depth];
+}
+
+#ifdef FAT_PATHS
+/**
+ * @brief Empty the cache of directory entries
+ */
+void dircache_reset(void) {
+    _dircache_count = 0;
+    _dircache_next = 0;
+}
+
+/**
+ * @brief Make a cached entry the active entry
+ *
+ * @param parent first cluster of the folder holding the entry
+ * @param name   DOS base name and extension (8 + 3 bytes)
+ * @return uint8_t 1 when the entry is cached, 0 otherwise
+ */
+static uint8_t dircache_find(uint32_t parent, const char* name) {
+    uint8_t rec[DIRCACHE_SIZE + 4];
+    uint16_t addr = DIRCACHE;
+
+    for(uint8_t i=0; i<_dircache_count; i++, addr += DIRCACHE_RECORD) {
+        if(ram_read_uint32_t(addr + DIRCACHE_PARENT) != parent) {
+            continue;
+        }
+        copy_from_ram(addr, rec, sizeof(rec));
+        if(memcmp(&rec[DIRCACHE_NAME], name, 11) == 0) {
+            memcpy(_base_name, &rec[DIRCACHE_NAME], 8);
+            memcpy(_ext, &rec[DIRCACHE_NAME + 8], 3);
+            _current_attrib = rec[DIRCACHE_ATTRIB];
+            memcpy(&_cluster_current_file, &rec[DIRCACHE_CLUSTER], 4);
+            memcpy(&_filesize_current_file, &rec[DIRCACHE_SIZE], 4);
+            format_sfn_filename();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Store the active entry in the cache
+ *
+ * @param parent  first cluster of the folder holding the entry
+ * @param name    DOS base name and extension (8 + 3 bytes)
+ * @param cluster first cluster of the entry
+ */
+static void dircache_store(uint32_t parent, const char* name, uint32_t cluster) {
+    uint8_t rec[DIRCACHE_SIZE + 4];
+    uint8_t slot;
+
+    memcpy(&rec[DIRCACHE_PARENT], &parent, 4);
+    memcpy(&rec[DIRCACHE_NAME], name, 11);
+    rec[DIRCACHE_ATTRIB] = _current_attrib;
+    memcpy(&rec[DIRCACHE_CLUSTER], &cluster, 4);
+    memcpy(&rec[DIRCACHE_SIZE], &_filesize_current_file, 4);
+
+    if(_dircache_count < DIRCACHE_ENTRIES) {
+        slot = _dircache_count++;
+    } else {
+        slot = _dircache_next;
+        _dircache_next = (slot + 1) & (DIRCACHE_ENTRIES - 1);
+    }
+    copy_to_ram(rec, DIRCACHE + slot * DIRCACHE_RECORD, sizeof(rec));
+}
+
+/**
+ * @brief Find a file or folder by its path, starting at the root folder when
+ *        the path starts with '/' and at the current folder otherwise; the
+ *        components "." and ".." are supported
+ *
+ * @param path     components are DOS 8.3 names separated by '/'
+ * @param cd       whether the path is followed to change the current folder,
+ *                 in which case only a folder resolves
+ * @return uint32_t first cluster of the entry, _root_dir_first_cluster for
+ *         the root folder, or 0 if not found
+ */
+uint32_t resolve_path(const char* path, uint8_t cd) {
+    char name[11];
+    uint32_t cluster = _current_folder_cluster;
+
+    if(*path == '/') {
+        cluster = _root_dir_first_cluster;
+        if(cd) {
+            recent_reset();
+        }
+        while(*path == '/') {
+            path++;
+        }
+    }
+
+    _current_attrib = 0x10;
+    while(*path != 0x00) {
+        if(!(_current_attrib & 0x10)) {
+            cluster = 0; // a file cannot contain further components
+            break;
+        }
+
+        // "." remains in the folder
+        if(path[0] == '.' && (path[1] == 0x00 || path[1] == '/')) {
+            path += path[1] == '/' ? 2 : 1;
+            continue;
+        }
+
+        const uint8_t up = path[0] == '.' && path[1] == '.' && (path[2] == 0x00 || path[2] == '/');
+        if(up) {
+            path += path[2] == '/' ? 3 : 2;
+            if(cluster == _root_dir_first_cluster) {
+                continue; // the root folder is its own parent
+            }
+            if(cd && _recent_depth != 0) {
+                cluster = recent_pop()->folder;
+                continue;
+            }
+            memcpy(name, "..         ", 11);
+        } else {
+            path = path_component(path, name, name + 8);
+        }
+
+        const uint32_t parent = cluster;
+        if(dircache_find(parent, name)) {
+            cluster = _cluster_current_file;
+        } else {
+            cluster = find_file(parent, name, name + 8);
+            if(up) {
+                // ".." of a folder in the root folder holds cluster 0
+                _current_attrib = 0x10;
+                if(cluster == 0) {
+                    cluster = _root_dir_first_cluster;
+                }
+            } else if(cluster == 0) {
+                break;
+            }
+            dircache_store(parent, name, cluster);
+        }
+
+        if(cd && !up && (_current_attrib & 0x10)) {
+            recent_push(parent, 0, 0);
+        }
+    }
+
+    if(cd && !(_current_attrib & 0x10)) {
+        cluster = 0;
+    }
+    if(cd && cluster == 0) {
+        recent_reset(); // the stack no longer leads to the current folder
+    }
+    return cluster;
+}
+#endif // FAT_PATHS
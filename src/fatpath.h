@@ -0,0 +1,122 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FATPATH_H
+#define _FATPATH_H
+
+/*
+ * Paths and recently left folders.
+ *
+ * With FAT_PATHS, resolve_path follows a path such as "/GAMES/PACMAN.CAS",
+ * "ARCADE" or "../DEMOS" from the root or the current folder. Every component
+ * found on the card is kept in a small cache of directory entries at
+ * DIRCACHE, keyed on the cluster of the folder holding it and its DOS 8.3
+ * name, such that following the same components again reads no sectors. A
+ * record holds
+ *
+ *   DIRCACHE_PARENT   first cluster of the folder holding the entry
+ *   DIRCACHE_NAME     DOS base name and extension (8 + 3 bytes)
+ *   DIRCACHE_ATTRIB   attribute byte
+ *   DIRCACHE_CLUSTER  first cluster, _root_dir_first_cluster for ".." of a
+ *                     folder in the root folder
+ *   DIRCACHE_SIZE     size in bytes
+ *
+ * Entries are replaced round robin. The cache only holds entries that exist,
+ * which saving a file cannot change, and is emptied upon mounting and after
+ * a program may have used the external RAM.
+ *
+ * The recent stack holds the folders that were left by entering one of their
+ * folders, together with the page and row shown at that moment. Going up
+ * returns to the folder on top without looking up "..", and EZLAUNCH returns
+ * to the position that was left.
+ */
+
+#include <stdint.h>
+
+#include "fat32.h"
+#include "ram.h"
+
+#define DIRCACHE_PARENT     0
+#define DIRCACHE_NAME       4
+#define DIRCACHE_ATTRIB     15
+#define DIRCACHE_CLUSTER    16
+#define DIRCACHE_SIZE       20
+#define DIRCACHE_RECORD     32      // bytes per record, of which 24 are used
+
+#define RECENT_DEPTH        8       // deeper folders are left by looking up ".."
+
+typedef struct {
+    uint32_t folder;    // first cluster of the folder that was left
+    uint8_t page;       // page shown when it was left (EZLAUNCH)
+    uint8_t row;        // highlighted row on that page (EZLAUNCH)
+} RecentFolder;
+
+extern uint8_t _recent_depth;   // number of folders on the recent stack
+
+/**
+ * @brief Empty the recent stack, after moving to a folder that is not a
+ *        subfolder or the parent of the current folder
+ */
+void recent_reset(void);
+
+/**
+ * @brief Push a folder that is left for one of its subfolders; the oldest
+ *        folder is dropped when the stack is full
+ *
+ * @param folder first cluster of the folder that is left
+ * @param page   page shown
+ * @param row    highlighted row
+ */
+void recent_push(uint32_t folder, uint8_t page, uint8_t row);
+
+/**
+ * @brief Pop the folder on top of the recent stack
+ *
+ * @return const RecentFolder* folder that was left, NULL when the stack is
+ *         empty
+ */
+const RecentFolder* recent_pop(void);
+
+#ifdef FAT_PATHS
+/**
+ * @brief Empty the cache of directory entries
+ */
+void dircache_reset(void);
+
+/**
+ * @brief Find a file or folder by its path, starting at the root folder when
+ *        the path starts with '/' and at the current folder otherwise; the
+ *        components "." and ".." are supported
+ *
+ * The metadata of a file (_current_attrib, _filesize_current_file,
+ * _cluster_current_file, _base_name, _ext and _filename) is set as by
+ * find_file; of a folder, only _current_attrib is guaranteed. When cd is set,
+ * the path is followed as by changing folders: a folder that is entered is
+ * pushed on the recent stack, and ".." pops it instead of looking it up.
+ *
+ * @param path     components are DOS 8.3 names separated by '/'
+ * @param cd       whether the path is followed to change the current folder
+ * @return uint32_t first cluster of the entry, _root_dir_first_cluster for
+ *         the root folder, or 0 if not found
+ */
+uint32_t resolve_path(const char* path, uint8_t cd);
+#endif
+
+#endif // _FATPATH_H
@@ -0,0 +1,141 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "fatsort.h"
+#include "prof.h"
+
+uint8_t _sort_enabled = 0;
+uint16_t _sort_count = 0;
+static uint16_t _sort_top = SORT_TABLE;    // first byte after the records
+static uint8_t _sort_full = 0;             // whether an entry did not fit
+
+// gaps of the Shell sort (Ciura), of which those below the count are used
+static const uint16_t _sort_gaps[] = {1750, 701, 301, 132, 57, 23, 10, 4, 1};
+
+/**
+ * @brief Empty the view before the entries of a folder are added
+ */
+void sort_reset(void) {
+    _sort_count = 0;
+    _sort_top = SORT_TABLE;
+    _sort_full = 0;
+}
+
+/**
+ * @brief Add the active entry (_filename, _base_name, _ext, _current_attrib,
+ *        _filesize_current_file and _cluster_current_file) to the view
+ *
+ * @return uint8_t 1 when the view is full, 0 otherwise
+ */
+uint8_t sort_add(void) {
+    uint8_t rec[SORT_RECORD_MAX];
+    char base[8];
+    char ext[3];
+
+    rec[SORT_ATTRIB] = _current_attrib;
+    memcpy(&rec[SORT_CLUSTER], &_cluster_current_file, 4);
+    memcpy(&rec[SORT_SIZE], &_filesize_current_file, 4);
+    rec[SORT_KEY] = !(_current_attrib & 0x10) ? SORT_CLASS_FILE :
+                    _base_name[0] == '.' ? SORT_CLASS_PARENT : SORT_CLASS_FOLDER;
+    uint8_t len = strlen((char*)_filename) + 1;
+    memcpy(&rec[SORT_KEY + 1], _filename, len);
+    len += SORT_KEY + 1;
+
+    // keep the DOS name when it does not follow from the display name
+    path_component((char*)_filename, base, ext);
+    if(memcmp(base, _base_name, 8) != 0 || memcmp(ext, _ext, 3) != 0) {
+        rec[SORT_ATTRIB] |= SORT_DOSNAME;
+        memcpy(&rec[len], _base_name, 8);
+        memcpy(&rec[len + 8], _ext, 3);
+        len += 11;
+    }
+
+    if(_sort_top + len > SORT_SLOT(_sort_count)) {
+        _sort_full = 1;
+        return 1;
+    }
+    copy_to_ram(rec, _sort_top, len);
+    ram_write_uint16_t(SORT_SLOT(_sort_count), _sort_top);
+    _sort_top += len;
+    _sort_count++;
+    return 0;
+}
+
+/**
+ * @brief Sort the entries added to the view
+ *
+ * A Shell sort of the index: an index slot is only rewritten when its entry
+ * moves, which leaves a folder that is already in order untouched.
+ *
+ * @return uint8_t 1 when the view holds the complete folder, 0 when the
+ *         folder did not fit
+ */
+uint8_t sort_view(void) {
+    if(_sort_full) {
+        return 0;
+    }
+
+    PROF_ENTER(PROF_SORT_VIEW);
+    for(uint8_t k=0; k<sizeof(_sort_gaps) / sizeof(_sort_gaps[0]); k++) {
+        const uint16_t gap = _sort_gaps[k];
+        for(uint16_t i=gap; i<_sort_count; i++) {
+            const uint16_t rec = ram_read_uint16_t(SORT_SLOT(i));
+            uint16_t j = i;
+            while(j >= gap) {
+                const uint16_t prev = ram_read_uint16_t(SORT_SLOT(j - gap));
+                if(ram_keycmp(rec + SORT_KEY, prev + SORT_KEY) >= 0) {
+                    break;
+                }
+                ram_write_uint16_t(SORT_SLOT(j), prev);
+                j -= gap;
+            }
+            if(j != i) {
+                ram_write_uint16_t(SORT_SLOT(j), rec);
+            }
+        }
+    }
+    PROF_EXIT(PROF_SORT_VIEW);
+
+    return 1;
+}
+
+/**
+ * @brief Make an entry of the view the active entry
+ *
+ * @param id       position of the entry in the view, starting at 1
+ * @return uint32_t first cluster of the entry
+ */
+uint32_t sort_entry(uint16_t id) {
+    uint8_t rec[SORT_RECORD_MAX];
+
+    copy_from_ram(ram_read_uint16_t(SORT_SLOT(id - 1)), rec, SORT_RECORD_MAX);
+    _current_attrib = rec[SORT_ATTRIB] & ~SORT_DOSNAME;
+    memcpy(&_cluster_current_file, &rec[SORT_CLUSTER], 4);
+    memcpy(&_filesize_current_file, &rec[SORT_SIZE], 4);
+    strcpy((char*)_filename, (char*)&rec[SORT_KEY + 1]);
+    if(rec[SORT_ATTRIB] & SORT_DOSNAME) {
+        const uint8_t* dos = &rec[SORT_KEY + 2 + strlen((char*)_filename)];
+        memcpy(_base_name, dos, 8);
+        memcpy(_ext, dos + 8, 3);
+    } else {
+        path_component((char*)_filename, _base_name, _ext);
+    }
+    return _cluster_current_file;
+}
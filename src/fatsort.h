@@ -0,0 +1,101 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FATSORT_H
+#define _FATSORT_H
+
+/*
+ * Sorted views of folders (FAT_SORT). When sorting is enabled, the first scan
+ * of a folder stores a compact record of every entry in RAM bank 0, from
+ * SORT_TABLE up to SORT_TABLE_END, and sorts them: the parent folder first,
+ * then the folders and then the files, each by name ignoring case. Listings,
+ * pages and file ids of the folder are served from the view without reading
+ * its directory again.
+ *
+ * Records grow upwards from SORT_TABLE, an index of 16 bit record addresses
+ * grows downwards from SORT_TABLE_END. Only the index is sorted, in place and
+ * using a Shell sort, such that records are never moved and a comparison
+ * only reads the names through the RAM ports (ram_keycmp). A record holds
+ *
+ *   SORT_ATTRIB   attribute byte, with SORT_DOSNAME set when the DOS name
+ *                 follows the key
+ *   SORT_CLUSTER  first cluster
+ *   SORT_SIZE     size in bytes
+ *   SORT_KEY      class (SORT_CLASS_*), display name and a terminating 0x00
+ *
+ * The DOS name of an entry is only stored (8 + 3 bytes) when it cannot be
+ * derived from the display name, as for long file names. The view holds over
+ * 2000 entries with 8.3 names, or about 1200 with long names of 20
+ * characters; a larger folder is listed in its order on disk.
+ */
+
+#include <stdint.h>
+
+#include "fat32.h"
+#include "ram.h"
+
+#define SORT_ATTRIB         0
+#define SORT_CLUSTER        1
+#define SORT_SIZE           5
+#define SORT_KEY            9
+#define SORT_RECORD_MAX     (SORT_KEY + 1 + MAX_LFN_LENGTH + 1 + 11)
+
+#define SORT_DOSNAME        0x80    // unused attribute bit
+
+#define SORT_CLASS_PARENT   0x01    // ".."
+#define SORT_CLASS_FOLDER   0x02
+#define SORT_CLASS_FILE     0x03
+
+// address of the index slot of the ith entry
+#define SORT_SLOT(i)        (SORT_TABLE_END - 2 - ((uint16_t)(i) << 1))
+
+extern uint8_t _sort_enabled;   // whether folders are listed in sorted order
+extern uint16_t _sort_count;    // number of entries in the view
+
+/**
+ * @brief Empty the view before the entries of a folder are added
+ */
+void sort_reset(void);
+
+/**
+ * @brief Add the active entry (_filename, _base_name, _ext, _current_attrib,
+ *        _filesize_current_file and _cluster_current_file) to the view
+ *
+ * @return uint8_t 1 when the view is full, 0 otherwise
+ */
+uint8_t sort_add(void);
+
+/**
+ * @brief Sort the entries added to the view
+ *
+ * @return uint8_t 1 when the view holds the complete folder, 0 when the
+ *         folder did not fit
+ */
+uint8_t sort_view(void);
+
+/**
+ * @brief Make an entry of the view the active entry
+ *
+ * @param id       position of the entry in the view, starting at 1
+ * @return uint32_t first cluster of the entry
+ */
+uint32_t sort_entry(uint16_t id);
+
+#endif // _FATSORT_H
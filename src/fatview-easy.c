@@ -0,0 +1,52 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author(s): Ivo Filot <ivo@ivofilot.nl>                               *
+ *              Dion Olsthoorn <@dionoid>                                 *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "fatview.h"
+#include "fat32.h"
+#include "format.h"
+
+/**
+ * @brief Write an entry of a folder listing on its row of the EZLAUNCH
+ *        screen; the line is formatted straight into video memory
+ *
+ * @param n    row of the entry on the page, starting at 1
+ * @param mode unused
+ * @return uint8_t 0, a page is never quit
+ */
+uint8_t list_entry(uint16_t n, uint8_t mode) {
+    (void)mode;
+    char* p = vidmem + 0x50*(n+DISPLAY_OFFSET) + 3;
+    if(_current_attrib & 0x10) {
+        // directory entry
+        if (_base_name[1] == '.') strcpy((char*)_filename, "(terug)");
+        *p++ = COL_CYAN;
+        p = fmt_pad(p, (char*)_filename, 26);
+        p = fmt_str(p, "  (map)", 7);
+    } else {
+        // file entry
+        *p++ = COL_YELLOW;
+        p = fmt_pad(p, (char*)_filename, 26);
+        *p++ = ' ';
+        p = fmt_u32(p, _filesize_current_file, 6);
+    }
+    *p = 0;
+    return 0;
+}
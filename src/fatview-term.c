@@ -0,0 +1,157 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "fatview.h"
+#include "fat32.h"
+#include "lz.h"
+#include "cad.h"
+#include "format.h"
+#include "progress.h"
+
+#ifdef FAT_LIST
+static uint32_t _list_bytes = 0;    // size of the files listed so far
+#endif
+
+/**
+ * @brief Put "<verb><n> / <total> sectors" in termbuffer
+ *
+ * @param verb  leading text, including its trailing space
+ * @param n     sectors processed
+ * @param total sectors in total
+ */
+void format_sectors(const char* verb, uint16_t n, uint16_t total) {
+    char* p = fmt_str(termbuffer, verb, LINELENGTH);
+    p = fmt_u16(p, n, 0);
+    p = fmt_str(p, " / ", 3);
+    p = fmt_u16(p, total, 0);
+    p = fmt_str(p, " sectors", 8);
+    *p = 0;
+}
+
+/**
+ * @brief Start a progress indicator behind a label on the current line of
+ *        the terminal; the line is replaced when the transfer is done
+ *
+ * @param label leading text, including its trailing space
+ * @param total sectors in total
+ */
+void progress_line(const char* label, uint16_t total) {
+    *fmt_str(termbuffer, label, LINELENGTH) = 0;
+    terminal_redoline();
+    progress_start(&vidmem[_terminal_curline * 0x50 + strlen(label)], total);
+}
+
+#ifdef FAT_LIST
+/**
+ * @brief Print an entry of a folder listing on the terminal, pausing after
+ *        every 16 entries
+ *
+ * @param n    file id of the entry
+ * @param mode 1 to show the metadata of CAS, CAZ and CAD files
+ * @return uint8_t 1 when the listing is quit, 0 otherwise
+ */
+uint8_t list_entry(uint16_t n, uint8_t mode) {
+    char* p = termbuffer;
+
+    if(n == 1) {
+        _list_bytes = 0;
+    }
+    _list_bytes += _filesize_current_file;
+
+    if(_current_attrib & 0x10) { // directory entry
+        *p++ = COL_YELLOW;
+        p = fmt_u16(p, n, 3);
+        *p++ = COL_WHITE;
+        p = fmt_pad(p, (char*)_filename, 24);
+        *p++ = COL_CYAN;
+        p = fmt_str(p, " (dir)", 6);
+    } else {             // file entry
+#ifdef FAT_CASINFO
+        const uint8_t caz = memcmp(_ext, "CAZ", 3) == 0;
+        const uint8_t cad = memcmp(_ext, "CAD", 3) == 0;
+        if(mode == 1 && (caz || cad || memcmp(_ext, "CAS", 3) == 0)) {    // cas file
+            // read from SD card once more and extract CAS data; a
+            // compressed or direct-load file carries the preamble
+            // after its header
+            read_sector_to(calculate_sector_address(_cluster_current_file, 0), SDCACHE1);
+            const uint16_t preamble = caz ? SDCACHE1 + LZ_PREAMBLE :
+                                      cad ? SDCACHE1 + CAD_PREAMBLE : SDCACHE1;
+
+            // grab CAS metadata
+            uint8_t casname[16];
+            uint8_t ext[3];
+            copy_from_ram(preamble + 0x36, casname, 8);
+            copy_from_ram(preamble + 0x47, &casname[8], 8);
+            copy_from_ram(preamble + 0x3E, ext, 3);
+
+            // replace terminating characters (0x00) by spaces (0x20)
+            replace_bytes(casname, 0x00, 0x20, 16);
+            replace_bytes(ext, 0x00, 0x20, 3);
+
+            const uint16_t filesize = ram_read_uint16_t(preamble + 0x32);
+            const uint8_t blocks = ram_read_uint8_t(preamble + 0x4F);
+            *p++ = COL_GREEN;
+            p = fmt_u16(p, n, 3);
+            *p++ = COL_YELLOW;
+            p = fmt_str(p, (char*)casname, 16);
+            *p++ = ' ';
+            p = fmt_str(p, (char*)ext, 3);
+            *p++ = COL_CYAN;
+            p = fmt_u16(p, blocks, 2);
+            *p++ = COL_WHITE;
+            *p++ = caz ? 'z' : cad ? 'd' : ' ';
+            p = fmt_u16(p, filesize, 6);
+        } else
+#endif
+        { // non-cas file or not a cas run
+            *p++ = COL_GREEN;
+            p = fmt_u16(p, n, 3);
+            *p++ = COL_WHITE;
+            p = fmt_pad(p, (char*)_filename, 24);
+            *p++ = COL_YELLOW;
+            p = fmt_u32(p, _filesize_current_file, 6);
+        }
+    }
+    *p = 0;
+    terminal_printtermbuffer();
+
+    if(n % 16 == 0) {
+        print_recall("-- Press key to continue, q to quit --");
+        if(wait_for_key_fixed(3) == 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Close a terminal listing with the number of entries and their size
+ *
+ * @param n number of entries listed
+ */
+void list_summary(uint16_t n) {
+    char* p = fmt_u16(termbuffer, n, 6);
+    p = fmt_str(p, " File(s) ", 9);
+    p = fmt_u32(p, n != 0 ? _list_bytes : 0, 10);
+    p = fmt_str(p, " Bytes", 6);
+    *p = 0;
+    terminal_printtermbuffer();
+}
+#endif // FAT_LIST
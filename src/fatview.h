@@ -0,0 +1,70 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FATVIEW_H
+#define _FATVIEW_H
+
+/*
+ * Presentation of the FAT32 engine. The engine scans a folder, or reads its
+ * sorted view (fatsort.h), and hands every entry to be listed to list_entry,
+ * after its metadata (_filename, _base_name, _ext, _current_attrib,
+ * _filesize_current_file and _cluster_current_file) has been set.
+ * fatview-term.c lists on the terminal of the LAUNCHER, fatview-easy.c on the
+ * pages of EZLAUNCH.
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Present an entry of a folder listing
+ *
+ * @param n    FAT_LIST: file id of the entry; FAT_PAGES: row on the page
+ * @param mode casrun argument of read_folder (FAT_LIST)
+ * @return uint8_t 1 to stop the listing, 0 to continue
+ */
+uint8_t list_entry(uint16_t n, uint8_t mode);
+
+/**
+ * @brief Close a terminal listing with the number of entries and their size
+ *        (FAT_LIST)
+ *
+ * @param n number of entries listed
+ */
+void list_summary(uint16_t n);
+
+/**
+ * @brief Put "<verb><n> / <total> sectors" in termbuffer
+ *
+ * @param verb  leading text, including its trailing space
+ * @param n     sectors processed
+ * @param total sectors in total
+ */
+void format_sectors(const char* verb, uint16_t n, uint16_t total);
+
+/**
+ * @brief Start a progress indicator behind a label on the current line of
+ *        the terminal; the line is replaced when the transfer is done
+ *
+ * @param label leading text, including its trailing space
+ * @param total sectors in total
+ */
+void progress_line(const char* label, uint16_t total);
+
+#endif // _FATVIEW_H
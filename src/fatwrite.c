@@ -0,0 +1,448 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "fatwrite.h"
+#include "freespace.h"
+
+#define FAT_DATE_1980   0x0021  // 1980-01-01, as there is no real-time clock
+
+static uint32_t _fat_buf_lba = FAT_CACHE_INVALID;   // FAT sector in FAT_BUFFER
+static uint8_t _fat_buf_dirty = 0;      // whether FAT_BUFFER has to be written
+static uint8_t _write_error = 0;        // set on any failed read or write
+static uint32_t _alloc_hint = 2;        // where the search for clusters starts
+static uint32_t _alloc_first = 0;       // first cluster of the last allocation
+static uint16_t _alloc_count = 0;       // clusters taken by this write
+static uint32_t _slot_lba = 0;          // sector holding the new directory entry
+static uint16_t _slot_loc = 0;          // ... and its position in SDCACHE0
+
+/**
+ * @brief Write a sector from external RAM using CMD24
+ *
+ * @param lba      sector address
+ * @param ram_addr external memory address of the 512 bytes
+ * @return uint8_t 0 on success
+ */
+uint8_t write_sector_from(uint32_t lba, uint16_t ram_addr) {
+    uint8_t err = 1;
+
+    open_command();
+    if(cmd24(lba) == 0) {
+        send_data_token(SD_TOKEN_SINGLE);
+        err = fast_ram_to_sd_full(ram_addr);
+    }
+    close_command();
+
+    if(err != 0) {
+        sd_errors++;
+    }
+    return err;
+}
+
+/**
+ * @brief Write consecutive sectors from external RAM using CMD25
+ *
+ * @param lba       address of the first sector
+ * @param ram_addr  external memory address of the data
+ * @param nrsectors number of sectors
+ * @return uint8_t 0 on success
+ */
+uint8_t write_sectors_from(uint32_t lba, uint16_t ram_addr, uint16_t nrsectors) {
+    uint8_t err = 1;
+
+    open_command();
+    if(cmd25(lba) == 0) {
+        err = 0;
+        while(nrsectors != 0 && err == 0) {
+            send_data_token(SD_TOKEN_MULTI);
+            err = fast_ram_to_sd_full(ram_addr);
+            ram_addr += 0x200;
+            nrsectors--;
+        }
+        // the stop token is also due after a rejected block
+        err |= stop_write();
+    }
+    close_command();
+
+    if(err != 0) {
+        sd_errors++;
+    }
+    return err;
+}
+
+/**
+ * @brief Write FAT_BUFFER to every copy of the FAT when it has been modified
+ */
+static void fat_flush(void) {
+    if(_fat_buf_dirty) {
+        _fat_buf_dirty = 0;
+        uint32_t lba = _fat_buf_lba;
+        for(uint8_t i=0; i<_number_of_fats; i++) {
+            if(write_sector_from(lba, FAT_BUFFER) != 0) {
+                _write_error = 1;
+            }
+            lba += _sectors_per_fat;
+        }
+    }
+}
+
+/**
+ * @brief Load the FAT sector holding the entry of a cluster in FAT_BUFFER
+ *
+ * @param cluster cluster
+ * @return uint16_t external memory address of the entry, 0 on a read error
+ */
+static uint16_t fat_entry(uint32_t cluster) {
+    const uint32_t lba = fat_sector_of(cluster);
+
+    if(lba != _fat_buf_lba) {
+        fat_flush();
+        if(read_sector_to(lba, FAT_BUFFER) != 0xFE) {
+            _fat_buf_lba = FAT_CACHE_INVALID;
+            _write_error = 1;
+            return 0;
+        }
+        _fat_buf_lba = lba;
+    }
+    return FAT_BUFFER + FAT_ENTRY_OFFSET(cluster);
+}
+
+/**
+ * @brief Read the FAT entry of a cluster; a read error reads as end of chain
+ */
+static uint32_t fat_get(uint32_t cluster) {
+    const uint16_t loc = fat_entry(cluster);
+    return loc != 0 ? ram_read_uint32_t(loc) & FAT_EOC : FAT_EOC;
+}
+
+/**
+ * @brief Set the FAT entry of a cluster, keeping its four reserved bits
+ */
+static void fat_set(uint32_t cluster, uint32_t value) {
+    const uint16_t loc = fat_entry(cluster);
+    if(loc != 0) {
+        ram_write_uint16_t(loc, (uint16_t)value);
+        ram_write_uint16_t(loc + 2, (ram_read_uint16_t(loc + 2) & 0xF000) |
+                                    (uint16_t)(value >> 16));
+        _fat_buf_dirty = 1;
+    }
+}
+
+/**
+ * @brief Release a cluster chain
+ *
+ * @param cluster first cluster of the chain
+ */
+static void free_chain(uint32_t cluster) {
+    while(cluster >= 2 && cluster < 0x0FFFFFF8 && !_write_error) {
+        const uint32_t next = fat_get(cluster);
+        fat_set(cluster, FAT_FREE);
+        _alloc_count--;
+        cluster = next;
+    }
+}
+
+/**
+ * @brief Allocate a cluster chain, starting the search at the next-free hint
+ *
+ * A run of contiguous free clusters is preferred. Only when the partition
+ * holds no such run, the first free clusters after the hint are chained.
+ *
+ * @param n number of clusters
+ * @return uint8_t WRITE_OK with the chain starting at _alloc_first
+ */
+static uint8_t allocate(uint16_t n) {
+    const uint32_t last = _total_clusters + 1;
+    uint32_t c = _alloc_hint;
+    uint32_t k;
+    uint16_t run = 0;
+
+    // once around the partition, and n clusters further for a run that
+    // crosses the hint
+    for(k = _total_clusters + n; k != 0 && !_write_error; k--) {
+        if(c > last) {
+            c = 2;      // a run does not wrap around the end of the FAT
+            run = 0;
+        }
+        if(fat_get(c) == FAT_FREE) {
+            if(++run == n) {
+                break;
+            }
+        } else {
+            run = 0;
+        }
+        c++;
+    }
+
+    if(run == n) {
+        _alloc_first = c - (n - 1);
+        for(c = _alloc_first; run > 1; run--, c++) {
+            fat_set(c, c + 1);
+        }
+        fat_set(c, FAT_EOC);
+        _alloc_count += n;
+    } else {
+        // fragmented: every cluster found is terminated right away, such that
+        // the chain is valid at all times
+        uint32_t prev = 0;
+        run = 0;
+        c = _alloc_hint;
+        for(k = _total_clusters; k != 0 && run != n && !_write_error; k--) {
+            if(c > last) {
+                c = 2;
+            }
+            if(fat_get(c) == FAT_FREE) {
+                fat_set(c, FAT_EOC);
+                if(prev != 0) {
+                    fat_set(prev, c);
+                } else {
+                    _alloc_first = c;
+                }
+                prev = c;
+                run++;
+                _alloc_count++;
+            }
+            c++;
+        }
+        if(run != n) {
+            if(prev != 0) {
+                free_chain(_alloc_first);
+            }
+            return _write_error ? WRITE_IO_ERROR : WRITE_DISK_FULL;
+        }
+        c = prev;
+    }
+
+    _alloc_hint = c + 1 <= last ? c + 1 : 2;
+    return _write_error ? WRITE_IO_ERROR : WRITE_OK;
+}
+
+/**
+ * @brief Read the FSInfo sector to SDCACHE0
+ *
+ * @return uint8_t 1 if it holds valid signatures
+ */
+static uint8_t read_fsinfo(void) {
+    return read_sector(_fsinfo_lba) == 0xFE &&
+           ram_read_uint32_t(SDCACHE0) == FSINFO_LEAD_SIG &&
+           ram_read_uint32_t(SDCACHE0 + FSINFO_STRUCT) == FSINFO_STRUCT_SIG;
+}
+
+/**
+ * @brief Store a 32 bit value in external memory
+ */
+static void ram_write_uint32(uint16_t addr, uint32_t val) {
+    ram_write_uint16_t(addr, (uint16_t)val);
+    ram_write_uint16_t(addr + 2, (uint16_t)(val >> 16));
+}
+
+/**
+ * @brief Find a free entry in the current folder, extending the folder by a
+ *        cluster when it is full, and check that the name is not taken
+ *
+ * @param basename 8 byte base name
+ * @param ext      3 byte extension
+ * @return uint8_t WRITE_OK with the entry at _slot_lba and _slot_loc
+ */
+static uint8_t find_slot(const char* basename, const char* ext) {
+    uint32_t cluster = _current_folder_cluster;
+    uint32_t prev = 0;
+    uint8_t name[11];
+    uint8_t i;
+
+    _slot_lba = 0;
+    while(cluster >= 2 && cluster < 0x0FFFFFF8) {
+        uint32_t lba = calculate_sector_address(cluster, 0);
+        for(i=0; i<_sectors_per_cluster; i++, lba++) {
+            if(read_sector(lba) != 0xFE) {
+                return WRITE_IO_ERROR;
+            }
+            for(uint16_t loc=SDCACHE0; loc<SDCACHE0+16*32; loc+=32) {
+                copy_from_ram(loc, name, 11);
+                if(name[0] == 0x00 || name[0] == 0xE5) {
+                    if(_slot_lba == 0) {
+                        _slot_lba = lba;
+                        _slot_loc = loc;
+                    }
+                    if(name[0] == 0x00) {
+                        return WRITE_OK; // no entries beyond the end marker
+                    }
+                } else if(memcmp(name, basename, 8) == 0 && memcmp(&name[8], ext, 3) == 0 &&
+                          ram_read_uint8_t(loc + 0x0B) != 0x0F) {
+                    return WRITE_EXISTS;
+                }
+            }
+        }
+        prev = cluster;
+        cluster = read_next_cluster(cluster);
+    }
+
+    if(_slot_lba != 0) {
+        return WRITE_OK;
+    }
+
+    // the folder is full: append a cleared cluster
+    const uint8_t res = allocate(1);
+    if(res != WRITE_OK) {
+        return res;
+    }
+    fat_set(prev, _alloc_first);
+    ram_write_uint8_t(SDCACHE0, 0x00);
+    ram_transfer(SDCACHE0, SDCACHE0 + 1, 0x1FF);
+    _slot_lba = calculate_sector_address(_alloc_first, 0);
+    _slot_loc = SDCACHE0;
+    for(i=0; i<_sectors_per_cluster; i++) {
+        if(write_sector_from(_slot_lba + i, SDCACHE0) != 0) {
+            return WRITE_IO_ERROR;
+        }
+    }
+    return WRITE_OK;
+}
+
+/**
+ * @brief Write the data over the allocated chain, using a single CMD25 per
+ *        run of contiguous clusters
+ *
+ * @param bank      external RAM bank holding the data
+ * @param ram_addr  external memory address of the data
+ * @param nrsectors number of sectors
+ * @return uint8_t 0 on success
+ */
+static uint8_t write_chain(uint8_t bank, uint16_t ram_addr, uint16_t nrsectors) {
+    uint32_t cluster = _alloc_first;
+
+    while(nrsectors != 0) {
+        const uint32_t start = cluster;
+        uint16_t run = _sectors_per_cluster;
+        uint32_t next;
+        while((next = fat_get(cluster)) == cluster + 1 && run < nrsectors) {
+            cluster = next;
+            run += _sectors_per_cluster;
+        }
+        if(run > nrsectors) {
+            run = nrsectors;
+        }
+
+        set_ram_bank(bank);
+        const uint8_t err = write_sectors_from(calculate_sector_address(start, 0), ram_addr, run);
+        set_ram_bank(RAM_BANK_CACHE);
+        if(err != 0) {
+            return err;
+        }
+
+        ram_addr += run << 9;
+        nrsectors -= run;
+        cluster = next;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill in the directory entry at _slot_lba and _slot_loc
+ *
+ * @return uint8_t 0 on success
+ */
+static uint8_t write_entry(const char* basename, const char* ext, uint16_t nrbytes) {
+    const uint16_t loc = _slot_loc;
+
+    if(read_sector(_slot_lba) != 0xFE) {
+        return 1;
+    }
+    ram_write_uint8_t(loc, 0x00);
+    ram_transfer(loc, loc + 1, 31);
+    copy_to_ram((uint8_t*)basename, loc, 8);
+    copy_to_ram((uint8_t*)ext, loc + 8, 3);
+    ram_write_uint8_t(loc + 0x0B, 0x20);               // archive
+    ram_write_uint16_t(loc + 0x10, FAT_DATE_1980);     // creation date
+    ram_write_uint16_t(loc + 0x12, FAT_DATE_1980);     // access date
+    ram_write_uint16_t(loc + 0x14, (uint16_t)(_alloc_first >> 16));
+    ram_write_uint16_t(loc + 0x18, FAT_DATE_1980);     // modification date
+    ram_write_uint16_t(loc + 0x1A, (uint16_t)_alloc_first);
+    ram_write_uint16_t(loc + 0x1C, nrbytes);
+    return write_sector_from(_slot_lba, SDCACHE0);
+}
+
+/**
+ * @brief Store a file in the current folder
+ *
+ * @param basename 8 byte base name, padded with spaces
+ * @param ext      3 byte extension
+ * @param bank     external RAM bank holding the data
+ * @param ram_addr external memory address of the data
+ * @param nrbytes  size of the file in bytes, at least 1
+ * @return uint8_t WRITE_OK or one of the WRITE_* errors
+ */
+uint8_t fat_write_file(const char* basename, const char* ext, uint8_t bank,
+                       uint16_t ram_addr, uint16_t nrbytes) {
+    const uint16_t nrsectors = ((nrbytes - 1) >> 9) + 1;
+    const uint16_t nrclusters = (nrsectors + _sectors_per_cluster - 1) >> _cluster_shift;
+    uint8_t res;
+
+    _fat_buf_lba = FAT_CACHE_INVALID;
+    _fat_buf_dirty = 0;
+    _write_error = 0;
+    _alloc_count = 0;
+
+    // start at the next-free hint, unless it is absent or out of range
+    _alloc_hint = 2;
+    if(read_fsinfo()) {
+        const uint32_t hint = ram_read_uint32_t(SDCACHE0 + FSINFO_NEXT_FREE);
+        if(hint >= 2 && hint <= _total_clusters + 1) {
+            _alloc_hint = hint;
+        }
+    }
+
+    res = find_slot(basename, ext);
+    if(res == WRITE_OK) {
+        res = allocate(nrclusters);
+    }
+    if(res == WRITE_OK) {
+        // the chain is on the card before anything refers to it
+        fat_flush();
+        if(_write_error ||
+           write_chain(bank, ram_addr, nrsectors) != 0 ||
+           write_entry(basename, ext, nrbytes) != 0) {
+            _write_error = 0;
+            free_chain(_alloc_first);
+            res = WRITE_IO_ERROR;
+        }
+    }
+    fat_flush();
+
+    if(_alloc_count != 0 && read_fsinfo()) {
+        const uint32_t nfree = ram_read_uint32_t(SDCACHE0 + FSINFO_FREE_COUNT);
+        if(nfree != 0xFFFFFFFF && nfree >= _alloc_count) {
+            ram_write_uint32(SDCACHE0 + FSINFO_FREE_COUNT, nfree - _alloc_count);
+        }
+        ram_write_uint32(SDCACHE0 + FSINFO_NEXT_FREE, _alloc_hint);
+        write_sector_from(_fsinfo_lba, SDCACHE0);
+    }
+    if(_alloc_count != 0) {
+        freespace_allocated(_alloc_count, _alloc_hint);
+    }
+
+    // the FAT and the folder have changed under the caches of the read engine
+    _fat_cache_lba = FAT_CACHE_INVALID;
+    _handle_table_cluster = 0;
+
+    if(res == WRITE_OK && _write_error) {
+        res = WRITE_IO_ERROR;
+    }
+    return res;
+}
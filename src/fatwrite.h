@@ -0,0 +1,91 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FATWRITE_H
+#define _FATWRITE_H
+
+/*
+ * Write engine of the launcher: stores a file from external RAM in the
+ * current folder of the mounted FAT32 partition.
+ *
+ * Clusters are searched from the next-free hint of the FSInfo sector and a
+ * contiguous run is preferred, such that the file can be written with a
+ * single CMD25 and is streamed back without seeking. The FAT is updated
+ * before the data and the directory entry are written, hence an interrupted
+ * write leaves at worst some lost clusters. All routines expect RAM bank 0
+ * to be selected and return with RAM bank 0 selected. The engine is only
+ * linked into launchers built with FAT_WRITE (make WRITE=-DFAT_WRITE).
+ */
+
+#include <stdint.h>
+
+#include "fat32.h"
+#include "ram.h"
+
+#define FAT_BUFFER          SDCACHE1    // FAT sector being modified
+#define FAT_FREE            0x00000000
+#define FAT_EOC             0x0FFFFFFF
+
+#define FSINFO_LEAD_SIG     0x41615252
+#define FSINFO_STRUCT_SIG   0x61417272
+#define FSINFO_TRAIL_SIG    0xAA550000
+#define FSINFO_STRUCT       0x1E4
+#define FSINFO_FREE_COUNT   0x1E8
+#define FSINFO_NEXT_FREE    0x1EC
+#define FSINFO_TRAIL        0x1FC
+
+#define WRITE_OK            0
+#define WRITE_EXISTS        1   // a file or folder with this name exists
+#define WRITE_DISK_FULL     2   // not enough free clusters
+#define WRITE_IO_ERROR      3   // the card rejected a read or a write
+
+/**
+ * @brief Write a sector from external RAM using CMD24
+ *
+ * @param lba      sector address
+ * @param ram_addr external memory address of the 512 bytes
+ * @return uint8_t 0 on success
+ */
+uint8_t write_sector_from(uint32_t lba, uint16_t ram_addr);
+
+/**
+ * @brief Write consecutive sectors from external RAM using CMD25
+ *
+ * @param lba       address of the first sector
+ * @param ram_addr  external memory address of the data
+ * @param nrsectors number of sectors
+ * @return uint8_t 0 on success
+ */
+uint8_t write_sectors_from(uint32_t lba, uint16_t ram_addr, uint16_t nrsectors);
+
+/**
+ * @brief Store a file in the current folder
+ *
+ * @param basename 8 byte base name, padded with spaces
+ * @param ext      3 byte extension
+ * @param bank     external RAM bank holding the data
+ * @param ram_addr external memory address of the data
+ * @param nrbytes  size of the file in bytes
+ * @return uint8_t WRITE_OK or one of the WRITE_* errors
+ */
+uint8_t fat_write_file(const char* basename, const char* ext, uint8_t bank,
+                       uint16_t ram_addr, uint16_t nrbytes);
+
+#endif // _FATWRITE_H
@@ -10,6 +10,8 @@
 #include "terminal.h"
 #include "sst39sf.h"
 #include "flash_utils.h"
+#include "progress.h"
+#include "fatview.h"
 
 uint8_t flash_rom(uint32_t faddr) {
     uint16_t rom_id = sst39sf_get_device_id();
@@ -79,45 +81,26 @@ uint8_t flash_rom(uint32_t faddr) {
  * @return number of sectors stored
  */
 uint8_t store_file_rom(uint32_t faddr, uint16_t rom_addr) {
-    build_linked_list(faddr);
-
-    // count number of clusters
+    // count number of sectors
     uint8_t total_sectors = (_filesize_current_file + 511) / 512;
-
-    uint8_t ctr = 0;    // counter for clusters
     uint8_t scctr = 0;  // counter for sectors
-    while(_linkedlist[ctr] != 0xFFFFFFFF && ctr < 16 && scctr < total_sectors) {
-
-        const uint32_t caddr = calculate_sector_address(_linkedlist[ctr], 0);
-
-        for(uint8_t i=0; i<_sectors_per_cluster; i++) {
-            // directly transfer data to ROM chip
-            open_command();
-            cmd17(caddr + i);
-            fast_sd_to_rom_full(rom_addr);
-            close_command();
 
-            // increment memory pointer
-            rom_addr += 0x200;
+    progress_line("Parsing ", total_sectors);
+    stream_open(faddr, total_sectors);
+    while(stream_next_sector()) {
+        // directly transfer data to ROM chip
+        fast_sd_to_rom_full(rom_addr);
 
-#ifdef FLASH_VERBOSE
-            sprintf(termbuffer, "Parsing %i / %i sectors", 
-                scctr, total_sectors);
-            terminal_redoline();
-#endif
-
-            scctr++;
-            if(scctr == total_sectors) {
-                break;
-            }
-        }
+        // increment memory pointer
+        rom_addr += 0x200;
 
-        ctr++;
+        scctr++;
     }
+    stream_close();
+    progress_stop();
 
 #ifdef FLASH_VERBOSE
-    sprintf(termbuffer, "Done parsing %i / %i sectors", 
-                total_sectors, total_sectors);
+    format_sectors("Done parsing ", total_sectors, total_sectors);
     terminal_printtermbuffer();
 #endif
 
@@ -0,0 +1,153 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#include "format.h"
+
+// powers of ten for the conversion by repeated subtraction, which avoids the
+// long division of the C library
+static const uint32_t _pow10_32[] = {1000000000, 100000000, 10000000, 1000000, 100000, 10000};
+static const uint16_t _pow10_16[] = {10000, 1000, 100, 10};
+
+/**
+ * @brief Append the decimal digits of a 16 bit value, starting at power of
+ *        ten i of _pow10_16; leading zeros are skipped while n is 0
+ *
+ * @return uint8_t number of digits in the buffer
+ */
+static uint8_t digits16(char* digits, uint8_t n, uint16_t val, uint8_t i) {
+    for(; i<4; i++) {
+        char d = '0';
+        while(val >= _pow10_16[i]) {
+            val -= _pow10_16[i];
+            d++;
+        }
+        if(d != '0' || n != 0) {
+            digits[n++] = d;
+        }
+    }
+    digits[n++] = '0' + (uint8_t)val;
+    return n;
+}
+
+/**
+ * @brief Store n digits right-aligned in a field of width characters
+ */
+static char* fmt_field(char* dest, const char* digits, uint8_t n, uint8_t width) {
+    while(width > n) {
+        *dest++ = ' ';
+        width--;
+    }
+    memcpy(dest, digits, n);
+    return dest + n;
+}
+
+/**
+ * @brief Write an unsigned 16 bit value in decimal, right-aligned in a field
+ *        of width characters (as %*u)
+ *
+ * @param dest  destination
+ * @param val   value
+ * @param width minimum number of characters, padded with leading spaces
+ * @return char* position after the last character
+ */
+char* fmt_u16(char* dest, uint16_t val, uint8_t width) {
+    char digits[5];
+    return fmt_field(dest, digits, digits16(digits, 0, val, 0), width);
+}
+
+/**
+ * @brief Write an unsigned 32 bit value in decimal, right-aligned in a field
+ *        of width characters (as %*lu)
+ *
+ * @param dest  destination
+ * @param val   value
+ * @param width minimum number of characters, padded with leading spaces
+ * @return char* position after the last character
+ */
+char* fmt_u32(char* dest, uint32_t val, uint8_t width) {
+    char digits[10];
+    uint8_t n = 0;
+
+    // only the upper digits need 32 bit arithmetic
+    for(uint8_t i=0; i<6; i++) {
+        char d = '0';
+        while(val >= _pow10_32[i]) {
+            val -= _pow10_32[i];
+            d++;
+        }
+        if(d != '0' || n != 0) {
+            digits[n++] = d;
+        }
+    }
+
+    return fmt_field(dest, digits, digits16(digits, n, (uint16_t)val, 1), width);
+}
+
+/**
+ * @brief Write a 16 bit value as four upper case hexadecimal digits (as %04X)
+ *
+ * @param dest destination
+ * @param val  value
+ * @return char* position after the last character
+ */
+char* fmt_hex16(char* dest, uint16_t val) {
+    for(uint8_t i=0; i<4; i++) {
+        const uint8_t nibble = val >> 12;
+        *dest++ = nibble < 10 ? '0' + nibble : 'A' - 10 + nibble;
+        val <<= 4;
+    }
+    return dest;
+}
+
+/**
+ * @brief Copy a string of at most maxlen characters (as %.*s)
+ *
+ * @param dest   destination
+ * @param src    null-terminated string, or a buffer of at least maxlen bytes
+ * @param maxlen maximum number of characters
+ * @return char* position after the last character
+ */
+char* fmt_str(char* dest, const char* src, uint8_t maxlen) {
+    while(maxlen != 0 && *src != 0) {
+        *dest++ = *src++;
+        maxlen--;
+    }
+    return dest;
+}
+
+/**
+ * @brief Copy a string into a field of exactly width characters, truncated
+ *        or padded with trailing spaces (as %-*.*s)
+ *
+ * @param dest  destination
+ * @param src   null-terminated string
+ * @param width number of characters
+ * @return char* position after the last character
+ */
+char* fmt_pad(char* dest, const char* src, uint8_t width) {
+    char* end = dest + width;
+    dest = fmt_str(dest, src, width);
+    while(dest != end) {
+        *dest++ = ' ';
+    }
+    return dest;
+}
@@ -0,0 +1,86 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+/*
+ * Formatting of listing and status lines without sprintf. Every routine
+ * writes to dest, which may point into termbuffer or straight into video
+ * memory, and returns the position after the last character written; the
+ * caller terminates the string when needed. Colour codes are single bytes
+ * and are simply stored with *dest++ = COL_...
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief Write an unsigned 16 bit value in decimal, right-aligned in a field
+ *        of width characters (as %*u)
+ *
+ * @param dest  destination
+ * @param val   value
+ * @param width minimum number of characters, padded with leading spaces
+ * @return char* position after the last character
+ */
+char* fmt_u16(char* dest, uint16_t val, uint8_t width);
+
+/**
+ * @brief Write an unsigned 32 bit value in decimal, right-aligned in a field
+ *        of width characters (as %*lu)
+ *
+ * @param dest  destination
+ * @param val   value
+ * @param width minimum number of characters, padded with leading spaces
+ * @return char* position after the last character
+ */
+char* fmt_u32(char* dest, uint32_t val, uint8_t width);
+
+/**
+ * @brief Write a 16 bit value as four upper case hexadecimal digits (as %04X)
+ *
+ * @param dest destination
+ * @param val  value
+ * @return char* position after the last character
+ */
+char* fmt_hex16(char* dest, uint16_t val);
+
+/**
+ * @brief Copy a string of at most maxlen characters (as %.*s)
+ *
+ * @param dest   destination
+ * @param src    null-terminated string, or a buffer of at least maxlen bytes
+ * @param maxlen maximum number of characters
+ * @return char* position after the last character
+ */
+char* fmt_str(char* dest, const char* src, uint8_t maxlen);
+
+/**
+ * @brief Copy a string into a field of exactly width characters, truncated
+ *        or padded with trailing spaces (as %-*.*s)
+ *
+ * @param dest  destination
+ * @param src   null-terminated string
+ * @param width number of characters
+ * @return char* position after the last character
+ */
+char* fmt_pad(char* dest, const char* src, uint8_t width);
+
+#endif // _FORMAT_H
@@ -0,0 +1,157 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "freespace.h"
+#include "fatwrite.h"
+
+uint32_t _free_clusters = FREE_UNKNOWN;
+uint32_t _free_hint = FREE_UNKNOWN;
+uint8_t _free_source = 0;
+
+static uint32_t _scan_sector;       // next FAT sector to count
+static uint32_t _scan_sectors;      // FAT sectors covering the clusters
+static uint32_t _scan_free;         // free entries counted so far
+static uint8_t _scan_error;         // whether the last read failed
+static uint8_t _fsinfo_valid;       // whether the FSInfo sector can be updated
+
+/**
+ * @brief Read the FSInfo sector to SDCACHE0
+ *
+ * @return uint8_t 1 if it holds valid signatures
+ */
+static uint8_t read_fsinfo(void) {
+    return read_sector(_fsinfo_lba) == 0xFE &&
+           ram_read_uint32_t(SDCACHE0) == FSINFO_LEAD_SIG &&
+           ram_read_uint32_t(SDCACHE0 + FSINFO_STRUCT) == FSINFO_STRUCT_SIG &&
+           ram_read_uint32_t(SDCACHE0 + FSINFO_TRAIL) == FSINFO_TRAIL_SIG;
+}
+
+/**
+ * @brief Take the free cluster count and the next-free hint from the FSInfo
+ *        sector, or prepare a scan of the FAT
+ */
+void freespace_mount(void) {
+    _free_clusters = FREE_UNKNOWN;
+    _free_hint = FREE_UNKNOWN;
+    _free_source = 0;
+    _scan_sector = 0;
+    _scan_free = 0;
+    _scan_error = 0;
+
+    // entries 0 and 1 of the FAT do not refer to clusters
+    _scan_sectors = (_total_clusters + 2 + 127) >> 7;
+    if(_scan_sectors > _sectors_per_fat) {
+        _scan_sectors = _sectors_per_fat;
+    }
+
+    _fsinfo_valid = read_fsinfo();
+    if(_fsinfo_valid) {
+        const uint32_t nfree = ram_read_uint32_t(SDCACHE0 + FSINFO_FREE_COUNT);
+        const uint32_t hint = ram_read_uint32_t(SDCACHE0 + FSINFO_NEXT_FREE);
+        if(hint >= 2 && hint <= _total_clusters + 1) {
+            _free_hint = hint;
+        }
+        if(nfree <= _total_clusters) {
+            _free_clusters = nfree;
+            _free_source = FREE_FSINFO;
+        }
+    }
+}
+
+/**
+ * @brief Count the free entries of the next FAT sectors, until the count is
+ *        known
+ *
+ * @param nrsectors maximum number of FAT sectors to read
+ * @return uint8_t 0 when a sector could not be read, 1 otherwise
+ */
+uint8_t freespace_scan(uint16_t nrsectors) {
+    for(; nrsectors != 0 && _free_clusters == FREE_UNKNOWN; nrsectors--) {
+        if(read_sector(_fat_begin_lba + _scan_sector) != 0xFE) {
+            _scan_error = 1;
+            return 0;
+        }
+        _scan_error = 0;
+        _scan_free += ram_count_free(SDCACHE0);
+        if(++_scan_sector != _scan_sectors) {
+            continue;
+        }
+
+        // the entries after the last cluster are not free clusters
+        for(uint8_t i=(_total_clusters + 2) & 0x7F; i != 0 && i < 128; i++) {
+            if((ram_read_uint32_t(SDCACHE0 + ((uint16_t)i << 2)) & 0x0FFFFFFF) == 0) {
+                _scan_free--;
+            }
+        }
+        _free_clusters = _scan_free;
+        _free_source = FREE_SCAN;
+
+#ifdef FAT_WRITE
+        // keep the count for the next mount
+        if(_fsinfo_valid && read_fsinfo()) {
+            ram_write_uint16_t(SDCACHE0 + FSINFO_FREE_COUNT, (uint16_t)_free_clusters);
+            ram_write_uint16_t(SDCACHE0 + FSINFO_FREE_COUNT + 2, (uint16_t)(_free_clusters >> 16));
+            write_sector_from(_fsinfo_lba, SDCACHE0);
+        }
+#endif
+    }
+    return 1;
+}
+
+/**
+ * @brief Count the free entries of a single FAT sector while the launcher is
+ *        idle, unless the count is known or the last read failed
+ */
+void freespace_idle(void) {
+    if(_free_clusters == FREE_UNKNOWN && !_scan_error) {
+        freespace_scan(1);
+    }
+}
+
+/**
+ * @brief Number of FAT sectors that the scan still has to read
+ *
+ * @return uint16_t number of sectors, at most 0xFFFF
+ */
+uint16_t freespace_remaining(void) {
+    if(_free_clusters != FREE_UNKNOWN) {
+        return 0;
+    }
+    const uint32_t n = _scan_sectors - _scan_sector;
+    return n > 0xFFFF ? 0xFFFF : (uint16_t)n;
+}
+
+#ifdef FAT_WRITE
+/**
+ * @brief Account for clusters allocated by the write engine
+ *
+ * @param nrclusters number of clusters allocated
+ * @param hint       next-free hint after the allocation
+ */
+void freespace_allocated(uint32_t nrclusters, uint32_t hint) {
+    _free_hint = hint;
+    if(_free_clusters != FREE_UNKNOWN) {
+        _free_clusters = _free_clusters >= nrclusters ? _free_clusters - nrclusters : 0;
+    } else {
+        _scan_sector = 0; // the FAT has changed under the scan
+        _scan_free = 0;
+    }
+}
+#endif
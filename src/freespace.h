@@ -0,0 +1,91 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _FREESPACE_H
+#define _FREESPACE_H
+
+/*
+ * Free space of the mounted partition, as reported by df and vol.
+ *
+ * At mount, the free cluster count and the next-free hint are taken from the
+ * FSInfo sector when its signatures are valid and the count does not exceed
+ * the number of clusters. Otherwise the free entries of the FAT are counted,
+ * one sector at a time while the launcher waits for a key, or at once when
+ * the count is asked for. The scan resumes where it stopped, also after a
+ * read error. Its result is kept in memory and, in builds with the write
+ * engine (FAT_WRITE) and a valid FSInfo sector, written to it such that the
+ * next mount finds it there.
+ *
+ * The write engine reports the clusters it allocates, which are subtracted
+ * from a known count; an ongoing scan starts over as the FAT has changed.
+ */
+
+#include <stdint.h>
+
+#include "fat32.h"
+
+#define FREE_UNKNOWN        0xFFFFFFFF
+
+#define FREE_FSINFO         1   // count read from the FSInfo sector
+#define FREE_SCAN           2   // count established by a scan of the FAT
+
+extern uint32_t _free_clusters; // free clusters, FREE_UNKNOWN while not known
+extern uint32_t _free_hint;     // next-free hint, FREE_UNKNOWN when absent
+extern uint8_t _free_source;    // FREE_FSINFO or FREE_SCAN, 0 while not known
+
+/**
+ * @brief Take the free cluster count and the next-free hint from the FSInfo
+ *        sector, or prepare a scan of the FAT
+ */
+void freespace_mount(void);
+
+/**
+ * @brief Count the free entries of the next FAT sectors, until the count is
+ *        known
+ *
+ * @param nrsectors maximum number of FAT sectors to read
+ * @return uint8_t 0 when a sector could not be read, 1 otherwise
+ */
+uint8_t freespace_scan(uint16_t nrsectors);
+
+/**
+ * @brief Count the free entries of a single FAT sector while the launcher is
+ *        idle, unless the count is known or the last read failed
+ */
+void freespace_idle(void);
+
+/**
+ * @brief Number of FAT sectors that the scan still has to read
+ *
+ * @return uint16_t number of sectors, at most 0xFFFF
+ */
+uint16_t freespace_remaining(void);
+
+#ifdef FAT_WRITE
+/**
+ * @brief Account for clusters allocated by the write engine
+ *
+ * @param nrclusters number of clusters allocated
+ * @param hint       next-free hint after the allocation
+ */
+void freespace_allocated(uint32_t nrclusters, uint32_t hint);
+#endif
+
+#endif // _FREESPACE_H
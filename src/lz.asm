@@ -0,0 +1,277 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+SECTION code_user
+
+INCLUDE "ports.inc"
+
+PUBLIC _lz_start
+PUBLIC _lz_read
+PUBLIC _lz_skip
+PUBLIC _lz_decompress_intram
+PUBLIC _lz_decompress_ram
+
+EXTERN _stream_next_sector
+
+LZ_ERROR            EQU $FFFF
+
+;-------------------------------------------------------------------------------
+; Decoder for the compressed stream of CAZ and PRZ containers (see
+; scripts/lzpack.py for the format). Input bytes are clocked straight out of
+; the SD card; at the end of each sector stream_next_sector of the FAT engine
+; is called to position the card at the next one. The number of bytes left in
+; the current sector lives in IX while decoding and in lz_left otherwise.
+;
+; When the stream ends prematurely, the stack pointer is restored to the
+; value at entry and LZ_ERROR is returned to the caller.
+;-------------------------------------------------------------------------------
+
+;-------------------------------------------------------------------------------
+; void lz_start(void) __z88dk_callee;
+;
+; Start reading after stream_next_sector positioned the card at the first
+; sector of the container
+;-------------------------------------------------------------------------------
+_lz_start:
+    ld hl,512
+    ld (lz_left),hl
+    ld a,$FF
+    out (SERIAL),a              ; flush shift register with ones
+    ret
+
+;-------------------------------------------------------------------------------
+; uint16_t lz_read(uint8_t* dest, uint16_t nrbytes) __z88dk_callee;
+;
+; Copy uncompressed bytes from the container to internal RAM
+;
+; output: hl - 0 on success, LZ_ERROR otherwise
+;-------------------------------------------------------------------------------
+_lz_read:
+    pop hl                      ; return address
+    pop de                      ; destination
+    pop bc                      ; number of bytes
+    push hl                     ; put return address back on stack
+    push ix
+    ld (lz_sp),sp
+    ld ix,(lz_left)
+lzrnext:
+    ld a,b
+    or c
+    jr z,lzrdone
+    call getbyte
+    ld (de),a
+    inc de
+    dec bc
+    jr lzrnext
+lzrdone:
+    ld hl,0
+    jp lz_leave
+
+;-------------------------------------------------------------------------------
+; uint16_t lz_skip(uint16_t nrbytes) __z88dk_fastcall;
+;
+; output: hl - 0 on success, LZ_ERROR otherwise
+;-------------------------------------------------------------------------------
+_lz_skip:
+    ld b,h
+    ld c,l
+    push ix
+    ld (lz_sp),sp
+    ld ix,(lz_left)
+lzsnext:
+    ld a,b
+    or c
+    jr z,lzrdone
+    call getbyte
+    dec bc
+    jr lzsnext
+
+;-------------------------------------------------------------------------------
+; uint16_t lz_decompress_intram(uint8_t* dest) __z88dk_fastcall;
+;
+; output: hl - address following the last decompressed byte or LZ_ERROR
+;-------------------------------------------------------------------------------
+_lz_decompress_intram:
+    ex de,hl                    ; de = destination
+    push ix
+    ld (lz_sp),sp
+    ld ix,(lz_left)
+lzinext:
+    call getbyte                ; control byte
+    or a
+    jr z,lzidone
+    jp m,lzimatch
+    ld b,a                      ; number of literals
+lzilit:
+    call getbyte
+    ld (de),a
+    inc de
+    djnz lzilit
+    jr lzinext
+lzimatch:
+    call lz_match               ; hl = source, b = length
+    ld c,b
+    ld b,0
+    ldir                        ; overlapping copies repeat the pattern
+    jr lzinext
+lzidone:
+    ex de,hl
+    jp lz_leave
+
+;-------------------------------------------------------------------------------
+; uint16_t lz_decompress_ram(uint16_t ram_addr) __z88dk_fastcall;
+;
+; Decompress into the active bank of the external RAM
+;
+; output: hl - address following the last decompressed byte or LZ_ERROR
+;-------------------------------------------------------------------------------
+_lz_decompress_ram:
+    ex de,hl                    ; de = destination
+    push ix
+    ld (lz_sp),sp
+    ld ix,(lz_left)
+lzxnext:
+    call getbyte                ; control byte
+    or a
+    jr z,lzidone
+    jp m,lzxmatch
+    ld b,a                      ; number of literals
+lzxlit:
+    call getbyte
+    ld c,ADDR_HIGH
+    out (c),d                   ; set destination address
+    dec c                       ; ADDR_LOW
+    out (c),e
+    out (RAM_IO),a
+    inc de
+    djnz lzxlit
+    jr lzxnext
+lzxmatch:
+    call lz_match               ; hl = source, b = length
+lzxcopy:
+    ld a,h
+    out (ADDR_HIGH),a           ; set source address
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)
+    ld c,ADDR_HIGH
+    out (c),d                   ; set destination address
+    dec c                       ; ADDR_LOW
+    out (c),e
+    out (RAM_IO),a
+    inc hl
+    inc de
+    djnz lzxcopy
+    jr lzxnext
+
+;-------------------------------------------------------------------------------
+; Decode the length and distance of a match
+;
+; input:  a  - control byte
+;         de - destination
+; output: hl - source, b - length
+; garbles: a,c
+;-------------------------------------------------------------------------------
+lz_match:
+    ld c,a
+    call getbyte
+    ld l,a
+    ld h,0
+    bit 6,c
+    jr nz,lzmlong
+    inc hl                      ; short distance is stored minus one
+    ld a,c
+    and $3F
+    add a,2
+    jr lzmsource
+lzmlong:
+    call getbyte
+    ld h,a
+    ld a,c
+    and $3F
+    add a,3
+lzmsource:
+    ld b,a
+    push de
+    ex de,hl                    ; de = distance, hl = destination
+    or a                        ; clear carry
+    sbc hl,de
+    pop de
+    ret
+
+;-------------------------------------------------------------------------------
+; Fetch the next byte of the container
+;
+; output: a - byte
+; garbles: ix (sector byte counter)
+;-------------------------------------------------------------------------------
+getbyte:
+    dec ix
+    ld a,ixh
+    inc a                       ; counter dropped below zero?
+    call z,refill
+    out (CLKSTART),a            ; pulse clock, does not care about value of a
+    in a,(SERIAL)
+    ret
+
+;-------------------------------------------------------------------------------
+; Move on to the next sector
+;-------------------------------------------------------------------------------
+refill:
+    out (CLKSTART),a            ; two more pulses for the checksum
+    out (CLKSTART),a            ; which are ignored
+    push bc
+    push de
+    push hl
+    push iy
+    call _stream_next_sector
+    ld a,l
+    pop iy
+    pop hl
+    pop de
+    pop bc
+    or a
+    jr z,lz_error
+    ld a,$FF
+    out (SERIAL),a              ; flush shift register with ones
+    ld ix,511                   ; the byte about to be read is the first one
+    ret
+
+lz_error:
+    ld sp,(lz_sp)
+    pop ix
+    ld hl,LZ_ERROR
+    ret
+
+lz_leave:
+    ld (lz_left),ix
+    pop ix
+    ret
+
+;-------------------------------------------------------------------------------
+; VARIABLES
+;-------------------------------------------------------------------------------
+
+SECTION bss_user
+
+lz_left:
+    defs 2
+lz_sp:
+    defs 2
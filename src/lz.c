@@ -0,0 +1,82 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+#include "lz.h"
+#include "memory.h"
+#include "ram.h"
+#include "crc16.h"
+#include "trace.h"
+
+/**
+ * @brief Load a CAZ or PRZ container
+ *
+ * @param cluster   first cluster of the file
+ * @param nrsectors number of sectors of the file
+ * @param type      expected container type
+ * @param header    receives the container header
+ * @return uint8_t 0 on success, 1 if the file is invalid or corrupt
+ */
+uint8_t lz_load(uint32_t cluster, uint16_t nrsectors, uint8_t type, LZHEADER* header) {
+    uint16_t end = LZ_ERROR;
+
+    TRACE_BEGIN();
+    stream_open(cluster, nrsectors);
+    if(!stream_next_sector()) {
+        return 1;
+    }
+    lz_start();
+
+    if(lz_read((uint8_t*)header, sizeof(LZHEADER)) != 0 ||
+       header->signature[0] != 'L' || header->signature[1] != 'Z' ||
+       header->type != type || header->length == 0) {
+        stream_close();
+        return 1;
+    }
+
+    if(type == LZ_TYPE_CAS) {
+        // the program may not run into the metadata at 0x8000
+        if(header->length <= 0x8000 && lz_skip(0x100) == 0) {
+            end = lz_decompress_ram(0x0000);
+        }
+    } else {
+        if(header->deploy_addr == PROGRAM_LOCATION && header->length <= 0x3D00) {
+            end = lz_decompress_intram((uint8_t*)PROGRAM_LOCATION);
+        }
+    }
+    stream_close();
+    TRACE_END(TRACE_LOAD_LZ, nrsectors);
+
+    if(end == LZ_ERROR || end - (type == LZ_TYPE_CAS ? 0x0000 : PROGRAM_LOCATION) != header->length) {
+        return 1;
+    }
+
+    if(type == LZ_TYPE_CAS) {
+        if(crc16_extram(0x0000, header->length) != header->crc16) {
+            return 1;
+        }
+        ram_write_uint16_t(0x8000, header->deploy_addr);
+        ram_write_uint16_t(0x8002, header->length);
+    } else if(crc16_intram((uint8_t*)PROGRAM_LOCATION, header->length) != header->crc16) {
+        return 1;
+    }
+
+    return 0;
+}
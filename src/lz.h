@@ -0,0 +1,103 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+#ifndef _LZ_H
+#define _LZ_H
+
+/*
+ * Compressed CAZ and PRZ containers, produced by scripts/lzpack.py. The
+ * container is decompressed while it is streamed from the SD card, using the
+ * sector stream of the FAT engine (stream_open / stream_next_sector).
+ */
+
+#include <stdint.h>
+
+#define LZ_TYPE_CAS     'C'
+#define LZ_TYPE_PRG     'P'
+#define LZ_PREAMBLE     0x10        // offset of the CAS preamble in a CAZ file
+#define LZ_ERROR        0xFFFF
+
+typedef struct {
+    uint8_t signature[2];   // 'L','Z'
+    uint8_t type;           // LZ_TYPE_CAS or LZ_TYPE_PRG
+    uint8_t version;
+    uint16_t deploy_addr;
+    uint16_t length;        // length of the uncompressed data
+    uint16_t crc16;         // CRC-16 of the uncompressed data
+    uint16_t zlength;       // length of the compressed stream
+    uint8_t reserved[4];
+} LZHEADER;
+
+// provided by the FAT engine
+void stream_open(uint32_t cluster, uint16_t nrsectors);
+uint8_t stream_next_sector(void);
+void stream_close(void);
+
+/**
+ * @brief Load a CAZ or PRZ container
+ *
+ * A CAS program is decompressed to the start of the active RAM bank and its
+ * deploy address and length are stored at 0x8000 and 0x8002, as done by
+ * store_cas_ram. A PRG program is decompressed to its deploy address, which
+ * must be PROGRAM_LOCATION.
+ *
+ * @param cluster   first cluster of the file
+ * @param nrsectors number of sectors of the file
+ * @param type      expected container type
+ * @param header    receives the container header
+ * @return uint8_t 0 on success, 1 if the file is invalid or corrupt
+ */
+uint8_t lz_load(uint32_t cluster, uint16_t nrsectors, uint8_t type, LZHEADER* header);
+
+/**
+ * @brief Start reading a container at the first sector of the stream
+ */
+void lz_start(void) __z88dk_callee;
+
+/**
+ * @brief Copy bytes from the container into internal RAM
+ *
+ * @return uint16_t 0 on success, LZ_ERROR otherwise
+ */
+uint16_t lz_read(uint8_t* dest, uint16_t nrbytes) __z88dk_callee;
+
+/**
+ * @brief Skip bytes of the container
+ *
+ * @return uint16_t 0 on success, LZ_ERROR otherwise
+ */
+uint16_t lz_skip(uint16_t nrbytes) __z88dk_fastcall;
+
+/**
+ * @brief Decompress the stream into internal RAM
+ *
+ * @return uint16_t address following the last byte written or LZ_ERROR
+ */
+uint16_t lz_decompress_intram(uint8_t* dest) __z88dk_fastcall;
+
+/**
+ * @brief Decompress the stream into the active bank of the external RAM
+ *
+ * @return uint16_t address following the last byte written or LZ_ERROR
+ */
+uint16_t lz_decompress_ram(uint16_t ram_addr) __z88dk_fastcall;
+
+#endif // _LZ_H
@@ -28,29 +28,33 @@
 #include "ascii.h"
 #include "config.h"
 #include "ports.h"
+#include "trace.h"
+#include "bootcfg.h"
+#include "fatsort.h"
+#include "freespace.h"
+#include "lz.h"
 
 // set printf io
 #pragma printf "%i %X %lX %c %s %lu %u"
 
 // definitions
 void init(void);
+uint8_t boot(void);
+uint8_t boot_load(uint32_t cluster);
 
 void main(void) {
     // initialize environment
     init();
 
-    // check if there is a file called "AUTOBOOT.CAS", if so, immediately
-    // launch this CAS file
-    uint32_t fcl = find_file(_root_dir_first_cluster, "AUTOBOOT", "CAS");
-    if(fcl != 0) {
-        print("Loading AUTOBOOT.CAS...");
-        build_linked_list(fcl);
-        set_ram_bank(RAM_BANK_CASSETTE);
-        store_cas_ram(_linkedlist[0], 0x0000);
-        set_ram_bank(0);
+    // apply P2000T.CFG and boot straight into a program when requested
+    if(boot()) {
         return;
     }
 
+    // insert cursor
+    sprintf(termbuffer, "%c>%c", COL_CYAN, COL_WHITE);
+    terminal_redoline();
+
     // put in infinite loop and wait for user commands
     for(;;) {
         if(keymem[0x0C] > 0) {
@@ -86,6 +90,10 @@ void main(void) {
 
         // add a blinking cursor
         terminal_cursor_blink();
+
+        // count the free clusters while waiting for a key, unless FSInfo
+        // has provided their number
+        freespace_idle();
     }
 }
 
@@ -111,29 +119,177 @@ void init(void) {
 
     // initialize command line
     memset(__input, 0x00, INPUTLENGTH+1);
-    memset(__lastinput, 0x00, INPUTLENGTH);
+    memset(__lastinput, 0x00, INPUTLENGTH+1);
 
     // turn LEDs off
     z80_outp(PORT_LED_IO, 0x00);
 
     // mount sd card
-    if(init_sdcard() != 0) {
+    TRACE_BEGIN();
+    const uint8_t status = init_sdcard();
+    TRACE_STEP(TRACE_SDCARD, status);
+    if(status != 0) {
         print_error("Cannot connect to SD-CARD.");
         for(;;){}
     }
 
     print_recall("Mounting partition 1..");
     uint32_t lba0 = read_mbr();
+    TRACE_STEP(TRACE_MBR, lba0);
     if(lba0 == 0) {
         print_error("Cannot connect to SD-CARD.");
         for(;;){}
     } else {
         read_partition(lba0);
+        freespace_mount();
+        TRACE_END(TRACE_PARTITION, _sectors_per_cluster);
         print("Partition 1 mounted");
         print("System ready.");
+    }
+}
+
+/**
+ * @brief Apply the boot configuration P2000T.CFG of the root folder (see
+ *        bootcfg.h) and boot a program when requested
+ *
+ * The settings are applied in the order of the file; a configured program
+ * is booted after the last line. Without a configuration file, or when it
+ * does not mention AUTOBOOT, the root folder is searched for AUTOBOOT.CAS.
+ *
+ * @return uint8_t 1 when a program has been booted
+ */
+uint8_t boot(void) {
+    char value[BOOTCFG_VALUE];
+    uint8_t settings = 0;
+    uint8_t verbose = 1;
+    uint8_t warm = 0;
+    uint8_t autoboot_set = 0;
+    uint32_t autoboot = 0;
+
+    TRACE_BEGIN();
+    uint32_t fcl = find_file(_root_dir_first_cluster, BOOTCFG_BASENAME, BOOTCFG_EXT);
+    uint8_t res = fcl != 0 ? bootcfg_open(calculate_sector_address(fcl, 0), _filesize_current_file) : 1;
+    if(res == BOOTCFG_TOOLONG) {
+        sprintf(termbuffer, "%cP2000T.CFG too long%c(max %u bytes)", COL_RED, COL_WHITE,
+                BOOTCFG_MAXSIZE);
+        terminal_printtermbuffer();
+    } else if(res == 0) {
+        uint8_t key;
+        while((key = bootcfg_next(value)) != BOOTCFG_END) {
+            settings++;
+            fcl = 0;
+            switch(key) {
+                case BOOTCFG_FOLDER:
+                    fcl = find_path(value);
+                    if(fcl != 0 && (_current_attrib & 0x10)) {
+                        _current_folder_cluster = fcl;
+                    }
+                break;
+                case BOOTCFG_AUTOBOOT:
+                    autoboot_set = 1;
+                    if(value[0] == 0x00) {
+                        continue;
+                    }
+                    fcl = autoboot = find_path(value);
+                break;
+                case BOOTCFG_VERBOSE:
+                    verbose = value[0] != '0';
+                    if(!verbose) {
+                        // remove the start-up lines
+                        for(uint8_t i=_terminal_startline; i<=_terminal_endline; i++) {
+                            memset(&vidmem[0x50*i], 0x00, LINELENGTH);
+                        }
+                        _terminal_curline = _terminal_startline;
+                    }
+                    continue;
+                case BOOTCFG_WARM:
+                    warm = bootcfg_warm(value);
+                    continue;
+                case BOOTCFG_PRELOAD:
+                    fcl = find_path(value);
+                    if(fcl != 0 && boot_load(fcl) == 0) {
+                        _preload_cluster = fcl;
+                    }
+                break;
+                case BOOTCFG_RUN:
+                    if(strlen(value) > INPUTLENGTH) {
+                        sprintf(termbuffer, "%cRUN line too long:%c%.18s", COL_RED, COL_WHITE, value);
+                        terminal_printtermbuffer();
+                        continue;
+                    }
+                    strcpy(__input, value);
+                    execute_command();
+                    continue;
+                case BOOTCFG_SORT:
+                    _sort_enabled = value[0] == '1';
+                    _handle_table_cluster = 0; // listed ids expire
+                    continue;
+                default:
+                    continue;
+            }
 
-        // insert cursor
-        sprintf(termbuffer, "%c>%c", COL_CYAN, COL_WHITE);
-        terminal_redoline();
+            if(fcl == 0) {
+                sprintf(termbuffer, "%cNot found:%c%.28s", COL_RED, COL_WHITE, value);
+                terminal_printtermbuffer();
+            }
+        }
     }
+    TRACE_STEP(TRACE_CONFIG, settings);
+
+    if(warm & BOOTCFG_WARM_FAT) {
+        build_linked_list(_current_folder_cluster);
+    }
+    if(warm & BOOTCFG_WARM_DIR) {
+        read_folder(-1, LIST_QUIET);
+    }
+    if(verbose && settings != 0) {
+        sprintf(termbuffer, "P2000T.CFG: %i settings", settings);
+        terminal_printtermbuffer();
+    }
+
+    // check if there is a file called "AUTOBOOT.CAS", if so, immediately
+    // launch this CAS file
+    if(!autoboot_set) {
+        autoboot = find_file(_root_dir_first_cluster, "AUTOBOOT", "CAS");
+    }
+    TRACE_END(TRACE_AUTOBOOT, autoboot != 0);
+    if(autoboot != 0) {
+        print("Loading autoboot program...");
+        if(boot_load(autoboot) == 0) {
+            return 1;
+        }
+        print_error("Cannot boot program");
+    }
+    return 0;
+}
+
+/**
+ * @brief Load a CAS, CAZ or CAD file into the cassette RAM bank, unless it
+ *        is the program that was preloaded
+ *
+ * @param cluster first cluster of the file, of which the metadata is active
+ * @return uint8_t 0 on success, 1 if the file is not a valid program
+ */
+uint8_t boot_load(uint32_t cluster) {
+    uint8_t result = 0;
+
+    if(cluster == _preload_cluster) {
+        return 0;
+    }
+
+    set_ram_bank(RAM_BANK_CASSETTE);
+    if(memcmp(_ext, "CAZ", 3) == 0) {
+        LZHEADER header;
+        result = lz_load(cluster, (_filesize_current_file + 511) / 512, LZ_TYPE_CAS, &header);
+    } else if(memcmp(_ext, "CAD", 3) == 0) {
+        result = store_cad_ram(cluster);
+    } else if(memcmp(_ext, "CAS", 3) == 0) {
+        result = store_cas_ram(cluster, 0x0000);
+    } else {
+        result = 1;
+    }
+    set_ram_bank(0);
+    _preload_cluster = 0;
+
+    return result;
 }
\ No newline at end of file
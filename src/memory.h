@@ -37,6 +37,10 @@
 #define PROGRAM_LOCATION 0xA000  // where to store custom programs
 #define MAX_BYTES_16K   14966  // maximum bytes free on a 16K P2000T
 
+#define BASIC_TXTTAB    0x625C // pointer to the start of the BASIC program
+#define BASIC_VARTAB    0x6405 // pointer to the end of the BASIC program
+#define BASIC_TOP       0x7000 // the launcher in RAM starts here
+
 extern char* memory;
 extern char* vidmem;
 extern char* keymem;
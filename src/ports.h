@@ -10,5 +10,6 @@
 #define PORT_RAM_BANK   (BASEPORT | 0x0B)
 #define PORT_ROM_IO     (BASEPORT | 0x0C)
 #define PORT_RAM_IO     (BASEPORT | 0x0D)
+#define PORT_PROFILE    (BASEPORT | 0x0F)  // markers of the profiling builds
 
 #endif // _PORTS_H
\ No newline at end of file
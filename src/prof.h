@@ -0,0 +1,55 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _PROF_H
+#define _PROF_H
+
+/*
+ * Profiling markers. In the profiling builds (PROFILING defined) every marker
+ * is a single write to PORT_PROFILE: the id of a function or region of
+ * profile.list on entry, the id with bit 7 set on exit. The writes can be
+ * captured with a logic analyser on the cartridge bus or by p2000t-bench -p
+ * and are turned into a profile by scripts/profile.py.
+ *
+ * A region only needs an entry marker: it is closed by the next entry of the
+ * same region or by the exit of the function around it.
+ */
+
+#ifdef PROFILING
+
+#include "ports.h"
+#include "prof_ids.h"
+
+// a write to an __sfr compiles into ld a,n and out (n),a: 18 T-states
+__sfr __at PORT_PROFILE _prof_port;
+
+#define PROF_ENTER(id)          _prof_port = (id)
+#define PROF_EXIT(id)           _prof_port = 0x80 | (id)
+#define PROF_RETURN(id, val)    do { PROF_EXIT(id); return val; } while(0)
+
+#else
+
+#define PROF_ENTER(id)
+#define PROF_EXIT(id)
+#define PROF_RETURN(id, val)    return val
+
+#endif // PROFILING
+
+#endif // _PROF_H
@@ -0,0 +1,118 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "progress.h"
+#include "format.h"
+#include "memory.h"
+
+static char* _progress_pos = 0;         // 0 when no indicator is active
+static uint16_t _progress_total = 0;
+static uint16_t _progress_remaining = 0;
+static uint16_t _progress_tick = 0;     // tick of the last redraw
+static uint8_t _progress_calls = 0;     // updates since the last redraw
+static uint8_t _progress_cells = 0;     // cells of the bar drawn as full
+
+/**
+ * @brief Read the 20 ms interrupt counter
+ */
+static uint16_t progress_ticks(void) {
+    return *(volatile uint16_t*)&memory[0x6010];
+}
+
+/**
+ * @brief Redraw the characters of the indicator that changed
+ */
+static void progress_draw(void) {
+    const uint16_t current = _progress_total - _progress_remaining;
+    char digits[5];
+    fmt_u16(digits, current, 5);
+    for(uint8_t i=0; i<5; i++) {
+        if(_progress_pos[i] != digits[i]) {
+            _progress_pos[i] = digits[i];
+        }
+    }
+
+    const uint8_t cells = (uint32_t)current * PROGRESS_BAR / _progress_total;
+    while(_progress_cells < cells) {
+        _progress_pos[12 + _progress_cells++] = PROGRESS_FULL;
+    }
+
+    _progress_tick = progress_ticks();
+    _progress_calls = 0;
+}
+
+/**
+ * @brief Draw an indicator for a transfer of total sectors and activate it
+ *
+ * @param pos   position in video memory, PROGRESS_WIDTH characters are used
+ * @param total number of sectors of the transfer
+ */
+void progress_start(char* pos, uint16_t total) {
+    _progress_pos = pos;
+    _progress_total = total ? total : 1;
+    _progress_remaining = total;
+    _progress_cells = 0;
+
+    // "    0/<total> ", padded to the start of the bar
+    char* p = fmt_u16(pos, 0, 5);
+    *p++ = '/';
+    p = fmt_u16(p, total, 1);
+    while(p < pos + 12) {
+        *p++ = ' ';
+    }
+    for(uint8_t i=0; i<PROGRESS_BAR; i++) {
+        *p++ = PROGRESS_EMPTY;
+    }
+
+    _progress_tick = progress_ticks();
+    _progress_calls = 0;
+}
+
+/**
+ * @brief Report the number of sectors that still have to be transferred;
+ *        the indicator is redrawn when sufficient time has passed
+ *
+ * @param remaining number of sectors still to go
+ */
+void progress_update(uint16_t remaining) {
+    if(!_progress_pos) {
+        return;
+    }
+
+    _progress_remaining = remaining;
+
+    // the call limit keeps the indicator going when the interrupt is off
+    if(remaining != 0 && ++_progress_calls < PROGRESS_MAX_CALLS &&
+       (uint16_t)(progress_ticks() - _progress_tick) < PROGRESS_INTERVAL) {
+        return;
+    }
+
+    progress_draw();
+}
+
+/**
+ * @brief Draw the final state of the indicator and deactivate it
+ */
+void progress_stop(void) {
+    if(_progress_pos) {
+        progress_draw();
+        _progress_pos = 0;
+    }
+}
@@ -0,0 +1,67 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _PROGRESS_H
+#define _PROGRESS_H
+
+/*
+ * Progress indicator of long transfers, drawn straight into video memory as
+ * a sector counter followed by a bar:
+ *
+ *     "   12/64 ###........."
+ *
+ * The FAT32 engines call progress_update for every sector they stream, which
+ * is a no-op unless a caller has started an indicator. A redraw is done at
+ * most once per PROGRESS_INTERVAL ticks of the 20 ms interrupt counter and
+ * only rewrites the digits and cells that changed, such that the indicator
+ * costs next to nothing compared to the transfer of a sector.
+ */
+
+#include <stdint.h>
+
+#define PROGRESS_BAR        12  // number of cells of the bar
+#define PROGRESS_WIDTH      (12 + PROGRESS_BAR) // characters on screen
+#define PROGRESS_INTERVAL   5   // ticks (of 20 ms) between redraws
+#define PROGRESS_MAX_CALLS  16  // redraw after this many updates regardless
+#define PROGRESS_FULL       127 // solid block
+#define PROGRESS_EMPTY      '.'
+
+/**
+ * @brief Draw an indicator for a transfer of total sectors and activate it
+ *
+ * @param pos   position in video memory, PROGRESS_WIDTH characters are used
+ * @param total number of sectors of the transfer
+ */
+void progress_start(char* pos, uint16_t total);
+
+/**
+ * @brief Report the number of sectors that still have to be transferred;
+ *        the indicator is redrawn when sufficient time has passed
+ *
+ * @param remaining number of sectors still to go
+ */
+void progress_update(uint16_t remaining);
+
+/**
+ * @brief Draw the final state of the indicator and deactivate it
+ */
+void progress_stop(void);
+
+#endif // _PROGRESS_H
@@ -22,8 +22,13 @@ SECTION code_user
 
 INCLUDE "ports.inc"
 
+IFDEF PROFILING
+INCLUDE "prof_ids.inc"
+ENDIF
+
 PUBLIC _set_ram_address
 PUBLIC _set_ram_bank
+PUBLIC _ram_bank
 
 PUBLIC _ram_read_uint8_t
 PUBLIC _ram_read_uint16_t
@@ -36,6 +41,9 @@ PUBLIC _copy_to_ram
 PUBLIC _copy_from_ram
 PUBLIC _ram_transfer
 
+PUBLIC _ram_keycmp
+PUBLIC _ram_count_free
+
 ;-------------------------------------------------------------------------------
 ; SETTER FUNCTIONS
 ;-------------------------------------------------------------------------------
@@ -56,11 +64,14 @@ _set_ram_address:
 ;-------------------------------------------------------------------------------
 ; void set_ram_bank(uint8_t val) __z88dk_fastcall;
 ;
+; The active bank is kept in _ram_bank as the bank register cannot be read.
+;
 ; input: l - ram bank
 ; garbles: a
 ;-------------------------------------------------------------------------------
 _set_ram_bank:
     ld a,l
+    ld (_ram_bank),a
     out (RAM_BANK),a
     ret
 
@@ -202,6 +213,10 @@ nextto:
 ; uses: all
 ;-------------------------------------------------------------------------------
 _copy_from_ram:
+IFDEF PROFILING
+    ld a,PROF_COPY_FROM_RAM
+    out (PROFILE),a             ; profiling marker: entry
+ENDIF
     ld a,0x01
     out (LED_IO),a              ; turn read LEd on
     pop iy                      ; return address
@@ -224,6 +239,10 @@ nextfrom:
     jr nz,nextfrom
     ld a,0x00
     out (LED_IO),a              ; turn RAM led off
+IFDEF PROFILING
+    ld a,PROF_COPY_FROM_RAM | $80
+    out (PROFILE),a             ; profiling marker: exit
+ENDIF
     ret
 
 ;-------------------------------------------------------------------------------
@@ -262,6 +281,116 @@ transferbyte:
     out (LED_IO),a              ; turn leds off
     ret
 
+;-------------------------------------------------------------------------------
+; COMPARE AND COUNT FUNCTIONS
+;-------------------------------------------------------------------------------
+
+;-------------------------------------------------------------------------------
+; Compare two zero-terminated strings in external RAM; the letters a-z are
+; folded to upper case
+;
+; int8_t ram_keycmp(uint16_t addr1, uint16_t addr2) __z88dk_callee;
+;
+; input:  hl - first string
+;         de - second string
+; return: l  - -1, 0 or 1 when the first string sorts before, equal to or
+;              after the second
+; uses: all
+;-------------------------------------------------------------------------------
+_ram_keycmp:
+    pop iy                      ; return address
+    pop hl                      ; first string
+    pop de                      ; second string
+    push iy                     ; put return address back on stack
+keycmpnext:
+    ld a,d                      ; character of the second string
+    out (ADDR_HIGH),a
+    ld a,e
+    out (ADDR_LOW),a
+    in a,(RAM_IO)
+    cp 'a'
+    jr c,keycmpsecond
+    cp 'z'+1
+    jr nc,keycmpsecond
+    sub 0x20                    ; to upper case
+keycmpsecond:
+    ld c,a
+    ld a,h                      ; character of the first string
+    out (ADDR_HIGH),a
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)
+    cp 'a'
+    jr c,keycmpfirst
+    cp 'z'+1
+    jr nc,keycmpfirst
+    sub 0x20
+keycmpfirst:
+    cp c
+    jr nz,keycmpdiff
+    or a
+    jr z,keycmpdone             ; both strings end here, l = 0
+    inc de
+    inc hl
+    jp keycmpnext
+keycmpdiff:
+    ld l,1
+    ret nc                      ; first string sorts after the second
+    ld l,0xFF
+    ret
+keycmpdone:
+    ld l,a
+    ret
+
+;-------------------------------------------------------------------------------
+; Count the free entries of a FAT sector in external RAM, being those of which
+; the lower 28 bits are zero
+;
+; uint8_t ram_count_free(uint16_t addr) __z88dk_fastcall;
+;
+; The four bytes of an entry share the upper byte of their address, hence
+; only the lower byte is set for the second to the fourth byte.
+;
+; input:  hl - address of the sector, a multiple of 4
+; return: l  - number of free entries (0-128)
+; uses: all
+;-------------------------------------------------------------------------------
+_ram_count_free:
+    ld c,0                      ; free entries
+    ld b,128                    ; entries per sector
+countfreenext:
+    ld a,h
+    out (ADDR_HIGH),a
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)               ; first byte
+    ld e,a
+    inc l
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)               ; second byte
+    or e
+    ld e,a
+    inc l
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)               ; third byte
+    or e
+    ld e,a
+    inc l
+    ld a,l
+    out (ADDR_LOW),a
+    in a,(RAM_IO)               ; fourth byte, of which the upper bits are reserved
+    and 0x0F
+    or e
+    jr nz,countfreeused
+    inc c
+countfreeused:
+    inc hl
+    djnz countfreenext
+    ld l,c
+    ret
+
 ;-------------------------------------------------------------------------------
 ; AUXILIARY ROUNTINES
 ;-------------------------------------------------------------------------------
@@ -278,4 +407,13 @@ ram_ptr_hl_ret_a:
     ld a,l
     out (ADDR_LOW),a            ; set lower byte address
     in a,(RAM_IO)
-    ret
\ No newline at end of file
+    ret
+
+;-------------------------------------------------------------------------------
+; VARIABLES
+;-------------------------------------------------------------------------------
+
+SECTION bss_user
+
+_ram_bank:
+    defs 1
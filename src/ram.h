@@ -30,12 +30,19 @@
 #define SDCACHE1 0x0200
 #define SDCACHE2 0x0400
 #define SDCACHE3 0x0600
-#define SDCACHE4 0x0800
+#define SDCACHE4 0x0800         // SDCACHE4-7: file handle buffers (fatfile.h)
 #define SDCACHE5 0x0A00
 #define SDCACHE6 0x0C00
 #define SDCACHE7 0x0E00
+#define DIRCACHE SDCACHE2        // SDCACHE2-3: path lookups of the LAUNCHER (fatpath.h)
+#define DIRCACHE_ENTRIES 32      // 32 bytes per entry, a power of two
 
 #define VIDMEM_CACHE 0x1000      // video memory address
+#define HANDLE_TABLE 0x2000      // directory entries of the last folder listing
+#define HANDLE_TABLE_ENTRIES 1024 // 32 bytes per entry (0x2000 - 0x9FFF)
+#define SORT_TABLE 0x2000        // sorted view of a folder (fatsort.h), replaces the handle table
+#define SORT_TABLE_END 0xF580    // up to the trace buffers (trace.h)
+#define FATCACHE 0xFE00          // last FAT sector read (in either bank)
 
 /*
  * The internal memory on the SD-card cartridge has a capacity of 128kb divided
@@ -45,6 +52,8 @@
 #define RAM_BANK_CACHE          0
 #define RAM_BANK_CASSETTE       1
 
+extern uint8_t ram_bank; // currently active ram bank
+
 //------------------------------------------------------------------------------
 // SETTER FUNCTIONS
 //------------------------------------------------------------------------------
@@ -148,4 +157,32 @@ void copy_from_ram(uint16_t src, uint8_t *dest, uint16_t nrbytes) __z88dk_callee
  */
 void ram_transfer(uint16_t src, uint16_t dest, uint16_t nrbytes) __z88dk_callee;
 
+//------------------------------------------------------------------------------
+// COMPARE AND COUNT FUNCTIONS
+//------------------------------------------------------------------------------
+
+/**
+ * @brief Compare two zero-terminated strings in external RAM, ignoring the
+ *        case of the letters a-z
+ *
+ * See: ram.asm
+ *
+ * @param addr1    external address of the first string
+ * @param addr2    external address of the second string
+ * @return int8_t  negative, zero or positive when the first string sorts
+ *                 before, equal to or after the second
+ */
+int8_t ram_keycmp(uint16_t addr1, uint16_t addr2) __z88dk_callee;
+
+/**
+ * @brief Count the free entries of a FAT sector in external RAM, of which the
+ *        lower 28 bits are zero
+ *
+ * See: ram.asm
+ *
+ * @param addr external memory address of the sector, a multiple of 4
+ * @return uint8_t number of free entries (0-128)
+ */
+uint8_t ram_count_free(uint16_t addr) __z88dk_fastcall;
+
 #endif // _RAM_H
\ No newline at end of file
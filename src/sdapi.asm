@@ -0,0 +1,64 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+SECTION code_user
+
+PUBLIC _sdapi_install
+
+EXTERN _sdapi_version
+EXTERN _sdapi_open
+EXTERN _sdapi_size
+EXTERN _sdapi_seek
+EXTERN _sdapi_read
+EXTERN _sdapi_read_sectors
+EXTERN _sdapi_read_sectors_ram
+
+;-------------------------------------------------------------------------------
+; The jump table is copied into the free part of system RAM that is also used
+; by the relocated CAS launcher (see launch_cas.asm); the two are never active
+; at the same time. PRG programs find the table at a fixed address and verify
+; its presence by means of the 'SD' signature. The layout of the table is
+; mirrored in basicmod/demo/sdapi.asm; entries may only be appended.
+;-------------------------------------------------------------------------------
+SDAPI_TABLE:        EQU $6160
+
+;-------------------------------------------------------------------------------
+; void sdapi_install(void) __z88dk_callee;
+;
+; garbles: bc,de,hl
+;-------------------------------------------------------------------------------
+_sdapi_install:
+    ld hl,sdapi_table
+    ld de,SDAPI_TABLE
+    ld bc,sdapi_table_end - sdapi_table
+    ldir
+    ret
+
+sdapi_table:
+    DB 'S','D'                          ; $6160 signature
+    jp _sdapi_version                   ; $6162
+    jp _sdapi_open                      ; $6165
+    jp _sdapi_size                      ; $6168
+    jp _sdapi_seek                      ; $616B
+    jp _sdapi_read                      ; $616E
+    jp _sdapi_read_sectors              ; $6171
+    jp _sdapi_read_sectors_ram          ; $6174
+sdapi_table_end:
+    ASSERT (sdapi_table_end - sdapi_table) <= ($6200 - SDAPI_TABLE), "Error: SD API jump table too large!"
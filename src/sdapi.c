@@ -0,0 +1,201 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include "sdapi.h"
+
+// handle of the file opened by the program, -1 if none
+static int8_t _sdapi_fh = -1;
+
+/**
+ * @brief Continue byte reads after the last sector read, capped by the end of
+ *        file
+ */
+static void sdapi_seek_sector(uint16_t sector) {
+    FILEHANDLE* f = &_file_handles[_sdapi_fh];
+
+    f->pos = (uint32_t)sector << 9;
+    if(f->pos > f->filesize) {
+        f->pos = f->filesize;
+    }
+}
+
+/**
+ * @brief Return the version of the API
+ *
+ * @return uint8_t API version
+ */
+uint8_t sdapi_version(void) {
+    return SDAPI_VERSION;
+}
+
+/**
+ * @brief Open a file in the current folder
+ *
+ * @param filename DOS 8.3 filename, e.g. "LEVEL1.DAT"
+ * @return uint8_t 0 on success, 1 if the file could not be found or is larger
+ *         than 32 MiB - 512 bytes
+ */
+uint8_t sdapi_open(const char* filename) {
+    char basename[8];
+    char ext[3];
+    char* dest = basename;
+    uint8_t space = 8;
+
+    // convert the filename to a space-padded and uppercased 8.3 name
+    memset(basename, ' ', 8);
+    memset(ext, ' ', 3);
+    for(; *filename != 0; filename++) {
+        if(*filename == '.') {
+            dest = ext;
+            space = 3;
+        } else if(space != 0) {
+            *dest++ = (*filename >= 'a' && *filename <= 'z') ? *filename - 0x20 : *filename;
+            space--;
+        }
+    }
+
+    set_ram_bank(RAM_BANK_CACHE);
+    sdapi_release();
+    const uint32_t cluster = find_file(_current_folder_cluster, basename, ext);
+    if(cluster == 0 || (_current_attrib & 0x10)) {
+        return 1;
+    }
+
+    _sdapi_fh = file_open(cluster, _filesize_current_file);
+    if(_sdapi_fh < 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Return the size of the opened file
+ *
+ * @return uint32_t file size in bytes
+ */
+uint32_t sdapi_size(void) {
+    return _sdapi_fh < 0 ? 0 : _file_handles[_sdapi_fh].filesize;
+}
+
+/**
+ * @brief Set the read position of the opened file
+ *
+ * @param offset byte offset from the start of the file
+ * @return uint8_t 0 on success, 1 if the offset lies beyond the end of file
+ */
+uint8_t sdapi_seek(uint32_t offset) {
+    return _sdapi_fh < 0 ? 1 : file_seek(_sdapi_fh, offset);
+}
+
+/**
+ * @brief Read bytes from the current position into internal RAM
+ *
+ * @param dest    internal RAM address
+ * @param nrbytes number of bytes to read
+ * @return uint16_t number of bytes read
+ */
+uint16_t sdapi_read(uint8_t* dest, uint16_t nrbytes) {
+    if(_sdapi_fh < 0) {
+        return 0;
+    }
+
+    set_ram_bank(RAM_BANK_CACHE);
+    return file_read(_sdapi_fh, dest, nrbytes);
+}
+
+/**
+ * @brief Read whole 512-byte sectors of the file into internal RAM
+ *
+ * @param sector first sector (relative to the start of the file)
+ * @param count  number of sectors
+ * @param dest   internal RAM address
+ * @return uint8_t number of sectors read
+ */
+uint8_t sdapi_read_sectors(uint16_t sector, uint8_t count, uint8_t* dest) {
+    uint8_t i = 0;
+
+    if(_sdapi_fh < 0) {
+        return 0;
+    }
+
+    set_ram_bank(RAM_BANK_CACHE);
+    count = file_sectors_left(_sdapi_fh, sector, count);
+    for(i=0; i<count; i++) {
+        const uint32_t addr = file_sector_address(_sdapi_fh, sector + i);
+        if(addr == FILE_NO_ADDRESS || read_sector_intram(addr, (uint16_t)dest) != 0xFE) {
+            break;
+        }
+        dest += 0x200;
+    }
+
+    sdapi_seek_sector(sector + i);
+
+    return i;
+}
+
+/**
+ * @brief Read whole 512-byte sectors of the file into RAM bank 1 of the
+ *        cartridge
+ *
+ * @param sector   first sector (relative to the start of the file)
+ * @param count    number of sectors
+ * @param ram_addr external RAM address
+ * @return uint8_t number of sectors read
+ */
+uint8_t sdapi_read_sectors_ram(uint16_t sector, uint8_t count, uint16_t ram_addr) {
+    uint8_t i = 0;
+    uint8_t res = 0;
+
+    if(_sdapi_fh < 0) {
+        return 0;
+    }
+
+    set_ram_bank(RAM_BANK_CACHE);
+    count = file_sectors_left(_sdapi_fh, sector, count);
+    for(i=0; i<count; i++) {
+        // the FAT is cached in bank 0, the data goes to bank 1
+        const uint32_t addr = file_sector_address(_sdapi_fh, sector + i);
+        if(addr == FILE_NO_ADDRESS) {
+            break;
+        }
+        set_ram_bank(RAM_BANK_CASSETTE);
+        res = read_sector_to(addr, ram_addr);
+        set_ram_bank(RAM_BANK_CACHE);
+        if(res != 0xFE) {
+            break;
+        }
+        ram_addr += 0x200;
+    }
+
+    sdapi_seek_sector(sector + i);
+
+    return i;
+}
+
+/**
+ * @brief Release the file handle held on behalf of the program
+ */
+void sdapi_release(void) {
+    if(_sdapi_fh >= 0) {
+        file_close(_sdapi_fh);
+        _sdapi_fh = -1;
+    }
+}
@@ -22,16 +22,32 @@ SECTION code_user
 
 INCLUDE "ports.inc"
 
+IFDEF PROFILING
+INCLUDE "prof_ids.inc"
+ENDIF
+
 SDCACHE0        EQU  $0000
 SDCACHE1        EQU  $0200
 SDCACHE2        EQU  $0400
-TIMEOUT_READ    EQU  4000
 TIMEOUT_WRITE   EQU  10000
+SD_RETRIES      EQU  3          ; see sdcard.h
+
+EXTERN _sd_verify
+EXTERN _sd_retries
+EXTERN _sd_errors
+EXTERN _sd_byte_addressing
+EXTERN _sd_read_timeout
+EXTERN _sd_token_left
 
 PUBLIC _sdpulse
 PUBLIC _cmd0
 PUBLIC _cmd8
+PUBLIC _cmd9
+PUBLIC _cmd10
+PUBLIC _cmd12
+PUBLIC _cmd16
 PUBLIC _cmd17
+PUBLIC _cmd18
 PUBLIC _cmd24
 PUBLIC _cmd55
 PUBLIC _cmd58
@@ -42,13 +58,17 @@ PUBLIC _open_command
 PUBLIC _close_command
 
 PUBLIC _fast_sd_to_intram_full
+PUBLIC _fast_sd_to_ram_full
 PUBLIC _read_sector_to
+PUBLIC _wait_data_token
 
 PUBLIC _sdout_set
 PUBLIC _sdout_reset
 PUBLIC _sdcs_set
 PUBLIC _sdcs_reset
 
+PUBLIC sd_send_command_and_address
+
 ;-------------------------------------------------------------------------------
 ; SD card command bytes
 ;-------------------------------------------------------------------------------
@@ -57,8 +77,20 @@ defb 0 |0x40,0x00,0x00,0x00,0x00,0x94|0x01
 
 cmd8str:
 defb 8 |0x40,0x00,0x00,0x01,0xaa,0x86|0x01
+
+cmd9str:
+defb 9 |0x40,0x00,0x00,0x00,0x00,0x00|0x01
+
+cmd10str:
+defb 10|0x40,0x00,0x00,0x00,0x00,0x00|0x01
+
+cmd12str:
+defb 12|0x40,0x00,0x00,0x00,0x00,0x00|0x01
 ;                      VHS  CHK  CRC
 
+cmd16str:
+defb 16|0x40,0x00,0x00,0x02,0x00,0x00|0x01
+
 cmd55str:
 defb 55|0x40,0x00,0x00,0x00,0x00,0x00|0x01
 
@@ -103,13 +135,84 @@ _cmd8:
     call receiveR7              ; garbles a,b,de
     ret
 
+;-------------------------------------------------------------------------------
+; CMD9: Read the CSD register
+;
+; uint8_t cmd9(uint8_t *reg);
+;
+; input: hl - pointer to a 16 byte buffer
+; garbles: a,bc,de,hl
+; result: data token in l (0xFE on success)
+;-------------------------------------------------------------------------------
+_cmd9:
+    ex de,hl
+    ld hl,cmd9str
+    jr readregister
+
+;-------------------------------------------------------------------------------
+; CMD10: Read the CID register
+;
+; uint8_t cmd10(uint8_t *reg);
+;
+; input: hl - pointer to a 16 byte buffer
+; garbles: a,bc,de,hl
+; result: data token in l (0xFE on success)
+;-------------------------------------------------------------------------------
+_cmd10:
+    ex de,hl
+    ld hl,cmd10str
+
+;-------------------------------------------------------------------------------
+; Send a register command and store the 16 byte data block that it answers
+;
+; input: hl - command list, de - pointer to a 16 byte buffer
+; garbles: a,bc,de,hl
+; result: data token in l (0xFE on success)
+;-------------------------------------------------------------------------------
+readregister:
+    push de
+    call sendcommand            ; garbles a,b,hl
+    call _receive_R1
+    call _wait_data_token       ; garbles a,bc
+    pop de
+    ld a,l
+    cp 0xFE
+    ret nz
+    ld b,16                     ; size of the register
+regnext:
+    out (CLKSTART),a            ; send out
+    in a,(SERIAL)
+    ld (de),a
+    inc de
+    djnz regnext
+    out (CLKSTART),a            ; two more pulses for the checksum
+    out (CLKSTART),a            ; which are ignored
+    ret
+
 ;-------------------------------------------------------------------------------
 ; Send command and address to the SD card
 ;
+; Standard capacity cards (_sd_byte_addressing set) are addressed in bytes
+; rather than in 512-byte blocks.
+;
 ; a contains the command byte
 ; dehl contains the address to send
+; garbles: a,c,dehl
 ;-------------------------------------------------------------------------------
 sd_send_command_and_address:
+    ld c,a
+    ld a,(_sd_byte_addressing)
+    or a
+    jr z,sdaddress
+    ld d,e                      ; dehl = dehl << 9
+    ld e,h
+    ld h,l
+    ld l,0
+    sla h
+    rl e
+    rl d
+sdaddress:
+    ld a,c
     out (SERIAL),a              ; a contains the command byte
     out (CLKSTART),a            ; send out
 
@@ -134,21 +237,96 @@ sd_send_command_and_address:
     out (CLKSTART),a            ; send out
     ret
 
+;-------------------------------------------------------------------------------
+; CMD12: Stop transmission of a multiple block read
+;
+; void cmd12(void);
+;
+; The card answers after a stuff byte and holds the line low while busy.
+;
+; garbles: a,b,c,hl
+;-------------------------------------------------------------------------------
+_cmd12:
+    ld hl,cmd12str
+    call sendcommand
+    ld a,0xFF                   ; flush with ones
+    out (SERIAL),a
+    out (CLKSTART),a            ; skip stuff byte
+    ld b,8                      ; R1 arrives within 8 bytes
+cmd12r1:
+    out (CLKSTART),a            ; send out
+    in a,(SERIAL)
+    bit 7,a                     ; R1 has its upper bit cleared
+    jr z,cmd12busy
+    djnz cmd12r1
+cmd12busy:
+    ld bc,TIMEOUT_WRITE         ; set timeout timer
+cmd12next:
+    out (CLKSTART),a            ; send out
+    in a,(SERIAL)
+    cp 0xFF                     ; card is ready when the line is released
+    ret z
+    dec bc
+    ld a,b
+    or c
+    jr nz,cmd12next
+    ret
+
+;-------------------------------------------------------------------------------
+; CMD16: Set the block length to 512 bytes, for standard capacity cards
+;
+; garbles: a,b,hl
+; result of R1 is stored in l
+;-------------------------------------------------------------------------------
+_cmd16:
+    ld hl,cmd16str
+    call sendr1
+    ret
+
+;-------------------------------------------------------------------------------
+; CMD18: Read multiple blocks, terminated by CMD12
+;
+; uint8_t cmd18(uint32_t addr);
+;
+; garbles: a,bc,de,hl,iy
+; result: data token of the first block in l (0xFE on success)
+;-------------------------------------------------------------------------------
+_cmd18:
+    ld a,18|0x40
+    call sd_send_command_and_address
+    call _receive_R1
+    jr _wait_data_token
+
 ;-------------------------------------------------------------------------------
 ; CMD17: Read block
 ;
 ; uint8_t cmd17(uint32_t addr);
 ;
-; garbles: a,b,de,hl,iy
+; garbles: a,bc,de,hl,iy
 ; result of R1 is stored in l
 ;-------------------------------------------------------------------------------
 _cmd17:
     ld a,17|0x40
     call sd_send_command_and_address
     call _receive_R1
+
+;-------------------------------------------------------------------------------
+; Wait for the data token that precedes a block; used for every block after
+; the first one of a multiple block read
+;
+; uint8_t wait_data_token(void);
+;
+; The number of polls is limited to _sd_read_timeout; the polls that were
+; left are stored in _sd_token_left, from which the probe of the card derives
+; its read latency.
+;
+; garbles: a,bc
+; result: 0xFE in l on success, 0xFF on timeout
+;-------------------------------------------------------------------------------
+_wait_data_token:
     ld a,0xFF                   ; flush with ones
     out (SERIAL),a
-    ld bc,TIMEOUT_READ          ; set timeout timer
+    ld bc,(_sd_read_timeout)    ; set timeout timer
 cmd17next:
     dec bc
     ld a,b
@@ -159,6 +337,7 @@ cmd17next:
     cp 0xFE                     ; wait for 0xFE to be received
     jr nz,cmd17next
     ld l,a
+    ld (_sd_token_left),bc
     ret
 cmd17timeout:
     ld l,0xFF
@@ -169,7 +348,7 @@ cmd17timeout:
 ;
 ; void cmd24(uint32_t addr);
 ;
-; garbles: a,b,de,hl,iy
+; garbles: a,bc,de,hl,iy
 ; result of R1 is stored in l
 ;-------------------------------------------------------------------------------
 _cmd24:
@@ -283,10 +462,13 @@ recvbyte:
 ; void read_block(void);
 ;
 ; Input: DE - external RAM address
-; Garbles: a,b,c
-; Output: None
+; Garbles: a,b,c,hl
+; Output: L - 0 and z flag set when the block is intact or not verified
 ;-------------------------------------------------------------------------------
 read_block:
+    ld a,(_sd_verify)
+    or a
+    jr nz,read_block_crc
     ld a,0x02
     out (LED_IO),a              ; turn write led on
     ld a,$FF
@@ -308,52 +490,179 @@ blocknext:
     jp nz, blockouter
     out (CLKSTART),a            ; two more pulses for the checksum
     out (CLKSTART),a            ; which are ignored
-    ld a,0x00
+    xor a
     out (LED_IO),a              ; turn write led off
+    ld l,a
+    ret
+
+;-------------------------------------------------------------------------------
+; Read block from SD card and verify its checksum
+;
+; The CRC-16 (CCITT) of the data is accumulated in hl while the bytes are
+; clocked in and compared with the two checksum bytes that follow the block.
+;
+; Input: DE - external RAM address
+; Garbles: a,b,c,hl
+; Output: L - 0 and z flag set when the checksum matches
+;-------------------------------------------------------------------------------
+read_block_crc:
+    ld a,0x02
+    out (LED_IO),a              ; turn write led on
+    push ix                     ; frame pointer of the C caller
+    ld hl,0                     ; checksum
+    ld a,$FF
+    out (SERIAL),a              ; flush shift register with ones
+    ld ixh,2                    ; number of outer loops
+crcblockouter:
+    ld b,0                      ; 256 iterations for inner loop
+crcblocknext:
+    ld a,d
+    out (ADDR_HIGH),a           ; set high byte
+    ld a,e
+    out (ADDR_LOW),a            ; set low byte
+    out (CLKSTART),a            ; pulse clock, does not care about value of a
+    in a, (SERIAL)              ; read value
+    out (RAM_IO),a              ; write to RAM
+    inc de                      ; increment RAM pointer
+    xor h                       ; crc = crc << 8 ^ table(crc >> 8 ^ byte),
+    ld c,a                      ; the table computed inline from
+    rrca                        ; x = crc >> 8 ^ byte, x ^= x >> 4:
+    rrca                        ; crc = crc << 8 ^ x << 12 ^ x << 5 ^ x
+    rrca
+    rrca
+    and $0F
+    xor c
+    ld c,a                      ; c = x
+    rrca
+    rrca
+    rrca                        ; a = x rotated left by 5
+    ld h,a
+    and $E0
+    xor c
+    ld c,a                      ; c = low byte
+    ld a,h
+    and $1F                     ; x >> 3
+    xor l
+    ld l,a
+    ld a,h
+    rrca                        ; x rotated left by 4
+    and $F0
+    xor l
+    ld h,a                      ; high byte
+    ld l,c
+    djnz crcblocknext
+    dec ixh
+    jp nz, crcblockouter
+    pop ix
+
+;-------------------------------------------------------------------------------
+; Compare the checksum in hl with the two checksum bytes of the block
+;
+; Garbles: a,hl
+; Output: L - 0 and z flag set when the checksum matches
+;-------------------------------------------------------------------------------
+crccheck:
+    out (CLKSTART),a            ; checksum, high byte first
+    in a,(SERIAL)
+    xor h
+    ld h,a
+    out (CLKSTART),a
+    in a,(SERIAL)
+    xor l
+    or h
+    ld l,a                      ; zero when the checksum matches
+    ld a,0x00
+    out (LED_IO),a              ; turn led off
+    or l
     ret
 
 ;-------------------------------------------------------------------------------
 ; Read a sector from the SD card
 ;
+; A read that times out or, when _sd_verify is set, a block with a bad
+; checksum is tried again up to SD_RETRIES times; _sd_retries counts these
+; attempts and _sd_errors the reads that failed nevertheless.
+;
 ; INPUT: stack contains the following:
 ;        - return address
 ;        - low word of sector address
 ;        - high word of sector address
 ;        - target address in external RAM
-; OUTPUT: L - read token (0xFE is success, failure otherwise)
+; OUTPUT: L - 0xFE on success, 0xFF on failure
 ;-------------------------------------------------------------------------------
 _read_sector_to:
+IFDEF PROFILING
+    ld a,PROF_READ_SECTOR_TO
+    out (PROFILE),a             ; profiling marker: entry
+ENDIF
     pop iy                      ; return address
     pop hl                      ; retrieve sector address (low)
     pop de                      ; retrieve sector address (high) 
+    pop bc                      ; retrieve target address external RAM
     push iy                     ; put return address back on stack
+    ld a,SD_RETRIES+1           ; number of attempts
+readsectortry:
+    push af                     ; attempts left
+    push bc
+    push de
+    push hl
     call _open_command
     call _cmd17                 ; return SD card status
-    pop iy                      ; return address
-    pop de                      ; retrieve target address external RAM
-    push iy                     ; put return address back on stack
     ld a,l                      ; load response into a
+    pop hl
+    pop de
+    pop bc
     cp 0xFE                     ; check if equal to success token
-    jp nz,readsectorexit        ; if not, exit with an error
+    jr nz,readsectorbad         ; if not, try again
+    push bc
+    push de
+    push hl
+    ld d,b
+    ld e,c
     call read_block             ; if success token, read block
-    jmp readsectorsuccess
-readsectorfail:
-    jmp readsectorexit
-readsectorsuccess:
+    pop hl
+    pop de
+    pop bc
+    jr nz,readsectorbad         ; checksum mismatch, try again
+    call _close_command
+    pop af
     ld l,0xFE
 readsectorexit:
-    call _close_command
+IFDEF PROFILING
+    ld a,PROF_READ_SECTOR_TO | $80
+    out (PROFILE),a             ; profiling marker: exit
+ENDIF
     ret
+readsectorbad:
+    call _close_command
+    pop af
+    dec a
+    jr z,readsectorfail
+    ld iy,(_sd_retries)
+    inc iy
+    ld (_sd_retries),iy
+    jr readsectortry
+readsectorfail:
+    ld iy,(_sd_errors)
+    inc iy
+    ld (_sd_errors),iy
+    ld l,0xFF
+    jr readsectorexit
 
 ;-------------------------------------------------------------------------------
 ; Copy the full 0x200 bytes from a block to internal RAM
 ;
-; void fast_sd_to_intram_full(uint16_t ram_addr);
+; uint8_t fast_sd_to_intram_full(uint16_t ram_addr);
+;
+; Output: L - 0 when the block is intact or not verified (see read_block)
 ;-------------------------------------------------------------------------------
 _fast_sd_to_intram_full:
     pop de                      ; return address
     pop hl                      ; ramptr
     push de                     ; put return address back on stack
+    ld a,(_sd_verify)
+    or a
+    jr nz,fstifcrc
     ld a,$FF
     out (SERIAL),a              ; flush shift register with ones
     ld c,2                      ; number of outer loops
@@ -369,8 +678,69 @@ fstifinner:
     jp nz, fstifouter
     out (CLKSTART),a            ; two more pulses for the checksum
     out (CLKSTART),a
+    ld l,0
     ret
 
+fstifcrc:
+    ex de,hl                    ; de: ramptr
+    push ix                     ; frame pointer of the C caller
+    ld hl,0                     ; checksum
+    ld a,$FF
+    out (SERIAL),a              ; flush shift register with ones
+    ld ixh,2                    ; number of outer loops
+fstifcrcouter:
+    ld b,0                      ; 256 iterations for inner loop
+fstifcrcinner:
+    out (CLKSTART),a            ; pulse clock, does not care about value of a
+    in a, (SERIAL)              ; read value
+    ld (de),a
+    inc de                      ; increment RAM pointer
+    xor h                       ; crc = crc << 8 ^ table(crc >> 8 ^ byte),
+    ld c,a                      ; the table computed inline from
+    rrca                        ; x = crc >> 8 ^ byte, x ^= x >> 4:
+    rrca                        ; crc = crc << 8 ^ x << 12 ^ x << 5 ^ x
+    rrca
+    rrca
+    and $0F
+    xor c
+    ld c,a                      ; c = x
+    rrca
+    rrca
+    rrca                        ; a = x rotated left by 5
+    ld h,a
+    and $E0
+    xor c
+    ld c,a                      ; c = low byte
+    ld a,h
+    and $1F                     ; x >> 3
+    xor l
+    ld l,a
+    ld a,h
+    rrca                        ; x rotated left by 4
+    and $F0
+    xor l
+    ld h,a                      ; high byte
+    ld l,c
+    djnz fstifcrcinner
+    dec ixh
+    jp nz, fstifcrcouter
+    pop ix
+    call crccheck
+    ret
+
+;-------------------------------------------------------------------------------
+; Copy the full 0x200 bytes from a block to external RAM
+;
+; uint8_t fast_sd_to_ram_full(uint16_t ram_addr);
+;
+; Output: L - 0 when the block is intact or not verified (see read_block)
+;-------------------------------------------------------------------------------
+_fast_sd_to_ram_full:
+    pop hl                      ; return address
+    pop de                      ; ramptr
+    push hl                     ; put return address back on stack
+    jp read_block
+
 ;-------------------------------------------------------------------------------
 ; void open_command(void);
 ;
@@ -18,6 +18,8 @@
  *                                                                        *
  **************************************************************************/
 
+#include <string.h>
+
 #include "sdcard.h"
 
 // shared buffer object to store the data of a single sector on the SD card
@@ -25,6 +27,16 @@ uint8_t _resp8[5];
 uint8_t _resp58[5];
 uint8_t _flag_sdcard_mounted = 0;
 
+uint8_t sd_verify = SD_VERIFY;
+uint16_t sd_retries = 0;
+uint16_t sd_errors = 0;
+
+SDCardProfile _sd_card;
+uint8_t sd_byte_addressing = 0;
+uint8_t sd_multiblock = 1;
+uint16_t sd_read_timeout = SD_TIMEOUT_READ;
+uint16_t sd_token_left = 0;
+
 /**
  * @brief Output information of the SD-CARD to the user
  * 
@@ -61,7 +73,8 @@ uint8_t init_sdcard(void) {
     // sprintf(termbuffer, "CMD8: %02X %02X %02X %02X %02X", _resp8[0], _resp8[1], _resp8[2], _resp8[3], _resp8[4]);
     // terminal_printtermbuffer();
 
-    if(_resp8[0] >= 0x02) {
+    // cards of physical layer version 1 reject CMD8 as an illegal command
+    if(_resp8[0] >= 0x02 && _resp8[0] != 0x05) {
         return -1;
     }
 
@@ -97,6 +110,8 @@ uint8_t init_sdcard(void) {
     // sprintf(termbuffer, "CMD58: %02X %02X %02X %02X %02X", _resp58[0], _resp58[1], _resp58[2], _resp58[3], _resp58[4]);
     // terminal_printtermbuffer();
 
+    sd_probe();
+
     // inform user that the SD card is initialized and that we are ready to read
     // the first block from the SD card and print it to the screen
 #ifndef NON_VERBOSE
@@ -106,6 +121,108 @@ uint8_t init_sdcard(void) {
     return 0;
 }
 
+/**
+ * @brief Establish the capabilities of the card after its initialization
+ *
+ * Version 1 cards and cards without the CCS bit in their OCR are addressed in
+ * bytes. The read timeout is raised for cards whose slowest probe read comes
+ * close to it, and streams fall back to single block reads when the card does
+ * not deliver a multiple block read.
+ */
+void sd_probe(void) {
+    uint16_t waits[SD_PROBE_READS];
+    uint8_t i, j;
+
+    memset(&_sd_card, 0x00, sizeof(SDCardProfile));
+    sd_read_timeout = SD_TIMEOUT_READ;
+
+    // addressing mode
+    if(_resp8[0] < 0x02) {
+        _sd_card.flags |= SD_CARD_V2;
+    }
+    if((_sd_card.flags & SD_CARD_V2) && (_resp58[1] & 0x40)) {
+        _sd_card.flags |= SD_CARD_SDHC;
+        sd_byte_addressing = 0;
+    } else {
+        sd_byte_addressing = 1;
+        open_command();
+        cmd16();
+        close_command();
+    }
+
+    // registers
+    open_command();
+    i = cmd9(_sd_card.csd);
+    close_command();
+    open_command();
+    j = cmd10(_sd_card.cid);
+    close_command();
+    if(i == 0xFE && j == 0xFE) {
+        const uint8_t *csd = _sd_card.csd;
+        _sd_card.flags |= SD_CARD_REGS;
+        if((csd[0] >> 6) == 1) {
+            // CSD version 2.0: (C_SIZE + 1) * 512 KiB
+            _sd_card.sectors = ((uint32_t)(csd[7] & 0x3F) << 16 | (uint16_t)csd[8] << 8 | csd[9]) + 1;
+            _sd_card.sectors <<= 10;
+        } else {
+            // CSD version 1.0: (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) blocks
+            // of 2^READ_BL_LEN bytes
+            const uint16_t csize = (uint16_t)(csd[6] & 0x03) << 10 | (uint16_t)csd[7] << 2 | csd[8] >> 6;
+            const uint8_t shift = ((csd[9] & 0x03) << 1 | csd[10] >> 7) + 2 + (csd[5] & 0x0F) - 9;
+            _sd_card.sectors = (uint32_t)(csize + 1) << shift;
+        }
+    }
+
+    // polls of the data token of single block reads, kept sorted
+    for(i=0; i<SD_PROBE_READS; i++) {
+        const uint16_t wait = read_sector_to(i, SDCACHE0) == 0xFE ?
+                              sd_read_timeout - sd_token_left : sd_read_timeout;
+        for(j=i; j>0 && waits[j-1] > wait; j--) {
+            waits[j] = waits[j-1];
+        }
+        waits[j] = wait;
+    }
+    _sd_card.wait_min = waits[0];
+    _sd_card.wait_median = waits[SD_PROBE_READS / 2];
+    _sd_card.wait_max = waits[SD_PROBE_READS - 1];
+
+    // keep a margin of 16 times the slowest read
+    if(_sd_card.wait_max >= 0x1000) {
+        sd_read_timeout = 0xFFFF;
+    } else if(_sd_card.wait_max * 16 > SD_TIMEOUT_READ) {
+        sd_read_timeout = _sd_card.wait_max * 16;
+    }
+
+    // multiple block read of two blocks; only a stream that delivered its
+    // first data token is stopped
+    open_command();
+    i = cmd18(0) == 0xFE;
+    if(i) {
+        fast_sd_to_ram_full(SDCACHE0);
+        i = wait_data_token() == 0xFE;
+        cmd12();
+    }
+    close_command();
+    sd_multiblock = i;
+}
+
 uint8_t read_sector(uint32_t sec_addr) { 
     return read_sector_to(sec_addr, SDCACHE0); 
-}
\ No newline at end of file
+}
+
+uint8_t read_sector_intram(uint32_t sec_addr, uint16_t ram_addr) {
+    for(uint8_t attempt=0; attempt<=SD_RETRIES; attempt++) {
+        if(attempt != 0) {
+            sd_retries++;
+        }
+        open_command();
+        const uint8_t ok = cmd17(sec_addr) == 0xFE &&
+                           fast_sd_to_intram_full(ram_addr) == 0;
+        close_command();
+        if(ok) {
+            return 0xFE;
+        }
+    }
+    sd_errors++;
+    return 0xFF;
+}
@@ -41,6 +41,52 @@ extern uint8_t _resp8[5];
 extern uint8_t _resp58[5];
 extern uint8_t _flag_sdcard_mounted;
 
+// number of times a corrupt or timed out read is tried again
+#define SD_RETRIES 3
+
+// whether the CRC-16 of each block is verified, defaults to SD_VERIFY
+#ifndef SD_VERIFY
+#define SD_VERIFY 1
+#endif
+extern uint8_t sd_verify;
+
+// number of reads that were tried again and that failed nevertheless
+extern uint16_t sd_retries;
+extern uint16_t sd_errors;
+
+// polls of the data token before a read times out, raised by sd_probe for
+// cards that turn out to be slower
+#define SD_TIMEOUT_READ 4000
+#define SD_PROBE_READS  16
+
+#define SD_TOKEN_SINGLE 0xFE    // data token of CMD17, CMD18 and CMD24
+#define SD_TOKEN_MULTI  0xFC    // data token of CMD25
+
+#define SD_CARD_V2      0x01    // answers CMD8, i.e. physical layer 2.0 or later
+#define SD_CARD_SDHC    0x02    // block addressed high capacity card (CCS set)
+#define SD_CARD_REGS    0x04    // CSD and CID have been read
+
+/**
+ * Capabilities of the mounted card as established by sd_probe
+ */
+typedef struct {
+    uint8_t flags;              // SD_CARD_*
+    uint32_t sectors;           // capacity in 512-byte sectors
+    uint8_t csd[16];            // card-specific data register
+    uint8_t cid[16];            // card identification register
+    uint16_t wait_min;          // polls of the data token of a CMD17 read
+    uint16_t wait_median;
+    uint16_t wait_max;
+} SDCardProfile;
+
+extern SDCardProfile _sd_card;
+
+// transfer settings derived from the profile and used by the asm routines
+extern uint8_t sd_byte_addressing;      // SDSC: addresses in bytes
+extern uint8_t sd_multiblock;           // whether streams use CMD18
+extern uint16_t sd_read_timeout;        // polls of the data token
+extern uint16_t sd_token_left;          // polls left at the last data token
+
 /**
  * @brief Initialize the SD card in such a way that sectors can be read
  *        from the card
@@ -49,6 +95,13 @@ extern uint8_t _flag_sdcard_mounted;
  */
 uint8_t init_sdcard(void);
 
+/**
+ * @brief Establish the capabilities of the card after its initialization:
+ *        the addressing mode, the CSD and CID registers, the latency of
+ *        single block reads and whether multiple block reads work
+ */
+void sd_probe(void);
+
 /******************************************************************************
  * RECEIVE OPERATIONS
  ******************************************************************************/
@@ -89,11 +142,40 @@ uint8_t cmd0(void) __z88dk_callee;
  */
 void cmd8(uint8_t *resp) __z88dk_fastcall;
 
+/**
+ * CMD9: Read the CSD register
+ *
+ * Returns 0xFE on success
+ */
+uint8_t cmd9(uint8_t *reg) __z88dk_fastcall;
+
+/**
+ * CMD10: Read the CID register
+ *
+ * Returns 0xFE on success
+ */
+uint8_t cmd10(uint8_t *reg) __z88dk_fastcall;
+
+/**
+ * CMD12: Stop transmission of a multiple block read
+ */
+void cmd12(void) __z88dk_callee;
+
+/**
+ * CMD16: Set the block length to 512 bytes
+ */
+uint8_t cmd16(void) __z88dk_callee;
+
 /**
  * CMD17: Read block
  */
 uint8_t cmd17(uint32_t addr) __z88dk_fastcall;
 
+/**
+ * CMD18: Read multiple blocks until CMD12 is sent
+ */
+uint8_t cmd18(uint32_t addr) __z88dk_fastcall;
+
 /**
  * CMD24: Write block
  */
@@ -122,8 +204,24 @@ uint8_t acmd41(void) __z88dk_callee;
  * @brief Copy all 0x200 bytes immediately from SD to internal RAM.
  * 
  * @param ram_addr external memory address
+ * @return uint8_t 0 if the checksum matches or sd_verify is not set
  */
-void fast_sd_to_intram_full(uint16_t ram_addr) __z88dk_callee;
+uint8_t fast_sd_to_intram_full(uint16_t ram_addr) __z88dk_callee;
+
+/**
+ * @brief Copy all 0x200 bytes immediately from SD to external RAM.
+ * 
+ * @param ram_addr external memory address
+ * @return uint8_t 0 if the checksum matches or sd_verify is not set
+ */
+uint8_t fast_sd_to_ram_full(uint16_t ram_addr) __z88dk_callee;
+
+/**
+ * @brief Wait for the data token of the next block of a multiple block read
+ * 
+ * @return uint8_t 0xFE on success
+ */
+uint8_t wait_data_token(void) __z88dk_callee;
 
 /**
  * @brief Read a single 512-byte sector
@@ -134,12 +232,59 @@ uint8_t read_sector(uint32_t sec_addr);
 
 /**
  * @brief Read a single 512-byte sector
+ *
+ * A read that times out or fails its checksum is tried again up to
+ * SD_RETRIES times.
  * 
  * @param sec_addr sector address
  * @param ram_addr external RAM address to write the sector data to
+ * @return uint8_t 0xFE on success
  */
 uint8_t read_sector_to(uint32_t sec_addr, uint16_t ram_addr) __z88dk_callee;
 
+/**
+ * @brief Read a single 512-byte sector into internal RAM, retrying as
+ *        read_sector_to does
+ *
+ * @param sec_addr sector address
+ * @param ram_addr internal RAM address to write the sector data to
+ * @return uint8_t 0xFE on success
+ */
+uint8_t read_sector_intram(uint32_t sec_addr, uint16_t ram_addr);
+
+/******************************************************************************
+ * WRITE OPERATIONS (sdwrite.asm, only linked into the launcher)
+ ******************************************************************************/
+
+/**
+ * CMD25: Write multiple blocks until the stop token is sent
+ */
+uint8_t cmd25(uint32_t addr) __z88dk_fastcall;
+
+/**
+ * @brief Send the token that starts a block, SD_TOKEN_SINGLE after CMD24 or
+ *        SD_TOKEN_MULTI after CMD25
+ *
+ * @param token data token
+ */
+void send_data_token(uint8_t token) __z88dk_fastcall;
+
+/**
+ * @brief Terminate a multiple block write and wait until it is stored
+ *
+ * @return uint8_t 0 on success
+ */
+uint8_t stop_write(void) __z88dk_callee;
+
+/**
+ * @brief Copy all 0x200 bytes from external RAM to the block started by
+ *        send_data_token and wait until the card has stored it
+ *
+ * @param ram_addr external memory address
+ * @return uint8_t 0 if the card accepted the block
+ */
+uint8_t fast_ram_to_sd_full(uint16_t ram_addr) __z88dk_callee;
+
 /******************************************************************************
  * I/O CONTROL
  ******************************************************************************/
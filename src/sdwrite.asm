@@ -0,0 +1,171 @@
+;-------------------------------------------------------------------------------
+;                                                                       
+;   Author: Ivo Filot <ivo@ivofilot.nl>                                 
+;                                                                       
+;   P2000T-SDCARD is free software:                                     
+;   you can redistribute it and/or modify it under the terms of the     
+;   GNU General Public License as published by the Free Software        
+;   Foundation, either version 3 of the License, or (at your option)    
+;   any later version.                                                  
+;                                                                       
+;   P2000T-SDCARD is distributed in the hope that it will be useful,    
+;   but WITHOUT ANY WARRANTY; without even the implied warranty         
+;   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.             
+;   See the GNU General Public License for more details.                
+;                                                                       
+;   You should have received a copy of the GNU General Public License   
+;   along with this program.  If not, see http://www.gnu.org/licenses/. 
+;                                                                       
+;-------------------------------------------------------------------------------
+
+SECTION code_user
+
+INCLUDE "ports.inc"
+
+;-------------------------------------------------------------------------------
+; Write path of the SD card; kept apart from sdcard.asm such that the builds
+; that only read from the card do not carry it.
+;-------------------------------------------------------------------------------
+
+EXTERN sd_send_command_and_address
+EXTERN _receive_R1
+
+PUBLIC _cmd25
+PUBLIC _send_data_token
+PUBLIC _stop_write
+PUBLIC _fast_ram_to_sd_full
+
+;-------------------------------------------------------------------------------
+; CMD25: Write multiple blocks until the stop token is sent
+;
+; uint8_t cmd25(uint32_t addr);
+;
+; garbles: a,bc,de,hl,iy
+; result of R1 is stored in l
+;-------------------------------------------------------------------------------
+_cmd25:
+    ld a,25|0x40
+    call sd_send_command_and_address
+    call _receive_R1
+    ret
+
+;-------------------------------------------------------------------------------
+; Send the token that starts a block: 0xFE after CMD24, 0xFC after CMD25
+;
+; void send_data_token(uint8_t token);
+;
+; input: l - token
+; garbles: a
+;-------------------------------------------------------------------------------
+_send_data_token:
+    ld a,0xFF
+    out (SERIAL),a
+    out (CLKSTART),a            ; one byte of ones before the token
+    ld a,l
+    out (SERIAL),a
+    out (CLKSTART),a            ; send out
+    ret
+
+;-------------------------------------------------------------------------------
+; Terminate a multiple block write and wait until the card has stored it
+;
+; uint8_t stop_write(void);
+;
+; garbles: a,bc
+; result: 0 in l on success
+;-------------------------------------------------------------------------------
+_stop_write:
+    ld l,0xFD                   ; stop token
+    call _send_data_token
+    ld a,0xFF
+    out (SERIAL),a
+    out (CLKSTART),a            ; skip stuff byte
+    ld l,0
+    call waitbusy
+    ret z
+    ld l,0xFF                   ; still busy
+    ret
+
+;-------------------------------------------------------------------------------
+; Copy the full 0x200 bytes from external RAM to a block on the SD card,
+; after send_data_token
+;
+; uint8_t fast_ram_to_sd_full(uint16_t ram_addr);
+;
+; garbles: a,bc,de,hl
+; result: 0 in l when the card accepted the block
+;-------------------------------------------------------------------------------
+_fast_ram_to_sd_full:
+    pop de                      ; return address
+    pop hl                      ; ramptr
+    push de                     ; put return address back on stack
+    ld a,0x02
+    out (LED_IO),a              ; turn write led on
+    ld c,2                      ; number of outer loops
+fstrsouter:
+    ld b,0                      ; 256 iterations for inner loop
+fstrsinner:
+    ld a,h
+    out (ADDR_HIGH),a           ; set high byte
+    ld a,l
+    out (ADDR_LOW),a            ; set low byte
+    in a,(RAM_IO)               ; read from RAM
+    out (SERIAL),a
+    out (CLKSTART),a            ; send out
+    inc hl                      ; increment RAM pointer
+    djnz fstrsinner
+    dec c
+    jp nz, fstrsouter
+
+;-------------------------------------------------------------------------------
+; Send the checksum of a block, collect the data response and wait until the
+; card has stored the block
+;
+; garbles: a,bc
+; result: 0 in l when the card accepted the block
+;-------------------------------------------------------------------------------
+write_finish:
+    ld a,0xFF
+    out (SERIAL),a              ; two bytes of checksum, which the card does
+    out (CLKSTART),a            ; not verify in SPI mode
+    out (CLKSTART),a
+    ld b,8                      ; the data response follows within 8 bytes
+wrresponse:
+    out (CLKSTART),a            ; send out
+    in a,(SERIAL)
+    cp 0xFF
+    jr nz,wrresponded
+    djnz wrresponse
+wrresponded:
+    and 0x1F
+    xor 0x05                    ; xxx00101: data accepted
+    ld l,a
+    call waitbusy
+    ld a,0x00
+    out (LED_IO),a              ; turn led off
+    ret z
+    ld l,0xFF                   ; still busy
+    ret
+
+;-------------------------------------------------------------------------------
+; Wait while the card holds the line low to store a block, for at most 65536
+; polls (about 1.7 s)
+;
+; garbles: a,bc
+; result: z flag set when the card is ready
+;-------------------------------------------------------------------------------
+waitbusy:
+    ld a,0xFF
+    out (SERIAL),a              ; flush with ones
+    ld bc,0
+waitbusynext:
+    out (CLKSTART),a            ; send out
+    in a,(SERIAL)
+    inc a                       ; card is ready when the line is released
+    ret z
+    dec bc
+    ld a,b
+    or c
+    jr nz,waitbusynext
+    inc a                       ; clear z flag
+    ret
@@ -0,0 +1,104 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+#include "trace.h"
+
+#ifdef TRACING
+
+#include "ram.h"
+
+static uint8_t _trace_head = 0;     // next slot of the ring buffer
+static uint16_t _trace_total = 0;   // number of entries stored since boot
+
+static const char* const _trace_names[] = {
+    "?", "sdcard", "mbr", "partition", "autoboot", "chain", "scan", "find",
+    "load cas", "load cad", "load prg", "load lz", "config", "sort",
+};
+
+/**
+ * @brief Store an entry in the trace
+ *
+ * @param id    event id
+ * @param arg   argument of the event
+ * @param start ticks at the start of the operation
+ */
+void trace_event(uint8_t id, uint16_t arg, uint16_t start) {
+    TRACEENTRY entry;
+    entry.id = id;
+    entry.reserved = 0;
+    entry.arg = arg;
+    entry.start = start;
+    entry.end = TRACE_TICKS;
+
+    // the loaders may have selected the other bank
+    const uint8_t bank = ram_bank;
+    set_ram_bank(RAM_BANK_CACHE);
+    if(_trace_total < TRACE_BOOT_ENTRIES) {
+        copy_to_ram((uint8_t*)&entry, TRACE_BOOT + _trace_total * sizeof(TRACEENTRY), sizeof(TRACEENTRY));
+    }
+    copy_to_ram((uint8_t*)&entry, TRACE_RING + _trace_head * sizeof(TRACEENTRY), sizeof(TRACEENTRY));
+    set_ram_bank(bank);
+
+    _trace_head++;      // wraps around at TRACE_RING_ENTRIES
+    if(_trace_total != 0xFFFF) {
+        _trace_total++;
+    }
+}
+
+/**
+ * @brief Retrieve an entry of the trace
+ *
+ * @param boot  1 for the boot timeline, 0 for the ring buffer
+ * @param n     index in the boot timeline, or 0 for the most recent entry
+ *              of the ring buffer, 1 for the one before, etc.
+ * @param entry receives the entry
+ * @return uint8_t 0 on success, 1 if there is no such entry
+ */
+uint8_t trace_get(uint8_t boot, uint8_t n, TRACEENTRY* entry) {
+    uint16_t addr;
+
+    if(boot) {
+        if(n >= _trace_total || n >= TRACE_BOOT_ENTRIES) {
+            return 1;
+        }
+        addr = TRACE_BOOT + n * sizeof(TRACEENTRY);
+    } else {
+        if(n >= _trace_total) {
+            return 1;
+        }
+        addr = TRACE_RING + (uint8_t)(_trace_head - 1 - n) * sizeof(TRACEENTRY);
+    }
+
+    const uint8_t bank = ram_bank;
+    set_ram_bank(RAM_BANK_CACHE);
+    copy_from_ram(addr, (uint8_t*)entry, sizeof(TRACEENTRY));
+    set_ram_bank(bank);
+    return 0;
+}
+
+/**
+ * @brief Name of an event id
+ */
+const char* trace_name(uint8_t id) {
+    return _trace_names[id < TRACE_NR_EVENTS ? id : 0];
+}
+
+#endif // TRACING
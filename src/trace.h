@@ -0,0 +1,113 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/*
+ * Timestamped trace of the boot sequence, directory scans and loaders. Every
+ * traced operation stores an entry holding its id, a 16-bit argument and the
+ * interrupt ticks (20 ms) at its start and end in external RAM bank 0. The
+ * first TRACE_BOOT_ENTRIES entries after boot are kept separately, the others
+ * go into a ring buffer of TRACE_RING_ENTRIES entries.
+ *
+ * Tracing is compiled in when TRACING is defined; otherwise the macros below
+ * expand to nothing.
+ */
+
+#include <stdint.h>
+
+#define TRACE_BOOT          0xF580  // boot timeline in RAM bank 0
+#define TRACE_BOOT_ENTRIES  16
+#define TRACE_RING          0xF600  // ring buffer in RAM bank 0, up to FATCACHE
+#define TRACE_RING_ENTRIES  256
+
+// event ids
+#define TRACE_SDCARD        1       // init_sdcard, argument: result
+#define TRACE_MBR           2       // read_mbr, argument: lower word of the LBA
+#define TRACE_PARTITION     3       // read_partition, argument: sectors per cluster
+#define TRACE_AUTOBOOT      4       // AUTOBOOT lookup, argument: whether found
+#define TRACE_CHAIN         5       // build_linked_list, argument: clusters
+#define TRACE_SCAN          6       // directory scan, argument: file id or page
+#define TRACE_FIND          7       // lookup by name
+#define TRACE_LOAD_CAS      8       // loaders, argument: sectors
+#define TRACE_LOAD_CAD      9
+#define TRACE_LOAD_PRG      10
+#define TRACE_LOAD_LZ       11
+#define TRACE_CONFIG        12      // boot configuration, argument: settings
+#define TRACE_SORT          13      // sorted view of a folder, argument: entries
+#define TRACE_NR_EVENTS     14
+
+#define TRACE_TICKS         (*(volatile uint16_t*)0x6010)
+#define TRACE_TICK_MS       20      // interval of the interrupt tick
+
+typedef struct {
+    uint8_t id;
+    uint8_t reserved;
+    uint16_t arg;
+    uint16_t start;     // ticks at the start of the operation
+    uint16_t end;       // ticks at the end of the operation
+} TRACEENTRY;
+
+#ifdef TRACING
+
+// TRACE_BEGIN starts timing an operation, TRACE_END stores it and TRACE_STEP
+// stores it and starts timing the next operation
+#define TRACE_BEGIN()           uint16_t __trace_start = TRACE_TICKS
+#define TRACE_END(id, arg)      trace_event(id, arg, __trace_start)
+#define TRACE_STEP(id, arg)     do { trace_event(id, arg, __trace_start); \
+                                     __trace_start = TRACE_TICKS; } while(0)
+
+/**
+ * @brief Store an entry in the trace
+ *
+ * @param id    event id
+ * @param arg   argument of the event
+ * @param start ticks at the start of the operation
+ */
+void trace_event(uint8_t id, uint16_t arg, uint16_t start);
+
+/**
+ * @brief Retrieve an entry of the trace
+ *
+ * @param boot  1 for the boot timeline, 0 for the ring buffer
+ * @param n     index in the boot timeline, or 0 for the most recent entry
+ *              of the ring buffer, 1 for the one before, etc.
+ * @param entry receives the entry
+ * @return uint8_t 0 on success, 1 if there is no such entry
+ */
+uint8_t trace_get(uint8_t boot, uint8_t n, TRACEENTRY* entry);
+
+/**
+ * @brief Name of an event id
+ */
+const char* trace_name(uint8_t id);
+
+#else
+
+#define TRACE_BEGIN()
+#define TRACE_END(id, arg)
+#define TRACE_STEP(id, arg)
+
+#endif // TRACING
+
+#endif // _TRACE_H
@@ -0,0 +1,457 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "host.h"
+#include "../src/sdcard.h"
+#include "../src/ram.h"
+#include "../src/terminal.h"
+#include "../src/util.h"
+#include "../src/fatlba.h"
+
+HostStats host_stats;
+uint8_t host_extram[2][0x10000];
+uint8_t host_intram[0x10000];
+uint32_t host_sectors = 0;
+
+static uint8_t *image = NULL;
+static size_t image_size = 0;
+static uint32_t stream_lba = 0;     // next block of an open CMD18
+static uint32_t write_lba = 0;      // next block of an open CMD24 or CMD25
+static int stream_open_cmd = 0;
+static unsigned corrupt_blocks = 0; // blocks still to arrive corrupt
+
+static char log_buffer[0x10000];
+static size_t log_length = 0;
+
+//------------------------------------------------------------------------------
+// FIRMWARE GLOBALS
+//------------------------------------------------------------------------------
+
+char *memory = (char*)host_intram;
+char *vidmem = (char*)&host_intram[0x5000];
+char *keymem = (char*)&host_intram[0x6000];
+char *highmem = (char*)&host_intram[0xA000];
+char *bankmem = (char*)&host_intram[0xE000];
+
+uint8_t ram_bank = 0;
+uint8_t _resp8[5];
+uint8_t _resp58[5];
+uint8_t _flag_sdcard_mounted = 0;
+uint8_t sd_verify = SD_VERIFY;
+uint16_t sd_retries = 0;
+uint16_t sd_errors = 0;
+uint8_t sd_multiblock = 1;
+char termbuffer[LINELENGTH];
+uint8_t _terminal_curline = 0;
+
+//------------------------------------------------------------------------------
+// IMAGE
+//------------------------------------------------------------------------------
+
+int host_open(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < 512) {
+        close(fd);
+        return -1;
+    }
+
+    // written sectors stay in memory, the image file is left untouched
+    image = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(image == MAP_FAILED) {
+        image = NULL;
+        return -1;
+    }
+    image_size = st.st_size;
+    host_sectors = (uint32_t)(image_size / 512);
+
+    memset(host_extram, 0x00, sizeof(host_extram));
+    memset(host_intram, 0x00, sizeof(host_intram));
+    ram_bank = 0;
+    stream_open_cmd = 0;
+    host_reset_stats();
+    host_reset_log();
+    return 0;
+}
+
+void host_close(void) {
+    if(image) {
+        munmap(image, image_size);
+        image = NULL;
+    }
+}
+
+void host_reset_stats(void) {
+    memset(&host_stats, 0x00, sizeof(HostStats));
+}
+
+void host_report(const char *label) {
+    printf("  %-34s %6llu SD cmds %6llu sectors %9llu ext RAM ports\n", label,
+           (unsigned long long)host_stats.sd_commands,
+           (unsigned long long)host_stats.sectors_read,
+           (unsigned long long)host_stats.ram_ports);
+}
+
+const char *host_log(void) {
+    return log_buffer;
+}
+
+void host_reset_log(void) {
+    log_length = 0;
+    log_buffer[0] = 0;
+}
+
+static void log_line(const char *str) {
+    size_t n = strnlen(str, LINELENGTH);
+    if(log_length + n + 2 < sizeof(log_buffer)) {
+        memcpy(&log_buffer[log_length], str, n);
+        log_length += n;
+        log_buffer[log_length++] = '\n';
+        log_buffer[log_length] = 0;
+    }
+}
+
+uint16_t host_crc16(const uint8_t *data, uint32_t nrbytes) {
+    uint16_t crc = 0;
+    for(uint32_t i=0; i<nrbytes; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t j=0; j<8; j++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+//------------------------------------------------------------------------------
+// SD CARD
+//------------------------------------------------------------------------------
+
+static const uint8_t *block(uint32_t lba) {
+    return lba < host_sectors ? &image[(size_t)lba * 512] : NULL;
+}
+
+static void count_command(void) {
+    host_stats.sd_commands++;
+}
+
+void open_command(void) {}
+
+void close_command(void) {}
+
+uint8_t cmd17(uint32_t addr) {
+    count_command();
+    host_stats.cmd17++;
+    stream_lba = addr;
+    return block(addr) ? 0xFE : 0xFF;
+}
+
+uint8_t cmd18(uint32_t addr) {
+    count_command();
+    host_stats.cmd18++;
+    stream_lba = addr;
+    stream_open_cmd = 1;
+    return block(addr) ? 0xFE : 0xFF;
+}
+
+void cmd12(void) {
+    count_command();
+    stream_open_cmd = 0;
+}
+
+uint8_t wait_data_token(void) {
+    return stream_open_cmd && block(stream_lba) ? 0xFE : 0xFF;
+}
+
+void host_corrupt_blocks(unsigned n) {
+    corrupt_blocks = n;
+}
+
+// clock a block into memory, inverted when it is to arrive corrupt;
+// returns 0 when the block is intact or not verified, as the kernels do
+static uint8_t clock_block(uint8_t *dest, uint16_t ram_addr) {
+    const uint8_t *src = block(stream_lba++);
+    const uint8_t corrupt = corrupt_blocks != 0 ? 0xFF : 0x00;
+    for(uint16_t i=0; i<512; i++) {
+        dest[(uint16_t)(ram_addr + i)] = (src ? src[i] : 0xFF) ^ corrupt;
+    }
+    host_stats.sectors_read++;
+    if(!corrupt) {
+        return 0;
+    }
+    corrupt_blocks--;
+    return sd_verify ? 1 : 0;
+}
+
+// clock a block into external RAM, as read_block does
+static uint8_t read_block(uint16_t ram_addr) {
+    host_stats.ram_writes += 512;
+    host_stats.ram_ports += 512 * 3;
+    return clock_block(host_extram[ram_bank], ram_addr);
+}
+
+uint8_t read_sector_to(uint32_t sec_addr, uint16_t ram_addr) {
+    for(uint8_t attempt=0; attempt<=SD_RETRIES; attempt++) {
+        if(attempt != 0) {
+            sd_retries++;
+        }
+        open_command();
+        const uint8_t ok = cmd17(sec_addr) == 0xFE && read_block(ram_addr) == 0;
+        close_command();
+        if(ok) {
+            return 0xFE;
+        }
+    }
+    sd_errors++;
+    return 0xFF;
+}
+
+uint8_t read_sector(uint32_t sec_addr) {
+    return read_sector_to(sec_addr, SDCACHE0);
+}
+
+uint8_t read_sector_intram(uint32_t sec_addr, uint16_t ram_addr) {
+    for(uint8_t attempt=0; attempt<=SD_RETRIES; attempt++) {
+        if(attempt != 0) {
+            sd_retries++;
+        }
+        open_command();
+        const uint8_t ok = cmd17(sec_addr) == 0xFE && clock_block(host_intram, ram_addr) == 0;
+        close_command();
+        if(ok) {
+            return 0xFE;
+        }
+    }
+    sd_errors++;
+    return 0xFF;
+}
+
+uint8_t fast_sd_to_ram_full(uint16_t ram_addr) {
+    return read_block(ram_addr);
+}
+
+uint8_t fast_sd_to_intram_full(uint16_t ram_addr) {
+    return clock_block(host_intram, ram_addr);
+}
+
+// clock a block out to the card, as fast_ram_to_sd_full does; blocks beyond
+// the image are rejected
+static uint8_t write_block(const uint8_t *src, uint16_t ram_addr) {
+    if(write_lba >= host_sectors) {
+        return 1;
+    }
+    uint8_t *dest = &image[(size_t)write_lba++ * 512];
+    for(uint16_t i=0; i<512; i++) {
+        dest[i] = src[(uint16_t)(ram_addr + i)];
+    }
+    host_stats.sectors_written++;
+    return 0;
+}
+
+uint8_t cmd24(uint32_t addr) {
+    count_command();
+    write_lba = addr;
+    return block(addr) ? 0x00 : 0x20;   // address error
+}
+
+uint8_t cmd25(uint32_t addr) {
+    count_command();
+    write_lba = addr;
+    return block(addr) ? 0x00 : 0x20;
+}
+
+void send_data_token(uint8_t token) {
+    (void)token;
+}
+
+uint8_t stop_write(void) {
+    return 0;
+}
+
+uint8_t fast_ram_to_sd_full(uint16_t ram_addr) {
+    host_stats.ram_reads += 512;
+    host_stats.ram_ports += 512 * 3;
+    return write_block(host_extram[ram_bank], ram_addr);
+}
+
+//------------------------------------------------------------------------------
+// EXTERNAL RAM
+//------------------------------------------------------------------------------
+
+static uint8_t ram_get(uint16_t addr) {
+    host_stats.ram_reads++;
+    host_stats.ram_ports += 3;      // address high, address low, data
+    return host_extram[ram_bank][addr];
+}
+
+static void ram_put(uint16_t addr, uint8_t val) {
+    host_stats.ram_writes++;
+    host_stats.ram_ports += 3;
+    host_extram[ram_bank][addr] = val;
+}
+
+void set_ram_address(uint16_t addr) {
+    (void)addr;
+    host_stats.ram_ports += 2;
+}
+
+void set_ram_bank(uint8_t val) {
+    ram_bank = val & 1;
+}
+
+uint8_t ram_read_uint8_t(uint16_t addr) {
+    return ram_get(addr);
+}
+
+uint16_t ram_read_uint16_t(uint16_t addr) {
+    return ram_get(addr) | (uint16_t)ram_get(addr + 1) << 8;
+}
+
+uint32_t ram_read_uint32_t(uint16_t addr) {
+    return ram_read_uint16_t(addr) | (uint32_t)ram_read_uint16_t(addr + 2) << 16;
+}
+
+void ram_write_uint8_t(uint16_t addr, uint8_t val) {
+    ram_put(addr, val);
+}
+
+void ram_write_uint16_t(uint16_t addr, uint16_t val) {
+    ram_put(addr, val & 0xFF);
+    ram_put(addr + 1, val >> 8);
+}
+
+void copy_to_ram(uint8_t *src, uint16_t dest, uint16_t nrbytes) {
+    for(uint16_t i=0; i<nrbytes; i++) {
+        ram_put(dest + i, src[i]);
+    }
+}
+
+void copy_from_ram(uint16_t src, uint8_t *dest, uint16_t nrbytes) {
+    for(uint16_t i=0; i<nrbytes; i++) {
+        dest[i] = ram_get(src + i);
+    }
+}
+
+void ram_transfer(uint16_t src, uint16_t dest, uint16_t nrbytes) {
+    for(uint16_t i=0; i<nrbytes; i++) {
+        ram_put(dest + i, ram_get(src + i));
+    }
+}
+
+static uint8_t key_fold(uint8_t c) {
+    return (c >= 'a' && c <= 'z') ? c - 0x20 : c;
+}
+
+int8_t ram_keycmp(uint16_t addr1, uint16_t addr2) {
+    for(;; addr1++, addr2++) {
+        const uint8_t c2 = key_fold(ram_get(addr2));
+        const uint8_t c1 = key_fold(ram_get(addr1));
+        if(c1 != c2) {
+            return c1 < c2 ? -1 : 1;
+        }
+        if(c1 == 0x00) {
+            return 0;
+        }
+    }
+}
+
+uint8_t ram_count_free(uint16_t addr) {
+    uint8_t n = 0;
+    for(uint16_t i=0; i<512; i+=4) {
+        n += (ram_read_uint32_t(addr + i) & 0x0FFFFFFF) == 0;
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// FAT ARITHMETIC
+//------------------------------------------------------------------------------
+
+// defined by either FAT32 engine
+extern uint32_t _SECTOR_begin_lba;
+extern uint32_t _fat_begin_lba;
+
+uint32_t cluster_to_lba(uint32_t cluster) {
+    return _SECTOR_begin_lba + ((cluster - 2) << _cluster_shift);
+}
+
+uint32_t fat_sector_of(uint32_t cluster) {
+    return _fat_begin_lba + (cluster >> 7);
+}
+
+//------------------------------------------------------------------------------
+// TERMINAL AND UTILITIES
+//------------------------------------------------------------------------------
+
+uint8_t z80_inp(uint16_t port) {
+    (void)port;
+    return 0xFF;
+}
+
+void z80_outp(uint16_t port, uint8_t data) {
+    (void)port;
+    (void)data;
+}
+
+void terminal_printtermbuffer(void) {
+    log_line(termbuffer);
+    memset(termbuffer, 0x00, LINELENGTH);
+}
+
+void terminal_redoline(void) {
+    memset(termbuffer, 0x00, LINELENGTH);
+}
+
+void print(char *str) {
+    log_line(str);
+}
+
+void print_recall(char *str) {
+    log_line(str);
+}
+
+void print_error(char *str) {
+    log_line(str);
+}
+
+uint8_t wait_for_key_fixed(uint8_t quitkey) {
+    (void)quitkey;
+    return 0;                       // continue listing
+}
+
+void replace_bytes(uint8_t *str, uint8_t org, uint8_t rep, uint16_t nrbytes) {
+    for(uint16_t i=0; i<nrbytes; i++) {
+        if(str[i] == org) {
+            str[i] = rep;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _HOST_H
+#define _HOST_H
+
+/*
+ * Host implementation of the routines the FAT32 engines use to reach the
+ * SD card, the external RAM and the screen. Sectors are served from an image
+ * file, of which written sectors only change the copy in memory, and every
+ * operation is counted in the way the Z80 routines would perform it.
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t sd_commands;           // CMD17, CMD18, CMD12, CMD24 and CMD25
+    uint64_t cmd17;
+    uint64_t cmd18;
+    uint64_t sectors_read;          // blocks clocked in from the card
+    uint64_t sectors_written;       // blocks clocked out to the card
+    uint64_t ram_reads;             // bytes read from RAM_IO
+    uint64_t ram_writes;            // bytes written to RAM_IO
+    uint64_t ram_ports;             // all accesses of the external RAM ports
+} HostStats;
+
+extern HostStats host_stats;
+extern uint8_t host_extram[2][0x10000];
+extern uint8_t host_intram[0x10000];
+extern uint32_t host_sectors;       // size of the image in sectors
+
+/**
+ * @brief Serve sectors from an image file
+ *
+ * @param filename image
+ * @return 0 on success, -1 on failure
+ */
+int host_open(const char *filename);
+
+/**
+ * @brief Release the image
+ */
+void host_close(void);
+
+/**
+ * @brief Reset the counters
+ */
+void host_reset_stats(void);
+
+/**
+ * @brief Print the counters of an operation on a single line
+ *
+ * @param label operation
+ */
+void host_report(const char *label);
+
+/**
+ * @brief Lines written to the terminal since the last call of host_reset_log,
+ *        separated by newlines
+ */
+const char *host_log(void);
+
+/**
+ * @brief Clear the terminal log
+ */
+void host_reset_log(void);
+
+/**
+ * @brief Let the next n blocks clocked in from the card arrive corrupt; the
+ *        fast_sd_to_* routines and read_sector_to report these as the Z80
+ *        routines do when sd_verify is set
+ *
+ * @param n number of blocks
+ */
+void host_corrupt_blocks(unsigned n);
+
+/**
+ * @brief CRC-16 (XMODEM) as calculated by crc16.asm
+ */
+uint16_t host_crc16(const uint8_t *data, uint32_t nrbytes);
+
+#endif // _HOST_H
@@ -0,0 +1,35 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _HOST_Z80_H
+#define _HOST_Z80_H
+
+/*
+ * Stand-in for the <z80.h> header of z88dk, such that the firmware sources
+ * compile on the host. The calling convention attributes are defined away
+ * on the command line (see Makefile).
+ */
+
+#include <stdint.h>
+
+uint8_t z80_inp(uint16_t port);
+void z80_outp(uint16_t port, uint8_t data);
+
+#endif // _HOST_Z80_H
@@ -0,0 +1,124 @@
+# -*- coding: utf-8 -*-
+
+#
+# Generate the SD-card images of the host test suite
+#
+# Every image comes with a manifest (<image>.txt) naming the folder under
+# test, in the root folder or '/' for the root folder itself, followed by its
+# files, one per line:
+#
+#   folder <NAME>
+#   <id> <NAME.EXT> <size> <crc16> [long name]
+#
+# where id is the number shown in a listing and crc16 the CRC-16 of the
+# program as it ends up in memory.
+#
+
+import os
+import sys
+import random
+import argparse
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'scripts'))
+
+from fatimage import FatImage, Folder, File
+from programs import make_cas, make_prg, loaded_crc
+from cas2cad import convert
+
+def main():
+    parser = argparse.ArgumentParser(
+                    prog='Test image tool',
+                    description='Create the SD-card images of the host test suite')
+
+    parser.add_argument('folder')
+    parser.add_argument('--seed', type=int, default=2000)
+
+    args = parser.parse_args()
+    os.makedirs(args.folder, exist_ok=True)
+
+    for name, build in (('huge', huge), ('fragmented', fragmented),
+                        ('lfn', lfn), ('clusters', clusters)):
+        rng = random.Random(args.seed)
+        img, folder = build(rng)
+        filename = os.path.join(args.folder, name + '.img')
+        img.save(filename)
+        write_manifest(filename + '.txt', folder)
+        print('Writing to: %s (%i clusters used)' % (filename, img.clusters_used))
+
+def program(i, rng, cas_length, prg_length):
+    if i % 4 == 3:
+        return '.PRG', make_prg(prg_length, rng)
+    cas = make_cas('TEST%04i' % i, cas_length, rng)
+    if i % 4 == 2:
+        return '.CAD', convert(cas)[0]
+    return '.CAS', cas
+
+def huge(rng):
+    """
+    A single folder holding 1500 small programs
+    """
+    img = FatImage(size_mb=64, sectors_per_cluster=8)
+    for i in range(1500):
+        ext, data = program(i, rng, 1024, 600)
+        img.root.add_file('F%07i%s' % (i, ext), data)
+    return img, img.root
+
+def fragmented(rng):
+    """
+    Large programs of which the chains of 512 byte clusters are split into
+    runs of three clusters, with free clusters in between
+    """
+    img = FatImage(size_mb=64, sectors_per_cluster=1, fragment=3)
+    for i in range(16):
+        ext, data = program(i, rng, 30 * 1024, 15 * 1024)
+        img.root.add_file('FRAG%04i%s' % (i, ext), data)
+        img.root.skip(i % 3)
+    return img, img.root
+
+def lfn(rng):
+    """
+    300 programs with long file names of two or three entries, stored in a
+    random order and of which some are written in lower case
+    """
+    img = FatImage(size_mb=64, sectors_per_cluster=8)
+    order = list(range(300))
+    rng.shuffle(order)
+    for i in order:
+        ext, data = program(i, rng, 2048, 1024)
+        long_name = ('Program number %04i with a long name' % i)[:20 + i % 16].rstrip() + ext.lower()
+        if i % 3 == 1:
+            long_name = long_name.lower()
+        img.root.add_file('PROGR~%02i%s' % (i % 100, ext) if i < 100 else 'P%07i%s' % (i, ext),
+                          data, long_name=long_name)
+    return img, img.root
+
+def clusters(rng):
+    """
+    Small clusters and a folder beyond cluster 65535, such that the upper
+    word of the cluster numbers is used
+    """
+    img = FatImage(size_mb=256, sectors_per_cluster=1)
+    img.root.add_file('README.TXT', b'P2000T\n')
+    img.root.skip(70000)
+    folder = img.root.mkdir('FAR')
+    for i in range(40):
+        ext, data = program(i, rng, 4096, 2048)
+        folder.add_file('FAR%05i%s' % (i, ext), data)
+    return img, folder
+
+def write_manifest(filename, folder):
+    with open(filename, 'w') as f:
+        f.write('folder %s\n' % (folder.name or '/'))
+        fid = 0 if folder.parent is None else 1   # '..' comes first
+        for c in folder.children:
+            if isinstance(c, Folder):
+                fid += 1
+            if not isinstance(c, File):
+                continue
+            fid += 1
+            ext = os.path.splitext(c.name)[1]
+            f.write('%i %s %i %i %s\n' % (fid, c.name, len(c.data),
+                    loaded_crc(c.data, ext), c.long_name or ''))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,277 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#include <string.h>
+
+#include "../src/fat32.h"
+#include "../src/fatsort.h"
+#include "host.h"
+#include "suite.h"
+
+Entry entries[MAX_ENTRIES];
+int nentries = 0;
+char folder_name[9];
+int failures = 0;
+
+int read_manifest(const char *image) {
+    char filename[256];
+    snprintf(filename, sizeof(filename), "%s.txt", image);
+    FILE *f = fopen(filename, "r");
+    if(!f) {
+        return -1;
+    }
+
+    char line[256];
+    nentries = 0;
+    memset(folder_name, 0x00, sizeof(folder_name));
+    while(fgets(line, sizeof(line), f) && nentries < MAX_ENTRIES) {
+        line[strcspn(line, "\r\n")] = 0;
+
+        char name[16];
+        if(sscanf(line, "folder %8s", name) == 1) {
+            if(strcmp(name, "/") != 0) {
+                snprintf(folder_name, sizeof(folder_name), "%-8.8s", name);
+            }
+            continue;
+        }
+
+        Entry *e = &entries[nentries];
+        unsigned id, crc;
+        unsigned long size;
+        int n = 0;
+        if(sscanf(line, "%u %15s %lu %u %n", &id, name, &size, &crc, &n) < 4) {
+            continue;
+        }
+
+        memset(e, 0x00, sizeof(Entry));
+        e->id = (uint16_t)id;
+        e->size = (uint32_t)size;
+        e->crc = (uint16_t)crc;
+        char *dot = strchr(name, '.');
+        if(dot) {
+            *dot = 0;
+        }
+        snprintf(e->base_name, sizeof(e->base_name), "%-8.8s", name);
+        snprintf(e->ext, sizeof(e->ext), "%-3s", dot ? dot + 1 : "");
+        snprintf(e->long_name, sizeof(e->long_name), "%s", &line[n]);
+        nentries++;
+    }
+
+    fclose(f);
+    return nentries > 0 ? 0 : -1;
+}
+
+int is_cas(const Entry *e) {
+    return memcmp(e->ext, "CAS", 3) == 0 || memcmp(e->ext, "CAD", 3) == 0;
+}
+
+void entry_path(const Entry *e, char *path) {
+    // the names are padded with spaces
+    int n = 0;
+    for(int i=0; i<8 && folder_name[i] && folder_name[i] != ' '; i++) {
+        path[n++] = folder_name[i];
+    }
+    if(n) {
+        path[n++] = '/';
+    }
+    for(int i=0; i<8 && e->base_name[i] != ' '; i++) {
+        path[n++] = e->base_name[i];
+    }
+    path[n++] = '.';
+    for(int i=0; i<3 && e->ext[i] != ' '; i++) {
+        path[n++] = e->ext[i];
+    }
+    path[n] = 0;
+}
+
+const Entry *find_entry(const char *base_name, const char *ext) {
+    for(int i=0; i<nentries; i++) {
+        if(memcmp(entries[i].base_name, base_name, 8) == 0 && memcmp(entries[i].ext, ext, 3) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static int sort_class(uint8_t attrib, const char *name) {
+    if(!(attrib & 0x10)) {
+        return 3;
+    }
+    return strcmp(name, "..") == 0 ? 1 : 2;
+}
+
+int sort_order(uint8_t attrib1, const char *name1, uint8_t attrib2, const char *name2) {
+    const int c1 = sort_class(attrib1, name1);
+    const int c2 = sort_class(attrib2, name2);
+    if(c1 != c2) {
+        return c1 - c2;
+    }
+    for(;; name1++, name2++) {
+        const int a = (*name1 >= 'a' && *name1 <= 'z') ? *name1 - 0x20 : (uint8_t)*name1;
+        const int b = (*name2 >= 'a' && *name2 <= 'z') ? *name2 - 0x20 : (uint8_t)*name2;
+        if(a != b || a == 0) {
+            return a - b;
+        }
+    }
+}
+
+uint16_t load_entry(const Entry *e, uint32_t cluster) {
+    if(is_cas(e)) {
+        set_ram_bank(RAM_BANK_CASSETTE);
+        if(memcmp(e->ext, "CAD", 3) != 0 ? store_cas_ram(cluster, 0x0000) != 0
+                                         : store_cad_ram(cluster) != 0) {
+            set_ram_bank(RAM_BANK_CACHE);
+            return ~e->crc;
+        }
+        const uint16_t length = host_extram[1][0x8002] | host_extram[1][0x8003] << 8;
+        set_ram_bank(RAM_BANK_CACHE);
+        return host_crc16(host_extram[1], length);
+    }
+
+    if(store_prg_intram(cluster, PROGRAM_LOCATION) != 0) {
+        return ~e->crc;
+    }
+    return host_crc16(&host_intram[PROGRAM_LOCATION], e->size);
+}
+
+void load_all(OpenId open) {
+    HostStats sum = {0};
+    int bad = 0;
+    for(int i=0; i<nentries; i++) {
+        const Entry *e = &entries[i];
+        host_reset_stats();
+        const uint32_t cluster = open(e->id);
+        if(_filesize_current_file != e->size || load_entry(e, cluster) != e->crc) {
+            bad++;
+        }
+        if(i == 0) {
+            host_report("open and load first file");
+        }
+        sum.sd_commands += host_stats.sd_commands;
+        sum.sectors_read += host_stats.sectors_read;
+        sum.ram_ports += host_stats.ram_ports;
+    }
+    host_stats = sum;
+
+    char label[40];
+    snprintf(label, sizeof(label), "open and load all %i files", nentries);
+    host_report(label);
+    CHECK(bad == 0, "%i programs not loaded intact", bad);
+}
+
+void single_block(OpenId open) {
+    // cards without multiple block reads are streamed sector by sector
+    sd_multiblock = 0;
+    int bad = 0;
+    host_reset_stats();
+    for(int i=0; i<nentries; i++) {
+        const Entry *e = &entries[i];
+        const uint32_t cluster = open(e->id);
+        if(load_entry(e, cluster) != e->crc) {
+            bad++;
+        }
+    }
+    sd_multiblock = 1;
+    CHECK(bad == 0, "%i programs not loaded intact using single block reads", bad);
+    CHECK(host_stats.cmd18 == 0, "%lu multiple block reads issued",
+          (unsigned long)host_stats.cmd18);
+}
+
+void retries(OpenId open) {
+    // the largest file, which is streamed over the most sectors
+    const Entry *e = &entries[0];
+    for(int i=1; i<nentries; i++) {
+        if(entries[i].size > e->size) {
+            e = &entries[i];
+        }
+    }
+
+    // a corrupt block is read again
+    const uint16_t retries = sd_retries;
+    const uint16_t errors = sd_errors;
+    uint32_t cluster = open(e->id);
+    host_corrupt_blocks(1);
+    CHECK(load_entry(e, cluster) == e->crc, "%.8s.%.3s not loaded intact after a retry",
+          e->base_name, e->ext);
+    CHECK(sd_retries == retries + 1 && sd_errors == errors,
+          "%u retries and %u errors after a corrupt block", sd_retries - retries,
+          sd_errors - errors);
+
+    // without verification, the corrupt block goes unnoticed
+    sd_verify = 0;
+    cluster = open(e->id);
+    host_corrupt_blocks(1);
+    CHECK(load_entry(e, cluster) != e->crc, "corrupt block not loaded without verification");
+    sd_verify = 1;
+
+    // a read is given up on after SD_RETRIES retries
+    host_corrupt_blocks(SD_RETRIES + 1);
+    CHECK(read_sector_to(0, SDCACHE0) != 0xFE && sd_errors == errors + 1,
+          "read of a persistently corrupt block does not fail");
+    CHECK(sd_retries == retries + 1 + SD_RETRIES, "%u retries of a persistently corrupt block",
+          sd_retries - retries - 1);
+
+    // a load is abandoned, rather than continued with the next sector, when
+    // one of its blocks stays corrupt
+    cluster = open(e->id);
+    host_corrupt_blocks(SD_RETRIES + 1);
+    host_reset_stats();
+    CHECK(load_entry(e, cluster) != e->crc && sd_errors == errors + 2 &&
+          host_stats.sectors_read < (e->size + 511) / 512 + SD_RETRIES,
+          "load of %.8s.%.3s with a persistently corrupt block not abandoned", e->base_name, e->ext);
+    host_corrupt_blocks(0);
+}
+
+void sorted_ids(uint16_t total, OpenId open) {
+    // every id is served from the view, in order
+    static uint8_t seen[MAX_ENTRIES];
+    memset(seen, 0x00, sizeof(seen));
+    char prev[MAX_LFN_LENGTH + 1] = "";
+    uint8_t prev_attrib = 0;
+    int unordered = 0;
+    int bad = 0;
+    host_reset_stats();
+    for(uint16_t id=1; id<=total; id++) {
+        open(id);
+        if(id > 1 && sort_order(prev_attrib, prev, _current_attrib, (char*)_filename) > 0) {
+            unordered++;
+        }
+        strcpy(prev, (char*)_filename);
+        prev_attrib = _current_attrib;
+        if(_current_attrib & 0x10) {
+            continue;
+        }
+        const Entry *e = find_entry(_base_name, _ext);
+        if(e == NULL || e->size != _filesize_current_file || seen[e - entries]++) {
+            bad++;
+        }
+    }
+    host_report("open all ids (sorted view)");
+    CHECK(host_stats.sd_commands == 0, "%lu SD commands for ids of the sorted view",
+          (unsigned long)host_stats.sd_commands);
+    CHECK(unordered == 0, "%i entries out of order", unordered);
+    CHECK(bad == 0, "%i entries of the view do not match the folder", bad);
+
+    // the last id opens the program it names
+    const uint32_t cluster = open(total);
+    const Entry *e = find_entry(_base_name, _ext);
+    CHECK(e != NULL && load_entry(e, cluster) == e->crc,
+          "last id of the sorted view not loaded intact");
+}
@@ -0,0 +1,127 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+#ifndef _SUITE_H
+#define _SUITE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Shared parts of the FAT32 engine tests: the manifest of a test image, the
+ * bookkeeping of failed checks and the tests that both engine builds run.
+ * The latter open a listing id through the function of the calling suite.
+ */
+
+#define MAX_ENTRIES 2048
+
+typedef struct {
+    uint16_t id;                    // number shown in a listing
+    char base_name[9];              // 8.3 name padded with spaces
+    char ext[4];
+    uint32_t size;
+    uint16_t crc;                   // CRC-16 of the program in memory
+    char long_name[64];             // empty when the file has no LFN
+} Entry;
+
+extern Entry entries[MAX_ENTRIES];
+extern int nentries;
+extern char folder_name[9];         // folder under test, empty for the root
+extern int failures;
+
+#define CHECK(cond, ...) do {                       \
+    if(!(cond)) {                                   \
+        failures++;                                 \
+        printf("  FAIL %s:%i: ", __FILE__, __LINE__);\
+        printf(__VA_ARGS__);                        \
+        printf("\n");                               \
+    }                                               \
+} while(0)
+
+/**
+ * @brief Read the manifest <image>.txt
+ *
+ * @param image image file
+ * @return 0 on success, -1 on failure
+ */
+int read_manifest(const char *image);
+
+/**
+ * @brief Whether the listing id of the manifest belongs to a CAS or CAD file,
+ *        which are loaded into the RAM bank
+ */
+int is_cas(const Entry *e);
+
+/**
+ * @brief Write the path of an entry of the manifest relative to the root
+ *        folder, such as "FOLDER/NAME.EXT", to a buffer of 22 bytes
+ */
+void entry_path(const Entry *e, char *path);
+
+/**
+ * @brief Entry of the manifest with a DOS 8.3 name, padded with spaces, or
+ *        NULL when there is none
+ */
+const Entry *find_entry(const char *base_name, const char *ext);
+
+/**
+ * @brief Compare two listed entries in the order of the sorted view: the
+ *        parent folder, the folders and then the files, each by name ignoring
+ *        case; returns a negative, zero or positive value as strcmp does
+ */
+int sort_order(uint8_t attrib1, const char *name1, uint8_t attrib2, const char *name2);
+
+/**
+ * @brief Opens the file or folder of a listing id as the launcher does and
+ *        returns its first cluster
+ */
+typedef uint32_t (*OpenId)(uint16_t id);
+
+/**
+ * @brief Load the program of an entry from its first cluster and return the
+ *        CRC-16 of the loaded program
+ */
+uint16_t load_entry(const Entry *e, uint32_t cluster);
+
+/**
+ * @brief Open and load every program of the manifest, reporting the I/O of
+ *        the first and of all programs
+ */
+void load_all(OpenId open);
+
+/**
+ * @brief Load every program of the manifest without multiple block reads
+ */
+void single_block(OpenId open);
+
+/**
+ * @brief Load the largest program with corrupt blocks, with and without
+ *        verification, and read a persistently corrupt block
+ */
+void retries(OpenId open);
+
+/**
+ * @brief Open all ids 1..total of the sorted view of the current folder and
+ *        check that they are served without SD commands, in order and match
+ *        the manifest; the last id is loaded
+ */
+void sorted_ids(uint16_t total, OpenId open);
+
+#endif // _SUITE_H
@@ -0,0 +1,404 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * Tests of the FAT32 engine of the launcher (src/fat32.c) against the images
+ * generated by mkimages.py. Besides checking the listings, the loaded
+ * programs and a saved program, the I/O of every operation is reported.
+ */
+
+#include <stdlib.h>
+
+#include "../src/fat32.h"
+#include "../src/fatwrite.h"
+#include "../src/fatfile.h"
+#include "../src/bootcfg.h"
+#include "../src/fatsort.h"
+#include "../src/fatpath.h"
+#include "../src/freespace.h"
+#include "host.h"
+#include "suite.h"
+
+static void mount(void) {
+    host_reset_stats();
+    read_partition(read_mbr());
+    host_report("mount");
+    CHECK(_flag_sdcard_mounted, "card not mounted");
+
+    if(folder_name[0]) {
+        host_reset_stats();
+        uint32_t cluster = find_file(_root_dir_first_cluster, folder_name, "   ");
+        host_report("find folder by name");
+        CHECK(cluster != 0 && (_current_attrib & 0x10), "folder %s not found", folder_name);
+        _current_folder_cluster = cluster;
+    }
+}
+
+static void free_space(void) {
+    host_reset_stats();
+    freespace_mount();
+    host_report("free space (FSInfo)");
+    CHECK(_free_source == FREE_FSINFO && _free_clusters <= _total_clusters,
+          "free space not taken from FSInfo");
+    const uint32_t nfree = _free_clusters;
+
+    // without a count in FSInfo, the FAT is counted while idle
+    read_sector(_fsinfo_lba);
+    ram_write_uint16_t(SDCACHE0 + FSINFO_FREE_COUNT, 0xFFFF);
+    ram_write_uint16_t(SDCACHE0 + FSINFO_FREE_COUNT + 2, 0xFFFF);
+    write_sector_from(_fsinfo_lba, SDCACHE0);
+    freespace_mount();
+    CHECK(_free_clusters == FREE_UNKNOWN, "invalid FSInfo count accepted");
+    const uint16_t sectors = freespace_remaining();
+
+    // a failed read stops the idle scan, which resumes upon request
+    host_reset_stats();
+    freespace_idle();
+    host_corrupt_blocks(SD_RETRIES + 1);
+    freespace_idle();
+    freespace_idle();
+    CHECK(freespace_remaining() == sectors - 1, "idle scan continues after a failed read");
+    CHECK(freespace_scan(0xFFFF) == 1, "scan of the FAT failed");
+    host_report("free space (FAT scan)");
+    CHECK(_free_source == FREE_SCAN && _free_clusters == nfree,
+          "FAT scan counts %lu free clusters, FSInfo %lu", (unsigned long)_free_clusters,
+          (unsigned long)nfree);
+
+    // the count is kept in FSInfo for the next mount
+    freespace_mount();
+    CHECK(_free_source == FREE_FSINFO && _free_clusters == nfree, "count not stored in FSInfo");
+}
+
+static void listing(void) {
+    // a subfolder also lists '..'
+    const unsigned total = nentries + (folder_name[0] ? 1 : 0);
+    char summary[40];
+    snprintf(summary, sizeof(summary), "%6u File(s)", total);
+
+    host_reset_log();
+    host_reset_stats();
+    read_folder(-1, 0);
+    host_report("ls");
+    CHECK(strstr(host_log(), summary) != NULL, "ls does not report %u files", total);
+    CHECK(_handle_table_count == (total < HANDLE_TABLE_ENTRIES ? total : HANDLE_TABLE_ENTRIES),
+          "handle table holds %u entries", _handle_table_count);
+
+    // the launcher shows the first 24 characters of a long name
+    int missing = 0;
+    for(int i=0; i<nentries; i++) {
+        char name[25];
+        snprintf(name, sizeof(name), "%.24s", entries[i].long_name);
+        if(name[0] && !strstr(host_log(), name)) {
+            missing++;
+        }
+    }
+    CHECK(missing == 0, "%i long names not listed", missing);
+
+    host_reset_log();
+    host_reset_stats();
+    read_folder(-1, 1);
+    host_report("lscas");
+    CHECK(strstr(host_log(), summary) != NULL, "lscas does not report %u files", total);
+}
+
+static void lookup(void) {
+    const Entry *last = &entries[nentries - 1];
+    uint32_t cluster;
+
+    host_reset_stats();
+    cluster = read_folder(last->id, 0);
+    host_report(last->id <= HANDLE_TABLE_ENTRIES ? "open last id (handle table)" :
+                                                   "open last id (scan)");
+    CHECK(_filesize_current_file == last->size, "id %u has size %lu", last->id,
+          (unsigned long)_filesize_current_file);
+
+    _handle_table_cluster = 0;
+    host_reset_stats();
+    uint32_t scanned = read_folder(last->id, 0);
+    host_report("open last id (no listing)");
+    CHECK(scanned == cluster, "scan and handle table disagree on id %u", last->id);
+
+    host_reset_stats();
+    cluster = find_file(_current_folder_cluster, last->base_name, last->ext);
+    host_report("find last file by name");
+    CHECK(cluster == scanned, "%.8s.%.3s not found by name", last->base_name, last->ext);
+
+    char path[22];
+    entry_path(last, path);
+    host_reset_stats();
+    cluster = find_path(path);
+    host_report("find last file by path");
+    CHECK(cluster == scanned && !(_current_attrib & 0x10), "%s not found by path", path);
+    CHECK(find_path("NOSUCH/FILE.CAS") == 0, "path to a missing folder resolved");
+}
+
+static void paths(void) {
+    const Entry *last = &entries[nentries - 1];
+    const uint32_t folder = _current_folder_cluster;
+    const uint32_t expected = find_file(folder, last->base_name, last->ext);
+    char name[22];
+    char path[32];
+
+    entry_path(last, name);
+    snprintf(path, sizeof(path), "/%s", name);
+    dircache_reset();
+    host_reset_stats();
+    uint32_t cluster = resolve_path(path, 0);
+    host_report("resolve last file by path");
+    CHECK(cluster == expected && _filesize_current_file == last->size, "%s not resolved", path);
+
+    host_reset_stats();
+    cluster = resolve_path(path, 0);
+    host_report("resolve last file by path (cached)");
+    CHECK(cluster == expected && _filesize_current_file == last->size &&
+          memcmp(_ext, last->ext, 3) == 0, "%s not resolved from the cache", path);
+    CHECK(host_stats.sd_commands == 0, "%lu SD commands for a cached path",
+          (unsigned long)host_stats.sd_commands);
+
+    // a path relative to the current folder, with "." and ".."
+    snprintf(path, sizeof(path), "./%s%s", folder_name[0] ? "../" : "", name);
+    CHECK(resolve_path(path, 0) == expected, "%s not resolved", path);
+    CHECK(resolve_path("NOSUCH/FILE.CAS", 0) == 0, "path to a missing folder resolved");
+    snprintf(path, sizeof(path), "/%s/X", name);
+    CHECK(resolve_path(path, 0) == 0, "path through a file resolved");
+
+    // changing folders leaves the parent on the recent stack
+    _current_folder_cluster = _root_dir_first_cluster;
+    recent_reset();
+    if(folder_name[0]) {
+        cluster = resolve_path(folder_name, 1);
+        CHECK(cluster == folder && _recent_depth == 1, "cd %s does not enter the folder", folder_name);
+        _current_folder_cluster = cluster;
+        host_reset_stats();
+        cluster = resolve_path("..", 1);
+        host_report("cd .. (recent stack)");
+        CHECK(cluster == _root_dir_first_cluster && _recent_depth == 0, "cd .. does not return to the root");
+        CHECK(host_stats.sd_commands == 0, "%lu SD commands for cd ..", (unsigned long)host_stats.sd_commands);
+        _current_folder_cluster = cluster;
+    }
+    CHECK(resolve_path(name, 1) == 0 && _recent_depth == 0, "cd into a file succeeded");
+    CHECK(resolve_path("/", 1) == _root_dir_first_cluster, "cd / does not enter the root");
+
+    _current_folder_cluster = folder;
+    recent_reset();
+}
+
+// opens a listing id as the cd and run commands do
+static uint32_t open_id(uint16_t id) {
+    return read_folder(id, 0);
+}
+
+static void sorted(void) {
+    const unsigned total = nentries + (folder_name[0] ? 1 : 0);
+    char summary[40];
+    snprintf(summary, sizeof(summary), "%6u File(s)", total);
+
+    _sort_enabled = 1;
+    _handle_table_cluster = 0;
+    host_reset_log();
+    host_reset_stats();
+    read_folder(-1, 0);
+    host_report("ls sorted");
+    CHECK(strstr(host_log(), summary) != NULL, "sorted ls does not report %u files", total);
+    CHECK(_handle_table_count == total, "sorted view holds %u entries", _handle_table_count);
+
+    sorted_ids(total, open_id);
+
+    host_reset_stats();
+    read_folder(-1, 0);
+    host_report("ls sorted (view)");
+    CHECK(host_stats.sd_commands == 0, "%lu SD commands for a listing of the sorted view",
+          (unsigned long)host_stats.sd_commands);
+
+    _sort_enabled = 0;
+    _handle_table_cluster = 0;
+}
+
+static void handles(void) {
+    // the largest file, whose chain is claimed to be a cluster longer
+    const Entry *e = &entries[0];
+    for(int i=1; i<nentries; i++) {
+        if(entries[i].size > e->size) {
+            e = &entries[i];
+        }
+    }
+    const uint32_t cluster = open_id(e->id);
+    const uint16_t nrsectors = (e->size + 511) / 512;
+    const uint16_t beyond = ((nrsectors + _sectors_per_cluster - 1) >> _cluster_shift) << _cluster_shift;
+
+    CHECK(file_open(cluster, FILE_MAX_SIZE + 1) < 0, "file larger than FILE_MAX_SIZE opened");
+
+    const int8_t fh = file_open(cluster, (uint32_t)(beyond + _sectors_per_cluster) * 512);
+    CHECK(fh >= 0, "%.8s.%.3s not opened", e->base_name, e->ext);
+    if(fh < 0) {
+        return;
+    }
+    CHECK(file_sector_address(fh, 0) == calculate_sector_address(cluster, 0),
+          "first sector of %.8s.%.3s misplaced", e->base_name, e->ext);
+    CHECK(file_sector_address(fh, nrsectors - 1) != FILE_NO_ADDRESS,
+          "last sector of %.8s.%.3s not resolved", e->base_name, e->ext);
+    CHECK(file_sector_address(fh, beyond) == FILE_NO_ADDRESS,
+          "sector beyond the chain of %.8s.%.3s resolved", e->base_name, e->ext);
+    CHECK(file_sector_address(fh, nrsectors - 1) != FILE_NO_ADDRESS,
+          "chain of %.8s.%.3s lost after the end of chain", e->base_name, e->ext);
+    file_close(fh);
+}
+
+static void save(void) {
+    // a program of three records, laid out as command_save does
+    const uint16_t length = 2500;
+    uint8_t program[2500];
+    for(unsigned i=0; i<length; i++) {
+        program[i] = rand();
+    }
+    memset(host_extram[1], 0x00, 0x10000);
+    for(unsigned r=0; r<3; r++) {
+        uint8_t *record = &host_extram[1][r * 0x500];
+        record[0x30] = 0x47;
+        record[0x31] = 0x65;
+        record[0x32] = length & 0xFF;
+        record[0x33] = length >> 8;
+        memcpy(&record[0x100], &program[r * 1024], r < 2 ? 1024 : length - 2048);
+    }
+
+    host_reset_stats();
+    uint8_t res = fat_write_file("SAVED   ", "CAS", RAM_BANK_CASSETTE, 0x0000, 3 * 0x500);
+    printf("  %-34s %6llu SD cmds %6llu sectors written\n", "save",
+           (unsigned long long)host_stats.sd_commands,
+           (unsigned long long)host_stats.sectors_written);
+    CHECK(res == WRITE_OK, "save failed with error %u", res);
+    CHECK(ram_bank == RAM_BANK_CACHE, "save leaves RAM bank %u selected", ram_bank);
+    res = fat_write_file("SAVED   ", "CAS", RAM_BANK_CASSETTE, 0x0000, 3 * 0x500);
+    CHECK(res == WRITE_EXISTS, "saving under a taken name gives %u", res);
+
+    // found by name and loaded intact
+    const uint32_t cluster = find_file(_current_folder_cluster, "SAVED   ", "CAS");
+    CHECK(cluster != 0 && _filesize_current_file == 3 * 0x500, "saved file not found");
+    if(cluster == 0) {
+        return;
+    }
+    memset(host_extram[1], 0x00, 0x10000);
+    set_ram_bank(RAM_BANK_CASSETTE);
+    store_cas_ram(cluster, 0x0000);
+    set_ram_bank(RAM_BANK_CACHE);
+    CHECK(memcmp(host_extram[1], program, length) == 0, "saved program not loaded intact");
+
+    // a contiguous chain, of which every copy of the FAT agrees
+    uint32_t c = cluster;
+    uint32_t next;
+    unsigned breaks = 0;
+    while((next = read_next_cluster(c)) < 0x0FFFFFF8) {
+        breaks += next != c + 1;
+        c = next;
+    }
+    CHECK(breaks == 0, "saved file is split over %u runs", breaks + 1);
+    int differ = 0;
+    for(uint32_t s=cluster >> 7; s<=(c >> 7); s++) {
+        read_sector_to(_fat_begin_lba + s, SDCACHE0);
+        read_sector_to(_fat_begin_lba + _sectors_per_fat + s, SDCACHE2);
+        differ |= memcmp(&host_extram[0][SDCACHE0], &host_extram[0][SDCACHE2], 512);
+    }
+    CHECK(differ == 0, "copies of the FAT differ");
+
+    // FSInfo points past the chain and agrees with the free space shown
+    read_sector(_fsinfo_lba);
+    CHECK(ram_read_uint32_t(SDCACHE0 + FSINFO_NEXT_FREE) == c + 1,
+          "FSInfo next free is %u after a chain ending at %u",
+          ram_read_uint32_t(SDCACHE0 + FSINFO_NEXT_FREE), c);
+    CHECK(ram_read_uint32_t(SDCACHE0 + FSINFO_FREE_COUNT) == _free_clusters && _free_hint == c + 1,
+          "%lu free clusters shown, FSInfo holds %u", (unsigned long)_free_clusters,
+          ram_read_uint32_t(SDCACHE0 + FSINFO_FREE_COUNT));
+}
+
+static void config(void) {
+    static const char text[] =
+        "# kiosk\r\n"
+        "folder = GAMES/ARCADE\r\n"
+        "AUTOBOOT=\n"
+        "\n"
+        "warm=FAT, DIR\n"
+        "  ; RUN=cd 1\n"
+        "COLOUR=1\n"
+        "RUN=ls   ";
+    static const struct {
+        uint8_t key;
+        const char *value;
+    } expected[] = {
+        {BOOTCFG_FOLDER, "GAMES/ARCADE"}, {BOOTCFG_AUTOBOOT, ""}, {BOOTCFG_WARM, "FAT, DIR"},
+        {BOOTCFG_UNKNOWN, "1"}, {BOOTCFG_RUN, "ls"}, {BOOTCFG_END, ""},
+    };
+
+    copy_to_ram((uint8_t*)text, SDCACHE2, sizeof(text) - 1);
+    const uint8_t res = fat_write_file(BOOTCFG_BASENAME, BOOTCFG_EXT, RAM_BANK_CACHE, SDCACHE2,
+                                       sizeof(text) - 1);
+    CHECK(res == WRITE_OK, "writing the configuration failed with error %u", res);
+
+    const uint32_t cluster = find_file(_current_folder_cluster, BOOTCFG_BASENAME, BOOTCFG_EXT);
+    CHECK(cluster != 0 && bootcfg_open(calculate_sector_address(cluster, 0),
+                                       _filesize_current_file) == 0, "configuration not read");
+
+    CHECK(bootcfg_open(calculate_sector_address(cluster, 0), BOOTCFG_MAXSIZE + 1) == BOOTCFG_TOOLONG &&
+          bootcfg_next(NULL) == BOOTCFG_END, "oversized configuration not rejected");
+    CHECK(bootcfg_open(calculate_sector_address(cluster, 0), _filesize_current_file) == 0,
+          "configuration not reopened");
+
+    char value[BOOTCFG_VALUE];
+    for(unsigned i=0; i<sizeof(expected) / sizeof(expected[0]); i++) {
+        const uint8_t key = bootcfg_next(value);
+        CHECK(key == expected[i].key && (key == BOOTCFG_END || strcmp(value, expected[i].value) == 0),
+              "setting %u reads key %u with value '%s'", i, key, key == BOOTCFG_END ? "" : value);
+    }
+    CHECK(bootcfg_warm("FAT, DIR") == (BOOTCFG_WARM_FAT | BOOTCFG_WARM_DIR), "WARM list not parsed");
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: test_fat32 image...\n");
+        return 2;
+    }
+
+    for(int i=1; i<argc; i++) {
+        if(read_manifest(argv[i]) != 0 || host_open(argv[i]) != 0) {
+            printf("%s: cannot open image or manifest\n", argv[i]);
+            failures++;
+            continue;
+        }
+        printf("%s (launcher)\n", argv[i]);
+
+        mount();
+        free_space();
+        listing();
+        lookup();
+        paths();
+        read_folder(-1, 0);     // ids are resolved as after an 'ls'
+        load_all(open_id);
+        sorted();
+        single_block(open_id);
+        retries(open_id);
+        handles();
+        save();
+        config();
+
+        host_close();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
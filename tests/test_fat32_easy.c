@@ -0,0 +1,227 @@
+/**************************************************************************
+ *                                                                        *
+ *   Author: Ivo Filot <ivo@ivofilot.nl>                                  *
+ *                                                                        *
+ *   P2000T-SDCARD is free software:                                      *
+ *   you can redistribute it and/or modify it under the terms of the      *
+ *   GNU General Public License as published by the Free Software         *
+ *   Foundation, either version 3 of the License, or (at your option)     *
+ *   any later version.                                                   *
+ *                                                                        *
+ *   P2000T-SDCARD is distributed in the hope that it will be useful,     *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty          *
+ *   of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.              *
+ *   See the GNU General Public License for more details.                 *
+ *                                                                        *
+ *   You should have received a copy of the GNU General Public License    *
+ *   along with this program.  If not, see http://www.gnu.org/licenses/.  *
+ *                                                                        *
+ **************************************************************************/
+
+/*
+ * Tests of the FAT32 engine as built for the easy launcher (FAT_PAGES) against
+ * the images generated by mkimages.py. Besides checking the pages and the
+ * loaded programs, the I/O of every operation is reported.
+ */
+
+#include <stdlib.h>
+
+#include "../src/fat32.h"
+#include "../src/progress.h"
+#include "../src/fatsort.h"
+#include "host.h"
+#include "suite.h"
+
+static unsigned total;              // entries in the folder, including '..'
+
+static void mount(void) {
+    host_reset_stats();
+    read_partition(read_mbr());
+    build_linked_list(_current_folder_cluster);
+    host_report("mount");
+
+    if(folder_name[0]) {
+        host_reset_stats();
+        uint32_t cluster = find_file(_current_folder_cluster, folder_name, "   ");
+        host_report("find folder by name");
+        CHECK(cluster != 0, "folder %s not found", folder_name);
+        _current_folder_cluster = cluster;
+        build_linked_list(_current_folder_cluster);
+    }
+    total = nentries + (folder_name[0] ? 1 : 0);
+}
+
+// whether the name of an entry is shown on the current page
+static int displayed(const Entry *e) {
+    char name[27];
+    if(e->long_name[0]) {
+        snprintf(name, sizeof(name), "%.26s", e->long_name);
+    } else {
+        snprintf(name, sizeof(name), "%.8s", e->base_name);
+        name[strcspn(name, " ")] = 0;
+    }
+
+    const int line = (e->id - 1) % PAGE_SIZE + 1 + DISPLAY_OFFSET;
+    return strstr(&vidmem[0x50 * line + 4], name) != NULL;
+}
+
+static void pages(void) {
+    host_reset_stats();
+    find_file(_current_folder_cluster, "AUTOBOOT", "CAS");
+    host_report("count pages");
+    CHECK(_num_of_pages == (total + PAGE_SIZE - 1) / PAGE_SIZE,
+          "%u pages counted for %u entries", _num_of_pages, total);
+
+    memset(vidmem, 0x00, 0x1000);
+    host_reset_stats();
+    display_folder(1, 0);
+    host_report("display first page");
+    CHECK(displayed(&entries[0]), "first entry not displayed");
+
+    memset(vidmem, 0x00, 0x1000);
+    host_reset_stats();
+    display_folder(_num_of_pages, 0);
+    host_report("display last page");
+    CHECK(displayed(&entries[nentries - 1]), "last entry not displayed");
+
+    // every page shows its own entries
+    int missing = 0;
+    for(uint8_t page=1; page<=_num_of_pages; page++) {
+        memset(vidmem, 0x00, 0x1000);
+        display_folder(page, 0);
+        for(int i=0; i<nentries; i++) {
+            if((entries[i].id - 1) / PAGE_SIZE + 1 == page && !displayed(&entries[i])) {
+                missing++;
+            }
+        }
+    }
+    CHECK(missing == 0, "%i entries not displayed on their page", missing);
+}
+
+static uint32_t open_id(uint16_t id) {
+    return read_folder(id, 0);
+}
+
+static void lookup(void) {
+    const Entry *last = &entries[nentries - 1];
+
+    host_reset_stats();
+    const uint32_t cluster = open_id(last->id);
+    host_report("open last id");
+    CHECK(_filesize_current_file == last->size, "id %u has size %lu", last->id,
+          (unsigned long)_filesize_current_file);
+
+    host_reset_stats();
+    const uint32_t found = find_file(_current_folder_cluster, last->base_name, last->ext);
+    host_report("find last file by name");
+    CHECK(found == cluster, "%.8s.%.3s not found by name", last->base_name, last->ext);
+
+    char path[22];
+    entry_path(last, path);
+    host_reset_stats();
+    const uint32_t resolved = find_path(path);
+    host_report("find last file by path");
+    CHECK(resolved == cluster && !(_current_attrib & 0x10), "%s not found by path", path);
+    CHECK(find_path("NOSUCH/FILE.CAS") == 0, "path to a missing folder resolved");
+
+    // as after booting, restore the list and the pages of the current folder
+    build_linked_list(_current_folder_cluster);
+    display_folder(1, 1);
+}
+
+static void sorted(void) {
+    _sort_enabled = 1;
+    _handle_table_cluster = 0;
+    host_reset_stats();
+    display_folder(1, 1);
+    host_report("display first page sorted");
+    CHECK(_num_of_pages == (total + PAGE_SIZE - 1) / PAGE_SIZE,
+          "%u pages for %u entries in the sorted view", _num_of_pages, total);
+
+    // the pages are served from the view
+    int missing = 0;
+    host_reset_stats();
+    for(uint8_t page=1; page<=_num_of_pages; page++) {
+        memset(vidmem, 0x00, 0x1000);
+        display_folder(page, 0);
+        for(uint8_t row=1; row<=PAGE_SIZE; row++) {
+            const uint16_t id = (page - 1) * PAGE_SIZE + row;
+            if(id > total) {
+                break;
+            }
+            open_id(id);
+            char name[27];
+            snprintf(name, sizeof(name), "%s", _base_name[1] == '.' ? "(terug)" : (char*)_filename);
+            if(!strstr(&vidmem[0x50 * (row + DISPLAY_OFFSET) + 4], name)) {
+                missing++;
+            }
+        }
+    }
+    host_report("display all pages sorted");
+    CHECK(host_stats.sd_commands == 0, "%lu SD commands for pages of the sorted view",
+          (unsigned long)host_stats.sd_commands);
+    CHECK(missing == 0, "%i entries not displayed on their page", missing);
+
+    // the ids are served from the view, in order
+    sorted_ids(total, open_id);
+
+    _sort_enabled = 0;
+    _handle_table_cluster = 0;
+    display_folder(1, 1);
+}
+
+static void progress(void) {
+    // the largest file, drawn on the status row as done by the easy launcher
+    const Entry *e = &entries[0];
+    const uint16_t nrsectors = (e->size + 511) / 512;
+    char *row = &vidmem[0x50 * 23];
+    memset(row, 0x00, 0x50);
+
+    uint32_t cluster = open_id(e->id);
+    progress_start(row, nrsectors);
+    CHECK(load_entry(e, cluster) == e->crc, "%.8s.%.3s not loaded intact with a progress indicator",
+          e->base_name, e->ext);
+    progress_stop();
+
+    char expected[PROGRESS_WIDTH + 1];
+    snprintf(expected, sizeof(expected), "%5u/%-6u", nrsectors, nrsectors);
+    memset(&expected[12], PROGRESS_FULL, PROGRESS_BAR);
+    CHECK(memcmp(row, expected, PROGRESS_WIDTH) == 0 && row[PROGRESS_WIDTH] == 0x00,
+          "progress indicator reads '%.*s'", PROGRESS_WIDTH, row);
+
+    // without an active indicator, streaming leaves the screen alone
+    memset(row, 0x00, 0x50);
+    cluster = open_id(e->id);
+    load_entry(e, cluster);
+    CHECK(row[0] == 0x00 && row[12] == 0x00, "inactive progress indicator drawn");
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: test_fat32_easy image...\n");
+        return 2;
+    }
+
+    for(int i=1; i<argc; i++) {
+        if(read_manifest(argv[i]) != 0 || host_open(argv[i]) != 0) {
+            printf("%s: cannot open image or manifest\n", argv[i]);
+            failures++;
+            continue;
+        }
+        printf("%s (easy launcher)\n", argv[i]);
+
+        mount();
+        pages();
+        lookup();
+        sorted();
+        load_all(open_id);
+        single_block(open_id);
+        retries(open_id);
+        progress();
+
+        host_close();
+    }
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}